@@ -122,6 +122,12 @@ else()
     )
 endif()
 
+#--- CONFIGURE HEADLESS
+add_library(LabSoundHeadless STATIC
+    "${LABSOUND_ROOT}/src/backends/headless/AudioDevice_Headless.cpp"
+    "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_Headless.h"
+)
+
 if (APPLE)
     set_target_properties(LabSound PROPERTIES
         FRAMEWORK TRUE
@@ -240,6 +246,20 @@ target_include_directories(LabSoundMiniAudio PRIVATE
     ${LABSOUND_ROOT}/third_party
     ${LABSOUND_ROOT}/third_party/libnyquist/include)
 
+target_include_directories(LabSoundHeadless PUBLIC
+    $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+    $<INSTALL_INTERFACE:include>
+)
+
+target_include_directories(LabSoundHeadless PRIVATE
+    ${LABSOUND_ROOT}/src
+    ${LABSOUND_ROOT}/src/internal)
+
+if (LINUX)
+    # shm_open
+    target_link_libraries(LabSoundHeadless PRIVATE rt)
+endif()
+
 if (MSVC_IDE)
     # hack to get around the "Debug" and "Release" directories cmake tries to add on Windows
     set_target_properties(LabSound PROPERTIES IMPORT_PREFIX "../")
@@ -256,6 +276,7 @@ target_link_libraries(LabSound
 
 configureProj(LabSound)
 configureProj(LabSoundMiniAudio)
+configureProj(LabSoundHeadless)
 if (NOT IOS)
     configureProj(LabSoundRtAudio)
 endif()
@@ -267,6 +288,7 @@ install(FILES ${labsnd_core_h}
 install(FILES ${labsnd_extended_h}
     DESTINATION include/LabSound/extended)
 install(FILES
+    "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_Headless.h"
     "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_Miniaudio.h"
     "${LABSOUND_ROOT}/include/LabSound/backends/AudioDevice_RtAudio.h"
    DESTINATION include/LabSound/backends)
@@ -294,6 +316,7 @@ source_group(third_party\\rtaudio FILES ${third_rtaudio})
 
 add_library(LabSound::LabSound ALIAS LabSound)
 add_library(LabSoundMiniAudio::LabSoundMiniAudio ALIAS LabSoundMiniAudio)
+add_library(LabSoundHeadless::LabSoundHeadless ALIAS LabSoundHeadless)
 if (NOT IOS)
     add_library(LabSoundRtAudio::LabSoundRtAudio ALIAS LabSoundRtAudio)
 endif()
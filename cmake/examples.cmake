@@ -96,3 +96,54 @@ set_property(TARGET LabSoundExample PROPERTY FOLDER "examples")
 install(TARGETS LabSoundExample
     BUNDLE DESTINATION bin
     RUNTIME DESTINATION bin)
+
+# Offline benchmark and regression runner for the example graphs.
+# Run with --record on the reference platform to (re)write the golden file.
+# Without the golden file, or an entry for a graph, the run fails.
+
+add_executable(LabSoundBenchmark "${LABSOUND_ROOT}/examples/src/ExamplesBenchmark.cpp")
+target_link_libraries(LabSoundBenchmark LabSound)
+if(WIN32)
+    target_compile_definitions(LabSoundBenchmark PRIVATE HAVE_STDINT_H=1 HAVE_SINF=1)
+elseif(APPLE)
+    target_link_libraries(LabSoundBenchmark ${DARWIN_LIBS})
+elseif(UNIX)
+    target_link_libraries(LabSoundBenchmark pthread)
+    target_compile_options(LabSoundBenchmark PRIVATE -fPIC)
+    target_compile_definitions(LabSoundBenchmark PRIVATE USE_KISS_FFT=1 HAVE_STDINT_H=1 HAVE_SETENV=1 HAVE_SINF=1)
+endif()
+if(MINGW)
+    target_link_libraries(LabSoundBenchmark mfuuid mfplat ksuser wmcodecdspuuid)
+endif(MINGW)
+set_target_properties(LabSoundBenchmark PROPERTIES
+                      RUNTIME_OUTPUT_DIRECTORY bin)
+target_compile_definitions(LabSoundBenchmark PRIVATE
+    SAMPLE_SRC_DIR="${LABSOUND_ROOT}/assets"
+    LABSOUND_BENCHMARK_GOLDEN="${LABSOUND_ROOT}/examples/benchmark_golden.txt")
+set_property(TARGET LabSoundBenchmark PROPERTY FOLDER "examples")
+
+# Microbenchmarks of the DSP kernels. These use LabSound's internal headers,
+# so the target mirrors the library's private include directories.
+
+add_executable(LabSoundKernelBenchmark "${LABSOUND_ROOT}/examples/src/ExamplesKernelBenchmark.cpp")
+target_link_libraries(LabSoundKernelBenchmark LabSound)
+target_include_directories(LabSoundKernelBenchmark PRIVATE
+    ${LABSOUND_ROOT}/src
+    ${LABSOUND_ROOT}/src/internal
+    ${LABSOUND_ROOT}/third_party)
+if(WIN32)
+    target_compile_definitions(LabSoundKernelBenchmark PRIVATE HAVE_STDINT_H=1 HAVE_SINF=1)
+elseif(APPLE)
+    target_link_libraries(LabSoundKernelBenchmark ${DARWIN_LIBS})
+elseif(UNIX)
+    target_link_libraries(LabSoundKernelBenchmark pthread)
+    target_compile_options(LabSoundKernelBenchmark PRIVATE -fPIC)
+    target_compile_definitions(LabSoundKernelBenchmark PRIVATE USE_KISS_FFT=1 HAVE_STDINT_H=1 HAVE_SETENV=1 HAVE_SINF=1)
+endif()
+if(MINGW)
+    target_link_libraries(LabSoundKernelBenchmark mfuuid mfplat ksuser wmcodecdspuuid)
+endif(MINGW)
+set_target_properties(LabSoundKernelBenchmark PROPERTIES
+                      RUNTIME_OUTPUT_DIRECTORY bin)
+target_compile_definitions(LabSoundKernelBenchmark PRIVATE SAMPLE_SRC_DIR="${LABSOUND_ROOT}/assets")
+set_property(TARGET LabSoundKernelBenchmark PROPERTY FOLDER "examples")
@@ -0,0 +1,416 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+// Renders the graphs of several examples on an offline context, reports
+// their cost, and compares their output against a golden file.
+//
+//   LabSoundBenchmark [--seconds s] [--iterations n] [--golden path] [--record]
+//                     [--exact] [--perf-tolerance percent] [graph ...]
+//
+// Each graph renders `seconds` of audio, `iterations` times. The cost is
+// reported as nanoseconds per render quantum and as a realtime factor, the
+// number of seconds of audio rendered per second of wall clock.
+//
+// The output of the first iteration is hashed. --record writes the hashes,
+// the output's rms and the cost to the golden file; otherwise the run is
+// compared against it. A hash mismatch is reported as a failure if --exact is
+// given, and otherwise passes if the rms is within tolerance, since summation
+// order and fused multiply-add differ between compilers and fft backends.
+// Graphs that draw random numbers are only ever compared by rms. A graph
+// whose cost exceeds the recorded cost by more than the perf tolerance fails,
+// as does a graph missing from the golden file, or every graph if the file
+// can't be read.
+//
+// The exit code is the number of failing graphs.
+
+#include "LabSound/LabSound.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace lab;
+
+namespace
+{
+    const float kSampleRate = 48000.f;
+    const int kChannels = 2;
+    const int kQuantum = AudioNode::ProcessingSizeInFrames;
+
+    std::shared_ptr<AudioBus> LoadSample(const char * name)
+    {
+        std::string path = std::string(SAMPLE_SRC_DIR) + "/" + name;
+        std::shared_ptr<AudioBus> bus = MakeBusFromFile(path, false);
+        if (!bus)
+            throw std::runtime_error("couldn't open " + path);
+        return bus;
+    }
+
+    // a graph under test. build() connects the graph's output to the
+    // destination. If set, animate() is called before each quantum is rendered.
+    struct BenchmarkGraph
+    {
+        const char * name;
+        bool deterministic;
+        std::function<void(AudioContext &, std::shared_ptr<AudioDestinationNode> &, std::vector<std::shared_ptr<AudioNode>> &)> build;
+        std::function<void(std::vector<std::shared_ptr<AudioNode>> &, double t, double duration)> animate;
+    };
+
+    std::vector<BenchmarkGraph> MakeGraphs()
+    {
+        std::vector<BenchmarkGraph> graphs;
+
+        // ex_offline_rendering: a sine through a gain, mixed with a music clip
+        graphs.push_back({"offline_rendering", true,
+            [](AudioContext & ac, std::shared_ptr<AudioDestinationNode> & dest, std::vector<std::shared_ptr<AudioNode>> & nodes)
+            {
+                auto musicClip = LoadSample("samples/stereo-music-clip.wav");
+
+                auto gain = std::make_shared<GainNode>(ac);
+                gain->gain()->setValue(0.125f);
+
+                auto oscillator = std::make_shared<OscillatorNode>(ac);
+                oscillator->frequency()->setValue(880.f);
+                oscillator->setType(OscillatorType::SINE);
+                oscillator->start(0.0f);
+
+                auto musicClipNode = std::make_shared<SampledAudioNode>(ac);
+                musicClipNode->setBus(musicClip);
+                musicClipNode->schedule(0.0, -1);
+
+                ac.connect(gain, oscillator, 0, 0);
+                ac.connect(dest, gain, 0, 0);
+                ac.connect(dest, musicClipNode, 0, 0);
+                nodes = {gain, oscillator, musicClipNode};
+            },
+            nullptr});
+
+        // ex_convolution_reverb: a voice, dry and through a convolver
+        graphs.push_back({"convolution_reverb", true,
+            [](AudioContext & ac, std::shared_ptr<AudioDestinationNode> & dest, std::vector<std::shared_ptr<AudioNode>> & nodes)
+            {
+                auto impulseResponseClip = LoadSample("impulse/cardiod-rear-levelled.wav");
+                auto voiceClip = LoadSample("samples/voice.ogg");
+
+                auto convolve = std::make_shared<ConvolverNode>(ac);
+                convolve->setImpulse(impulseResponseClip);
+
+                auto wetGain = std::make_shared<GainNode>(ac);
+                wetGain->gain()->setValue(0.5f);
+                auto dryGain = std::make_shared<GainNode>(ac);
+                dryGain->gain()->setValue(0.1f);
+                auto outputGain = std::make_shared<GainNode>(ac);
+                outputGain->gain()->setValue(0.5f);
+
+                auto voiceNode = std::make_shared<SampledAudioNode>(ac);
+                voiceNode->setBus(voiceClip);
+                voiceNode->schedule(0.0, -1);
+
+                ac.connect(wetGain, convolve, 0, 0);
+                ac.connect(outputGain, wetGain, 0, 0);
+                ac.connect(outputGain, dryGain, 0, 0);
+                ac.connect(convolve, dryGain, 0, 0);
+                ac.connect(dryGain, voiceNode, 0, 0);
+                ac.connect(dest, outputGain, 0, 0);
+                nodes = {convolve, wetGain, dryGain, outputGain, voiceNode};
+            },
+            nullptr});
+
+        // ex_hrtf_spatialization: a looping clip swept past the listener
+        graphs.push_back({"hrtf_spatialization", true,
+            [](AudioContext & ac, std::shared_ptr<AudioDestinationNode> & dest, std::vector<std::shared_ptr<AudioNode>> & nodes)
+            {
+                if (!ac.loadHrtfDatabase(std::string(SAMPLE_SRC_DIR) + "/hrtf"))
+                    throw std::runtime_error("couldn't load the hrtf database");
+
+                auto audioClip = LoadSample("samples/trainrolling.wav");
+                auto audioClipNode = std::make_shared<SampledAudioNode>(ac);
+                auto panner = std::make_shared<PannerNode>(ac);
+                panner->setPanningModel(PanningModel::HRTF);
+                audioClipNode->setBus(audioClip);
+                audioClipNode->schedule(0.0, -1);
+
+                ac.connect(panner, audioClipNode, 0, 0);
+                ac.connect(dest, panner, 0, 0);
+
+                ac.listener()->setPosition({0, 0, 0});
+                panner->setVelocity(4, 0, 0);
+                nodes = {panner, audioClipNode};
+            },
+            [](std::vector<std::shared_ptr<AudioNode>> & nodes, double t, double duration)
+            {
+                // as in the example, move every 10ms
+                const double step = 0.01;
+                if (std::fmod(t, step) >= kQuantum / kSampleRate)
+                    return;
+                float x = static_cast<float>((t - duration * 0.5) / (duration * 0.5));
+                std::static_pointer_cast<PannerNode>(nodes[0])->setPosition({x, 0.1f, 0.1f});
+            }});
+
+        // ex_granulation_node: grain positions are random, so compare by rms only
+        graphs.push_back({"granulation_node", false,
+            [](AudioContext & ac, std::shared_ptr<AudioDestinationNode> & dest, std::vector<std::shared_ptr<AudioNode>> & nodes)
+            {
+                auto grain_source = LoadSample("samples/voice.ogg");
+
+                auto granulation_node = std::make_shared<GranulationNode>(ac);
+                auto gain = std::make_shared<GainNode>(ac);
+                gain->gain()->setValue(0.75f);
+                granulation_node->numGrains->setValue(20.f);
+                {
+                    ContextRenderLock r(&ac, "LabSoundBenchmark");
+                    granulation_node->setGrainSource(r, grain_source);
+                }
+
+                ac.connect(gain, granulation_node, 0, 0);
+                ac.connect(dest, gain, 0, 0);
+                granulation_node->start(0.0f);
+                nodes = {granulation_node, gain};
+            },
+            nullptr});
+
+        return graphs;
+    }
+
+    struct BenchmarkResult
+    {
+        uint64_t hash = 0;
+        double rms = 0;
+        double nsPerQuantum = 0;  // best of the iterations
+        double realtimeFactor = 0;
+    };
+
+    struct Fnv1a
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        void add(const float * data, int count)
+        {
+            const uint8_t * bytes = reinterpret_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < count * sizeof(float); ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+            }
+        }
+    };
+
+    BenchmarkResult Run(const BenchmarkGraph & graph, double seconds, int iterations)
+    {
+        BenchmarkResult result;
+        const int quanta = static_cast<int>(std::ceil(seconds * kSampleRate / kQuantum));
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            AudioStreamConfig offlineConfig;
+            offlineConfig.device_index = 0;
+            offlineConfig.desired_samplerate = kSampleRate;
+            offlineConfig.desired_channels = kChannels;
+
+            auto context = std::make_shared<AudioContext>(true, false);
+            auto dest = std::make_shared<AudioDestinationNode>(*context,
+                std::make_shared<AudioDevice_Null>(AudioStreamConfig{}, offlineConfig));
+            context->setDestinationNode(dest);
+
+            std::vector<std::shared_ptr<AudioNode>> nodes;
+            graph.build(*context, dest, nodes);
+
+            AudioBus bus(kChannels, kQuantum);
+            Fnv1a hash;
+            double sumSquares = 0;
+            std::chrono::nanoseconds elapsed {0};
+
+            for (int q = 0; q < quanta; ++q)
+            {
+                if (graph.animate)
+                    graph.animate(nodes, q * kQuantum / double(kSampleRate), seconds);
+
+                auto start = std::chrono::steady_clock::now();
+                dest->offlineRender(&bus, kQuantum);
+                elapsed += std::chrono::steady_clock::now() - start;
+
+                if (iteration == 0)
+                {
+                    for (int c = 0; c < kChannels; ++c)
+                    {
+                        const float * data = bus.channel(c)->data();
+                        hash.add(data, kQuantum);
+                        for (int i = 0; i < kQuantum; ++i)
+                            sumSquares += data[i] * data[i];
+                    }
+                }
+            }
+
+            if (iteration == 0)
+            {
+                result.hash = hash.hash;
+                result.rms = std::sqrt(sumSquares / (double(quanta) * kQuantum * kChannels));
+            }
+
+            const double ns = double(elapsed.count()) / quanta;
+            if (iteration == 0 || ns < result.nsPerQuantum)
+                result.nsPerQuantum = ns;
+
+            // the graph references the context; release it before the context goes
+            nodes.clear();
+            dest.reset();
+        }
+
+        result.realtimeFactor = (1.e9 * kQuantum / kSampleRate) / result.nsPerQuantum;
+        return result;
+    }
+
+    // golden file lines are: name hash rms ns_per_quantum
+    // returns false if the file can't be read
+    bool ReadGolden(const std::string & path, std::map<std::string, BenchmarkResult> & golden)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            std::string name;
+            BenchmarkResult r;
+            fields >> name >> std::hex >> r.hash >> std::dec >> r.rms >> r.nsPerQuantum;
+            if (fields)
+                golden[name] = r;
+        }
+        return true;
+    }
+
+    void WriteGolden(const std::string & path, const std::map<std::string, BenchmarkResult> & results)
+    {
+        std::ofstream file(path);
+        file << "# LabSoundBenchmark golden results: name hash rms ns_per_quantum\n";
+        for (auto & r : results)
+        {
+            char line[256];
+            snprintf(line, sizeof(line), "%s %016llx %.9g %.1f\n", r.first.c_str(),
+                     static_cast<unsigned long long>(r.second.hash), r.second.rms, r.second.nsPerQuantum);
+            file << line;
+        }
+    }
+}
+
+int main(int argc, char * argv[]) try
+{
+    double seconds = 10.0;
+    int iterations = 3;
+    std::string goldenPath = LABSOUND_BENCHMARK_GOLDEN;
+    bool record = false;
+    bool exact = false;
+    double perfTolerance = 25.0;  // percent
+    const double rmsTolerance = 1.e-3;  // relative, for outputs that aren't bit exact
+    const double randomRmsTolerance = 0.5;   // relative, for graphs that draw random numbers
+    std::vector<std::string> only;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (arg == "--iterations" && i + 1 < argc) iterations = std::max(1, atoi(argv[++i]));
+        else if (arg == "--golden" && i + 1 < argc) goldenPath = argv[++i];
+        else if (arg == "--perf-tolerance" && i + 1 < argc) perfTolerance = atof(argv[++i]);
+        else if (arg == "--record") record = true;
+        else if (arg == "--exact") exact = true;
+        else only.push_back(arg);
+    }
+
+    std::map<std::string, BenchmarkResult> golden;
+    if (!ReadGolden(goldenPath, golden) && !record)
+        printf("cannot read the golden file %s; run with --record to write it\n", goldenPath.c_str());
+
+    std::map<std::string, BenchmarkResult> results = record ? golden : std::map<std::string, BenchmarkResult>{};
+    int failures = 0;
+
+    printf("%-22s %12s %10s %18s %12s  %s\n", "graph", "ns/quantum", "realtime", "hash", "rms", "status");
+    for (auto & graph : MakeGraphs())
+    {
+        if (!only.empty() && std::find(only.begin(), only.end(), graph.name) == only.end())
+            continue;
+
+        BenchmarkResult r;
+        try
+        {
+            r = Run(graph, seconds, iterations);
+        }
+        catch (const std::exception & e)
+        {
+            printf("%-22s %s\n", graph.name, e.what());
+            ++failures;
+            continue;
+        }
+        results[graph.name] = r;
+
+        std::string status = "recorded";
+        if (!record)
+        {
+            auto g = golden.find(graph.name);
+            if (g == golden.end())
+            {
+                status = "NO GOLDEN";
+                ++failures;
+            }
+            else
+            {
+                const double rmsError = std::fabs(r.rms - g->second.rms) / std::max(g->second.rms, 1.e-9);
+                bool ok = true;
+                if (graph.deterministic && r.hash == g->second.hash)
+                    status = "exact";
+                else if (graph.deterministic && exact)
+                {
+                    status = "HASH MISMATCH";
+                    ok = false;
+                }
+                else if (rmsError <= (graph.deterministic ? rmsTolerance : randomRmsTolerance))
+                    status = "within tolerance";
+                else
+                {
+                    status = "OUTPUT CHANGED";
+                    ok = false;
+                }
+
+                if (g->second.nsPerQuantum > 0 && r.nsPerQuantum > g->second.nsPerQuantum * (1.0 + perfTolerance / 100.0))
+                {
+                    char slower[64];
+                    snprintf(slower, sizeof(slower), ", SLOWER %+.0f%%", 100.0 * (r.nsPerQuantum / g->second.nsPerQuantum - 1.0));
+                    status += slower;
+                    ok = false;
+                }
+
+                if (!ok)
+                    ++failures;
+            }
+        }
+
+        printf("%-22s %12.0f %9.1fx   %016llx %12.6g  %s\n", graph.name, r.nsPerQuantum, r.realtimeFactor,
+               static_cast<unsigned long long>(r.hash), r.rms, status.c_str());
+    }
+
+    if (record)
+    {
+        WriteGolden(goldenPath, results);
+        printf("wrote %s\n", goldenPath.c_str());
+    }
+
+    return failures;
+}
+catch (const std::exception & e)
+{
+    std::cerr << "unhandled fatal exception: " << e.what() << std::endl;
+    return -1;
+}
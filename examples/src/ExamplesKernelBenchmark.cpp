@@ -0,0 +1,544 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2015+, The LabSound Authors. All rights reserved.
+
+// Times LabSound's inner DSP kernels in isolation, across block sizes and
+// channel counts.
+//
+//   LabSoundKernelBenchmark [--format table|csv|json] [--out path]
+//                           [--frames 64,128,...] [--channels 1,2,...]
+//                           [--repeats n] [--min-ms ms] [kernel ...]
+//
+// Each case is calibrated to run for at least --min-ms per batch, then timed
+// for --repeats batches. The median and minimum cost per call, and the median
+// cost per frame per channel, are reported. Kernel names given on the command
+// line select cases by prefix, so "vector" runs every VectorMath case.
+//
+// The csv and json formats carry the same fields as the table, one record per
+// case, so that results can be collected over time and compared.
+//
+// Before timing, the vramp and vgeom recurrences are checked against their
+// closed forms over long blocks; if either strays past its bound, the errors
+// are reported and the exit code is nonzero.
+
+#include "LabSound/LabSound.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Biquad.h"
+#include "internal/DelayDSPKernel.h"
+#include "internal/DynamicsCompressorKernel.h"
+#include "internal/FFTFrame.h"
+#include "internal/HRTFPanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace lab;
+
+namespace
+{
+    const float kSampleRate = 48000.f;
+
+    struct KernelCase
+    {
+        std::string kernel;   // e.g. "biquad"
+        std::string variant;  // e.g. "lowpass"
+        int frames;
+        int channels;
+        std::function<void()> run;  // processes frames * channels once
+    };
+
+    struct KernelResult
+    {
+        double medianNs = 0;
+        double minNs = 0;
+        double nsPerSample = 0;  // median, per frame per channel
+        int64_t callsPerBatch = 0;
+    };
+
+    KernelResult Measure(const KernelCase & c, int repeats, double minBatchMs)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // warm caches, and let kernels with ramps settle
+        for (int i = 0; i < 16; ++i)
+            c.run();
+
+        // find a batch size that runs for at least minBatchMs
+        int64_t calls = 1;
+        for (;;)
+        {
+            auto start = clock::now();
+            for (int64_t i = 0; i < calls; ++i)
+                c.run();
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            if (ms >= minBatchMs || calls >= (int64_t(1) << 30))
+                break;
+            calls *= ms > 0 ? std::max<int64_t>(2, std::min<int64_t>(100, int64_t(minBatchMs / ms) + 1)) : 100;
+        }
+
+        std::vector<double> perCall;
+        for (int r = 0; r < repeats; ++r)
+        {
+            auto start = clock::now();
+            for (int64_t i = 0; i < calls; ++i)
+                c.run();
+            double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            perCall.push_back(ns / calls);
+        }
+
+        std::sort(perCall.begin(), perCall.end());
+        KernelResult result;
+        result.medianNs = perCall[perCall.size() / 2];
+        result.minNs = perCall.front();
+        result.nsPerSample = result.medianNs / (double(c.frames) * c.channels);
+        result.callsPerBatch = calls;
+        return result;
+    }
+
+    void FillNoise(float * p, int n, uint32_t seed)
+    {
+        // a fixed sequence, so that runs are comparable
+        for (int i = 0; i < n; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            p[i] = float(int32_t(seed)) * (0.5f / 2147483648.f);
+        }
+    }
+
+    std::unique_ptr<AudioBus> MakeNoiseBus(int channels, int frames)
+    {
+        std::unique_ptr<AudioBus> bus(new AudioBus(channels, frames));
+        for (int c = 0; c < channels; ++c)
+            FillNoise(bus->channel(c)->mutableData(), frames, 1234u + c);
+        return bus;
+    }
+
+    // State that outlives the cases built from it.
+    struct Fixture
+    {
+        std::shared_ptr<AudioContext> context;
+        std::shared_ptr<AudioDestinationNode> destination;
+        std::unique_ptr<ContextRenderLock> renderLock;
+        bool hrtfLoaded = false;
+
+        std::vector<std::shared_ptr<void>> keepAlive;
+        std::vector<std::shared_ptr<AudioContext>> graphContexts;  // outlive the nodes in keepAlive
+
+        template <typename T>
+        T * keep(T * p)
+        {
+            keepAlive.push_back(std::shared_ptr<void>(p, [](void * q) { delete static_cast<T *>(q); }));
+            return p;
+        }
+
+        ~Fixture()
+        {
+            keepAlive.clear();
+            graphContexts.clear();
+            renderLock.reset();
+            destination.reset();
+            context.reset();
+        }
+    };
+
+    void AddVectorMathCases(std::vector<KernelCase> & cases, Fixture & fx, int frames)
+    {
+        auto a = fx.keep(new AudioFloatArray(frames));
+        auto b = fx.keep(new AudioFloatArray(frames));
+        auto d = fx.keep(new AudioFloatArray(frames));
+        auto e = fx.keep(new AudioFloatArray(frames));
+        FillNoise(a->data(), frames, 1);
+        FillNoise(b->data(), frames, 2);
+        FillNoise(d->data(), frames, 3);
+        FillNoise(e->data(), frames, 4);
+        float * pa = a->data(), * pb = b->data(), * pd = d->data(), * pe = e->data();
+
+        cases.push_back({"vectormath", "vsmul", frames, 1, [=]() { float s = 0.5f; VectorMath::vsmul(pa, 1, &s, pd, 1, frames); }});
+        cases.push_back({"vectormath", "vsma", frames, 1, [=]() { float s = 1.e-3f; VectorMath::vsma(pa, 1, &s, pd, 1, frames); }});
+        cases.push_back({"vectormath", "vadd", frames, 1, [=]() { VectorMath::vadd(pa, 1, pb, 1, pd, 1, frames); }});
+        cases.push_back({"vectormath", "vmul", frames, 1, [=]() { VectorMath::vmul(pa, 1, pb, 1, pd, 1, frames); }});
+        cases.push_back({"vectormath", "vmaxmgv", frames, 1, [=]() { float m; VectorMath::vmaxmgv(pa, 1, &m, frames); pd[0] = m; }});
+        cases.push_back({"vectormath", "vsvesq", frames, 1, [=]() { float s; VectorMath::vsvesq(pa, 1, &s, frames); pd[0] = s; }});
+        cases.push_back({"vectormath", "vclip", frames, 1, [=]() { float lo = -0.25f, hi = 0.25f; VectorMath::vclip(pa, 1, &lo, &hi, pd, 1, frames); }});
+        cases.push_back({"vectormath", "zvmul", frames, 1, [=]() { VectorMath::zvmul(pa, pb, pd, pe, pd, pe, frames); }});
+        cases.push_back({"vectormath", "vramp", frames, 1, [=]() { float a = 440.f, k = -0.003f; VectorMath::vramp(&a, &k, pd, 1, frames); }});
+        cases.push_back({"vectormath", "vgeom", frames, 1, [=]() { float a = 1.f, r = 0.9998f, c = 0.5f; VectorMath::vgeom(&a, &r, &c, pd, 1, frames); }});
+    }
+
+    // Compares vramp and vgeom to their closed forms, evaluated in double precision.
+    // vramp computes every value from its index, so it stays within an ulp or two
+    // of the larger of its terms however long the ramp. vgeom steps its four lanes
+    // by a rounded ratio^4 and re-anchors every 128 frames, so its error relative
+    // to the geometric term is bounded by the per-block drift, plus the rounding
+    // of the offset. The worst error is reported as a fraction of its bound, and
+    // false is returned if any value is out of bounds.
+    bool CheckRecurrences()
+    {
+        const double kRampBound = 2.5e-7;   // relative to |start| + |i * step|
+        const double kGeomBound = 1.e-5;    // relative to |start * ratio^i|, plus an ulp of the value
+        bool passed = true;
+
+        struct Ramp { const char * name; float start, step; int frames; };
+        const Ramp ramps[] = {
+            {"time", 0.f, 1.f / kSampleRate, (1 << 20) + 3},
+            {"falling", 440.f, -0.003f, (1 << 20) + 1},
+            {"index", -1.f, 2.f / 65536.f, (1 << 18) + 2},
+        };
+        for (const Ramp & t : ramps)
+        {
+            std::vector<float> values(t.frames);
+            VectorMath::vramp(&t.start, &t.step, values.data(), 1, t.frames);
+            double worst = 0;
+            for (int i = 0; i < t.frames; ++i)
+            {
+                const double expected = double(t.start) + double(i) * t.step;
+                const double bound = kRampBound * (std::fabs(t.start) + std::fabs(double(i) * t.step));
+                worst = std::max(worst, std::fabs(values[i] - expected) / bound);
+            }
+            const bool ok = worst <= 1.0;
+            passed = passed && ok;
+            fprintf(stderr, "vramp %-10s %8d frames  worst error %.2f of bound  %s\n", t.name, t.frames, worst, ok ? "ok" : "FAILED");
+        }
+
+        // per-sample multipliers of an exponential ramp up, a setTarget approach, and a decay
+        struct Geom { const char * name; float start, ratio, offset; int frames; };
+        const Geom geoms[] = {
+            {"rise", 1.f, float(std::exp(std::log(1000.0) / (2.0 * kSampleRate))), 0.f, 2 * int(kSampleRate) + 3},
+            {"approach", -0.75f, float(1.0 - 1.0 / (0.1 * kSampleRate)), 1.f, 2 * int(kSampleRate) + 1},
+            {"decay", 1.f, float(std::exp(std::log(1.e-4) / (8.0 * kSampleRate))), 0.f, 8 * int(kSampleRate) + 2},
+        };
+        for (const Geom & t : geoms)
+        {
+            std::vector<float> values(t.frames);
+            VectorMath::vgeom(&t.start, &t.ratio, &t.offset, values.data(), 1, t.frames);
+            double worst = 0;
+            for (int i = 0; i < t.frames; ++i)
+            {
+                const double term = double(t.start) * std::pow(double(t.ratio), i);
+                const double expected = t.offset + term;
+                const double bound = kGeomBound * std::fabs(term) + std::ldexp(std::fabs(expected), -23);
+                worst = std::max(worst, std::fabs(values[i] - expected) / bound);
+            }
+            const bool ok = worst <= 1.0;
+            passed = passed && ok;
+            fprintf(stderr, "vgeom %-10s %8d frames  worst error %.2f of bound  %s\n", t.name, t.frames, worst, ok ? "ok" : "FAILED");
+        }
+
+        return passed;
+    }
+
+    void AddBiquadCases(std::vector<KernelCase> & cases, Fixture & fx, int frames, int channels)
+    {
+        struct Setup { const char * name; std::function<void(Biquad &)> set; };
+        const Setup setups[] = {
+            {"lowpass", [](Biquad & b) { b.setLowpassParams(1000.0 / (kSampleRate * 0.5), 0.7); }},
+            {"peaking", [](Biquad & b) { b.setPeakingParams(1000.0 / (kSampleRate * 0.5), 1.0, 6.0); }},
+        };
+
+        for (auto & setup : setups)
+        {
+            auto filters = fx.keep(new std::vector<Biquad>(channels));
+            for (auto & f : *filters)
+                setup.set(f);
+            auto in = fx.keep(MakeNoiseBus(channels, frames).release());
+            auto out = fx.keep(new AudioBus(channels, frames));
+
+            cases.push_back({"biquad", setup.name, frames, channels, [=]()
+            {
+                for (int c = 0; c < channels; ++c)
+                    (*filters)[c].process(in->channel(c)->data(), out->channel(c)->mutableData(), frames);
+            }});
+        }
+    }
+
+    void AddDelayCases(std::vector<KernelCase> & cases, Fixture & fx, int frames, int channels)
+    {
+        auto kernels = fx.keep(new std::vector<std::unique_ptr<DelayDSPKernel>>());
+        for (int c = 0; c < channels; ++c)
+        {
+            kernels->emplace_back(new DelayDSPKernel(2.0, kSampleRate));
+            kernels->back()->setDelayFrames(0.25 * kSampleRate + 0.5);  // fractional, so the interpolator runs
+        }
+        auto in = fx.keep(MakeNoiseBus(channels, frames).release());
+        auto out = fx.keep(new AudioBus(channels, frames));
+        ContextRenderLock * r = fx.renderLock.get();
+
+        cases.push_back({"delay", "fractional", frames, channels, [=]()
+        {
+            for (int c = 0; c < channels; ++c)
+                (*kernels)[c]->process(*r, in->channel(c)->data(), out->channel(c)->mutableData(), frames);
+        }});
+    }
+
+    void AddCompressorCases(std::vector<KernelCase> & cases, Fixture & fx, int frames, int channels)
+    {
+        auto kernel = fx.keep(new DynamicsCompressorKernel(channels));
+        auto in = fx.keep(MakeNoiseBus(channels, frames).release());
+        auto out = fx.keep(new AudioBus(channels, frames));
+        auto sources = fx.keep(new std::vector<const float *>(channels));
+        auto destinations = fx.keep(new std::vector<float *>(channels));
+        for (int c = 0; c < channels; ++c)
+        {
+            (*sources)[c] = in->channel(c)->data();
+            (*destinations)[c] = out->channel(c)->mutableData();
+        }
+        ContextRenderLock * r = fx.renderLock.get();
+
+        // DynamicsCompressor's default parameters
+        cases.push_back({"compressor", "default", frames, channels, [=]()
+        {
+            kernel->process(*r, sources->data(), destinations->data(), channels, frames,
+                            -24.f, 30.f, 12.f, 0.003f, 0.25f, 0.006f, 0.f, 1.f,
+                            0.09f, 0.16f, 0.42f, 0.98f);
+        }});
+    }
+
+    void AddHrtfCases(std::vector<KernelCase> & cases, Fixture & fx, int frames, int channels)
+    {
+        if (!fx.hrtfLoaded || channels > 2)
+            return;
+
+        auto in = fx.keep(MakeNoiseBus(channels, frames).release());
+        auto out = fx.keep(new AudioBus(2, frames));
+        ContextRenderLock * r = fx.renderLock.get();
+
+        auto fixed = fx.keep(new HRTFPanner(kSampleRate));
+        cases.push_back({"hrtf", "fixed", frames, channels, [=]()
+        {
+            fixed->pan(*r, 30.0, 0.0, *in, *out, 0, frames);
+        }});
+
+        // moving sources cross fade between two sets of convolvers
+        auto moving = fx.keep(new HRTFPanner(kSampleRate));
+        auto azimuth = fx.keep(new double(0));
+        cases.push_back({"hrtf", "moving", frames, channels, [=]()
+        {
+            *azimuth = *azimuth > 170.0 ? -170.0 : *azimuth + 7.0;
+            moving->pan(*r, *azimuth, 10.0, *in, *out, 0, frames);
+        }});
+    }
+
+    void AddFFTCases(std::vector<KernelCase> & cases, Fixture & fx, int fftSize)
+    {
+        auto frame = fx.keep(new FFTFrame(fftSize));
+        auto data = fx.keep(new AudioFloatArray(fftSize));
+        FillNoise(data->data(), fftSize, 7);
+        float * p = data->data();
+
+        cases.push_back({"fft", "forward", fftSize, 1, [=]() { frame->computeForwardFFT(p); }});
+        cases.push_back({"fft", "inverse", fftSize, 1, [=]() { frame->computeInverseFFT(p); }});
+    }
+
+    void AddBusCases(std::vector<KernelCase> & cases, Fixture & fx, int frames, int channels)
+    {
+        auto in = fx.keep(MakeNoiseBus(channels, frames).release());
+        auto out = fx.keep(new AudioBus(channels, frames));
+        cases.push_back({"bus_sumfrom", "same", frames, channels, [=]() { out->sumFrom(*in); }});
+
+        if (channels == 1)
+        {
+            auto stereo = fx.keep(new AudioBus(2, frames));
+            cases.push_back({"bus_sumfrom", "upmix_1to2", frames, 1, [=]() { stereo->sumFrom(*in); }});
+        }
+        else if (channels == 2)
+        {
+            auto mono = fx.keep(new AudioBus(1, frames));
+            cases.push_back({"bus_sumfrom", "downmix_2to1", frames, 2, [=]() { mono->sumFrom(*in); }});
+        }
+        else
+        {
+            auto discrete = fx.keep(new AudioBus(channels, frames));
+            cases.push_back({"bus_sumfrom", "discrete", frames, channels, [=]() { discrete->sumFrom(*in, ChannelInterpretation::Discrete); }});
+        }
+    }
+
+    // The sampled node is measured through the graph, since its resampler is
+    // driven by the node's scheduling. The graph always renders whole quanta,
+    // so frames is the number of frames rendered per call, and channels is the
+    // channel count of the clip. A playback rate of one is the baseline
+    // without resampling.
+    void AddSampledCases(std::vector<KernelCase> & cases, Fixture & fx, int frames, int channels)
+    {
+        // the node's output follows its bus only up to stereo
+        if (frames % AudioNode::ProcessingSizeInFrames || channels > 2)
+            return;
+
+        const float rates[] = {1.f, 0.77f, 1.5f};
+        for (float rate : rates)
+        {
+            auto context = std::make_shared<AudioContext>(true, false);
+            AudioStreamConfig outputConfig;
+            outputConfig.device_index = 0;
+            outputConfig.desired_channels = 2;
+            outputConfig.desired_samplerate = kSampleRate;
+            auto destination = std::make_shared<AudioDestinationNode>(*context,
+                std::make_shared<AudioDevice_Null>(AudioStreamConfig{}, outputConfig));
+            context->setDestinationNode(destination);
+
+            std::shared_ptr<AudioBus> clip(MakeNoiseBus(channels, int(kSampleRate) * 4).release());
+            auto node = std::make_shared<SampledAudioNode>(*context);
+            node->setBus(clip);
+            node->playbackRate()->setValue(rate);
+            node->schedule(0.0, -1);
+            context->connect(destination, node, 0, 0);
+
+            // offlineRender renders each quantum over the previous one
+            auto out = fx.keep(new AudioBus(2, AudioNode::ProcessingSizeInFrames));
+            fx.keepAlive.push_back(node);
+            fx.keepAlive.push_back(destination);
+            fx.graphContexts.push_back(context);
+
+            char variant[32];
+            snprintf(variant, sizeof(variant), "rate_%.2f", rate);
+            AudioDestinationNode * d = destination.get();
+            cases.push_back({"sampled_resample", variant, frames, channels, [=]() { d->offlineRender(out, frames); }});
+        }
+    }
+
+    std::vector<int> ParseList(const char * s)
+    {
+        std::vector<int> values;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                values.push_back(atoi(item.c_str()));
+        return values;
+    }
+}
+
+int main(int argc, char * argv[]) try
+{
+    std::string format = "table";
+    std::string outPath;
+    std::vector<int> frameSizes = {64, 128, 256, 512, 1024};
+    std::vector<int> channelCounts = {1, 2, 6};
+    std::vector<int> fftSizes = {256, 512, 1024, 2048, 4096};
+    std::vector<std::string> only;
+    int repeats = 9;
+    double minBatchMs = 5.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) format = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc) frameSizes = ParseList(argv[++i]);
+        else if (arg == "--channels" && i + 1 < argc) channelCounts = ParseList(argv[++i]);
+        else if (arg == "--repeats" && i + 1 < argc) repeats = std::max(1, atoi(argv[++i]));
+        else if (arg == "--min-ms" && i + 1 < argc) minBatchMs = atof(argv[++i]);
+        else only.push_back(arg);
+    }
+
+    if (format != "table" && format != "csv" && format != "json")
+        throw std::invalid_argument("unknown format " + format);
+
+    const bool recurrencesPassed = CheckRecurrences();
+
+    Fixture fx;
+    {
+        AudioStreamConfig outputConfig;
+        outputConfig.device_index = 0;
+        outputConfig.desired_channels = 2;
+        outputConfig.desired_samplerate = kSampleRate;
+        fx.context = std::make_shared<AudioContext>(true, false);
+        fx.destination = std::make_shared<AudioDestinationNode>(*fx.context,
+            std::make_shared<AudioDevice_Null>(AudioStreamConfig{}, outputConfig));
+        fx.context->setDestinationNode(fx.destination);
+        fx.hrtfLoaded = fx.context->loadHrtfDatabase(std::string(SAMPLE_SRC_DIR) + "/hrtf");
+        if (!fx.hrtfLoaded)
+            std::cerr << "hrtf database not found; hrtf cases skipped" << std::endl;
+        fx.renderLock.reset(new ContextRenderLock(fx.context.get(), "LabSoundKernelBenchmark"));
+    }
+
+    std::vector<KernelCase> cases;
+    for (int frames : frameSizes)
+    {
+        AddVectorMathCases(cases, fx, frames);
+        for (int channels : channelCounts)
+        {
+            AddBiquadCases(cases, fx, frames, channels);
+            AddDelayCases(cases, fx, frames, channels);
+            AddCompressorCases(cases, fx, frames, channels);
+            AddHrtfCases(cases, fx, frames, channels);
+            AddBusCases(cases, fx, frames, channels);
+            AddSampledCases(cases, fx, frames, channels);
+        }
+    }
+    for (int fftSize : fftSizes)
+        AddFFTCases(cases, fx, fftSize);
+
+    if (!only.empty())
+    {
+        cases.erase(std::remove_if(cases.begin(), cases.end(), [&](const KernelCase & c)
+        {
+            for (auto & prefix : only)
+                if (c.kernel.compare(0, prefix.size(), prefix) == 0)
+                    return false;
+            return true;
+        }), cases.end());
+    }
+
+    std::stable_sort(cases.begin(), cases.end(), [](const KernelCase & a, const KernelCase & b)
+    {
+        if (a.kernel != b.kernel) return a.kernel < b.kernel;
+        if (a.variant != b.variant) return a.variant < b.variant;
+        if (a.channels != b.channels) return a.channels < b.channels;
+        return a.frames < b.frames;
+    });
+
+    FILE * out = stdout;
+    if (!outPath.empty())
+    {
+        out = fopen(outPath.c_str(), "w");
+        if (!out)
+            throw std::runtime_error("couldn't open " + outPath);
+    }
+
+    if (format == "table")
+        fprintf(out, "%-18s %-14s %7s %4s %14s %14s %10s\n", "kernel", "variant", "frames", "ch", "median ns", "min ns", "ns/sample");
+    else if (format == "csv")
+        fprintf(out, "kernel,variant,frames,channels,median_ns,min_ns,ns_per_sample,calls_per_batch\n");
+    else
+        fprintf(out, "{\n  \"sample_rate\": %.0f,\n  \"repeats\": %d,\n  \"results\": [", kSampleRate, repeats);
+
+    bool first = true;
+    for (auto & c : cases)
+    {
+        KernelResult r = Measure(c, repeats, minBatchMs);
+        if (format == "table")
+            fprintf(out, "%-18s %-14s %7d %4d %14.1f %14.1f %10.3f\n", c.kernel.c_str(), c.variant.c_str(), c.frames, c.channels,
+                    r.medianNs, r.minNs, r.nsPerSample);
+        else if (format == "csv")
+            fprintf(out, "%s,%s,%d,%d,%.1f,%.1f,%.4f,%lld\n", c.kernel.c_str(), c.variant.c_str(), c.frames, c.channels,
+                    r.medianNs, r.minNs, r.nsPerSample, static_cast<long long>(r.callsPerBatch));
+        else
+            fprintf(out, "%s\n    {\"kernel\": \"%s\", \"variant\": \"%s\", \"frames\": %d, \"channels\": %d, "
+                    "\"median_ns\": %.1f, \"min_ns\": %.1f, \"ns_per_sample\": %.4f, \"calls_per_batch\": %lld}",
+                    first ? "" : ",", c.kernel.c_str(), c.variant.c_str(), c.frames, c.channels,
+                    r.medianNs, r.minNs, r.nsPerSample, static_cast<long long>(r.callsPerBatch));
+        fflush(out);
+        first = false;
+    }
+
+    if (format == "json")
+        fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+
+    return recurrencesPassed ? 0 : 1;
+}
+catch (const std::exception & e)
+{
+    std::cerr << "unhandled fatal exception: " << e.what() << std::endl;
+    return -1;
+}
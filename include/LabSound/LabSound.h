@@ -37,13 +37,19 @@
 #include "LabSound/extended/BPMDelayNode.h"
 #include "LabSound/extended/ClipNode.h"
 #include "LabSound/extended/DiodeNode.h"
+#include "LabSound/extended/FDNReverbNode.h"
 #include "LabSound/extended/FunctionNode.h"
 #include "LabSound/extended/GranulationNode.h"
+#include "LabSound/extended/GraphDescription.h"
+#include "LabSound/extended/KernelNode.h"
+#include "LabSound/extended/LFONode.h"
+#include "LabSound/extended/MultiTapDelayNode.h"
 #include "LabSound/extended/NoiseNode.h"
 //#include "LabSound/extended/PdNode.h"
 #include "LabSound/extended/PeakCompNode.h"
 #include "LabSound/extended/PingPongDelayNode.h"
 #include "LabSound/extended/PolyBLEPNode.h"
+#include "LabSound/extended/PolyphonicNode.h"
 #include "LabSound/extended/PowerMonitorNode.h"
 #include "LabSound/extended/PWMNode.h"
 #include "LabSound/extended/RealtimeAnalyser.h"
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef labsound_audiodevice_headless_hpp
+#define labsound_audiodevice_headless_hpp
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace lab {
+
+// Layout of the ring the headless device writes into. When the device streams
+// to shared memory, another process maps the region by name and reads it: the
+// header is followed by capacityFrames interleaved float frames. The device only
+// advances writeFrame, and the reader only advances readFrame; both count frames
+// from the start of the stream, and a frame lives at index (frame & (capacityFrames - 1)).
+// When the ring is full the device drops whole quanta rather than wait.
+struct HeadlessRingHeader
+{
+    static const uint32_t kMagic = 0x4252534c;  // "LSRB"
+    static const uint32_t kVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channels;
+    uint32_t capacityFrames;  // a power of two, and a multiple of the render quantum
+    float sampleRate;
+    uint32_t reserved;
+
+    alignas(64) std::atomic<uint64_t> writeFrame;
+    alignas(64) std::atomic<uint64_t> readFrame;
+};
+
+enum class HeadlessSink
+{
+    None,          // render and discard; useful for timing alone
+    File,          // 32 bit float WAV file
+    Pipe,          // raw interleaved 32 bit floats, to a named pipe created if necessary
+    SharedMemory   // HeadlessRingHeader and frames, in a named shared memory region
+};
+
+struct HeadlessDeviceConfig
+{
+    HeadlessSink sink = HeadlessSink::None;
+
+    // file path, pipe path, or shared memory name. Posix shared memory names
+    // begin with a slash; one is prepended if missing.
+    std::string path;
+
+    // capacity of the ring between the render thread and the sink, in frames.
+    // Rounded up to a power of two of at least two render quanta.
+    uint32_t ringFrames = 8192;
+};
+
+struct HeadlessDeviceStats
+{
+    uint64_t quanta = 0;            // quanta rendered
+    uint64_t deadlineMisses = 0;    // quanta not ready by the time the next was due, including skipped quanta
+    uint64_t droppedFrames = 0;     // frames the sink's ring had no room for
+    double meanWakeJitterUs = 0;    // lateness of the render thread's wake ups
+    double maxWakeJitterUs = 0;
+    double meanRenderUs = 0;        // time spent rendering a quantum
+    double maxRenderUs = 0;
+};
+
+// A device without hardware. A render thread paced by a monotonic clock pulls
+// the graph one quantum per period, just as a sound card's callback would, and
+// hands the output to the configured sink. Deadline misses and scheduling
+// jitter are recorded so that real-time behaviour can be measured on machines
+// without sound cards. Input, if configured, is silent.
+class AudioDevice_Headless : public AudioDevice
+{
+    struct Sink;
+
+    HeadlessDeviceConfig _config;
+    std::unique_ptr<Sink> _sink;
+    std::unique_ptr<AudioBus> _renderBus;
+    std::unique_ptr<AudioBus> _inputBus;
+    SamplingInfo samplingInfo;
+
+    std::thread _renderThread;
+    std::thread _writerThread;
+    std::atomic<bool> _running{false};
+    std::atomic<bool> _writing{false};
+
+    std::atomic<uint64_t> _quanta{0};
+    std::atomic<uint64_t> _deadlineMisses{0};
+    std::atomic<uint64_t> _droppedFrames{0};
+    std::atomic<uint64_t> _wakeJitterTotalNs{0};
+    std::atomic<uint64_t> _wakeJitterMaxNs{0};
+    std::atomic<uint64_t> _renderTotalNs{0};
+    std::atomic<uint64_t> _renderMaxNs{0};
+
+    void renderLoop();
+    void writerLoop();
+    void renderQuantum();
+
+public:
+    AudioDevice_Headless(
+        const AudioStreamConfig & inputConfig,
+        const AudioStreamConfig & outputConfig,
+        const HeadlessDeviceConfig & config = {});
+    virtual ~AudioDevice_Headless();
+
+    float authoritativeDeviceSampleRateAtRuntime{0.f};
+
+    // AudioDevice Interface
+    virtual void start() override final;
+    virtual void stop() override final;
+    virtual bool isRunning() const override final;
+    virtual void backendReinitialize() override final;
+
+    HeadlessDeviceStats stats() const;
+    void resetStats();
+};
+
+}  // namespace lab
+
+#endif  // labsound_audiodevice_headless_hpp
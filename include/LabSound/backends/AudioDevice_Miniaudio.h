@@ -7,7 +7,9 @@
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/AudioDevice.h"
 #include "LabSound/core/AudioNode.h"
-#include "LabSound/core/ConcurrentQueue.h"
+
+#include <atomic>
+#include <chrono>
 
 struct ma_device;
 
@@ -18,12 +20,41 @@ class AudioDevice_Miniaudio : public AudioDevice
     AudioBus * _renderBus = nullptr;
     AudioBus * _inputBus = nullptr;
     ma_device* _device = nullptr;
+    bool _deviceOpen = false;
     SamplingInfo samplingInfo;
-
-    lab::RingBufferT<float> * _ring = nullptr;
-    float * _scratch = nullptr;
     int _remainder = 0;
 
+    // capture frames waiting to be rendered, de-interleaved. In duplex mode
+    // capture and playback frames arrive in the same callback, so this only
+    // ever holds about one render quantum, rather than a long ring buffer.
+    float * _captureFifo = nullptr;
+    uint32_t _captureRead = 0;
+    uint32_t _captureWrite = 0;
+
+    // period sizing
+    int _periodFrames = 0;
+    std::atomic<int> _recommendedPeriodFrames{0};
+
+    // callback timing, written on the audio thread
+    std::chrono::steady_clock::time_point _lastCallback;
+    bool _hasLastCallback = false;
+    std::atomic<float> _jitterMs{0.f};
+    std::atomic<float> _peakJitterMs{0.f};
+    std::atomic<uint64_t> _lateCallbacks{0};
+
+    // round trip measurement
+    std::atomic<int> _measureState{0};
+    std::atomic<int> _roundTripFrames{-1};
+    mutable std::atomic<bool> _measureTimedOut{false};  // set by the audio thread, reported by latency()
+    float _measureThreshold = 0.25f;
+    uint64_t _measureFrames = 0;
+
+    bool initDevice();
+    void pushCapture(const float * interleaved, int frames, int channels);
+    void pullCapture(int channels);
+    void measure(const float * interleavedIn, float * interleavedOut, int frames);
+    void updateJitter(int frameCount);
+
 public:
 
 #ifdef _MSC_VER
@@ -32,8 +63,21 @@ public:
     void operator delete(void * p) { _mm_free(p); }
 #endif
 
+    struct LatencyInfo
+    {
+        int periodFrames = 0;             // playback period requested from the backend
+        int playbackFrames = 0;           // playback buffering reported by the backend
+        int captureFrames = 0;            // capture buffering reported by the backend
+        int internalFrames = 0;           // render quantum staging added by LabSound
+        int measuredRoundTripFrames = -1; // -1 until a measurement has completed
+        float callbackJitterMs = 0.f;     // smoothed deviation from the nominal callback interval
+        float peakJitterMs = 0.f;         // slowly decaying peak deviation
+        uint64_t lateCallbacks = 0;       // callbacks that arrived more than a period late
+        int recommendedPeriodFrames = 0;  // period the jitter observed so far suggests
+    };
+
     AudioDevice_Miniaudio(
-        const AudioStreamConfig & outputConfig, 
+        const AudioStreamConfig & outputConfig,
         const AudioStreamConfig & inputConfig);
     virtual ~AudioDevice_Miniaudio();
 
@@ -46,6 +90,21 @@ public:
     virtual bool isRunning() const override final;
     virtual void backendReinitialize() override final;
 
+    // Latency and buffering as currently known. Safe to call from any thread;
+    // a round trip measurement that timed out is reported here.
+    LatencyInfo latency() const;
+
+    // Emits a single impulse on every output channel and times its arrival on
+    // the first input channel; the result appears in latency() once the
+    // impulse has been detected. Requires a physical or virtual loopback
+    // between the devices, and input channels to be configured.
+    void measureRoundTripLatency(float threshold = 0.25f);
+
+    // Reopens the device with the period recommended by the callback jitter
+    // observed so far, if it differs from the current period. Must not be
+    // called from the audio thread. Returns true if the period changed.
+    bool adaptPeriodSize();
+
     static std::vector<AudioDeviceInfo> MakeAudioDeviceList();
 };
 
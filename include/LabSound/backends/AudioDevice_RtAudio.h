@@ -17,11 +17,29 @@ namespace lab
 
 class AudioDevice_RtAudio : public AudioDevice
 {
-    std::unique_ptr<AudioBus> _renderBus;
+    // quanta are rendered straight into the device's channel buffers through
+    // these views; nothing is allocated once the stream is open.
+    std::unique_ptr<AudioBus> _outputView;
+    std::unique_ptr<AudioBus> _inputView;
+
+    // the last quantum of a callback whose size isn't a multiple of the render
+    // quantum is rendered here, and its leftover frames begin the next callback.
+    std::unique_ptr<AudioBus> _remainderBus;
+    int _remainder = 0;
+
+    // input for such callbacks is staged, delayed by one quantum, so that a
+    // whole quantum of input is always available when one must be rendered.
     std::unique_ptr<AudioBus> _inputBus;
+    std::unique_ptr<AudioBus> _inputStaging;
+    int _inputStaged = 0;
+    bool _inputAligned = true;
+
     SamplingInfo samplingInfo;
 
     void createContext();
+    void allocateBusses(uint32_t bufferFrames);
+    void stageInput(const float * input, int stride, int offset, int frames);
+    void renderQuantum(AudioSourceProvider * provider, AudioBus * input, AudioBus * output);
 
 public:
     AudioDevice_RtAudio(
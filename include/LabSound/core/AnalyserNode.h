@@ -8,9 +8,12 @@
 #include "LabSound/core/AudioBasicInspectorNode.h"
 #include "LabSound/core/AudioNodeDescriptor.h"
 
+#include <memory>
+
 namespace lab
 {
 class AudioSetting;
+struct AnalyserSnapshot;
 
 // If the analyserNode is intended to run without it's output
 // being connected to an AudioDestination, the AnalyserNode must be
@@ -56,6 +59,10 @@ public:
     void setSmoothingTimeConstant(double k);
     double smoothingTimeConstant() const;
 
+    // The latest analysis, which may be held and read on any thread; the
+    // get*Data functions read it too. It is updated about 120 times a second.
+    std::shared_ptr<const AnalyserSnapshot> snapshot() const;
+
     // frequency bins, reported in db
     void getFloatFrequencyData(std::vector<float> & array);
 
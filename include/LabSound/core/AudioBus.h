@@ -31,6 +31,9 @@ public:
         LayoutCanonical = 0
     };
 
+    // the most channels a bus may have
+    static constexpr int MaxChannels = 32;
+
     // allocate indicates whether or not to initially have the AudioChannels created with managed storage.
     // Normal usage is to pass true here, in which case the AudioChannels will memory-manage their own storage.
     // If allocate is false then setChannelMemory() has to be called later on for each channel before the AudioBus is useable...
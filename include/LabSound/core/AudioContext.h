@@ -11,6 +11,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -31,12 +32,16 @@ class AudioScheduledSourceNode;
 class ContextGraphLock;
 class ContextRenderLock;
 class HRTFDatabaseLoader;
+struct PendingNodeConnection;
+struct PendingParamConnection;
+struct CommittedGraphTransaction;
 
 class AudioContext
 {
     friend class ContextGraphLock;
     friend class ContextRenderLock;
     friend class AudioDestinationNode;
+    friend class AudioNode;
 
 public:
 
@@ -130,6 +135,12 @@ public:
     // expected audio events and other systems.
     double predictedCurrentTime() const;
 
+    // A node whose quantum is split at automation events is processed as
+    // several sub-blocks. While it is, this is the frame offset within the
+    // current render quantum of the sub-block being processed, otherwise it
+    // is zero. k-rate parameter values are evaluated at this offset.
+    int currentSubQuantumOffset() const { return m_subQuantumOffset; }
+
     // engine
     
     void startOfflineRendering();
@@ -194,6 +205,51 @@ public:
     // disconnect a parameter from the indexed output of a node
     void disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index);
 
+    // graph transactions
+    //
+    // A GraphTransaction stages any number of connection edits on the calling
+    // thread without touching the render thread. Committing it publishes the
+    // whole batch with a single atomic pointer swap; the render thread picks
+    // it up at the next quantum boundary and applies every edit within that
+    // one quantum, so the graph is never observed partially connected.
+    //
+    // Disconnections ramp out as they do via disconnect(), and the whole
+    // batch finishes together once the ramp has elapsed. The returned future
+    // becomes ready when every edit in the transaction has taken effect; it is
+    // fulfilled by the update thread, within a few milliseconds, or by the next
+    // commit. As with synchronizeConnections, a suspended context will not
+    // resolve it.
+    class GraphTransaction
+    {
+        friend class AudioContext;
+        std::unique_ptr<CommittedGraphTransaction> _edits;
+        CommittedGraphTransaction & edits();
+
+    public:
+        GraphTransaction();
+        GraphTransaction(GraphTransaction &&) noexcept;
+        GraphTransaction & operator=(GraphTransaction &&) noexcept;
+        ~GraphTransaction();
+
+        void connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx = 0, int srcIdx = 0);
+        void disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx = 0, int srcIdx = 0);
+        void disconnect(std::shared_ptr<AudioNode> node, int destIdx = 0);
+
+        // connect an input that a node pulls itself, rather than one of its numbered inputs
+        void connectInput(std::shared_ptr<AudioNodeInput> input, std::shared_ptr<AudioNode> source, int srcIdx = 0);
+
+        void connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index);
+        void connectParam(std::shared_ptr<AudioNode> destinationNode, char const*const parameterName, std::shared_ptr<AudioNode> driver, int index);
+        void disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index);
+
+        // number of staged edits
+        size_t size() const;
+    };
+
+    // the transaction is consumed by commit; it may be reused after being
+    // reassigned from a fresh GraphTransaction.
+    std::future<void> commit(GraphTransaction && transaction);
+
     // events
     //    
     // event dispatching will be called automatically, depending on constructor
@@ -226,6 +282,7 @@ private:
     float lastGraphUpdateTime{0.f};
 
     std::atomic<int> _contextIsInitialized{0};
+    int m_subQuantumOffset = 0; // only accessed on the render thread
     bool m_isAudioThreadFinished = false;
     bool m_isOfflineContext = false;
     bool m_automaticPullNodesNeedUpdating = false;  // indicates m_automaticPullNodes was modified.
@@ -235,6 +292,11 @@ private:
     void updateAutomaticPullNodes();
     void uninitialize();
 
+    void applyParamConnection(ContextGraphLock &, PendingParamConnection &);
+    void applyNodeConnection(ContextGraphLock &, PendingNodeConnection &);
+    void applyCommittedTransactions(ContextGraphLock &);
+    void releaseRetiredTransactions();
+
     std::shared_ptr<AudioDestinationNode> _destinationNode;
 
     std::shared_ptr<AudioListener> m_listener;
@@ -97,6 +97,9 @@ protected:
         ProfileSample graphTime;    // how much time the node spend pulling inputs
         ProfileSample totalTime;    // total time spent by the node. total-graph is the self time.
 
+        // the hashed parameter and setting names of the node's type
+        AudioNodeDescriptorIndex const * index = nullptr;
+
         int color = 0;
         bool m_isInitialized {false};
     };
@@ -136,6 +139,14 @@ public :
     // Called from context's audio thread.
     virtual void reset(ContextRenderLock &) = 0;
 
+    // Readies a node that no graph refers to any more to be handed out again:
+    // unschedules it, drops its ended callback, cancels its parameters'
+    // scheduled values and resets its processing state. Returns false, and
+    // leaves the node alone, if anything is still connected to it.
+    // Used by NodeRegistry's node pools, on the thread acquiring a node, with
+    // the render lock of the node's context held.
+    bool resetForReuse(ContextRenderLock & r);
+
     // tailTime() is the length of time (not counting latency time) where 
     // non-zero output may occur after continuous silent input.
     virtual double tailTime(ContextRenderLock & r) const = 0;
@@ -156,6 +167,13 @@ public :
     // scheduling nodes.
     virtual bool isScheduledNode() const { return false; }
 
+    // If true, process() renders only the frames given by the scheduler's
+    // _renderOffset and _renderLength. Such a node's quantum is split into
+    // sub-blocks at its parameters' automation events, and process() is called
+    // once per sub-block, so that k-rate values change on the exact frame while
+    // the rest of the graph keeps rendering whole quanta.
+    virtual bool supportsSubQuantumProcessing() const { return false; }
+
     // No significant resources should be allocated until initialize() is called.
     // Processing may not occur until a node is initialized.
     virtual void initialize();
@@ -235,6 +253,11 @@ public :
     std::shared_ptr<AudioSetting> setting(int index);
     int setting_index(char const * const str);
 
+    // by interned name; a name resolved once with InternName applies to
+    // every node type that has a parameter or setting of that name
+    std::shared_ptr<AudioParam> param(NameID);
+    std::shared_ptr<AudioSetting> setting(NameID);
+
     std::vector<std::shared_ptr<AudioParam>> params() const {
         return _self->_params; }
     std::vector<std::shared_ptr<AudioSetting>> settings() const {
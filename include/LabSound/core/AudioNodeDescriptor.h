@@ -5,8 +5,28 @@
 #ifndef AudioNodeDescriptor_h
 #define AudioNodeDescriptor_h
 
+#include <atomic>
+#include <cstdint>
+
 namespace lab {
 
+// Parameter, setting and enumeration names are interned into compact ids,
+// so that a name can be resolved once, and then compared or looked up as an
+// integer. Interning is thread safe, and an id is valid for the life of the
+// program. The id of no name is zero.
+struct NameID
+{
+    uint32_t value = 0;
+
+    bool operator==(NameID rhs) const { return value == rhs.value; }
+    bool operator!=(NameID rhs) const { return value != rhs.value; }
+    explicit operator bool() const { return value != 0; }
+};
+
+NameID InternName(char const * const name);
+char const * InternedName(NameID);
+
+struct AudioNodeDescriptorIndex;
 struct AudioParamDescriptor;
 struct AudioSettingDescriptor;
 struct AudioNodeDescriptor
@@ -15,8 +35,23 @@ struct AudioNodeDescriptor
     AudioSettingDescriptor * settings = nullptr;
     int initialChannelCount = 0;
 
+    ~AudioNodeDescriptor();
+
     AudioParamDescriptor const * const param(char const * const) const;
     AudioSettingDescriptor const * const setting(char const * const) const;
+
+    // The slot of a named parameter or setting, which is its index on every
+    // node of the type, or -1. Lookups are hashed, by name or interned id.
+    int paramIndex(char const * const) const;
+    int paramIndex(NameID) const;
+    int settingIndex(char const * const) const;
+    int settingIndex(NameID) const;
+
+    // The hash tables behind the lookups, built on first use and shared by
+    // all nodes of the type.
+    AudioNodeDescriptorIndex const & index() const;
+
+    mutable std::atomic<AudioNodeDescriptorIndex *> _index {nullptr};
 };
 
 } // namespace
@@ -57,6 +57,25 @@ public:
 
     const std::string& name() const { return m_name; }
 
+    // A control-rate output carries one value per controlPeriod() frames instead of
+    // a full-rate signal, for modulators such as LFOs and envelopes. Its node writes
+    // the points and only evaluates its signal there; connected AudioParams sum the
+    // points and interpolate between them without a bus being rendered. If audio
+    // inputs are connected as well, the node fills the bus with expandControlPoints.
+    // The period is rounded down to a power of two no larger than the render quantum;
+    // zero makes the output audio rate. The first nonzero period allocates the points,
+    // so a node sets it when it is constructed; later calls may come from the audio thread.
+    void setControlPeriod(int frames);
+    int controlPeriod() const { return m_controlPeriod; }
+
+    // ProcessingSizeInFrames / controlPeriod() + 1 points; the last is at the first
+    // frame of the next quantum.
+    float * controlPoints() { return m_controlPoints.data(); }
+    int controlPointCount() const { return m_controlPeriod ? AudioNode::ProcessingSizeInFrames / m_controlPeriod + 1 : 0; }
+
+    // Fills every channel of the bus by interpolating the control points.
+    void expandControlPoints(ContextRenderLock &);
+
     // Must be called within the context's graph lock.
     static void disconnectAll(ContextGraphLock &, std::shared_ptr<AudioNodeOutput>);
     static void disconnectAllInputs(ContextGraphLock &, std::shared_ptr<AudioNodeOutput>);
@@ -113,6 +132,9 @@ private:
     int m_renderingFanOutCount;
     int m_renderingParamFanOutCount;
 
+    int m_controlPeriod = 0;
+    std::vector<float> m_controlPoints;
+
     // connected params
     std::set<std::shared_ptr<AudioParam>> m_params;
     typedef std::set<AudioParam *>::iterator ParamsIterator;
@@ -67,9 +67,16 @@ public:
 
     bool hasSampleAccurateValues() { return m_timeline.hasValues() || numberOfConnections(); }
 
+    // Writes the frame offsets within the current render quantum at which
+    // scheduled values change, so that the quantum can be split there.
+    // Returns the number of offsets written, at most maxFrames.
+    int eventFramesInQuantum(ContextRenderLock &, int bufferSize, int * frames, int maxFrames);
+
     // Calculates numberOfValues parameter values starting at the context's current time.
-    // Must be called in the context's render thread.
-    void calculateSampleAccurateValues(ContextRenderLock &, float * values, int numberOfValues);
+    // Must be called in the context's render thread. The values are always written; the
+    // returned shape reports whether they are constant or linear across the block, so
+    // that the caller can use a scalar path instead of the per-sample one.
+    AudioParamShape calculateSampleAccurateValues(ContextRenderLock &, float * values, int numberOfValues);
 
     AudioBus const* const bus() const;
 
@@ -80,8 +87,8 @@ public:
 
 private:
     // sampleAccurate corresponds to a-rate (audio rate) vs. k-rate in the Web Audio specification.
-    void calculateFinalValues(ContextRenderLock & r, float * values, int numberOfValues, bool sampleAccurate);
-    void calculateTimelineValues(ContextRenderLock & r, float * values, int numberOfValues);
+    void calculateFinalValues(ContextRenderLock & r, float * values, int numberOfValues, bool sampleAccurate, AudioParamShape * shape = nullptr);
+    void calculateTimelineValues(ContextRenderLock & r, float * values, int numberOfValues, AudioParamShape * shape);
 
     double m_value;
 
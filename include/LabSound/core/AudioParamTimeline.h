@@ -12,6 +12,26 @@
 namespace lab
 {
 
+// Describes a block of parameter values, so that a node can take a scalar
+// path when the values don't change across the block. For a Constant block
+// every value equals value; for a Linear block value i is value + i * slope,
+// to within rounding. Varying promises nothing.
+struct AudioParamShape
+{
+    enum Kind
+    {
+        Varying = 0,
+        Constant,
+        Linear
+    };
+
+    Kind kind = Varying;
+    float value = 0;  // the first value of the block
+    float slope = 0;  // per frame, for a Linear block
+
+    bool isConstant() const { return kind == Constant; }
+};
+
 class AudioParamTimeline
 {
 
@@ -34,11 +54,19 @@ public:
     // controlRate is the rate (number per second) at which parameter values will be calculated.
     // It should equal sampleRate for sample-accurate parameter changes, and otherwise will usually match
     // the render quantum size such that the parameter value changes once per render quantum.
+    // If shape is not null, it receives the shape of the values written.
     float valuesForTimeRange(double startTime, double endTime, float defaultValue,
-                             float * values, size_t numberOfValues, double sampleRate, double controlRate);
+                             float * values, size_t numberOfValues, double sampleRate, double controlRate,
+                             AudioParamShape * shape = nullptr);
 
     bool hasValues() { return m_events.size() > 0; }
 
+    // Writes the frame offsets within the quantum of bufferSize frames starting
+    // at startTime at which events occur, excluding the first frame. Each offset
+    // is the first frame at or after its event. Returns the number written,
+    // which is at most maxFrames.
+    int eventFrames(double startTime, double sampleRate, int bufferSize, int * frames, int maxFrames);
+
 private:
 
     // @tofix - move to implementation file to hide from public API
@@ -107,7 +135,8 @@ private:
 
     void insertEvent(const ParamEvent &);
     float valuesForTimeRangeImpl(double startTime, double endTime, float defaultValue,
-                                 float * values, size_t numberOfValues, double sampleRate, double controlRate);
+                                 float * values, size_t numberOfValues, double sampleRate, double controlRate,
+                                 AudioParamShape * shape);
 
     std::vector<ParamEvent> m_events;
 };
@@ -32,6 +32,15 @@ public:
     // Processes the source to destination bus.  The number of channels must match in source and destination.
     virtual void process(ContextRenderLock &, const AudioBus * source, AudioBus * destination, int bufferSize) = 0;
 
+    // Processes frames [offset, offset + count) of the source to the destination bus, for a node
+    // whose quantum is split into sub-blocks. The processor of a node that supports sub-quantum
+    // processing overrides this; the default can only process a whole buffer.
+    virtual void process(ContextRenderLock & r, const AudioBus * source, AudioBus * destination, int bufferSize, int offset, int count)
+    {
+        if (offset == 0 && count == bufferSize)
+            process(r, source, destination, bufferSize);
+    }
+
     // Resets filter state
     virtual void reset() = 0;
     bool isInitialized() const { return m_initialized; }
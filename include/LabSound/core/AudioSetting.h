@@ -16,6 +16,8 @@
 
 namespace lab
 {
+struct AudioSettingEnumIndex;
+
 // An AudioSetting holds settings for a node that don't vary with
 // time, and that cannot be driven by an audio bus.
 // The WebAudio interface typically exposes settings via functional
@@ -36,6 +38,7 @@ public:
 
 private:
     AudioSettingDescriptor const*const _desc;
+    AudioSettingEnumIndex const * _enumIndex = nullptr;  // hashed enums, if the node has indexed them
 
     float _valf = 0;
     uint32_t _vali = 0;
@@ -50,6 +53,12 @@ public:
     {
     }
 
+    AudioSetting(AudioSettingDescriptor const * const d, AudioSettingEnumIndex const * enumIndex)
+        : _desc(d)
+        , _enumIndex(enumIndex)
+    {
+    }
+
     ~AudioSetting() = default;
 
     std::string name() const { return _desc->name; }
@@ -57,19 +66,7 @@ public:
     SettingType type() const { return _desc->type; }
     char const * const * enums() const { return _desc->enums; }
 
-    int enumFromName(char const* const e)
-    {
-        if (!_desc->enums || !e)
-            return -1;
-
-        int enum_idx = 0;
-        for (char const* const* names_p = _desc->enums; *names_p != nullptr; ++names_p, ++enum_idx)
-        {
-            if (!strcmp(e, *names_p))
-                return enum_idx;
-        }
-        return -1;
-    }
+    int enumFromName(char const* const e) const;
 
     bool valueBool() const { return _valb; }
     float valueFloat() const { return _valf; }
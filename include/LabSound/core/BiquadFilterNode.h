@@ -26,6 +26,9 @@ public:
     virtual const char* name() const override { return static_name(); }
     static AudioNodeDescriptor * desc();
 
+    // coefficients are recomputed at each automation event within a quantum
+    virtual bool supportsSubQuantumProcessing() const override { return true; }
+
     FilterType type() const;
     void setType(FilterType type);
 
@@ -33,6 +33,20 @@ enum TempoSync
     TS_2D,
 };
 
+// How a delay line is read between samples. Linear is the cheapest and rolls off
+// the highs at fractional delays, cubic is flatter, and allpass keeps the full
+// spectrum but is recursive, so it suits delays that change slowly.
+enum class DelayInterpolation
+{
+    Linear,
+    Cubic,
+    Allpass,
+    _Count
+};
+
+// params:
+// settings: delayTime, interpolation
+//
 class DelayNode : public AudioBasicProcessorNode
 {
     DelayProcessor * delayProcessor();
@@ -48,6 +62,7 @@ public:
     static AudioNodeDescriptor * desc();
 
     std::shared_ptr<AudioSetting> delayTime();
+    std::shared_ptr<AudioSetting> interpolation();
 };
 
 }  // namespace lab
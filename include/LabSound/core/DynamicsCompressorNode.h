@@ -11,6 +11,7 @@
 namespace lab
 {
 
+class AudioSetting;
 class DynamicsCompressor;
 
 // Fun trick:
@@ -19,6 +20,13 @@ class DynamicsCompressor;
 //
 // sounds like an old radio
 //
+// With the bands setting at two or three, the signal is split at lowCrossover, and
+// at highCrossover for three bands, and each band is compressed independently with
+// the same parameters, so a loud bass doesn't duck the rest of the mix.
+//
+// params: threshold, knee, ratio, reduction, attack, release
+// settings: bands, lowCrossover, highCrossover
+//
 
 class DynamicsCompressorNode : public AudioNode
 {
@@ -45,8 +53,14 @@ public:
     std::shared_ptr<AudioParam> release() { return m_release; }
 
     // Amount by which the compressor is currently compressing the signal in decibels.
+    // In multi-band mode, it is the reduction of the most compressed band.
     std::shared_ptr<AudioParam> reduction() { return m_reduction; }
 
+    // Multi-band mode.
+    std::shared_ptr<AudioSetting> bands() { return m_bands; }                  // 1 to 3
+    std::shared_ptr<AudioSetting> lowCrossover() { return m_lowCrossover; }    // Hz
+    std::shared_ptr<AudioSetting> highCrossover() { return m_highCrossover; }  // Hz
+
 private:
     virtual double tailTime(ContextRenderLock & r) const override;
     virtual double latencyTime(ContextRenderLock & r) const override;
@@ -58,6 +72,9 @@ private:
     std::shared_ptr<AudioParam> m_reduction;
     std::shared_ptr<AudioParam> m_attack;
     std::shared_ptr<AudioParam> m_release;
+    std::shared_ptr<AudioSetting> m_bands;
+    std::shared_ptr<AudioSetting> m_lowCrossover;
+    std::shared_ptr<AudioSetting> m_highCrossover;
 };
 
 }  // namespace lab
@@ -8,6 +8,7 @@
 #include "LabSound/core/AudioScheduledSourceNode.h"
 #include "LabSound/core/Macros.h"
 #include "LabSound/core/PeriodicWave.h"
+#include <atomic>
 
 namespace lab
 {
@@ -16,6 +17,14 @@ class AudioBus;
 class AudioContext;
 class AudioSetting;
 
+// OscillatorNode plays a periodic waveform. Every type but CUSTOM plays one of the
+// basic waveforms, whose band-limited tables are built once for each sample rate and
+// shared by every oscillator. CUSTOM plays the waveform given to setPeriodicWave.
+//
+// The tables are chosen for the fundamental frequency, so the waveforms don't alias.
+// When the frequency or detune is automated, the tables are chosen for the highest
+// frequency in the render quantum.
+//
 // params: frequency, detune, amplitude, and bias
 // settings: type
 //
@@ -24,7 +33,7 @@ class AudioSetting;
 
 class OscillatorNode : public AudioScheduledSourceNode
 {
-    double phase = 0.0;
+    double phase = 0.0; // in cycles, [0, 1)
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
     virtual bool propagatesSilence(ContextRenderLock & r) const override;
@@ -44,6 +53,10 @@ public:
     OscillatorType type() const;
     void setType(OscillatorType type);
 
+    // Sets the waveform played by the CUSTOM type, and sets the type to CUSTOM. The wave
+    // should be created at the context's sample rate.
+    void setPeriodicWave(std::shared_ptr<PeriodicWave> periodicWave);
+
     std::shared_ptr<AudioParam> amplitude() { return m_amplitude; }
     std::shared_ptr<AudioParam> frequency() { return m_frequency; }
     std::shared_ptr<AudioParam> detune() { return m_detune; }
@@ -60,6 +73,25 @@ public:
     AudioFloatArray m_biasValues;
     AudioFloatArray m_detuneValues;
     AudioFloatArray m_amplitudeValues;
+    AudioFloatArray m_tablePositions;
+    AudioFloatArray m_lowerWaveValues;
+
+private:
+    struct WaveSlot;
+
+    void retireWave(WaveSlot * slot);
+
+    float m_contextSampleRate = 0;
+
+    // The waves in use belong to the audio thread. setType publishes a basic wave in
+    // m_pendingBasicWave, and setPeriodicWave a custom wave in m_pendingPeriodicWave. The
+    // audio thread pushes the slots it replaces on to m_retiredWaves, to be freed by the
+    // next setType, so a wave is never released on the audio thread.
+    WaveSlot * m_basicWave = nullptr;
+    WaveSlot * m_customWave = nullptr;
+    std::atomic<WaveSlot *> m_pendingBasicWave{nullptr};
+    std::atomic<WaveSlot *> m_pendingPeriodicWave{nullptr};
+    std::atomic<WaveSlot *> m_retiredWaves{nullptr};
 };
 
 }  // namespace lab
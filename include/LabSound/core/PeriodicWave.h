@@ -14,14 +14,31 @@
 namespace lab
 {
 
+// PeriodicWave holds a waveform as a set of wavetables, one for each third of an
+// octave of fundamental frequency, each with the partials above the Nyquist frequency
+// of its range removed. OscillatorNode plays them back without aliasing.
+//
+// Each table has periodicWaveSize() points, followed by a copy of its first point so
+// that an interpolated read of the last point stays in the table.
+//
+// A wave from real and imag coefficients is normalized to a peak of one, unless
+// normalization is disabled, in which case the coefficients are the amplitudes of
+// the partials.
+//
 class PeriodicWave
 {
 public:
     PeriodicWave(const float sampleRate, OscillatorType basicWaveform);
-    PeriodicWave(const float sampleRate, OscillatorType basicWaveform, std::vector<float> & real, std::vector<float> & imag);
+    PeriodicWave(const float sampleRate, OscillatorType basicWaveform, std::vector<float> & real, std::vector<float> & imag,
+                 bool disableNormalization = false);
 
     ~PeriodicWave();
 
+    // The tables for the basic waveforms are built once per sample rate and shared by every
+    // oscillator in the process. FAST_SINE shares the sine tables, and FALLING_SAWTOOTH shares
+    // the sawtooth tables.
+    static std::shared_ptr<PeriodicWave> sharedBasicWaveform(float sampleRate, OscillatorType basicWaveform);
+
     // Returns pointers to the lower and higher wavetable data for the pitch range containing
     // the given fundamental frequency. These two tables are in adjacent "pitch" ranges
     // where the higher table will have the maximum number of partials which won't alias when played back
@@ -35,6 +52,8 @@ public:
 
     unsigned periodicWaveSize() const;
 
+    float sampleRate() const { return m_sampleRate; }
+
 private:
     void generateBasicWaveform(OscillatorType);
 
@@ -56,7 +75,7 @@ private:
     int numberOfPartialsForRange(int rangeIndex) const;
 
     // Creates tables based on numberOfComponents Fourier coefficients.
-    void createBandLimitedTables(const float * real, const float * imag, int numberOfComponents);
+    void createBandLimitedTables(const float * real, const float * imag, int numberOfComponents, bool normalize);
 
     std::vector<std::unique_ptr<AudioFloatArray>> m_bandLimitedTables;
 };
@@ -26,7 +26,7 @@ struct SRC_Resampler;
 
 class SampledAudioNode final : public AudioScheduledSourceNode
 {
-    virtual void reset(ContextRenderLock& r) override {}
+    virtual void reset(ContextRenderLock& r) override { clearSchedules(); }
     virtual double tailTime(ContextRenderLock& r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock& r) const override { return 0; }
     virtual bool propagatesSilence(ContextRenderLock& r) const override { return false; }
@@ -5,9 +5,10 @@
 #ifndef WaveShaperNode_h
 #define WaveShaperNode_h
 
+#include "LabSound/core/AudioArray.h"
 #include "LabSound/core/AudioNode.h"
 #include <atomic>
-#include <mutex>
+#include <vector>
 
 namespace lab {
 enum OverSampleType
@@ -18,6 +19,17 @@ enum OverSampleType
     _OverSampleTypeCount
 };
 
+// WaveShaperNode maps its input through a curve spanning inputs from -1 to 1,
+// interpolating linearly between the points of the curve. Inputs beyond the
+// curve are clamped to its ends.
+//
+// A new curve is published to the audio thread without locking; the curve it
+// replaces is freed on the thread that sets the next curve, or by the node's
+// destructor. Oversampling runs the curve at two or four times the sample rate,
+// between half-band resampling filters, which reduces the aliasing of curves
+// that add high harmonics. The resamplers are built by the first setOversample
+// that turns oversampling on, so rendering never allocates them.
+//
 class WaveShaperNode : public AudioNode
 {
 public:
@@ -31,31 +43,36 @@ public:
 
     // copies the curve
     void setCurve(std::vector<float> & curve);
-    void setOversample(OverSampleType oversample) { m_oversample = oversample; }
+    void setOversample(OverSampleType oversample);
     OverSampleType oversample() const { return m_oversample; }
 
     // AudioNode
     virtual void process(ContextRenderLock &, int bufferSize) override;
-    virtual void reset(ContextRenderLock &) override {}
+    virtual void reset(ContextRenderLock &) override;
 
 protected:
+    struct Curve;
+
     void processCurve(const float * source, float * destination, int framesToProcess);
     virtual double tailTime(ContextRenderLock& r) const override { return 0.; }
     virtual double latencyTime(ContextRenderLock& r) const override { return 0.; }
 
-    std::mutex _curveMutex;
-    
-    std::vector<float> m_curve;
-    std::vector<float> m_newCurve;
-    std::atomic<int> _newCurveReady{0};
+    // The curve in use belongs to the audio thread. setCurve publishes a new one
+    // in m_pendingCurve, and the audio thread pushes the one it replaces on to
+    // m_retiredCurves, to be freed by the next setCurve.
+    Curve * m_curve = nullptr;
+    std::atomic<Curve *> m_pendingCurve{nullptr};
+    std::atomic<Curve *> m_retiredCurves{nullptr};
+    AudioFloatArray m_positions;
 
-    // Oversampling.
-    void * m_oversamplingArrays = nullptr;
+    // Oversampling. The arrays are published once by setOversample, and freed by the destructor.
+    std::atomic<void *> m_oversamplingArrays{nullptr};
     std::atomic<OverSampleType> m_oversample{OverSampleType::NONE};
+    OverSampleType m_lastOversample = OverSampleType::NONE;
 
     // Use up-sampling, process at the higher sample-rate, then down-sample.
-    void processCurve2x(const float * source, float * dest, int framesToProcess);
-    void processCurve4x(const float * source, float * dest, int framesToProcess);
+    void processCurve2x(int channel, const float * source, float * dest, int framesToProcess);
+    void processCurve4x(int channel, const float * source, float * dest, int framesToProcess);
 };
 
 }  // namespace lab
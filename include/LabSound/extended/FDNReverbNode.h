@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef labsound_fdnreverbnode_h
+#define labsound_fdnreverbnode_h
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioParam.h"
+
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class AudioSetting;
+
+// FDNReverbNode is an algorithmic reverb built from a feedback delay network:
+// eight or sixteen delay lines whose outputs are low pass filtered, mixed by a
+// Hadamard matrix, and fed back with the input. Unlike ConvolverNode, its cost
+// doesn't depend on the length of the reverb; it is fixed by the number of lines.
+//
+// Every line is longer than a render quantum, so a whole quantum of every line
+// is read, filtered, mixed, and written back as vectors. The line lengths are
+// slowly modulated to break up metallic resonances; a modulation of zero turns
+// the modulated reads off, which is cheaper.
+//
+// The output is stereo and entirely wet. A stereo input feeds the even lines from
+// the left channel and the odd lines from the right; a mono input feeds them all.
+//
+// All sixteen lines are allocated when the node is constructed, for the largest
+// size at the context's sample rate at that time. The lines and size settings
+// only choose how many of them are in use and how long they are.
+//
+// params: decayTime, damping, modulation
+// settings: lines, size
+//
+class FDNReverbNode : public AudioNode
+{
+public:
+    static constexpr int MaxLines = 16;
+
+    FDNReverbNode(AudioContext & ac);
+    virtual ~FDNReverbNode();
+
+    static const char * static_name() { return "FDNReverb"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    std::shared_ptr<AudioParam> decayTime() const { return _decayTime; }    // seconds to decay by 60dB
+    std::shared_ptr<AudioParam> damping() const { return _damping; }        // [0, 1], high frequencies decay faster
+    std::shared_ptr<AudioParam> modulation() const { return _modulation; }  // [0, 1]
+
+    std::shared_ptr<AudioSetting> lines() const { return _lines; }  // 8 or 16
+    std::shared_ptr<AudioSetting> size() const { return _size; }    // [0.25, 2], scales the line lengths
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override;
+    virtual double latencyTime(ContextRenderLock &) const override { return 0; }
+
+    void configure(float sampleRate, int lineCount, float size);
+
+    struct Line;
+
+    std::shared_ptr<AudioParam> _decayTime;
+    std::shared_ptr<AudioParam> _damping;
+    std::shared_ptr<AudioParam> _modulation;
+    std::shared_ptr<AudioSetting> _lines;
+    std::shared_ptr<AudioSetting> _size;
+
+    std::vector<std::unique_ptr<Line>> _network;  // MaxLines, of which _lineCount are in use
+    int _lineCount = 0;
+    float _configuredSize = 0;
+    float _configuredSampleRate = 0;
+};
+
+}  // namespace lab
+
+#endif  // labsound_fdnreverbnode_h
@@ -11,6 +11,9 @@
 namespace lab
 {
 
+// FunctionNode calls a function to fill each output channel in turn. For
+// processing that needs inputs, parameters, or the whole output at once, make
+// a KernelNode instead.
 class FunctionNode : public AudioScheduledSourceNode
 {
 
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef labsound_graphdescription_h
+#define labsound_graphdescription_h
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lab {
+
+class AudioContext;
+class AudioNode;
+
+// A GraphDescription holds the nodes, parameter values, connections and
+// schedules of a graph, with every node type and parameter already resolved
+// to a NodeRegistry index and a parameter or setting slot. Instantiating one
+// creates the whole graph in a single pass over a flat list of operations,
+// without any name lookups.
+//
+// Descriptions are parsed from the text format of serialization_proposal.txt,
+// or loaded from the compact binary form produced by toBinary().
+//
+// Text format:
+//
+//     # comment
+//     osc1                           a key at the left names a node
+//         Oscillator                 a capitalized component is the node's registered type
+//             frequency 440          a parameter's value
+//             frequency 0, 440; 0.5, 500     time, value pairs
+//             type sine              a setting; enums by name, in any case, or index
+//     dest
+//         DefaultAudio               the context's destination node
+//     > osc1 > gain1 > dest          a connection chain; signal flows left to right
+//     > lfo > osc1:detune            to a parameter, or to an input index as gain1:1
+//     > split:1 > gain2              from an output index
+//     osc1
+//         schedule
+//             start 0, 1             start and stop times of a scheduled node
+//             stop 0.5
+//         ui                         other lowercase components are kept as metadata
+//             pos 345, 200
+//
+// Parse and load errors throw std::runtime_error; text errors name the line.
+//
+// Binary format, all little endian:
+//
+//     BinaryHeader
+//     types    typeCount records of {u32 name, u16 paramCount, u16 settingCount}
+//              followed by the u32 names of the type's params, then its settings,
+//              as registered when the file was written
+//     nodes    nodeCount records of {u32 name, u16 type, u16 reserved}
+//     ops      opCount 16 byte Op records
+//     meta     metaCount records of {u32 node, u32 component, u32 key, u32 value}
+//     strings  stringBytes of nul terminated strings; names above are offsets here
+//
+// A type's parameter and setting names are compared to the registered
+// descriptor once per type when a file is loaded; if they differ, for instance
+// because a parameter was added since, the file's slots are remapped by name.
+class GraphDescription
+{
+public:
+    enum class OpCode : uint8_t
+    {
+        SetParam,        // node, slot, a = value
+        SetParamAtTime,  // node, slot, a = time, b = value
+        SetSetting,      // node, slot, aux = SettingValue, a = value, or bits = value
+        Connect,         // node = destination, slot = input, source, aux = output
+        ConnectParam,    // node = destination, slot = param, source, aux = output
+        Start,           // node, a = when
+        Stop             // node, a = when
+    };
+
+    enum SettingValue : uint8_t
+    {
+        SettingBool,
+        SettingInteger,
+        SettingFloat,
+        SettingEnum
+    };
+
+    struct Op
+    {
+        OpCode code;
+        uint8_t aux;
+        uint16_t node;
+        uint16_t slot;
+        uint16_t source;
+        union
+        {
+            float a;
+            uint32_t bits;
+        };
+        float b;
+    };
+    static_assert(sizeof(Op) == 16, "GraphDescription::Op is a binary record");
+
+    struct BinaryHeader
+    {
+        char magic[4];  // "LSGB"
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t typeCount;
+        uint32_t nodeCount;
+        uint32_t opCount;
+        uint32_t metaCount;
+        uint32_t stringBytes;
+    };
+
+    static const uint16_t kDestinationType = 0xffff;
+
+    struct Node
+    {
+        std::string name;
+        uint16_t type;  // index into types(), or kDestinationType
+    };
+
+    struct NodeType
+    {
+        std::string name;
+        int registryIndex;
+    };
+
+    struct Meta
+    {
+        uint16_t node;
+        std::string component;
+        std::string key;
+        std::string value;
+    };
+
+    // The nodes of an instantiated description, in description order. The
+    // connections are committed as a single graph transaction; connected
+    // becomes ready once all of them have taken effect.
+    struct Instance
+    {
+        std::vector<std::shared_ptr<AudioNode>> nodes;
+        std::future<void> connected;
+    };
+
+    static GraphDescription FromText(const std::string & text);
+    static GraphDescription FromBinary(const void * data, size_t size);
+
+    std::vector<uint8_t> toBinary() const;
+
+    Instance instantiate(AudioContext &) const;
+
+    // -1 if the description has no node of that name
+    int nodeIndex(const std::string & name) const;
+
+    const std::vector<Node> & nodes() const { return _nodes; }
+    const std::vector<NodeType> & types() const { return _types; }
+    const std::vector<Op> & ops() const { return _ops; }
+    const std::vector<Meta> & meta() const { return _meta; }
+
+private:
+    std::vector<NodeType> _types;
+    std::vector<Node> _nodes;
+    std::vector<Op> _ops;
+    std::vector<Meta> _meta;
+    std::unordered_map<std::string, int> _nodeIndex;
+
+    friend struct GraphTextParser;
+};
+
+}  // namespace lab
+
+#endif  // labsound_graphdescription_h
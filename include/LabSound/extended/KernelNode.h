@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef labsound_kernel_node_h
+#define labsound_kernel_node_h
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/core/AudioSetting.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/Registry.h"
+
+#include <type_traits>
+#include <vector>
+
+namespace lab
+{
+
+// One quantum of work for a DSP kernel.
+//
+// inputs holds a bus for each of the node's inputs, the sum of its
+// connections; an unconnected input is silent. params holds the values of
+// the node's parameters, in the order of its descriptor, on every frame of the
+// quantum, and shapes tells which of them are constant or linear, so that a
+// kernel can skip reading the arrays.
+//
+// A kernel writes frames [offset, offset + frames) of each channel of output.
+// Effects always process the whole quantum; a source is handed the frames
+// between its start and stop times, and the rest of its output is silent.
+struct KernelBlock
+{
+    ContextRenderLock & r;
+    AudioBus const * const * inputs;
+    int inputCount;
+    AudioBus * output;
+    float const * const * params;
+    AudioParamShape const * shapes;
+    int offset;
+    int frames;
+    int bufferSize;
+    float sampleRate;
+
+    float const * input(int index, int channel) const { return inputs[index]->channel(channel)->data(); }
+    float * outputChannel(int channel) const { return output->channel(channel)->mutableData(); }
+    float param(int index, int frame) const { return shapes[index].isConstant() ? shapes[index].value : params[index][frame]; }
+};
+
+// DSPKernel provides the defaults for the optional parts of a kernel. A kernel
+// derives from it and hides the members it needs; none of them are virtual,
+// because KernelNode calls them on the kernel's own type.
+struct DSPKernel
+{
+    // The number of inputs. A kernel with no inputs is a source, and its node
+    // is scheduled with start and stop.
+    enum
+    {
+        Inputs = 1
+    };
+
+    // Called once, when the node is made, so that the kernel can keep the
+    // node's settings.
+    void bind(AudioNode &) {}
+
+    // Clears the processing state, on the audio thread.
+    void reset() {}
+
+    double tailTime() const { return 0; }
+    double latencyTime() const { return 0; }
+};
+
+// KernelParams evaluates the sample accurate values of a node's parameters
+// for a KernelBlock, into storage the node keeps between quanta.
+class KernelParams
+{
+public:
+    explicit KernelParams(int paramCount);
+
+    void evaluate(ContextRenderLock & r, std::vector<std::shared_ptr<AudioParam>> const & params, int bufferSize);
+
+    float const * const * values() const { return m_pointers.data(); }
+    AudioParamShape const * shapes() const { return m_shapes.data(); }
+
+private:
+    AudioFloatArray m_storage;
+    std::vector<float const *> m_pointers;
+    std::vector<AudioParamShape> m_shapes;
+};
+
+// KernelNode makes a node from a DSP kernel, a struct that processes a whole
+// quantum at a time, with every input, the output, and the parameters in
+// hand. The kernel is a member of the node and its process is called
+// directly, so it runs as fast as a node written into the library, and the
+// node can be registered in NodeRegistry alongside the built in nodes.
+//
+// A kernel needs
+//
+//     static const char * static_name();
+//     static AudioNodeDescriptor * desc();
+//     void process(const KernelBlock &);
+//
+// and whatever of DSPKernel's members it wants to replace. The descriptor's
+// params and settings become the node's. Its channel count fixes the number
+// of output channels; if it is zero, the output has as many channels as the
+// first input. For example,
+//
+//     struct Tremolo : DSPKernel
+//     {
+//         static const char * static_name() { return "Tremolo"; }
+//         static AudioNodeDescriptor * desc();  // params rate and depth
+//         void process(const KernelBlock & block);
+//         double phase = 0;
+//     };
+//
+//     KernelNode<Tremolo>::Register();
+//     auto tremolo = std::make_shared<KernelNode<Tremolo>>(ac);
+//
+template <typename Kernel>
+class KernelNode : public std::conditional<Kernel::Inputs == 0, AudioScheduledSourceNode, AudioNode>::type
+{
+    using Base = typename std::conditional<Kernel::Inputs == 0, AudioScheduledSourceNode, AudioNode>::type;
+    using IsSource = std::integral_constant<bool, Kernel::Inputs == 0>;
+
+public:
+    explicit KernelNode(AudioContext & ac)
+        : Base(ac, *Kernel::desc())
+        , m_params(static_cast<int>(this->params().size()))
+        , m_inputs(Kernel::Inputs > 0 ? Kernel::Inputs : 1)
+    {
+        for (int i = 0; i < Kernel::Inputs; ++i)
+            this->addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+        // a descriptor without a channel count still needs an output, which follows the first input
+        if (!this->numberOfOutputs())
+            this->addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, 1)));
+
+        m_kernel.bind(*this);
+        this->initialize();
+    }
+
+    virtual ~KernelNode()
+    {
+        this->uninitialize();
+    }
+
+    static const char * static_name() { return Kernel::static_name(); }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc() { return Kernel::desc(); }
+
+    // Adds the node type to a registry, so that it can be made by name.
+    static bool Register(NodeRegistry & registry = NodeRegistry::Instance())
+    {
+        return registry.Register(static_name(), desc(),
+            [](AudioContext & ac) -> AudioNode * { return new KernelNode(ac); },
+            [](AudioNode * n) { delete n; });
+    }
+
+    // The kernel is used on the audio thread; change it only under a ContextRenderLock.
+    Kernel & kernel() { return m_kernel; }
+
+    virtual void process(ContextRenderLock & r, int bufferSize) override
+    {
+        AudioBus * outputBus = this->output(0)->bus(r);
+        if (!this->isInitialized())
+        {
+            outputBus->zero();
+            return;
+        }
+
+        int offset = 0;
+        int frames = bufferSize;
+        if (IsSource::value)
+        {
+            offset = this->_self->_scheduler._renderOffset;
+            frames = this->_self->_scheduler._renderLength;
+            if (!frames)
+            {
+                outputBus->zero();
+                return;
+            }
+        }
+        else if (!Kernel::desc()->initialChannelCount)
+        {
+            const int channels = this->input(0)->bus(r)->numberOfChannels();
+            if (channels && channels != outputBus->numberOfChannels())
+            {
+                this->output(0)->setNumberOfChannels(r, channels);
+                outputBus = this->output(0)->bus(r);
+            }
+        }
+
+        for (int i = 0; i < Kernel::Inputs; ++i)
+            m_inputs[i] = this->input(i)->bus(r);
+
+        m_params.evaluate(r, this->_self->_params, bufferSize);
+
+        if (offset || frames != bufferSize)
+            outputBus->zero();
+
+        const KernelBlock block {r, m_inputs.data(), Kernel::Inputs, outputBus, m_params.values(), m_params.shapes(),
+                                 offset, frames, bufferSize, r.context()->sampleRate()};
+        m_kernel.process(block);
+        outputBus->clearSilentFlag();
+    }
+
+    virtual void reset(ContextRenderLock &) override { m_kernel.reset(); }
+
+private:
+    virtual double tailTime(ContextRenderLock &) const override { return m_kernel.tailTime(); }
+    virtual double latencyTime(ContextRenderLock &) const override { return m_kernel.latencyTime(); }
+
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return propagatesSilence(r, IsSource()); }
+
+    bool propagatesSilence(ContextRenderLock &, std::true_type) const
+    {
+        return !this->isPlayingOrScheduled() || this->hasFinished();
+    }
+    bool propagatesSilence(ContextRenderLock & r, std::false_type) const
+    {
+        return AudioNode::propagatesSilence(r);
+    }
+
+    Kernel m_kernel;
+    KernelParams m_params;
+    std::vector<AudioBus const *> m_inputs;
+};
+
+}  // namespace lab
+
+#endif  // labsound_kernel_node_h
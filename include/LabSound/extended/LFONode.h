@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef labsound_lfonode_h
+#define labsound_lfonode_h
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioScheduledSourceNode.h"
+
+namespace lab
+{
+
+class AudioSetting;
+
+// LFONode is a low frequency oscillator for modulating parameters. Its output
+// is control rate, see AudioNodeOutput::setControlPeriod: the waveform is only
+// evaluated once every period frames, and the parameters it is connected to
+// interpolate between those points. A slow LFO driving a filter cutoff or a
+// gain therefore costs a few points per quantum rather than a full-rate signal.
+//
+// The output is bias + amplitude * waveform. The waveform types are those of
+// OscillatorNode; FastSine is the same as Sine, and Custom is silent. The
+// node's own parameters are sampled at the control points.
+//
+// params: frequency, amplitude, bias
+// settings: type, period
+//
+class LFONode : public AudioScheduledSourceNode
+{
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+
+public:
+    LFONode(AudioContext & ac);
+    virtual ~LFONode();
+
+    static const char * static_name() { return "LFO"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override { _phase = 0; }
+
+    OscillatorType type() const;
+    void setType(OscillatorType type);
+
+    std::shared_ptr<AudioParam> frequency() const { return _frequency; }  // hz
+    std::shared_ptr<AudioParam> amplitude() const { return _amplitude; }  // default 1.0
+    std::shared_ptr<AudioParam> bias() const { return _bias; }            // default 0.0
+
+    // frames between control points, a power of two from 2 to the render quantum size
+    std::shared_ptr<AudioSetting> period() const { return _period; }
+
+private:
+    std::shared_ptr<AudioParam> _frequency;
+    std::shared_ptr<AudioParam> _amplitude;
+    std::shared_ptr<AudioParam> _bias;
+    std::shared_ptr<AudioSetting> _type;
+    std::shared_ptr<AudioSetting> _period;
+
+    AudioFloatArray _frequencyValues;
+    AudioFloatArray _amplitudeValues;
+    AudioFloatArray _biasValues;
+
+    double _phase = 0;  // in cycles, [0, 1)
+};
+
+}  // namespace lab
+
+#endif  // labsound_lfonode_h
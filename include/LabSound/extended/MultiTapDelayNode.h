@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef labsound_multitapdelaynode_h
+#define labsound_multitapdelaynode_h
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/DelayNode.h"
+
+#include <memory>
+#include <vector>
+
+namespace lab
+{
+
+class AudioSetting;
+
+// MultiTapDelayNode reads up to four taps from a single delay line per channel,
+// and outputs the sum of the taps scaled by their gains. Chorus, flanger, and
+// multi-tap echo effects can be built from one node rather than a delay node
+// per voice, each of which would keep a copy of the same signal.
+//
+// The tap times are parameters, so they may be modulated, for example by an
+// LFONode. A tap whose time is steady over a render quantum is read as a block;
+// a modulated tap is read frame by frame with the selected interpolation. Taps
+// with a gain of zero are skipped. Delay times are clamped to maxDelayTime.
+//
+// The lines are allocated when the node is constructed, one for each of up to
+// maxChannels input channels, using the context's sample rate at that time.
+// Input channels beyond maxChannels are output as silence.
+//
+// params: delayTime1, gain1, delayTime2, gain2, delayTime3, gain3, delayTime4, gain4
+// settings: interpolation
+//
+class MultiTapDelayNode : public AudioNode
+{
+public:
+    static constexpr int TapCount = 4;
+
+    MultiTapDelayNode(AudioContext & ac, double maxDelayTime = 2.0, int maxChannels = 2);
+    virtual ~MultiTapDelayNode();
+
+    static const char * static_name() { return "MultiTapDelay"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override;
+
+    double maxDelayTime() const { return _maxDelayTime; }
+    int maxChannels() const { return static_cast<int>(_lines.size()); }
+
+    // tap is in [0, TapCount)
+    std::shared_ptr<AudioParam> delayTime(int tap) const;  // seconds
+    std::shared_ptr<AudioParam> gain(int tap) const;       // tap 0 defaults to 1, the others to 0
+
+    std::shared_ptr<AudioSetting> interpolation() const { return _interpolation; }
+
+private:
+    virtual double tailTime(ContextRenderLock &) const override { return _maxDelayTime; }
+    virtual double latencyTime(ContextRenderLock &) const override { return 0; }
+
+    struct Line;
+
+    double _maxDelayTime;
+    std::shared_ptr<AudioParam> _delayTimes[TapCount];
+    std::shared_ptr<AudioParam> _gains[TapCount];
+    std::shared_ptr<AudioSetting> _interpolation;
+
+    std::vector<std::unique_ptr<Line>> _lines;  // one per channel, up to maxChannels
+    AudioFloatArray _delayFrames[TapCount];
+    AudioFloatArray _gainValues[TapCount];
+    AudioFloatArray _tapOutput;
+};
+
+}  // namespace lab
+
+#endif  // labsound_multitapdelaynode_h
@@ -10,10 +10,20 @@
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioScheduledSourceNode.h"
 
+#include <atomic>
+#include <vector>
+
 namespace lab
 {
 class AudioSetting;
-
+class RandomGenerator;
+
+// NoiseNode generates white, pink, or brown noise. Every channel of the
+// output is filled with its own stream of noise. The streams are determined
+// by the seed setting; changing the seed, or resetting the node, restarts them.
+//
+// settings: type, seed
+//
 class NoiseNode : public AudioScheduledSourceNode
 {
 
@@ -39,24 +49,22 @@ public:
     NoiseType type() const;
     void setType(NoiseType newType);
 
+    uint32_t seed() const;
+    void setSeed(uint32_t seed);
+
 private:
     virtual bool propagatesSilence(ContextRenderLock & r) const override;
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
 
-    std::shared_ptr<AudioSetting> _type;
-
-    uint32_t whiteSeed = 1489853723;
+    void reseed();
 
-    float lastBrown = 0;
+    std::shared_ptr<AudioSetting> _type;
+    std::shared_ptr<AudioSetting> _seed;
 
-    float pink0 = 0;
-    float pink1 = 0;
-    float pink2 = 0;
-    float pink3 = 0;
-    float pink4 = 0;
-    float pink5 = 0;
-    float pink6 = 0;
+    // one for each channel the output could have, made by the constructor
+    std::vector<std::unique_ptr<RandomGenerator>> _generators;
+    std::atomic<bool> _reseed {false};
 };
 }
 
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#pragma once
+
+#ifndef labsound_polyphonicnode_h
+#define labsound_polyphonicnode_h
+
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/extended/GraphDescription.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lab
+{
+
+class AudioSetting;
+
+enum class VoiceStealing
+{
+    None = 0,   // a note is dropped when every voice is held
+    Oldest,     // the longest held voice is reused
+    Quietest,   // the held voice with the lowest output level is reused
+    _Count
+};
+
+// PolyphonicNode plays notes on a fixed bank of voices, each an instance of
+// the same GraphDescription. The description is the immutable prototype; all
+// of the voices are created up front by setVoices, so starting and ending
+// notes never builds or tears down nodes, and never changes the graph.
+//
+// The voices are not connected to the graph. The node pulls the output node
+// of each sounding voice and mixes them to its output; an idle voice is not
+// pulled at all and so costs nothing to render.
+//
+// noteOn takes an idle voice if there is one, then the voice that has been
+// releasing longest, and otherwise steals a held voice per the stealing
+// setting. A released voice returns to idle once its scheduled nodes have
+// finished or its output has stayed silent for a few quanta.
+//
+// By default a note start sets any parameter named "gate" to one, and any
+// named "velocity" to the note's velocity, at the note's time, and starts the
+// voice's scheduled nodes. A release sets the gates to zero, or stops the
+// scheduled nodes if the voice has no gate. Gates are sample accurate; the
+// voice's scheduled nodes start in the quantum in which the voice resumes.
+// setVoiceHandlers replaces either behaviour, for example to set a frequency
+// from the key.
+//
+// params:
+// settings: stealing
+//
+class PolyphonicNode : public AudioNode
+{
+public:
+    // when is relative to the context's current time, as for start() and stop()
+    using VoiceHandler = std::function<void(GraphDescription::Instance & voice, int key, float velocity, double when)>;
+
+    PolyphonicNode(AudioContext & ac);
+    virtual ~PolyphonicNode();
+
+    static const char * static_name() { return "Polyphonic"; }
+    virtual const char * name() const override { return static_name(); }
+    static AudioNodeDescriptor * desc();
+
+    // Instantiates count voices from the description, and replaces the current
+    // voices once the render thread picks them up. outputNode names the node
+    // in the description whose first output is the voice's output. Throws
+    // std::invalid_argument if the node doesn't exist, or if the description
+    // uses the destination. The voices are connected by a graph transaction
+    // committed to the context, as their own connections are.
+    void setVoices(AudioContext & ac, std::shared_ptr<const GraphDescription> voice,
+                   const std::string & outputNode, int count);
+
+    void setVoiceHandlers(VoiceHandler onStart, VoiceHandler onRelease);
+
+    // returns the index of the voice playing the note, or -1 if none was free
+    int noteOn(int key, float velocity = 1.f, double when = 0);
+    void noteOff(int key, double when = 0);
+    void allNotesOff(double when = 0);
+
+    int voiceCount() const;
+    int sounding() const;  // voices that are held or releasing
+
+    std::shared_ptr<AudioSetting> stealing() const { return _stealing; }
+
+    virtual void process(ContextRenderLock &, int bufferSize) override;
+    virtual void reset(ContextRenderLock &) override {}
+
+private:
+    virtual double tailTime(ContextRenderLock & r) const override { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
+    virtual bool propagatesSilence(ContextRenderLock & r) const override { return false; }
+
+    void release(int voice, double when);
+
+    struct Internals;
+    std::unique_ptr<Internals> _internals;
+
+    std::shared_ptr<AudioSetting> _stealing;
+};
+
+}  // namespace lab
+
+#endif  // labsound_polyphonicnode_h
@@ -7,29 +7,55 @@
 
 #include "LabSound/core/AudioArray.h"
 #include "LabSound/extended/AudioContextLock.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace lab
 {
 
 class AudioBus;
-class FFTFrame;
+class AnalysisWorker;
 
-class RealtimeAnalyser
+// One analysis of an analyser's input, published as a whole; see
+// RealtimeAnalyser::snapshot.
+struct AnalyserSnapshot
 {
+    uint64_t frame = 0;              // the number of input frames written when the analysis began
+    int fftSize = 0;
+    std::vector<float> magnitudes;   // linear and smoothed, fftSize / 2 bins
+    std::vector<float> timeDomain;   // the last fftSize input frames, mixed to mono
+};
 
+// RealtimeAnalyser keeps a spectrum of the audio passing through an
+// AnalyserNode, for visualizers and meters.
+//
+// The audio thread does no more than mix its input into a ring, without
+// locking or allocating. The analysis runs on a worker thread shared by every
+// analyser, about 120 times a second when new input has arrived, with windows
+// and FFTs made once per size. Each analysis is published as an immutable
+// snapshot that any number of threads may hold and read, at any rate. The
+// snapshot is exchanged with the shared_ptr atomic functions, which may take a
+// short lock between readers and the worker; the audio thread never touches it.
+// Smoothing is applied once per analysis, however often the results are read.
+class RealtimeAnalyser
+{
     RealtimeAnalyser(const RealtimeAnalyser &);  // noncopyable
 
 public:
     RealtimeAnalyser(int fftSize);
     virtual ~RealtimeAnalyser();
 
+    // Clears the input and the smoothed spectrum; safe on the audio thread.
     void reset();
 
-    int fftSize() const { return m_fftSize; }
+    int fftSize() const { return m_fftSize.load(std::memory_order_relaxed); }
+
+    // Takes effect at the next analysis; nothing is reallocated.
     void setFftSize(int fftSize);
 
-    uint32_t frequencyBinCount() const { return m_fftSize / 2; }
+    uint32_t frequencyBinCount() const { return fftSize() / 2; }
 
     void setMinDecibels(double k) { m_minDecibels = k; }
     double minDecibels() const { return m_minDecibels; }
@@ -40,6 +66,9 @@ public:
     void setSmoothingTimeConstant(double k) { m_smoothingTimeConstant = k; }
     double smoothingTimeConstant() const { return m_smoothingTimeConstant; }
 
+    // The latest analysis, or nullptr before the first; it never changes once published.
+    std::shared_ptr<const AnalyserSnapshot> snapshot() const;
+
     void getFloatFrequencyData(std::vector<float> &);
     void getFloatTimeDomainData(std::vector<float> &);
 
@@ -49,6 +78,7 @@ public:
     void getByteFrequencyData(std::vector<uint8_t> &, bool resample);
     void getByteTimeDomainData(std::vector<uint8_t> &);
 
+    // Called on the audio thread.
     void writeInput(ContextRenderLock & r, AudioBus *, int bufferSize);
 
     static const double DefaultSmoothingTimeConstant;
@@ -61,24 +91,39 @@ public:
     static const int InputBufferSize;
 
 private:
-    // The audio thread writes the input audio here.
+    friend class AnalysisWorker;
+
+    // Called on the worker thread, when there is new input.
+    void analyse(AnalysisWorker & worker);
+
+    // The audio thread writes the input audio here, and then advances m_writeFrame.
+    // reset doesn't clear the ring; it records the frame before which the input is silent.
     AudioFloatArray m_inputBuffer;
-    int m_writeIndex;
+    std::atomic<uint64_t> m_writeFrame {0};
+    std::atomic<uint64_t> m_resetFrame {0};
+    std::atomic<bool> m_resetRequested {false};
 
-    int m_fftSize;
-    std::unique_ptr<FFTFrame> m_analysisFrame;
-    void doFFTAnalysis();
+    std::atomic<int> m_fftSize;
 
-    // doFFTAnalysis() stores the floating-point magnitude analysis data here.
+    // the worker's state: the smoothed magnitudes, the frame and size of the last analysis,
+    // and the frame of the last reset seen
     AudioFloatArray m_magnitudeBuffer;
-    AudioFloatArray & magnitudeBuffer() { return m_magnitudeBuffer; }
+    uint64_t m_analysedFrame = 0;
+    int m_analysedSize = 0;
+    uint64_t m_silentBefore = 0;
+
+    // The published snapshot, and the worker's own references to it and to the
+    // one before, which is filled again once every reader has let it go.
+    std::shared_ptr<const AnalyserSnapshot> m_snapshot;
+    std::shared_ptr<AnalyserSnapshot> m_current;
+    std::shared_ptr<AnalyserSnapshot> m_spare;
 
     // A value between 0 and 1 which averages the previous version of m_magnitudeBuffer with the current analysis magnitude data.
-    double m_smoothingTimeConstant;
+    std::atomic<double> m_smoothingTimeConstant;
 
     // The range used when converting when using getByteFrequencyData().
-    double m_minDecibels;
-    double m_maxDecibels;
+    std::atomic<double> m_minDecibels;
+    std::atomic<double> m_maxDecibels;
 };
 
 }  // namespace lab
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "LabSound/core/AudioNode.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,42 @@ public:
     std::vector<std::string> Names() const;
     lab::AudioNode* Create(const std::string& n, lab::AudioContext& ac);
     AudioNodeDescriptor const * const Descriptor(const std::string & n) const;
+
+    // Types are also indexed in registration order, so that a name need only
+    // be looked up once. Registering a name again replaces the type, keeping
+    // its index. TypeIndex returns -1 for unregistered names.
+    int TypeIndex(const std::string& n) const;
+    int TypeCount() const;
+    std::string const & Name(int typeIndex) const;
+    lab::AudioNode* Create(int typeIndex, lab::AudioContext& ac);
+    AudioNodeDescriptor const * const Descriptor(int typeIndex) const;
+    DeleteNodeFn Deleter(int typeIndex) const;
+
+    // Pooled nodes. Acquire hands out a node of the type that was released
+    // earlier in the same context, reset to the parameter and setting values
+    // it was constructed with, or creates a new one if the pool is empty.
+    // When the last reference to an acquired node is released, the node goes
+    // back to the pool instead of being deleted, unless it is still connected
+    // or the pool is full. Releasing may happen on any thread, including the
+    // render thread; it only queues the node, which the next Acquire of the
+    // type resets, under the context's render lock, or deletes.
+    //
+    // Bus settings, such as a SampledAudioNode's source, are kept, so that a
+    // pooled one shot is ready to be scheduled again. Don't hold on to a
+    // node's params or settings beyond the node itself.
+    std::shared_ptr<AudioNode> Acquire(int typeIndex, AudioContext& ac);
+    std::shared_ptr<AudioNode> Acquire(const std::string& n, AudioContext& ac);
+
+    // Creates nodes up front, so that the first Acquires don't allocate.
+    void Reserve(int typeIndex, AudioContext& ac, int count);
+
+    // The most nodes kept per type and context; 256 by default.
+    void SetPoolCapacity(int capacity);
+
+    // Deletes the nodes pooled for a context, and those of any context that
+    // no longer exists. Nodes still in use are deleted by a later Acquire or
+    // ClearPools, after they have been released.
+    void ClearPools(AudioContext& ac);
 };
 
 } // lab
@@ -1,4 +1,3 @@
-
 // SPDX-License-Identifier: BSD-2-Clause
 // Copyright (C) 2015, The LabSound Authors. All rights reserved.
 
@@ -12,6 +11,21 @@
 
 namespace lab
 {
+
+// SupersawNode is a bank of detuned sawtooth or square voices, summed to a
+// mono output. The voices are rendered together, side by side in vector
+// lanes, so a thick unison sound costs one node rather than one oscillator
+// node per voice.
+//
+// voices is the number of voices sounding, up to 16. It may be fractional,
+// in which case the last voice is faded in by the fraction, so automating it
+// adds and removes voices smoothly. detune is the spread of the voices in
+// cents; they are spaced evenly from -detune to +detune around frequency.
+// Both are sample accurate. The sum is divided by the number of voices.
+//
+// params: frequency, detune, voices
+// settings: sawCount, type
+//
 class SupersawNode : public AudioScheduledSourceNode
 {
     class SupersawNodeInternal;
@@ -25,16 +39,20 @@ public:
     virtual const char* name() const override { return static_name(); }
     static AudioNodeDescriptor * desc();
 
+    // setting sawCount sets the value of voices
     std::shared_ptr<AudioSetting> sawCount() const;
+    std::shared_ptr<AudioSetting> type() const;  // Sawtooth or Square
     std::shared_ptr<AudioParam> frequency() const;
     std::shared_ptr<AudioParam> detune() const;
+    std::shared_ptr<AudioParam> voices() const;
 
-    void update(ContextRenderLock & r);  // call if sawCount is changed. CBB: update automatically
+    // The voices follow their params on every quantum, so this no longer needs to be called.
+    void update(ContextRenderLock & r);
 
 private:
     virtual void process(ContextRenderLock &, int bufferSize) override;
 
-    virtual void reset(ContextRenderLock &) override {}
+    virtual void reset(ContextRenderLock &) override;
 
     virtual double tailTime(ContextRenderLock & r) const override { return 0; }
     virtual double latencyTime(ContextRenderLock & r) const override { return 0; }
@@ -37,6 +37,28 @@ namespace VectorMath
     // Copies elements while clipping values to the threshold inputs.
     void vclip(const float * sourceP, int sourceStride, const float * lowThresholdP, const float * highThresholdP, float * destP, int destStride, int framesToProcess);
 
+    // Fills a vector with an arithmetic sequence, destP[i] = start + i * step.
+    void vramp(const float * start, const float * step, float * destP, int destStride, int framesToProcess);
+
+    // Fills a vector with a geometric sequence approaching offset, destP[i] = offset + start * ratio^i.
+    void vgeom(const float * start, const float * ratio, const float * offset, float * destP, int destStride, int framesToProcess);
+
+    // Replaces two vectors with their sum and difference, the butterfly of a Walsh-Hadamard transform.
+    void vbfly(float * aP, float * bP, int framesToProcess);
+
+    // Fast approximations for gain and level conversions. vlog2 is within 4e-6 of log2 for
+    // positive sources, and vexp2 is within 2e-7 of 2^x relative to it, for x in [-126, 127].
+    void vlog2(const float * sourceP, float * destP, int framesToProcess);
+    void vexp2(const float * sourceP, float * destP, int framesToProcess);
+
+    // Linearly interpolated table lookup, destP[i] = tableP[k] + f * (tableP[k + 1] - tableP[k]),
+    // where k and f are the whole and fractional parts of positionP[i]. Positions must be
+    // non-negative, and tableP[k + 1] must be in the table.
+    void vlint(const float * tableP, const float * positionP, float * destP, int framesToProcess);
+
+    // Wraps a vector into [0, period), destP[i] = sourceP[i] - period * floor(sourceP[i] / period).
+    void vwrap(const float * sourceP, const float * period, float * destP, int framesToProcess);
+
 }  // namespace VectorMath
 
 }  // namespace lab
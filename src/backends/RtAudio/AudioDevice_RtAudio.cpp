@@ -13,6 +13,9 @@
 
 #include "RtAudio.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace lab
 {
 
@@ -27,9 +30,8 @@ int rt_audio_callback(
     RtAudioStreamStatus status, void * userData)
 {
     AudioDevice_RtAudio * device = reinterpret_cast<AudioDevice_RtAudio *>(userData);
-    float * fltOutputBuffer = reinterpret_cast<float *>(outputBuffer);
-    memset(fltOutputBuffer, 0, nBufferFrames * device->getOutputConfig().desired_channels * sizeof(float));
-    device->render(device->sourceProvider(), nBufferFrames, fltOutputBuffer, inputBuffer);
+    // render() writes every output frame, so the buffer isn't cleared first
+    device->render(device->sourceProvider(), nBufferFrames, outputBuffer, inputBuffer);
     return 0;
 }
 
@@ -99,7 +101,7 @@ AudioDevice_RtAudio::MakeAudioDeviceList()
 
 const float kLowThreshold = -1.0f;
 const float kHighThreshold = 1.0f;
-const bool kInterleaved = false;
+const int kRenderQuantum = AudioNode::ProcessingSizeInFrames;
 
 void AudioDevice_RtAudio::createContext()
 {
@@ -162,7 +164,10 @@ void AudioDevice_RtAudio::createContext()
     // RTAUDIO_MINIMIZE_LATENCY tells RtAudio to use the hardware's minimum buffer size
     // which is not desirable as the minimum way be too small, and a non-power of 2.
     //options.flags = RTAUDIO_MINIMIZE_LATENCY;
-    if (!kInterleaved) options.flags |= RTAUDIO_NONINTERLEAVED;
+    // Non-interleaved streams let quanta be rendered directly into the device's
+    // channel buffers. RtAudio accepts this flag for every api, converting
+    // internally where the hardware itself is interleaved.
+    options.flags |= RTAUDIO_NONINTERLEAVED;
 
     // Note! RtAudio has a hard limit on a power of two buffer size, non-power of two sizes will result in
     // heap corruption, for example, when dac.stopStream() is invoked.
@@ -186,6 +191,48 @@ void AudioDevice_RtAudio::createContext()
     {
         LOG_ERROR(e.getMessage().c_str());
     }
+
+    allocateBusses(bufferFrames);
+}
+
+void AudioDevice_RtAudio::allocateBusses(uint32_t bufferFrames)
+{
+    const int outChannels = _outConfig.desired_channels;
+    const int inChannels = _inConfig.desired_channels;
+
+    _outputView.reset();
+    _remainderBus.reset();
+    _inputView.reset();
+    _inputBus.reset();
+    _inputStaging.reset();
+    _remainder = 0;
+
+    if (outChannels)
+    {
+        _outputView.reset(new AudioBus(outChannels, kRenderQuantum, false));
+        _outputView->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        _remainderBus.reset(new AudioBus(outChannels, kRenderQuantum, true));
+        _remainderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+    }
+
+    // RtAudio delivers the negotiated number of frames to every callback,
+    // so whether input can be used in place is known once the stream is open.
+    _inputAligned = (bufferFrames % kRenderQuantum) == 0;
+    if (bufferFrames % kRenderQuantum)
+        LOG_INFO("[AudioDevice_RtAudio] buffer of %d frames is not a multiple of the render quantum", bufferFrames);
+
+    if (inChannels)
+    {
+        _inputView.reset(new AudioBus(inChannels, kRenderQuantum, false));
+        _inputView->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+        _inputBus.reset(new AudioBus(inChannels, kRenderQuantum, true));
+        _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+
+        // the staged input never holds more than the primed quantum, plus the
+        // frames of one quantum's worth of output, plus the callback's tail.
+        _inputStaging.reset(new AudioBus(inChannels, 4 * kRenderQuantum, true));
+        _inputStaged = kRenderQuantum;
+    }
 }
 
 AudioDevice_RtAudio::AudioDevice_RtAudio(
@@ -264,96 +311,147 @@ bool AudioDevice_RtAudio::isRunning() const
 }
 
 
-// called by RtAudio periodically to get audio data.
-// Pulls on our provider to get rendered audio stream.
-//
-void AudioDevice_RtAudio::render(
-    AudioSourceProvider* provider,
-    int numberOfFrames, void * outputBuffer, void * inputBuffer)
+void AudioDevice_RtAudio::stageInput(const float * input, int stride, int offset, int frames)
 {
-    float * fltOutputBuffer = reinterpret_cast<float *>(outputBuffer);
-    float * fltInputBuffer = reinterpret_cast<float *>(inputBuffer);
-
-    if (_outConfig.desired_channels)
-    {
-        if (!_renderBus || _renderBus->length() < numberOfFrames)
-        {
-            _renderBus.reset(new AudioBus(_outConfig.desired_channels, numberOfFrames, true));
-            _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
-        }
-    }
+    if (frames <= 0)
+        return;
 
-    if (_inConfig.desired_channels)
+    const int capacity = _inputStaging->length();
+    if (_inputStaged + frames > capacity)
     {
-        if (!_inputBus || _inputBus->length() < numberOfFrames)
+        // the graph has fallen behind the device; drop the oldest input rather than grow latency
+        const int drop = _inputStaged + frames - capacity;
+        for (int c = 0; c < _inputStaging->numberOfChannels(); ++c)
         {
-            _inputBus.reset(new AudioBus(_inConfig.desired_channels, numberOfFrames, true));
-            _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+            float * staged = _inputStaging->channel(c)->mutableData();
+            memmove(staged, staged + drop, sizeof(float) * (_inputStaged - drop));
         }
+        _inputStaged -= drop;
     }
 
-    // copy the input buffer
-    if (_inConfig.desired_channels)
-    {
-        if (kInterleaved)
-        {
-            for (uint32_t i = 0; i < _inConfig.desired_channels; ++i)
-            {
-                AudioChannel * channel = _inputBus->channel(i);
-                float * src = &fltInputBuffer[i];
-                VectorMath::vclip(src, 1, &kLowThreshold, &kHighThreshold,
-                                  channel->mutableData(), _inConfig.desired_channels,
-                                  numberOfFrames);
-            }
-        }
-        else
-        {
-            for (uint32_t i = 0; i < _inConfig.desired_channels; ++i)
-            {
-                AudioChannel * channel = _inputBus->channel(i);
-                float * src = &fltInputBuffer[i * numberOfFrames];
-                VectorMath::vclip(src, 1, &kLowThreshold, &kHighThreshold, channel->mutableData(), 1, numberOfFrames);
-            }
-        }
-    }
+    for (int c = 0; c < _inputStaging->numberOfChannels(); ++c)
+        memcpy(_inputStaging->channel(c)->mutableData() + _inputStaged, input + c * stride + offset, sizeof(float) * frames);
+    _inputStaged += frames;
+}
 
+void AudioDevice_RtAudio::renderQuantum(AudioSourceProvider * provider, AudioBus * input, AudioBus * output)
+{
     // Update sampling info
     const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
     const uint64_t t = samplingInfo.current_sample_frame & ~1;
     samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
-    samplingInfo.current_sample_frame = t + numberOfFrames + index;
+    samplingInfo.current_sample_frame = t + kRenderQuantum + index;
     samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
     samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
 
     // Pull on the graph
     auto dn = _destinationNode; // up the ref count
     if (dn)
-        dn->render(provider, _inputBus.get(), _renderBus.get(), numberOfFrames, samplingInfo);
+        dn->render(provider, input, output, kRenderQuantum, samplingInfo);
+    else if (output)
+        output->zero();
+
+    // Clamp values at 0db (i.e., [-1.0, 1.0]), in place
+    if (output)
+    {
+        for (int i = 0; i < output->numberOfChannels(); ++i)
+        {
+            float * data = output->channel(i)->mutableData();
+            VectorMath::vclip(data, 1, &kLowThreshold, &kHighThreshold, data, 1, kRenderQuantum);
+        }
+    }
+}
+
+// called by RtAudio periodically to get audio data.
+// Pulls on our provider to get rendered audio stream.
+//
+// Buffers are non-interleaved; channel i starts at i * numberOfFrames.
+// Whole quanta are rendered directly into the device's output buffer. A
+// final partial quantum is rendered into the remainder bus, and the frames
+// that didn't fit begin the next callback.
+void AudioDevice_RtAudio::render(
+    AudioSourceProvider* provider,
+    int numberOfFrames, void * outputBuffer, void * inputBuffer)
+{
+    float * fltOutputBuffer = reinterpret_cast<float *>(outputBuffer);
+    const float * fltInputBuffer = reinterpret_cast<const float *>(inputBuffer);
+
+    const int outChannels = (fltOutputBuffer && _outputView) ? _outConfig.desired_channels : 0;
+    const int inChannels = (fltInputBuffer && _inputView) ? _inConfig.desired_channels : 0;
+
+    int written = 0;   // output frames delivered in this callback
+    int staged = 0;    // input frames of this callback handed to the staging bus
 
-    // Then deliver the rendered audio back to rtaudio, ready for the next callback
-    if (_outConfig.desired_channels)
+    // deliver the frames left over from the last quantum of the previous callback
+    if (_remainder > 0)
     {
-        // Clamp values at 0db (i.e., [-1.0, 1.0]) and also copy result to the DAC output buffer
-        if (kInterleaved)
+        written = std::min(_remainder, numberOfFrames);
+        const int from = kRenderQuantum - _remainder;
+        for (int i = 0; i < outChannels; ++i)
+            memcpy(fltOutputBuffer + i * numberOfFrames, _remainderBus->channel(i)->data() + from, sizeof(float) * written);
+        _remainder -= written;
+    }
+
+    while (written < numberOfFrames)
+    {
+        const bool wholeQuantum = written + kRenderQuantum <= numberOfFrames;
+
+        AudioBus * input = nullptr;
+        if (inChannels)
         {
-            for (uint32_t i = 0; i < _outConfig.desired_channels; ++i)
+            if (_inputAligned && wholeQuantum)
             {
-                AudioChannel * channel = _renderBus->channel(i);
-                float * dst = &fltOutputBuffer[i];
-                VectorMath::vclip(channel->data(), 1, &kLowThreshold, &kHighThreshold, dst,
-                                  _outConfig.desired_channels, numberOfFrames);
+                for (int i = 0; i < inChannels; ++i)
+                    _inputView->setChannelMemory(i, const_cast<float *>(fltInputBuffer) + i * numberOfFrames + written, kRenderQuantum);
+                input = _inputView.get();
+            }
+            else
+            {
+                // hand over the input that arrived alongside the output about to be rendered
+                const int upTo = std::min(numberOfFrames, written + kRenderQuantum);
+                stageInput(fltInputBuffer, numberOfFrames, staged, upTo - staged);
+                staged = std::max(staged, upTo);
+
+                const int frames = std::min(_inputStaged, kRenderQuantum);
+                for (int i = 0; i < inChannels; ++i)
+                {
+                    float * staging = _inputStaging->channel(i)->mutableData();
+                    float * dst = _inputBus->channel(i)->mutableData();
+                    memcpy(dst, staging, sizeof(float) * frames);
+                    if (frames < kRenderQuantum)
+                        memset(dst + frames, 0, sizeof(float) * (kRenderQuantum - frames));
+                    memmove(staging, staging + frames, sizeof(float) * (_inputStaged - frames));
+                }
+                _inputStaged -= frames;
+                input = _inputBus.get();
             }
         }
-        else
+
+        if (wholeQuantum)
         {
-            for (uint32_t i = 0; i < _outConfig.desired_channels; ++i)
+            AudioBus * output = nullptr;
+            if (outChannels)
             {
-                AudioChannel * channel = _renderBus->channel(i);
-                float * dst = &fltOutputBuffer[i * numberOfFrames];
-                VectorMath::vclip(channel->data(), 1, &kLowThreshold, &kHighThreshold, dst, 1, numberOfFrames);
+                for (int i = 0; i < outChannels; ++i)
+                    _outputView->setChannelMemory(i, fltOutputBuffer + i * numberOfFrames + written, kRenderQuantum);
+                output = _outputView.get();
             }
+            renderQuantum(provider, input, output);
+            written += kRenderQuantum;
+        }
+        else
+        {
+            renderQuantum(provider, input, outChannels ? _remainderBus.get() : nullptr);
+            const int frames = numberOfFrames - written;
+            for (int i = 0; i < outChannels; ++i)
+                memcpy(fltOutputBuffer + i * numberOfFrames + written, _remainderBus->channel(i)->data(), sizeof(float) * frames);
+            _remainder = kRenderQuantum - frames;
+            written = numberOfFrames;
         }
     }
+
+    if (inChannels && !_inputAligned && staged < numberOfFrames)
+        stageInput(fltInputBuffer, numberOfFrames, staged, numberOfFrames - staged);
 }
 
 }  // namespace lab
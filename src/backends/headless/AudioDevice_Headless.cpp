@@ -0,0 +1,555 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/backends/AudioDevice_Headless.h"
+
+#include "internal/Assertions.h"
+
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lab
+{
+
+const float kLowThreshold = -1.0f;
+const float kHighThreshold = 1.0f;
+const int kRenderQuantum = AudioNode::ProcessingSizeInFrames;
+
+// a render thread this many periods behind gives up on the missed quanta and
+// resynchronizes, rather than rendering a burst to catch up
+const int kMaxLatePeriods = 4;
+
+namespace
+{
+    uint32_t ringCapacity(uint32_t frames)
+    {
+        uint32_t capacity = 2 * kRenderQuantum;
+        while (capacity < frames)
+            capacity *= 2;
+        return capacity;
+    }
+
+    void writeLE32(uint8_t * p, uint32_t v)
+    {
+        p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; p[2] = (v >> 16) & 0xff; p[3] = (v >> 24) & 0xff;
+    }
+
+    void writeLE16(uint8_t * p, uint16_t v)
+    {
+        p[0] = v & 0xff; p[1] = (v >> 8) & 0xff;
+    }
+
+    // a canonical 44 byte header for 32 bit float samples
+    void writeWavHeader(FILE * f, uint32_t channels, uint32_t sampleRate, uint64_t frames)
+    {
+        const uint64_t dataBytes64 = frames * channels * sizeof(float);
+        const uint32_t dataBytes = dataBytes64 > 0xffffffff - 36 ? 0xffffffff - 36 : static_cast<uint32_t>(dataBytes64);
+
+        uint8_t h[44];
+        memcpy(h, "RIFF", 4);
+        writeLE32(h + 4, 36 + dataBytes);
+        memcpy(h + 8, "WAVEfmt ", 8);
+        writeLE32(h + 16, 16);
+        writeLE16(h + 20, 3);  // WAVE_FORMAT_IEEE_FLOAT
+        writeLE16(h + 22, static_cast<uint16_t>(channels));
+        writeLE32(h + 24, sampleRate);
+        writeLE32(h + 28, sampleRate * channels * sizeof(float));
+        writeLE16(h + 32, static_cast<uint16_t>(channels * sizeof(float)));
+        writeLE16(h + 34, 32);
+        memcpy(h + 36, "data", 4);
+        writeLE32(h + 40, dataBytes);
+
+        fseek(f, 0, SEEK_SET);
+        fwrite(h, 1, sizeof(h), f);
+        fseek(f, 0, SEEK_END);
+    }
+
+    std::string sharedMemoryName(const std::string & path)
+    {
+#ifdef _WIN32
+        return path;
+#else
+        return (path.empty() || path[0] != '/') ? "/" + path : path;
+#endif
+    }
+}
+
+///////////////////////////////////
+//   AudioDevice_Headless::Sink  //
+///////////////////////////////////
+
+// Owns the ring, and whatever the ring drains to. The render thread writes to
+// the ring; for files and pipes a writer thread drains it, so that the render
+// thread never blocks on i/o.
+struct AudioDevice_Headless::Sink
+{
+    HeadlessSink kind = HeadlessSink::None;
+    std::string path;
+    uint32_t channels = 0;
+    uint32_t sampleRate = 0;
+
+    HeadlessRingHeader * ring = nullptr;
+    float * frames = nullptr;
+    size_t regionBytes = 0;
+
+    std::unique_ptr<uint8_t[]> heap;
+    FILE * file = nullptr;
+    uint64_t fileFrames = 0;
+
+#ifdef _WIN32
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int pipe = -1;
+#endif
+
+    Sink(const HeadlessDeviceConfig & config, uint32_t channels, uint32_t sampleRate)
+    : kind(config.sink), path(config.path), channels(channels), sampleRate(sampleRate)
+    {
+        const uint32_t capacity = ringCapacity(config.ringFrames);
+        regionBytes = sizeof(HeadlessRingHeader) + sizeof(float) * capacity * channels;
+
+        void * region = nullptr;
+        if (kind == HeadlessSink::SharedMemory)
+            region = mapSharedMemory();
+        if (!region)
+        {
+            if (kind == HeadlessSink::SharedMemory)
+                kind = HeadlessSink::None;
+
+            // over allocate, so that the header can be aligned for its atomics
+            size_t space = regionBytes + alignof(HeadlessRingHeader);
+            heap.reset(new uint8_t[space]);
+            region = heap.get();
+            std::align(alignof(HeadlessRingHeader), regionBytes, region, space);
+        }
+
+        ring = new (region) HeadlessRingHeader;
+        ring->magic = HeadlessRingHeader::kMagic;
+        ring->version = HeadlessRingHeader::kVersion;
+        ring->channels = channels;
+        ring->capacityFrames = capacity;
+        ring->sampleRate = static_cast<float>(sampleRate);
+        ring->reserved = 0;
+        ring->writeFrame.store(0, std::memory_order_relaxed);
+        ring->readFrame.store(0, std::memory_order_relaxed);
+        frames = reinterpret_cast<float *>(reinterpret_cast<uint8_t *>(ring) + sizeof(HeadlessRingHeader));
+        memset(frames, 0, sizeof(float) * capacity * channels);
+
+        if (kind == HeadlessSink::File)
+        {
+            file = fopen(path.c_str(), "wb");
+            if (!file)
+            {
+                LOG_ERROR("[AudioDevice_Headless] could not open %s for writing", path.c_str());
+                kind = HeadlessSink::None;
+            }
+            else
+                writeWavHeader(file, channels, sampleRate, 0);
+        }
+    }
+
+    ~Sink()
+    {
+        if (file)
+        {
+            writeWavHeader(file, channels, sampleRate, fileFrames);
+            fclose(file);
+        }
+
+#ifdef _WIN32
+        if (pipe != INVALID_HANDLE_VALUE)
+        {
+            FlushFileBuffers(pipe);
+            DisconnectNamedPipe(pipe);
+            CloseHandle(pipe);
+        }
+        if (mapping)
+        {
+            UnmapViewOfFile(ring);
+            CloseHandle(mapping);
+        }
+#else
+        if (pipe >= 0)
+            close(pipe);
+        if (kind == HeadlessSink::SharedMemory && ring)
+        {
+            munmap(ring, regionBytes);
+            shm_unlink(sharedMemoryName(path).c_str());
+        }
+#endif
+    }
+
+    void * mapSharedMemory()
+    {
+        const std::string name = sharedMemoryName(path);
+#ifdef _WIN32
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                     static_cast<DWORD>(uint64_t(regionBytes) >> 32), static_cast<DWORD>(regionBytes & 0xffffffff),
+                                     name.c_str());
+        void * region = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, regionBytes) : nullptr;
+#else
+        void * region = nullptr;
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd >= 0)
+        {
+            if (ftruncate(fd, static_cast<off_t>(regionBytes)) == 0)
+            {
+                region = mmap(nullptr, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (region == MAP_FAILED)
+                    region = nullptr;
+            }
+            close(fd);
+        }
+#endif
+        if (!region)
+            LOG_ERROR("[AudioDevice_Headless] could not map shared memory %s", name.c_str());
+        return region;
+    }
+
+    // called on the writer thread, since a pipe can't be written until a reader arrives
+    bool openPipe(const std::atomic<bool> & keepWaiting)
+    {
+#ifdef _WIN32
+        std::string name = path.compare(0, 9, "\\\\.\\pipe\\") == 0 ? path : "\\\\.\\pipe\\" + path;
+        pipe = CreateNamedPipeA(name.c_str(), PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1,
+                                static_cast<DWORD>(regionBytes), 0, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE)
+            return false;
+        if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+        {
+            CloseHandle(pipe);
+            pipe = INVALID_HANDLE_VALUE;
+            return false;
+        }
+        return true;
+#else
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 && mkfifo(path.c_str(), 0600) != 0)
+            return false;
+
+        // a non-blocking open fails until there is a reader; poll, so that the
+        // device can still be stopped while nobody is listening
+        while (keepWaiting.load(std::memory_order_acquire))
+        {
+            pipe = open(path.c_str(), O_WRONLY | O_NONBLOCK);
+            if (pipe >= 0)
+            {
+                fcntl(pipe, F_SETFL, fcntl(pipe, F_GETFL) & ~O_NONBLOCK);
+                return true;
+            }
+            if (errno != ENXIO)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+#endif
+    }
+
+    bool writePipe(const float * data, size_t count)
+    {
+        const char * bytes = reinterpret_cast<const char *>(data);
+        size_t remaining = count * sizeof(float);
+        while (remaining)
+        {
+#ifdef _WIN32
+            DWORD written = 0;
+            if (!WriteFile(pipe, bytes, static_cast<DWORD>(remaining), &written, nullptr))
+                return false;
+#else
+            ssize_t written = ::write(pipe, bytes, remaining);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+#endif
+            bytes += written;
+            remaining -= written;
+        }
+        return true;
+    }
+
+    // render thread. Returns false if there was no room for the quantum.
+    bool push(const AudioBus & bus, int frameCount)
+    {
+        const uint64_t w = ring->writeFrame.load(std::memory_order_relaxed);
+        const uint64_t r = ring->readFrame.load(std::memory_order_acquire);
+        if (kind != HeadlessSink::None && w - r + frameCount > ring->capacityFrames)
+            return false;
+
+        // quanta are written at multiples of the quantum, and the capacity is a
+        // multiple of the quantum, so a quantum never wraps.
+        float * dst = frames + (w & (ring->capacityFrames - 1)) * channels;
+        for (uint32_t i = 0; i < channels; ++i)
+        {
+            VectorMath::vclip(bus.channel(i)->data(), 1, &kLowThreshold, &kHighThreshold,
+                              dst + i, channels, frameCount);
+        }
+        ring->writeFrame.store(w + frameCount, std::memory_order_release);
+
+        // nothing consumes the ring when there is no sink
+        if (kind == HeadlessSink::None)
+            ring->readFrame.store(w + frameCount, std::memory_order_relaxed);
+        return true;
+    }
+
+    // writer thread. Returns false if the sink failed.
+    bool drain()
+    {
+        const uint64_t w = ring->writeFrame.load(std::memory_order_acquire);
+        uint64_t r = ring->readFrame.load(std::memory_order_relaxed);
+        const uint32_t mask = ring->capacityFrames - 1;
+
+        bool ok = true;
+        while (ok && r < w)
+        {
+            const uint64_t start = r & mask;
+            const uint64_t count = std::min<uint64_t>(w - r, ring->capacityFrames - start);
+            const float * src = frames + start * channels;
+            if (file)
+            {
+                ok = fwrite(src, sizeof(float) * channels, count, file) == count;
+                fileFrames += count;
+            }
+            else
+                ok = writePipe(src, count * channels);
+            r += count;
+            ring->readFrame.store(r, std::memory_order_release);
+        }
+        return ok;
+    }
+};
+
+//////////////////////////////
+//   AudioDevice_Headless   //
+//////////////////////////////
+
+AudioDevice_Headless::AudioDevice_Headless(
+    const AudioStreamConfig & inputConfig,
+    const AudioStreamConfig & outputConfig,
+    const HeadlessDeviceConfig & config)
+: AudioDevice(inputConfig, outputConfig)
+, _config(config)
+{
+    backendReinitialize();
+    samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
+}
+
+AudioDevice_Headless::~AudioDevice_Headless()
+{
+    stop();
+}
+
+void AudioDevice_Headless::backendReinitialize()
+{
+    stop();
+
+    authoritativeDeviceSampleRateAtRuntime = _outConfig.desired_samplerate;
+    if (authoritativeDeviceSampleRateAtRuntime <= 0.f)
+        throw std::invalid_argument("AudioDevice_Headless requires a sample rate");
+
+    _renderBus.reset(new AudioBus(_outConfig.desired_channels, kRenderQuantum, true));
+    _renderBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+
+    _inputBus.reset();
+    if (_inConfig.desired_channels)
+    {
+        _inputBus.reset(new AudioBus(_inConfig.desired_channels, kRenderQuantum, true));
+        _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
+    }
+
+    _sink.reset(new Sink(_config, _outConfig.desired_channels, static_cast<uint32_t>(authoritativeDeviceSampleRateAtRuntime)));
+}
+
+void AudioDevice_Headless::start()
+{
+    ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+    if (_running.exchange(true))
+        return;
+
+    if (_sink->kind == HeadlessSink::File || _sink->kind == HeadlessSink::Pipe)
+    {
+        _writing = true;
+        _writerThread = std::thread(&AudioDevice_Headless::writerLoop, this);
+    }
+    _renderThread = std::thread(&AudioDevice_Headless::renderLoop, this);
+}
+
+void AudioDevice_Headless::stop()
+{
+    if (!_running.exchange(false))
+        return;
+
+    if (_renderThread.joinable())
+        _renderThread.join();
+
+    // the writer stops after the renderer, so that it delivers every rendered quantum
+    _writing = false;
+    if (_writerThread.joinable())
+        _writerThread.join();
+}
+
+bool AudioDevice_Headless::isRunning() const
+{
+    return _running.load(std::memory_order_acquire);
+}
+
+HeadlessDeviceStats AudioDevice_Headless::stats() const
+{
+    HeadlessDeviceStats s;
+    s.quanta = _quanta.load(std::memory_order_relaxed);
+    s.deadlineMisses = _deadlineMisses.load(std::memory_order_relaxed);
+    s.droppedFrames = _droppedFrames.load(std::memory_order_relaxed);
+    if (s.quanta)
+    {
+        s.meanWakeJitterUs = 1.e-3 * _wakeJitterTotalNs.load(std::memory_order_relaxed) / s.quanta;
+        s.meanRenderUs = 1.e-3 * _renderTotalNs.load(std::memory_order_relaxed) / s.quanta;
+    }
+    s.maxWakeJitterUs = 1.e-3 * _wakeJitterMaxNs.load(std::memory_order_relaxed);
+    s.maxRenderUs = 1.e-3 * _renderMaxNs.load(std::memory_order_relaxed);
+    return s;
+}
+
+void AudioDevice_Headless::resetStats()
+{
+    _quanta = 0;
+    _deadlineMisses = 0;
+    _droppedFrames = 0;
+    _wakeJitterTotalNs = 0;
+    _wakeJitterMaxNs = 0;
+    _renderTotalNs = 0;
+    _renderMaxNs = 0;
+}
+
+void AudioDevice_Headless::renderQuantum()
+{
+    // Update sampling info for use by the render graph
+    const int32_t index = 1 - (samplingInfo.current_sample_frame & 1);
+    const uint64_t t = samplingInfo.current_sample_frame & ~1;
+    samplingInfo.sampling_rate = authoritativeDeviceSampleRateAtRuntime;
+    samplingInfo.current_sample_frame = t + kRenderQuantum + index;
+    samplingInfo.current_time = samplingInfo.current_sample_frame / static_cast<double>(samplingInfo.sampling_rate);
+    samplingInfo.epoch[index] = std::chrono::high_resolution_clock::now();
+
+    auto dn = _destinationNode; // up the ref count
+    if (dn)
+        dn->render(sourceProvider(), _inputBus.get(), _renderBus.get(), kRenderQuantum, samplingInfo);
+    else
+        _renderBus->zero();
+
+    if (!_sink->push(*_renderBus, kRenderQuantum))
+        _droppedFrames.fetch_add(kRenderQuantum, std::memory_order_relaxed);
+}
+
+// Quantum n is due at t0 + n * period, the moment a sound card would have
+// started playing it. The thread wakes when it is due, renders it, and a
+// deadline is missed if rendering wasn't finished before quantum n + 1 was due.
+void AudioDevice_Headless::renderLoop()
+{
+    using clock = std::chrono::steady_clock;
+    const double periodNs = 1.e9 * kRenderQuantum / authoritativeDeviceSampleRateAtRuntime;
+    const auto period = std::chrono::nanoseconds(static_cast<int64_t>(periodNs));
+
+    auto t0 = clock::now();
+    uint64_t n = 0;
+
+    while (_running.load(std::memory_order_acquire))
+    {
+        const auto due = t0 + std::chrono::nanoseconds(static_cast<int64_t>(n * periodNs));
+        std::this_thread::sleep_until(due);
+
+        const auto woke = clock::now();
+        renderQuantum();
+        const auto done = clock::now();
+
+        const uint64_t jitterNs = std::chrono::duration_cast<std::chrono::nanoseconds>(woke - due).count();
+        const uint64_t renderNs = std::chrono::duration_cast<std::chrono::nanoseconds>(done - woke).count();
+
+        // only this thread writes the statistics
+        _quanta.store(_quanta.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        _wakeJitterTotalNs.store(_wakeJitterTotalNs.load(std::memory_order_relaxed) + jitterNs, std::memory_order_relaxed);
+        _renderTotalNs.store(_renderTotalNs.load(std::memory_order_relaxed) + renderNs, std::memory_order_relaxed);
+        if (jitterNs > _wakeJitterMaxNs.load(std::memory_order_relaxed))
+            _wakeJitterMaxNs.store(jitterNs, std::memory_order_relaxed);
+        if (renderNs > _renderMaxNs.load(std::memory_order_relaxed))
+            _renderMaxNs.store(renderNs, std::memory_order_relaxed);
+
+        ++n;
+        if (done > due + period)
+        {
+            uint64_t missed = 1;
+            if (done > due + kMaxLatePeriods * period)
+            {
+                // skip the quanta that can no longer be delivered on time
+                const uint64_t next = static_cast<uint64_t>((done - t0).count() * 1.0 / std::chrono::duration_cast<clock::duration>(period).count()) + 1;
+                missed += next - n;
+                n = next;
+            }
+            _deadlineMisses.fetch_add(missed, std::memory_order_relaxed);
+        }
+    }
+}
+
+void AudioDevice_Headless::writerLoop()
+{
+#ifndef _WIN32
+    // a reader closing the pipe must surface as a write error, not terminate the process
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+#endif
+
+    if (_sink->kind == HeadlessSink::Pipe && !_sink->openPipe(_writing))
+    {
+        LOG_ERROR("[AudioDevice_Headless] could not open pipe %s", _sink->path.c_str());
+        return;
+    }
+
+    const auto interval = std::chrono::nanoseconds(static_cast<int64_t>(0.5e9 * kRenderQuantum / authoritativeDeviceSampleRateAtRuntime));
+    while (_writing.load(std::memory_order_acquire))
+    {
+        if (!_sink->drain())
+        {
+            LOG_ERROR("[AudioDevice_Headless] writing to %s failed", _sink->path.c_str());
+            return;
+        }
+        std::this_thread::sleep_for(interval);
+    }
+
+    // the render thread has finished; deliver what it left behind
+    _sink->drain();
+
+    // leave a playable file behind whenever the device stops
+    if (_sink->file)
+    {
+        writeWavHeader(_sink->file, _sink->channels, _sink->sampleRate, _sink->fileFrames);
+        fflush(_sink->file);
+    }
+}
+
+}  // namespace lab
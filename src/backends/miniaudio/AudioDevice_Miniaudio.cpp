@@ -13,7 +13,9 @@
 #include "LabSound/extended/Logging.h"
 #include "LabSound/extended/VectorMath.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <cmath>
 
 //#define MA_DEBUG_OUTPUT
 #define MINIAUDIO_IMPLEMENTATION
@@ -186,12 +188,26 @@ std::vector<AudioDeviceInfo> AudioDevice_Miniaudio::MakeAudioDeviceList()
 
 namespace
 {
+    // holds the capture frames of at most a few render quanta; must be a power of two
+    const uint32_t kCaptureFifoFrames = 4 * kRenderQuantum;
+    const int kMinPeriodFrames = kRenderQuantum;
+    const int kMaxPeriodFrames = 4096;
+
+    // measurement gives up if the impulse hasn't been heard within this many seconds
+    const double kMeasureTimeout = 1.0;
+
+    enum MeasureState
+    {
+        MeasureIdle = 0,
+        MeasureRequested,
+        MeasureListening
+    };
+
     void outputCallback(ma_device * pDevice, void * pOutput, const void * pInput, ma_uint32 frameCount)
     {
-        // Buffer is nBufferFrames * channels, interleaved
-        float * fBufOut = (float *) pOutput;
+        // Buffers are frameCount * channels, interleaved. The output buffer is not
+        // pre-silenced; render() writes every frame.
         AudioDevice_Miniaudio * ad = reinterpret_cast<AudioDevice_Miniaudio *>(pDevice->pUserData);
-        memset(fBufOut, 0, sizeof(float) * frameCount * ad->getOutputConfig().desired_channels);
         ad->render(frameCount, pOutput, const_cast<void *>(pInput));
     }
 }
@@ -204,64 +220,47 @@ AudioDevice_Miniaudio::AudioDevice_Miniaudio(const AudioStreamConfig & _inputCon
     auto device_list = MakeAudioDeviceList();
     PrintAudioDeviceList();
 
-    //ma_device_config deviceConfig = ma_device_config_init(ma_device_type_duplex);
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-    deviceConfig.playback.format = ma_format_f32;
-    deviceConfig.playback.channels = _outConfig.desired_channels;
-    deviceConfig.sampleRate = static_cast<int>(_outConfig.desired_samplerate);
-    deviceConfig.capture.format = ma_format_f32;
-    deviceConfig.capture.channels = _inConfig.desired_channels;
-    deviceConfig.dataCallback = outputCallback;
-    deviceConfig.performanceProfile = ma_performance_profile_low_latency;
-    deviceConfig.pUserData = this;
+    _periodFrames = kMinPeriodFrames;
+    if (_inConfig.desired_channels)
+        _captureFifo = reinterpret_cast<float *>(calloc(kCaptureFifoFrames * _inConfig.desired_channels, sizeof(float)));
 
-#ifdef __WINDOWS_WASAPI__
-    deviceConfig.wasapi.noAutoConvertSRC = true;
-#endif
-
-    if (ma_device_init(&g_context, &deviceConfig, _device) != MA_SUCCESS)
-    {
-        LOG_ERROR("Unable to open audio playback device");
+    if (!initDevice())
         return;
-    }
-
-    authoritativeDeviceSampleRateAtRuntime = _outConfig.desired_samplerate;
 
     samplingInfo.epoch[0] = samplingInfo.epoch[1] = std::chrono::high_resolution_clock::now();
-
-    _ring = new lab::RingBufferT<float>();
-    _ring->resize(static_cast<int>(authoritativeDeviceSampleRateAtRuntime));  // ad hoc. hold one second
-    _scratch = reinterpret_cast<float *>(malloc(sizeof(float) * kRenderQuantum * _inConfig.desired_channels));
 }
 
 AudioDevice_Miniaudio::~AudioDevice_Miniaudio()
 {
     stop();
-    ma_device_uninit(_device);
+    if (_deviceOpen)
+        ma_device_uninit(_device);
     ma_context_uninit(&g_context);
     g_must_init = true;
     delete _renderBus;
     delete _inputBus;
-    delete _ring;
-    if (_scratch)
-        free(_scratch);
+    if (_captureFifo)
+        free(_captureFifo);
     delete _device;
 }
 
-void AudioDevice_Miniaudio::backendReinitialize()
+bool AudioDevice_Miniaudio::initDevice()
 {
-    auto device_list = MakeAudioDeviceList();
-    PrintAudioDeviceList();
+    // capture and playback run from a single callback in duplex mode, so that
+    // input frames reach the graph in the same callback that renders the output.
+    const bool duplex = _inConfig.desired_channels > 0;
 
-    //ma_device_config deviceConfig = ma_device_config_init(ma_device_type_duplex);
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+    ma_device_config deviceConfig = ma_device_config_init(duplex ? ma_device_type_duplex : ma_device_type_playback);
     deviceConfig.playback.format = ma_format_f32;
     deviceConfig.playback.channels = _outConfig.desired_channels;
     deviceConfig.sampleRate = static_cast<int>(_outConfig.desired_samplerate);
     deviceConfig.capture.format = ma_format_f32;
     deviceConfig.capture.channels = _inConfig.desired_channels;
+    deviceConfig.periodSizeInFrames = _periodFrames;
     deviceConfig.dataCallback = outputCallback;
     deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+    deviceConfig.noPreSilencedOutputBuffer = true;  // render() writes every output frame
+    deviceConfig.noClip = true;                     // render() clips as it interleaves
     deviceConfig.pUserData = this;
 
 #ifdef __WINDOWS_WASAPI__
@@ -270,15 +269,51 @@ void AudioDevice_Miniaudio::backendReinitialize()
 
     if (ma_device_init(&g_context, &deviceConfig, _device) != MA_SUCCESS)
     {
-        LOG_ERROR("Unable to open audio playback device");
-        return;
+        LOG_ERROR("Unable to open audio %s device", duplex ? "duplex" : "playback");
+        _deviceOpen = false;
+        return false;
     }
+
+    _deviceOpen = true;
+    authoritativeDeviceSampleRateAtRuntime = _outConfig.desired_samplerate;
+
+    // prime the capture fifo with one quantum of silence, which is exactly
+    // enough that a quantum of input is always available when a quantum of
+    // output has to be rendered, whatever the callback size.
+    _captureRead = 0;
+    _captureWrite = kRenderQuantum;
+    if (_captureFifo)
+        memset(_captureFifo, 0, sizeof(float) * kCaptureFifoFrames * _inConfig.desired_channels);
+
+    LOG_INFO("[LabSound] miniaudio %s device opened, period %d frames (playback %d x %d, capture %d x %d)",
+             duplex ? "duplex" : "playback", _periodFrames,
+             _device->playback.internalPeriodSizeInFrames, _device->playback.internalPeriods,
+             _device->capture.internalPeriodSizeInFrames, _device->capture.internalPeriods);
+    return true;
 }
 
+void AudioDevice_Miniaudio::backendReinitialize()
+{
+    auto device_list = MakeAudioDeviceList();
+    PrintAudioDeviceList();
+
+    if (_deviceOpen)
+    {
+        ma_device_uninit(_device);
+        _deviceOpen = false;
+    }
+
+    _remainder = 0;
+    initDevice();
+}
 
 void AudioDevice_Miniaudio::start()
 {
     ASSERT(authoritativeDeviceSampleRateAtRuntime != 0.f);  // something went very wrong
+
+    // timing from before the device stopped says nothing about the new stream
+    _hasLastCallback = false;
+
     if (ma_device_start(_device) != MA_SUCCESS)
     {
         LOG_ERROR("Unable to start audio device");
@@ -287,6 +322,9 @@ void AudioDevice_Miniaudio::start()
 
 void AudioDevice_Miniaudio::stop()
 {
+    if (!_deviceOpen)
+        return;
+
     if (ma_device_stop(_device) != MA_SUCCESS)
     {
         LOG_ERROR("Unable to stop audio device");
@@ -295,14 +333,196 @@ void AudioDevice_Miniaudio::stop()
 
 bool AudioDevice_Miniaudio::isRunning() const
 {
-    return ma_device_is_started(_device);
+    return _deviceOpen && ma_device_is_started(_device);
+}
+
+AudioDevice_Miniaudio::LatencyInfo AudioDevice_Miniaudio::latency() const
+{
+    LatencyInfo info;
+    info.periodFrames = _periodFrames;
+    if (_deviceOpen)
+    {
+        info.playbackFrames = _device->playback.internalPeriodSizeInFrames * _device->playback.internalPeriods;
+        if (_inConfig.desired_channels)
+            info.captureFrames = _device->capture.internalPeriodSizeInFrames * _device->capture.internalPeriods;
+    }
+
+    // output is rendered up to a quantum ahead, and input is held back by the
+    // quantum of silence that primes the capture fifo.
+    info.internalFrames = _inConfig.desired_channels ? 2 * kRenderQuantum : kRenderQuantum;
+
+    info.measuredRoundTripFrames = _roundTripFrames.load(std::memory_order_relaxed);
+    if (_measureTimedOut.exchange(false, std::memory_order_relaxed))
+        LOG_ERROR("Round trip latency measurement timed out, is there a loopback from output to input?");
+    info.callbackJitterMs = _jitterMs.load(std::memory_order_relaxed);
+    info.peakJitterMs = _peakJitterMs.load(std::memory_order_relaxed);
+    info.lateCallbacks = _lateCallbacks.load(std::memory_order_relaxed);
+    info.recommendedPeriodFrames = _recommendedPeriodFrames.load(std::memory_order_relaxed);
+    return info;
+}
+
+void AudioDevice_Miniaudio::measureRoundTripLatency(float threshold)
+{
+    if (!_inConfig.desired_channels)
+    {
+        LOG_ERROR("Round trip latency measurement requires an input device");
+        return;
+    }
+
+    _measureThreshold = threshold;
+    _roundTripFrames.store(-1, std::memory_order_relaxed);
+    _measureTimedOut.store(false, std::memory_order_relaxed);
+    _measureState.store(MeasureRequested, std::memory_order_release);
+}
+
+bool AudioDevice_Miniaudio::adaptPeriodSize()
+{
+    int recommended = _recommendedPeriodFrames.load(std::memory_order_relaxed);
+    if (!recommended || recommended == _periodFrames)
+        return false;
+
+    const bool wasRunning = isRunning();
+    stop();
+    if (_deviceOpen)
+    {
+        ma_device_uninit(_device);
+        _deviceOpen = false;
+    }
+
+    LOG_INFO("[LabSound] miniaudio period %d -> %d frames, callback jitter %f ms (peak %f ms)",
+             _periodFrames, recommended, _jitterMs.load(), _peakJitterMs.load());
+
+    _periodFrames = recommended;
+    _remainder = 0;
+    _jitterMs = 0.f;
+    _peakJitterMs = 0.f;
+    _recommendedPeriodFrames = 0;
+
+    if (!initDevice())
+        return false;
+
+    if (wasRunning)
+        start();
+
+    return true;
 }
 
+void AudioDevice_Miniaudio::pushCapture(const float * interleaved, int frames, int channels)
+{
+    if (frames <= 0)
+        return;
+
+    // if the graph has fallen behind, drop the oldest frames rather than grow latency
+    const uint32_t mask = kCaptureFifoFrames - 1;
+    if (_captureWrite - _captureRead + frames > kCaptureFifoFrames)
+        _captureRead = _captureWrite + frames - kCaptureFifoFrames;
+
+    for (int c = 0; c < channels; ++c)
+    {
+        float * dst = _captureFifo + c * kCaptureFifoFrames;
+        const float * src = interleaved + c;
+        uint32_t w = _captureWrite;
+        for (int i = 0; i < frames; ++i, ++w)
+            dst[w & mask] = src[i * channels];
+    }
+    _captureWrite += frames;
+}
+
+void AudioDevice_Miniaudio::pullCapture(int channels)
+{
+    const uint32_t mask = kCaptureFifoFrames - 1;
+    const uint32_t available = _captureWrite - _captureRead;
+    const uint32_t frames = available < static_cast<uint32_t>(kRenderQuantum) ? available : kRenderQuantum;
+    const uint32_t start = _captureRead & mask;
+    const uint32_t first = std::min(frames, kCaptureFifoFrames - start);
+
+    for (int c = 0; c < channels; ++c)
+    {
+        const float * src = _captureFifo + c * kCaptureFifoFrames;
+        float * dst = _inputBus->channel(c)->mutableData();
+        memcpy(dst, src + start, sizeof(float) * first);
+        memcpy(dst + first, src, sizeof(float) * (frames - first));
+        if (frames < static_cast<uint32_t>(kRenderQuantum))
+            memset(dst + frames, 0, sizeof(float) * (kRenderQuantum - frames));
+    }
+    _captureRead += frames;
+}
+
+void AudioDevice_Miniaudio::updateJitter(int frameCount)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (_hasLastCallback && frameCount > 0)
+    {
+        const float interval = std::chrono::duration<float, std::milli>(now - _lastCallback).count();
+        const float nominal = 1000.f * frameCount / authoritativeDeviceSampleRateAtRuntime;
+        const float deviation = std::fabs(interval - nominal);
+
+        float jitter = _jitterMs.load(std::memory_order_relaxed);
+        jitter += (deviation - jitter) * 0.05f;
+        _jitterMs.store(jitter, std::memory_order_relaxed);
+
+        // the peak decays by about half a second's worth of callbacks
+        float peak = _peakJitterMs.load(std::memory_order_relaxed) * 0.995f;
+        if (deviation > peak)
+            peak = deviation;
+        _peakJitterMs.store(peak, std::memory_order_relaxed);
+
+        if (interval > 2.f * nominal)
+            _lateCallbacks.fetch_add(1, std::memory_order_relaxed);
+
+        // a period twice the peak deviation absorbs a late callback without starving the device
+        const float needed = 2.f * peak * authoritativeDeviceSampleRateAtRuntime / 1000.f;
+        int frames = kMinPeriodFrames;
+        while (frames < needed && frames < kMaxPeriodFrames)
+            frames *= 2;
+        _recommendedPeriodFrames.store(frames, std::memory_order_relaxed);
+    }
+
+    _lastCallback = now;
+    _hasLastCallback = true;
+}
+
+void AudioDevice_Miniaudio::measure(const float * interleavedIn, float * interleavedOut, int frames)
+{
+    int state = _measureState.load(std::memory_order_acquire);
+    if (state == MeasureIdle)
+        return;
+
+    const int in_channels = _inConfig.desired_channels;
+    const int out_channels = _outConfig.desired_channels;
+
+    if (state == MeasureRequested)
+    {
+        // the impulse leaves on the first frame of this callback
+        for (int i = 0; i < out_channels; ++i)
+            interleavedOut[i] = 1.f;
+        _measureFrames = frames;
+        _measureState.store(MeasureListening, std::memory_order_release);
+        return;
+    }
+
+    for (int i = 0; i < frames; ++i)
+    {
+        if (std::fabs(interleavedIn[i * in_channels]) >= _measureThreshold)
+        {
+            _roundTripFrames.store(static_cast<int>(_measureFrames + i), std::memory_order_relaxed);
+            _measureState.store(MeasureIdle, std::memory_order_release);
+            return;
+        }
+    }
+
+    _measureFrames += frames;
+    if (_measureFrames > kMeasureTimeout * authoritativeDeviceSampleRateAtRuntime)
+    {
+        // logged by latency(), as the audio thread must not format or write output
+        _measureTimedOut.store(true, std::memory_order_relaxed);
+        _measureState.store(MeasureIdle, std::memory_order_release);
+    }
+}
 
 // Pulls on our provider to get rendered audio stream.
-void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, void * inputBuffer)
+void AudioDevice_Miniaudio::render(int numberOfFrames, void * outputBuffer, void * inputBuffer)
 {
-    int numberOfFrames = numberOfFrames_;
     if (!_renderBus)
     {
         _renderBus = new AudioBus(_outConfig.desired_channels, kRenderQuantum, true);
@@ -315,27 +535,29 @@ void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, voi
         _inputBus->setSampleRate(authoritativeDeviceSampleRateAtRuntime);
     }
 
-    float * pIn = static_cast<float *>(inputBuffer);
+    updateJitter(numberOfFrames);
+
+    const float * pIn = static_cast<const float *>(inputBuffer);
     float * pOut = static_cast<float *>(outputBuffer);
 
-    int in_channels = _inConfig.desired_channels;
-    int out_channels = _outConfig.desired_channels;
+    const int in_channels = pIn ? _inConfig.desired_channels : 0;
+    const int out_channels = _outConfig.desired_channels;
 
-    if (pIn && numberOfFrames * in_channels)
-        _ring->write(pIn, numberOfFrames * in_channels);
+    int written = 0;   // output frames written in this callback
+    int captured = 0;  // input frames of this callback handed to the capture fifo
 
-    while (numberOfFrames > 0)
+    while (written < numberOfFrames)
     {
         if (_remainder > 0)
         {
             // copy samples to output buffer. There might have been some rendered frames
-            // left over from the previous numberOfFrames, so start by moving those into
+            // left over from the previous callback, so start by moving those into
             // the output buffer.
 
             // miniaudio expects interleaved data, this loop leverages the vclip operation
             // to copy, interleave, and clip in one pass.
 
-            int samples = _remainder < numberOfFrames ? _remainder : numberOfFrames;
+            int samples = std::min(_remainder, numberOfFrames - written);
             for (int i = 0; i < out_channels; ++i)
             {
                 int src_stride = 1;  // de-interleaved
@@ -343,29 +565,22 @@ void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, voi
                 AudioChannel * channel = _renderBus->channel(i);
                 VectorMath::vclip(channel->data() + kRenderQuantum - _remainder, src_stride,
                                   &kLowThreshold, &kHighThreshold,
-                                  pOut + i, dst_stride, samples);
+                                  pOut + written * out_channels + i, dst_stride, samples);
             }
-            pOut += out_channels * samples;
 
-            numberOfFrames -= samples;  // deduct samples actually copied to output
+            written += samples;  // deduct samples actually copied to output
             _remainder -= samples;  // deduct samples remaining from last render() invocation
         }
         else
         {
             if (in_channels)
             {
-                // miniaudio provides the input data in interleaved form, vclip is used here to de-interleave
-
-                _ring->read(_scratch, in_channels * kRenderQuantum);
-                for (int i = 0; i < in_channels; ++i)
-                {
-                    int src_stride = in_channels;  // interleaved
-                    int dst_stride = 1;  // de-interleaved
-                    AudioChannel * channel = _inputBus->channel(i);
-                    VectorMath::vclip(_scratch + i, src_stride,
-                                      &kLowThreshold, &kHighThreshold,
-                                      channel->mutableData(), dst_stride, kRenderQuantum);
-                }
+                // hand over the capture frames that arrived alongside the output
+                // about to be rendered; they are current to this very callback.
+                int upTo = std::min(numberOfFrames, written + kRenderQuantum);
+                pushCapture(pIn + captured * in_channels, upTo - captured, in_channels);
+                captured = std::max(captured, upTo);
+                pullCapture(in_channels);
             }
 
             // Update sampling info for use by the render graph
@@ -381,6 +596,12 @@ void AudioDevice_Miniaudio::render(int numberOfFrames_, void * outputBuffer, voi
             _remainder = kRenderQuantum;
         }
     }
+
+    if (in_channels && captured < numberOfFrames)
+        pushCapture(pIn + captured * in_channels, numberOfFrames - captured, in_channels);
+
+    if (in_channels)
+        measure(pIn, pOut, numberOfFrames);
 }
 
 }  // namespace lab
@@ -56,12 +56,7 @@ void AnalyserNode::shared_construction(int fftSize)
     _detail->_fftSize->setUint32(static_cast<uint32_t>(fftSize));
     _detail->_fftSize->setValueChanged(
         [this]() {
-            delete _detail->m_analyser;
-            _detail->m_analyser = new RealtimeAnalyser(_detail->_fftSize->valueUint32());
-
-            // restore other values
-            _detail->m_analyser->setMinDecibels(_detail->_minDecibels->valueFloat());
-            _detail->m_analyser->setMaxDecibels(_detail->_maxDecibels->valueFloat());
+            _detail->m_analyser->setFftSize(_detail->_fftSize->valueUint32());
         });
 
     _detail->_minDecibels->setFloat(-100.f);
@@ -73,7 +68,7 @@ void AnalyserNode::shared_construction(int fftSize)
     _detail->_maxDecibels->setFloat(-30.f);
     _detail->_maxDecibels->setValueChanged(
         [this]() {
-            _detail->m_analyser->setMaxDecibels(_detail->_minDecibels->valueFloat());
+            _detail->m_analyser->setMaxDecibels(_detail->_maxDecibels->valueFloat());
         });
 
     _detail->_smoothingTimeConstant->setFloat(0.8f);
@@ -103,6 +98,7 @@ AnalyserNode::AnalyserNode(AudioContext & ac)
 AnalyserNode::~AnalyserNode()
 {
     uninitialize();
+    delete _detail;
 }
 
 void AnalyserNode::setMinDecibels(double k)
@@ -145,6 +141,10 @@ size_t AnalyserNode::frequencyBinCount() const
 {
     return _detail->m_analyser->frequencyBinCount();
 }
+std::shared_ptr<const AnalyserSnapshot> AnalyserNode::snapshot() const
+{
+    return _detail->m_analyser->snapshot();
+}
 void AnalyserNode::getFloatFrequencyData(std::vector<float> & array)
 {
     _detail->m_analyser->getFloatFrequencyData(array);
@@ -18,6 +18,11 @@ AudioBasicProcessorNode::AudioBasicProcessorNode(AudioContext & ac, AudioNodeDes
 {
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
 
+    // descriptors with no initial channel count still need an output; it
+    // conforms to the input's channel count during processing.
+    if (!numberOfOutputs())
+        addOutput(std::unique_ptr<AudioNodeOutput>(new AudioNodeOutput(this, 1)));
+
     // The subclass must create m_processor.
 }
 
@@ -68,6 +73,15 @@ void AudioBasicProcessorNode::process(ContextRenderLock & r, int bufferSize)
             destinationBus = output(0)->bus(r);
         }
 
+        const int offset = _self->_scheduler._renderOffset;
+        const int length = _self->_scheduler._renderLength;
+        if (supportsSubQuantumProcessing() && (offset != 0 || length != bufferSize))
+        {
+            // process the sub-block of a split quantum
+            processor()->process(r, sourceBus, destinationBus, bufferSize, offset, length);
+            return;
+        }
+
         // process entire buffer
         processor()->process(r, sourceBus, destinationBus, bufferSize);
     }
@@ -17,13 +17,11 @@ namespace lab
 
 using namespace VectorMath;
 
-const unsigned MaxBusChannels = 32;
-
 AudioBus::AudioBus(int numberOfChannels, int length, bool allocate)
     : m_length(length)
 {
-    ASSERT(numberOfChannels <= MaxBusChannels);
-    if (numberOfChannels > MaxBusChannels)
+    ASSERT(numberOfChannels <= MaxChannels);
+    if (numberOfChannels > MaxChannels)
         return;
 
     for (int i = 0; i < numberOfChannels; ++i)
@@ -574,8 +572,8 @@ void AudioBus::copyWithGainFrom(const AudioBus & sourceBus, float * lastMixGain,
     }
 
     const int numberOfChannels = static_cast<int>(m_channels.size());
-    ASSERT(numberOfChannels <= MaxBusChannels);
-    if (numberOfChannels > MaxBusChannels) return;
+    ASSERT(numberOfChannels <= MaxChannels);
+    if (numberOfChannels > MaxChannels) return;
 
     // If it is copying from the same bus and no need to change gain, just return.
     if ((this == &sourceBus) && (*lastMixGain == targetGain) && (targetGain == 1))
@@ -584,8 +582,8 @@ void AudioBus::copyWithGainFrom(const AudioBus & sourceBus, float * lastMixGain,
     }
 
     AudioBus & sourceBusSafe = const_cast<AudioBus &>(sourceBus);
-    const float * sources[MaxBusChannels];
-    float * destinations[MaxBusChannels];
+    const float * sources[MaxChannels];
+    float * destinations[MaxChannels];
 
     for (int i = 0; i < numberOfChannels; ++i)
     {
@@ -44,6 +44,7 @@ struct PendingNodeConnection
     int destIndex = 0;
     int srcIndex = 0;
     float duration = 0.1f;
+    std::shared_ptr<AudioNodeInput> input;  // connected in place of the destination's indexed input
 
     PendingNodeConnection() = default;
     ~PendingNodeConnection() = default;
@@ -60,19 +61,122 @@ struct PendingParamConnection
     ~PendingParamConnection() = default;
 };
 
+// A GraphTransaction's staged edits. Once committed, the render thread owns
+// it until every edit has been applied, then hands it back to be completed and
+// freed off the render thread.
+struct CommittedGraphTransaction
+{
+    std::vector<PendingParamConnection> params;
+    std::vector<PendingNodeConnection> nodes;
+    std::promise<void> completed;
+    uint64_t finishFrame = 0;   // sample frame at which ramped disconnections complete
+    CommittedGraphTransaction * next = nullptr;
+};
+
+namespace {
+
+    void validateConnect(AudioNode * destination, AudioNode * source, int destIdx, int srcIdx)
+    {
+        if (!destination)
+            throw std::runtime_error("Cannot connect to null destination");
+        if (!source)
+            throw std::runtime_error("Cannot connect from null source");
+        if (srcIdx > source->numberOfOutputs())
+            throw std::out_of_range("Output index greater than available outputs");
+        if (destIdx > destination->numberOfInputs())
+            throw std::out_of_range("Input index greater than available inputs");
+    }
+
+    void validateDisconnect(AudioNode * destination, AudioNode * source, int destIdx, int srcIdx)
+    {
+        if (source && srcIdx > source->numberOfOutputs())
+            throw std::out_of_range("Output index greater than available outputs");
+        if (destination && destIdx > destination->numberOfInputs())
+            throw std::out_of_range("Input index greater than available inputs");
+    }
+
+    void validateParamConnect(AudioParam * param, AudioNode * driver, int index)
+    {
+        if (!param)
+            throw std::invalid_argument("No parameter specified");
+        if (!driver)
+            throw std::invalid_argument("No driving node supplied");
+        if (index >= driver->numberOfOutputs())
+            throw std::out_of_range("Output index greater than available outputs on the driver");
+    }
+
+    std::shared_ptr<AudioParam> namedParam(AudioNode * destinationNode, char const * const parameterName)
+    {
+        if (!parameterName)
+            throw std::invalid_argument("No parameter specified");
+
+        std::shared_ptr<AudioParam> param = destinationNode->param(parameterName);
+        if (!param)
+            throw std::invalid_argument("Parameter not found on node");
+        return param;
+    }
+
+} // anon
+
 struct AudioContext::Internals
 {
     Internals(bool a)
         : autoDispatchEvents(a)
     {
     }
-    ~Internals() = default;
+    ~Internals()
+    {
+        freeTransactions(committedTransactions.exchange(nullptr));
+        freeTransactions(rampingTransactions);
+        completeTransactions(retiredTransactions.exchange(nullptr));
+    }
 
     bool autoDispatchEvents;
     moodycamel::ConcurrentQueue<std::function<void()>> enqueuedEvents;
     moodycamel::ConcurrentQueue<PendingNodeConnection> pendingNodeConnections;
     moodycamel::ConcurrentQueue<PendingParamConnection> pendingParamConnections;
 
+    // committed transactions form a lock free stack that the render thread
+    // takes in its entirety with a single exchange at the start of a quantum.
+    // Transactions waiting for disconnection ramps are owned by the render
+    // thread, and finished transactions are pushed on to the retired stack so
+    // that their futures are fulfilled, and they are destroyed, by the update
+    // or committing thread; a promise takes a lock, which the render thread must not.
+    std::atomic<CommittedGraphTransaction *> committedTransactions{nullptr};
+    CommittedGraphTransaction * rampingTransactions = nullptr;
+    std::atomic<CommittedGraphTransaction *> retiredTransactions{nullptr};
+    std::atomic<int> transactionsInFlight{0};
+
+    static void pushTransaction(std::atomic<CommittedGraphTransaction *> & stack, CommittedGraphTransaction * t)
+    {
+        t->next = stack.load(std::memory_order_relaxed);
+        while (!stack.compare_exchange_weak(t->next, t, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    static void freeTransactions(CommittedGraphTransaction * t)
+    {
+        while (t)
+        {
+            CommittedGraphTransaction * next = t->next;
+            delete t;
+            t = next;
+        }
+    }
+
+    // fulfills the futures of finished transactions, then frees them
+    static void completeTransactions(CommittedGraphTransaction * t)
+    {
+        for (CommittedGraphTransaction * i = t; i; i = i->next)
+            i->completed.set_value();
+        freeTransactions(t);
+    }
+
+    void retireTransaction(CommittedGraphTransaction * t)
+    {
+        --transactionsInFlight;
+        pushTransaction(retiredTransactions, t);
+    }
+
     std::shared_ptr<HRTFDatabaseLoader> hrtfDatabaseLoader;
 
     
@@ -297,7 +401,9 @@ void AudioContext::handlePreRenderTasks(ContextRenderLock & r)
 
     // check for pending connections
     if (m_internal->pendingParamConnections.size_approx() > 0 ||
-        m_internal->pendingNodeConnections.size_approx() > 0)
+        m_internal->pendingNodeConnections.size_approx() > 0 ||
+        m_internal->committedTransactions.load(std::memory_order_relaxed) ||
+        m_internal->rampingTransactions)
     {
         // take a graph lock until the queues are cleared
         ContextGraphLock gLock(this, "AudioContext::handlePreRenderTasks()");
@@ -305,111 +411,184 @@ void AudioContext::handlePreRenderTasks(ContextRenderLock & r)
         // resolve parameter connections
         PendingParamConnection param_connection;
         while (m_internal->pendingParamConnections.try_dequeue(param_connection))
-        {
-            if (param_connection.type == ConnectionOperationKind::Connect)
-            {
-                AudioParam::connect(gLock,
-                                    param_connection.destination,
-                                    param_connection.source->output(param_connection.destIndex));
-
-                // if unscheduled, the source should start to play as soon as possible
-                if (!param_connection.source->isScheduledNode())
-                    param_connection.source->_self->_scheduler.start(0);
-            }
-            else
-                AudioParam::disconnect(gLock,
-                                       param_connection.destination,
-                                       param_connection.source->output(param_connection.destIndex));
-        }
+            applyParamConnection(gLock, param_connection);
 
         // resolve node connections
         PendingNodeConnection node_connection;
         std::vector<PendingNodeConnection> requeued_connections;
         while (m_internal->pendingNodeConnections.try_dequeue(node_connection))
         {
-            switch (node_connection.type)
+            if (node_connection.type == ConnectionOperationKind::FinishDisconnect && node_connection.duration > 0)
             {
-                case ConnectionOperationKind::Connect:
-                {
-                    AudioNodeInput::connect(gLock,
-                                            node_connection.destination->input(node_connection.destIndex),
-                                            node_connection.source->output(node_connection.srcIndex));
+                node_connection.duration -= AudioNode::ProcessingSizeInFrames / sampleRate();
+                requeued_connections.push_back(node_connection);
+                continue;
+            }
 
-                    if (!node_connection.source->isScheduledNode())
-                        node_connection.source->_self->_scheduler.start(0);
-                }
-                break;
+            bool ramping = node_connection.type == ConnectionOperationKind::Disconnect;
+            applyNodeConnection(gLock, node_connection);
+            if (ramping)
+                requeued_connections.push_back(node_connection);  // save for later
+        }
+
+        // We have incompletely connected nodes, so next time the thread ticks we can re-check them
+        for (auto & sc : requeued_connections)
+            m_internal->pendingNodeConnections.enqueue(sc);
 
-                case ConnectionOperationKind::Disconnect:
+        applyCommittedTransactions(gLock);
+    }
+
+    AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
+    updateAutomaticPullNodes();
+}
+
+void AudioContext::applyParamConnection(ContextGraphLock & gLock, PendingParamConnection & param_connection)
+{
+    if (param_connection.type == ConnectionOperationKind::Connect)
+    {
+        AudioParam::connect(gLock,
+                            param_connection.destination,
+                            param_connection.source->output(param_connection.destIndex));
+
+        // if unscheduled, the source should start to play as soon as possible
+        if (!param_connection.source->isScheduledNode())
+            param_connection.source->_self->_scheduler.start(0);
+    }
+    else
+        AudioParam::disconnect(gLock,
+                               param_connection.destination,
+                               param_connection.source->output(param_connection.destIndex));
+}
+
+// A Disconnect starts the ramp out, and becomes a FinishDisconnect that the
+// caller must apply again once the ramp has elapsed.
+void AudioContext::applyNodeConnection(ContextGraphLock & gLock, PendingNodeConnection & node_connection)
+{
+    switch (node_connection.type)
+    {
+        case ConnectionOperationKind::Connect:
+        {
+            AudioNodeInput::connect(gLock,
+                                    node_connection.input ? node_connection.input : node_connection.destination->input(node_connection.destIndex),
+                                    node_connection.source->output(node_connection.srcIndex));
+
+            if (!node_connection.source->isScheduledNode())
+                node_connection.source->_self->_scheduler.start(0);
+        }
+        break;
+
+        case ConnectionOperationKind::Disconnect:
+        {
+            node_connection.type = ConnectionOperationKind::FinishDisconnect;
+            if (node_connection.source)
+            {
+                // if source and destination are specified, then don't ramp out the destination
+                // source will be completely disconnected
+                node_connection.source->scheduleDisconnect();
+            }
+            else if (node_connection.destination)
+            {
+                // destination will be completely disconnected
+                node_connection.destination->scheduleDisconnect();
+            }
+        }
+        break;
+
+        case ConnectionOperationKind::FinishDisconnect:
+        {
+            if (node_connection.source && node_connection.destination)
+            {
+                AudioNodeInput::disconnect(gLock, node_connection.destination->input(node_connection.destIndex), node_connection.source->output(node_connection.srcIndex));
+            }
+            else if (node_connection.destination)
+            {
+                for (int in = 0; in < node_connection.destination->numberOfInputs(); ++in)
                 {
-                    node_connection.type = ConnectionOperationKind::FinishDisconnect;
-                    requeued_connections.push_back(node_connection);  // save for later
-                    if (node_connection.source)
-                    {
-                        // if source and destination are specified, then don't ramp out the destination
-                        // source will be completely disconnected
-                        node_connection.source->scheduleDisconnect();
-                    }
-                    else if (node_connection.destination)
-                    {
-                        // destination will be completely disconnected
-                        node_connection.destination->scheduleDisconnect();
-                    }
+                    auto input= node_connection.destination->input(in);
+                    if (input)
+                        AudioNodeInput::disconnectAll(gLock, input);
                 }
-                break;
-
-                case ConnectionOperationKind::FinishDisconnect:
+            }
+            else if (node_connection.source)
+            {
+                for (int out = 0; out < node_connection.source->numberOfOutputs(); ++out)
                 {
-                    if (node_connection.duration > 0)
-                    {
-                        node_connection.duration -= AudioNode::ProcessingSizeInFrames / sampleRate();
-                        requeued_connections.push_back(node_connection);
-                        continue;
-                    }
-
-                    if (node_connection.source && node_connection.destination)
-                    {
-                        //if (!node_connection.destination->disconnectionReady() || !node_connection.source->disconnectionReady())
-                        //    requeued_connections.push_back(node_connection);
-                        //else
-                            AudioNodeInput::disconnect(gLock, node_connection.destination->input(node_connection.destIndex), node_connection.source->output(node_connection.srcIndex));
-                    }
-                    else if (node_connection.destination)
-                    {
-                        //if (!node_connection.destination->disconnectionReady())
-                        //    requeued_connections.push_back(node_connection);
-                        //else
-                            for (int in = 0; in < node_connection.destination->numberOfInputs(); ++in)
-                            {
-                                auto input= node_connection.destination->input(in);
-                                if (input)
-                                    AudioNodeInput::disconnectAll(gLock, input);
-                            }
-                    }
-                    else if (node_connection.source)
-                    {
-                        //if (!node_connection.destination->disconnectionReady())
-                        //    requeued_connections.push_back(node_connection);
-                        //else
-                            for (int out = 0; out < node_connection.source->numberOfOutputs(); ++out)
-                            {
-                                auto output = node_connection.source->output(out);
-                                if (output)
-                                    AudioNodeOutput::disconnectAll(gLock, output);
-                            }
-                    }
+                    auto output = node_connection.source->output(out);
+                    if (output)
+                        AudioNodeOutput::disconnectAll(gLock, output);
                 }
-                break;
             }
         }
+        break;
+    }
+}
 
-        // We have incompletely connected nodes, so next time the thread ticks we can re-check them
-        for (auto & sc : requeued_connections)
-            m_internal->pendingNodeConnections.enqueue(sc);
+void AudioContext::applyCommittedTransactions(ContextGraphLock & gLock)
+{
+    const uint64_t now = currentSampleFrame();
+
+    // complete the transactions whose disconnection ramps have elapsed
+    CommittedGraphTransaction ** link = &m_internal->rampingTransactions;
+    while (*link)
+    {
+        CommittedGraphTransaction * t = *link;
+        if (t->finishFrame > now)
+        {
+            link = &t->next;
+            continue;
+        }
+
+        *link = t->next;
+        for (auto & c : t->nodes)
+            if (c.type == ConnectionOperationKind::FinishDisconnect)
+                applyNodeConnection(gLock, c);
+
+        m_internal->retireTransaction(t);
     }
 
-    AudioSummingJunction::handleDirtyAudioSummingJunctions(r);
-    updateAutomaticPullNodes();
+    // take every transaction committed since the previous quantum in one swap.
+    // The stack holds them newest first, so reverse it to apply in commit order.
+    CommittedGraphTransaction * committed = m_internal->committedTransactions.exchange(nullptr, std::memory_order_acquire);
+    CommittedGraphTransaction * ordered = nullptr;
+    while (committed)
+    {
+        CommittedGraphTransaction * next = committed->next;
+        committed->next = ordered;
+        ordered = committed;
+        committed = next;
+    }
+
+    while (ordered)
+    {
+        CommittedGraphTransaction * t = ordered;
+        ordered = t->next;
+
+        for (auto & c : t->params)
+            applyParamConnection(gLock, c);
+
+        float ramp = -1.f;
+        for (auto & c : t->nodes)
+        {
+            if (c.type == ConnectionOperationKind::Disconnect && c.duration > ramp)
+                ramp = c.duration;
+            applyNodeConnection(gLock, c);
+        }
+
+        if (ramp < 0)
+        {
+            m_internal->retireTransaction(t);
+            continue;
+        }
+
+        t->finishFrame = now + static_cast<uint64_t>(ramp * sampleRate());
+        t->next = m_internal->rampingTransactions;
+        m_internal->rampingTransactions = t;
+    }
+}
+
+void AudioContext::releaseRetiredTransactions()
+{
+    Internals::completeTransactions(m_internal->retiredTransactions.exchange(nullptr, std::memory_order_acquire));
 }
 
 void AudioContext::handlePostRenderTasks(ContextRenderLock & r)
@@ -429,7 +608,7 @@ void AudioContext::synchronizeConnections(int timeOut_ms)
     if (!_destinationNode->device()->isRunning())
         return;
 
-    while (m_internal->pendingNodeConnections.size_approx() > 0 && timeOut_ms > 0)
+    while ((m_internal->pendingNodeConnections.size_approx() > 0 || m_internal->transactionsInFlight > 0) && timeOut_ms > 0)
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
         timeOut_ms -= 5;
@@ -439,14 +618,7 @@ void AudioContext::synchronizeConnections(int timeOut_ms)
 
 void AudioContext::connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
 {
-    if (!destination)
-        throw std::runtime_error("Cannot connect to null destination");
-    if (!source)
-        throw std::runtime_error("Cannot connect from null source");
-    if (srcIdx > source->numberOfOutputs())
-        throw std::out_of_range("Output index greater than available outputs");
-    if (destIdx > destination->numberOfInputs())
-        throw std::out_of_range("Input index greater than available inputs");
+    validateConnect(destination.get(), source.get(), destIdx, srcIdx);
     m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Connect, destination, source, destIdx, srcIdx});
 }
 
@@ -454,10 +626,7 @@ void AudioContext::disconnect(std::shared_ptr<AudioNode> destination, std::share
 {
     if (!destination && !source)
         return;
-    if (source && srcIdx > source->numberOfOutputs())
-        throw std::out_of_range("Output index greater than available outputs");
-    if (destination && destIdx > destination->numberOfInputs())
-        throw std::out_of_range("Input index greater than available inputs");
+    validateDisconnect(destination.get(), source.get(), destIdx, srcIdx);
     m_internal->pendingNodeConnections.enqueue({ConnectionOperationKind::Disconnect, destination, source, destIdx, srcIdx});
 }
 
@@ -487,12 +656,7 @@ bool AudioContext::isConnected(std::shared_ptr<AudioNode> destination, std::shar
 
 void AudioContext::connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
 {
-    if (!param)
-        throw std::invalid_argument("No parameter specified");
-    if (!driver)
-        throw std::invalid_argument("No driving node supplied");
-    if (index >= driver->numberOfOutputs())
-        throw std::out_of_range("Output index greater than available outputs on the driver");
+    validateParamConnect(param.get(), driver.get(), index);
     m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
 }
 
@@ -501,32 +665,126 @@ void AudioContext::connectParam(std::shared_ptr<AudioParam> param, std::shared_p
 void AudioContext::connectParam(std::shared_ptr<AudioNode> destinationNode, char const*const parameterName,
                                 std::shared_ptr<AudioNode> driver, int index)
 {
-    if (!parameterName)
-        throw std::invalid_argument("No parameter specified");
+    std::shared_ptr<AudioParam> param = namedParam(destinationNode.get(), parameterName);
+    validateParamConnect(param.get(), driver.get(), index);
+    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
+}
 
-    std::shared_ptr<AudioParam> param = destinationNode->param(parameterName);
-    if (!param)
-        throw std::invalid_argument("Parameter not found on node");
 
-    if (!driver)
-        throw std::invalid_argument("No driving node supplied");
+void AudioContext::disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
+{
+    if (!param)
+        throw std::invalid_argument("No parameter specified");
 
     if (index >= driver->numberOfOutputs())
         throw std::out_of_range("Output index greater than available outputs on the driver");
 
-    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Connect, param, driver, index});
+    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Disconnect, param, driver, index});
 }
 
+AudioContext::GraphTransaction::GraphTransaction()
+    : _edits(new CommittedGraphTransaction())
+{
+}
 
-void AudioContext::disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
+AudioContext::GraphTransaction::GraphTransaction(GraphTransaction &&) noexcept = default;
+AudioContext::GraphTransaction & AudioContext::GraphTransaction::operator=(GraphTransaction &&) noexcept = default;
+AudioContext::GraphTransaction::~GraphTransaction() = default;
+
+CommittedGraphTransaction & AudioContext::GraphTransaction::edits()
+{
+    // a committed transaction is left empty, and may be reused
+    if (!_edits)
+        _edits.reset(new CommittedGraphTransaction());
+    return *_edits;
+}
+
+void AudioContext::GraphTransaction::connect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
+{
+    validateConnect(destination.get(), source.get(), destIdx, srcIdx);
+    edits().nodes.push_back({ConnectionOperationKind::Connect, destination, source, destIdx, srcIdx});
+}
+
+void AudioContext::GraphTransaction::disconnect(std::shared_ptr<AudioNode> destination, std::shared_ptr<AudioNode> source, int destIdx, int srcIdx)
+{
+    if (!destination && !source)
+        return;
+    validateDisconnect(destination.get(), source.get(), destIdx, srcIdx);
+    edits().nodes.push_back({ConnectionOperationKind::Disconnect, destination, source, destIdx, srcIdx});
+}
+
+void AudioContext::GraphTransaction::disconnect(std::shared_ptr<AudioNode> node, int index)
+{
+    if (!node)
+        return;
+    edits().nodes.push_back({ConnectionOperationKind::Disconnect, node, std::shared_ptr<AudioNode>(), index, 0});
+}
+
+void AudioContext::GraphTransaction::connectInput(std::shared_ptr<AudioNodeInput> input, std::shared_ptr<AudioNode> source, int srcIdx)
+{
+    if (!input)
+        throw std::runtime_error("Cannot connect to null input");
+    if (!source)
+        throw std::runtime_error("Cannot connect from null source");
+    if (srcIdx >= source->numberOfOutputs())
+        throw std::out_of_range("Output index greater than available outputs");
+
+    PendingNodeConnection c;
+    c.type = ConnectionOperationKind::Connect;
+    c.source = source;
+    c.srcIndex = srcIdx;
+    c.input = input;
+    edits().nodes.push_back(std::move(c));
+}
+
+void AudioContext::GraphTransaction::connectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
+{
+    validateParamConnect(param.get(), driver.get(), index);
+    edits().params.push_back({ConnectionOperationKind::Connect, param, driver, index});
+}
+
+void AudioContext::GraphTransaction::connectParam(std::shared_ptr<AudioNode> destinationNode, char const*const parameterName,
+                                                  std::shared_ptr<AudioNode> driver, int index)
+{
+    std::shared_ptr<AudioParam> param = namedParam(destinationNode.get(), parameterName);
+    validateParamConnect(param.get(), driver.get(), index);
+    edits().params.push_back({ConnectionOperationKind::Connect, param, driver, index});
+}
+
+void AudioContext::GraphTransaction::disconnectParam(std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNode> driver, int index)
 {
     if (!param)
         throw std::invalid_argument("No parameter specified");
-
     if (index >= driver->numberOfOutputs())
         throw std::out_of_range("Output index greater than available outputs on the driver");
+    edits().params.push_back({ConnectionOperationKind::Disconnect, param, driver, index});
+}
 
-    m_internal->pendingParamConnections.enqueue({ConnectionOperationKind::Disconnect, param, driver, index});
+size_t AudioContext::GraphTransaction::size() const
+{
+    return _edits ? _edits->params.size() + _edits->nodes.size() : 0;
+}
+
+std::future<void> AudioContext::commit(GraphTransaction && transaction)
+{
+    // transactions finished since the last commit are completed here, off the render thread
+    releaseRetiredTransactions();
+
+    std::unique_ptr<CommittedGraphTransaction> t = std::move(transaction._edits);
+    if (!t)
+        t.reset(new CommittedGraphTransaction());
+
+    std::future<void> result = t->completed.get_future();
+    if (t->params.empty() && t->nodes.empty())
+    {
+        t->completed.set_value();
+        return result;
+    }
+
+    ++m_internal->transactionsInFlight;
+    Internals::pushTransaction(m_internal->committedTransactions, t.release());
+    cv.notify_all();
+    return result;
 }
 
 void AudioContext::update()
@@ -541,6 +799,11 @@ void AudioContext::update()
     ASSERT(graphTickDurationMs);
     ASSERT(graphTickDurationUs);
 
+    // an offline context renders on the calling thread, which completes the
+    // transactions finished by the previous quantum before rendering the next
+    if (m_isOfflineContext)
+        releaseRetiredTransactions();
+
     // graphKeepAlive keeps the thread alive momentarily (letting tail tasks
     // finish) even updateThreadShouldRun has been signaled.
     while (updateThreadShouldRun != 0 || graphKeepAlive > 0)
@@ -562,6 +825,8 @@ void AudioContext::update()
         if (m_internal->autoDispatchEvents)
             dispatchEvents();
 
+        releaseRetiredTransactions();
+
         {
             const double now = currentTime();
             const float delta = static_cast<float>(now - lastGraphUpdateTime);
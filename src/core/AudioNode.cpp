@@ -13,6 +13,9 @@
 #include "LabSound/extended/AudioContextLock.h"
 
 #include "internal/Assertions.h"
+#include "internal/AudioNodeDescriptorIndex.h"
+
+#include <algorithm>
 
 using namespace std;
 
@@ -104,6 +107,7 @@ const char * schedulingStateName(SchedulingState s)
 
 const int start_envelope = 64;
 const int end_envelope = 64;
+const int max_quantum_splits = 16;
 
 AudioNodeScheduler::AudioNodeScheduler(float sampleRate)
     : _epoch(0)
@@ -148,10 +152,15 @@ bool AudioNodeScheduler::update(ContextRenderLock & r, int epoch_length, const c
                 _playbackState = SchedulingState::FADE_IN;
             }
 
-            /// @TODO the case of a start and stop within one epoch needs to be special
-            /// cased, to fit this current architecture, there'd be a FADE_IN_OUT scheduling
-            /// state so that the envelope can be correctly applied.
-            // FADE_IN_OUT would transition to UNSCHEDULED.
+            if (_playbackState == SchedulingState::FADE_IN && _stopWhen < _epoch + epoch_length)
+            {
+                // the stop falls within the same frame as the start; render only
+                // the frames between them, and finish on the next quantum.
+                int stopOffset = _stopWhen > _epoch ? static_cast<int>(_stopWhen - _epoch) : 0;
+                _renderLength = stopOffset > _renderOffset ? stopOffset - _renderOffset : 0;
+                LOG_PLAYBACK_STATE_TRANSITION(node_name, _playbackState, SchedulingState::STOPPING);
+                _playbackState = SchedulingState::STOPPING;
+            }
             break;
 
         case SchedulingState::FADE_IN:
@@ -283,43 +292,11 @@ void AudioNodeScheduler::finish(ContextRenderLock & r)
     r.context()->enqueueEvent(_onEnded);
 }
 
-AudioParamDescriptor const * const AudioNodeDescriptor::param(char const * const p) const
-{
-    if (!params)
-        return nullptr;
-
-    AudioParamDescriptor const * i = params;
-    while (i->name)
-    {
-        if (!strcmp(p, i->name))
-            return i;
-
-        ++i;
-    }
-
-    return nullptr;
-}
-
-AudioSettingDescriptor const * const AudioNodeDescriptor::setting(char const * const s) const
-{
-    if (!settings)
-        return nullptr;
-
-    AudioSettingDescriptor const * i = settings;
-    while (i->name)
-    {
-        if (!strcmp(s, i->name))
-            return i;
-
-        ++i;
-    }
-
-    return nullptr;
-}
-
 AudioNode::AudioNode(AudioContext & ac, AudioNodeDescriptor const & desc)
     : _self(new Internal(ac))
 {
+    _self->index = &desc.index();
+
     if (desc.params) {
         AudioParamDescriptor const * i = desc.params;
         while (i->name)
@@ -332,7 +309,8 @@ AudioNode::AudioNode(AudioContext & ac, AudioNodeDescriptor const & desc)
         AudioSettingDescriptor const * i = desc.settings;
         while (i->name)
         {
-            _self->_settings.push_back(std::make_shared<AudioSetting>(i));
+            int slot = static_cast<int>(_self->_settings.size());
+            _self->_settings.push_back(std::make_shared<AudioSetting>(i, _self->index->enumIndex(slot)));
             ++i;
         }
     }
@@ -364,6 +342,31 @@ void AudioNode::reset(ContextRenderLock & r)
     _self->_scheduler.reset();
 }
 
+bool AudioNode::resetForReuse(ContextRenderLock & r)
+{
+    for (auto & in : _self->m_inputs)
+        if (in->isConnected())
+            return false;
+    for (auto & out : _self->m_outputs)
+        if (out->isConnected())
+            return false;
+    for (auto & p : _self->_params)
+        if (p->isConnected())
+            return false;
+
+    reset(r);
+
+    AudioNodeScheduler & scheduler = _self->_scheduler;
+    scheduler._playbackState = SchedulingState::UNSCHEDULED;
+    scheduler._startWhen = std::numeric_limits<uint64_t>::max();
+    scheduler._stopWhen = std::numeric_limits<uint64_t>::max();
+    scheduler._onEnded = nullptr;
+
+    for (auto & p : _self->_params)
+        p->cancelScheduledValues(0);
+    return true;
+}
+
 void AudioNode::addInput(ContextGraphLock&, std::unique_ptr<AudioNodeInput> input)
 {
     _self->m_inputs.emplace_back(std::move(input));
@@ -516,6 +519,11 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
     // do it here before pulling inputs
     conformChannelCounts();
 
+    // nodes pulled while this one renders, such as the drivers of its
+    // parameters, render their own quanta from the start.
+    const int enclosingSubQuantumOffset = ac->m_subQuantumOffset;
+    ac->m_subQuantumOffset = 0;
+
     // get inputs in preparation for processing
     {
         ProfileScope scope(_self->graphTime);
@@ -542,9 +550,43 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
                 memset(out->bus(r)->channel(i)->mutableData() + final_zero_start, 0, sizeof(float) * final_zero_count);
     }
 
-    // do the signal processing
+    // do the signal processing, split at parameter events if the node supports it
 
-    process(r, bufferSize);
+    int splits[max_quantum_splits];
+    int splitCount = 0;
+    if (supportsSubQuantumProcessing())
+    {
+        for (auto & p : _self->_params)
+            splitCount += p->eventFramesInQuantum(r, bufferSize, splits + splitCount, max_quantum_splits - splitCount);
+    }
+
+    if (!splitCount)
+        process(r, bufferSize);
+    else
+    {
+        std::sort(splits, splits + splitCount);
+
+        AudioNodeScheduler & scheduler = _self->_scheduler;
+        const int renderOffset = scheduler._renderOffset;
+        const int renderEnd = renderOffset + scheduler._renderLength;
+        int subBlockStart = renderOffset;
+        for (int i = 0; i <= splitCount; ++i)
+        {
+            int subBlockEnd = i < splitCount ? std::min(splits[i], renderEnd) : renderEnd;
+            if (subBlockEnd <= subBlockStart)
+                continue;
+
+            scheduler._renderOffset = subBlockStart;
+            scheduler._renderLength = subBlockEnd - subBlockStart;
+            ac->m_subQuantumOffset = subBlockStart;
+            process(r, bufferSize);
+            subBlockStart = subBlockEnd;
+        }
+
+        scheduler._renderOffset = renderOffset;
+        scheduler._renderLength = renderEnd - renderOffset;
+        ac->m_subQuantumOffset = 0;
+    }
 
     // clean pops resulting from starting or stopping
 
@@ -607,6 +649,7 @@ void AudioNode::processIfNecessary(ContextRenderLock & r, int bufferSize)
     }
 
     unsilenceOutputs(r);
+    ac->m_subQuantumOffset = enclosingSubQuantumOffset;
     selfScope.finalize(); // ensure profile is not prematurely destructed
 }
 
@@ -688,6 +731,8 @@ void AudioNode::silenceOutputs(ContextRenderLock & r)
     for (auto out : _self->m_outputs)
     {
         out->bus(r)->zero();
+        if (out->controlPeriod())
+            std::fill(out->controlPoints(), out->controlPoints() + out->controlPointCount(), 0.f);
     }
 }
 
@@ -701,23 +746,22 @@ void AudioNode::unsilenceOutputs(ContextRenderLock & r)
 
 std::shared_ptr<AudioParam> AudioNode::param(char const * const str)
 {
-    for (auto & p : _self->_params)
-    {
-        if (!strcmp(str, p->name().c_str()))
-            return p;
-    }
-    return {};
+    int slot = param_index(str);
+    return slot < 0 ? std::shared_ptr<AudioParam>() : _self->_params[slot];
+}
+
+std::shared_ptr<AudioParam> AudioNode::param(NameID id)
+{
+    auto i = _self->index->paramById.find(id.value);
+    return i == _self->index->paramById.end() ? std::shared_ptr<AudioParam>() : _self->_params[i->second];
 }
 
 int AudioNode::param_index(char const * const str)
 {
-    int count = (int) _self->_params.size();
-    for (int i = 0; i < count; ++i)
-    {
-        if (!strcmp(str, _self->_params[i]->name().c_str()))
-            return i;
-    }
-    return -1;
+    if (!str)
+        return -1;
+    auto i = _self->index->paramByName.find(str);
+    return i == _self->index->paramByName.end() ? -1 : i->second;
 }
 
 std::shared_ptr<AudioParam> AudioNode::param(int index)
@@ -730,23 +774,22 @@ std::shared_ptr<AudioParam> AudioNode::param(int index)
 
 std::shared_ptr<AudioSetting> AudioNode::setting(char const * const str)
 {
-    for (auto & p : _self->_settings)
-    {
-        if (!strcmp(str, p->name().c_str()))
-            return p;
-    }
-    return {};
+    int slot = setting_index(str);
+    return slot < 0 ? std::shared_ptr<AudioSetting>() : _self->_settings[slot];
+}
+
+std::shared_ptr<AudioSetting> AudioNode::setting(NameID id)
+{
+    auto i = _self->index->settingById.find(id.value);
+    return i == _self->index->settingById.end() ? std::shared_ptr<AudioSetting>() : _self->_settings[i->second];
 }
 
 int AudioNode::setting_index(char const * const str)
 {
-    int count = (int) _self->_settings.size();
-    for (int i = 0; i < count; ++i)
-    {
-        if (!strcmp(str, _self->_settings[i]->name().c_str()))
-            return i;
-    }
-    return -1;
+    if (!str)
+        return -1;
+    auto i = _self->index->settingByName.find(str);
+    return i == _self->index->settingByName.end() ? -1 : i->second;
 }
 
 std::shared_ptr<AudioSetting> AudioNode::setting(int index)
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/core/AudioNodeDescriptor.h"
+#include "LabSound/core/AudioParamDescriptor.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/AudioSettingDescriptor.h"
+
+#include "internal/AudioNodeDescriptorIndex.h"
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+
+namespace lab {
+
+namespace {
+
+    struct NameTable
+    {
+        std::shared_mutex mutex;
+        std::deque<std::string> names {std::string()};  // id zero is no name
+        std::unordered_map<std::string_view, uint32_t> ids;
+    };
+
+    NameTable & Names()
+    {
+        static NameTable table;
+        return table;
+    }
+
+    template <typename T>
+    int Find(const std::unordered_map<T, int> & map, T key)
+    {
+        auto i = map.find(key);
+        return i == map.end() ? -1 : i->second;
+    }
+
+}  // namespace
+
+NameID InternName(char const * const name)
+{
+    if (!name || !*name)
+        return {};
+
+    NameTable & table = Names();
+    const std::string_view key(name);
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto i = table.ids.find(key);
+        if (i != table.ids.end())
+            return {i->second};
+    }
+
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    auto i = table.ids.find(key);
+    if (i != table.ids.end())
+        return {i->second};
+
+    // a deque doesn't move its strings as it grows, so the views stay valid
+    const uint32_t id = static_cast<uint32_t>(table.names.size());
+    table.names.emplace_back(name);
+    table.ids[table.names.back()] = id;
+    return {id};
+}
+
+char const * InternedName(NameID id)
+{
+    NameTable & table = Names();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    if (id.value >= table.names.size())
+        return "";
+    return table.names[id.value].c_str();
+}
+
+AudioNodeDescriptorIndex::AudioNodeDescriptorIndex(AudioNodeDescriptor const & desc)
+{
+    if (desc.params)
+    {
+        int slot = 0;
+        for (AudioParamDescriptor const * p = desc.params; p->name; ++p, ++slot)
+        {
+            paramByName.emplace(p->name, slot);
+            paramById.emplace(InternName(p->name).value, slot);
+        }
+    }
+
+    if (desc.settings)
+    {
+        int slot = 0;
+        for (AudioSettingDescriptor const * s = desc.settings; s->name; ++s, ++slot)
+        {
+            settingByName.emplace(s->name, slot);
+            settingById.emplace(InternName(s->name).value, slot);
+
+            enums.emplace_back();
+            if (s->enums)
+            {
+                int value = 0;
+                for (char const * const * e = s->enums; *e; ++e, ++value)
+                    enums.back().byName.emplace(*e, value);
+            }
+        }
+    }
+}
+
+AudioSettingEnumIndex const * AudioNodeDescriptorIndex::enumIndex(int settingSlot) const
+{
+    if (settingSlot < 0 || settingSlot >= static_cast<int>(enums.size()) || enums[settingSlot].byName.empty())
+        return nullptr;
+    return &enums[settingSlot];
+}
+
+AudioNodeDescriptor::~AudioNodeDescriptor()
+{
+    delete _index.load();
+}
+
+AudioNodeDescriptorIndex const & AudioNodeDescriptor::index() const
+{
+    AudioNodeDescriptorIndex * index = _index.load(std::memory_order_acquire);
+    if (index)
+        return *index;
+
+    // if another thread builds the index at the same time, the first one wins
+    AudioNodeDescriptorIndex * built = new AudioNodeDescriptorIndex(*this);
+    if (_index.compare_exchange_strong(index, built, std::memory_order_acq_rel))
+        return *built;
+
+    delete built;
+    return *index;
+}
+
+int AudioNodeDescriptor::paramIndex(char const * const name) const
+{
+    return name ? Find(index().paramByName, std::string_view(name)) : -1;
+}
+
+int AudioNodeDescriptor::paramIndex(NameID id) const
+{
+    return Find(index().paramById, id.value);
+}
+
+int AudioNodeDescriptor::settingIndex(char const * const name) const
+{
+    return name ? Find(index().settingByName, std::string_view(name)) : -1;
+}
+
+int AudioNodeDescriptor::settingIndex(NameID id) const
+{
+    return Find(index().settingById, id.value);
+}
+
+AudioParamDescriptor const * const AudioNodeDescriptor::param(char const * const p) const
+{
+    int slot = paramIndex(p);
+    return slot < 0 ? nullptr : params + slot;
+}
+
+AudioSettingDescriptor const * const AudioNodeDescriptor::setting(char const * const s) const
+{
+    int slot = settingIndex(s);
+    return slot < 0 ? nullptr : settings + slot;
+}
+
+int AudioSetting::enumFromName(char const * const e) const
+{
+    if (!_desc->enums || !e)
+        return -1;
+
+    if (_enumIndex)
+        return Find(_enumIndex->byName, std::string_view(e));
+
+    int enum_idx = 0;
+    for (char const * const * names_p = _desc->enums; *names_p != nullptr; ++names_p, ++enum_idx)
+    {
+        if (!strcmp(e, *names_p))
+            return enum_idx;
+    }
+    return -1;
+}
+
+}  // namespace lab
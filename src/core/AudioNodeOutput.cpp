@@ -9,9 +9,11 @@
 #include "LabSound/core/AudioParam.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 
+#include <algorithm>
 #include <mutex>
 
 using namespace std;
@@ -123,6 +125,46 @@ AudioBus * AudioNodeOutput::pull(ContextRenderLock & r, AudioBus * inPlaceBus, i
     return bus(r);
 }
 
+void AudioNodeOutput::setControlPeriod(int frames)
+{
+    int period = 0;
+    if (frames > 1)
+    {
+        period = 1;
+        while (period * 2 <= frames && period * 2 <= AudioNode::ProcessingSizeInFrames)
+            period *= 2;
+    }
+
+    if (period == m_controlPeriod)
+        return;
+
+    // sized once for the shortest period, off the audio thread, so changing it later doesn't allocate
+    if (period && m_controlPoints.empty())
+        m_controlPoints.resize(AudioNode::ProcessingSizeInFrames + 1);
+
+    m_controlPeriod = period;
+    std::fill(m_controlPoints.begin(), m_controlPoints.end(), 0.f);
+}
+
+void AudioNodeOutput::expandControlPoints(ContextRenderLock & r)
+{
+    AudioBus * output = bus(r);
+    if (!m_controlPeriod || !output->numberOfChannels())
+        return;
+
+    float * destination = output->channel(0)->mutableData();
+    const float * points = m_controlPoints.data();
+    const float period = static_cast<float>(m_controlPeriod);
+    for (int frame = 0, i = 0; frame < AudioNode::ProcessingSizeInFrames; frame += m_controlPeriod, ++i)
+    {
+        float step = (points[i + 1] - points[i]) / period;
+        VectorMath::vramp(points + i, &step, destination + frame, 1, m_controlPeriod);
+    }
+
+    for (int i = 1; i < output->numberOfChannels(); ++i)
+        output->channel(i)->copyFrom(output->channel(0));
+}
+
 AudioBus * AudioNodeOutput::bus(ContextRenderLock & r) const
 {
     // only legal during rendering because an in-place bus might have been supplied to pull
@@ -3,11 +3,13 @@
 
 #include "LabSound/core/AudioParam.h"
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNode.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/Macros.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
@@ -22,6 +24,70 @@ AudioBus const* const AudioParam::bus() const
 }
 
 
+namespace
+{
+    // Adds the points of a control-rate output to values, interpolating linearly between them.
+    // values holds the frames of the quantum starting at offset.
+    void sumControlPoints(AudioNodeOutput * output, float * values, int offset, int numberOfValues, AudioParamShape * shape)
+    {
+        const int period = output->controlPeriod();
+        const float * points = output->controlPoints();
+        numberOfValues = std::min(numberOfValues, static_cast<int>(AudioNode::ProcessingSizeInFrames) - offset);
+        const int end = offset + numberOfValues;
+
+        const int firstPoint = offset / period;
+        const int lastPoint = (end + period - 1) / period;
+        bool isConstant = true;
+        for (int i = firstPoint + 1; i <= lastPoint && isConstant; ++i)
+            isConstant = points[i] == points[firstPoint];
+
+        if (isConstant)
+        {
+            // a constant contribution keeps the shape of the values, and a zero one adds nothing
+            const float point = points[firstPoint];
+            if (point == 0)
+                return;
+
+            for (int i = 0; i < numberOfValues; ++i)
+                values[i] += point;
+            if (shape)
+                shape->value += point;
+            return;
+        }
+
+        if (shape)
+            shape->kind = AudioParamShape::Varying;
+
+        for (int frame = offset; frame < end;)
+        {
+            const int i = frame / period;
+            const int pointFrame = i * period;
+            const float step = (points[i + 1] - points[i]) / period;
+            const float start = points[i] + (frame - pointFrame) * step;
+            const int frames = std::min(pointFrame + period, end) - frame;
+            float * destination = values + frame - offset;
+            for (int j = 0; j < frames; ++j)
+                destination[j] += start + j * step;
+            frame += frames;
+        }
+    }
+
+    // Adds frames [offset, offset + numberOfValues) of a connection's bus to values, mixed
+    // down to mono as AudioBus::sumFrom mixes mono and stereo. Other layouts contribute
+    // their first channel.
+    void sumConnectionFrames(const AudioBus & bus, float * values, int offset, int numberOfValues)
+    {
+        if (bus.numberOfChannels() == Channels::Stereo)
+        {
+            const float scale = 0.5f;
+            VectorMath::vsma(bus.channel(0)->data() + offset, 1, &scale, values, 1, numberOfValues);
+            VectorMath::vsma(bus.channel(1)->data() + offset, 1, &scale, values, 1, numberOfValues);
+        }
+        else
+            VectorMath::vadd(bus.channel(0)->data() + offset, 1, values, 1, values, 1, numberOfValues);
+    }
+}
+
 const double AudioParam::DefaultSmoothingConstant = 0.05;
 const double AudioParam::SnapThreshold = 0.001;
 
@@ -87,16 +153,18 @@ float AudioParam::finalValue(ContextRenderLock & r)
     return value;
 }
 
-void AudioParam::calculateSampleAccurateValues(ContextRenderLock & r, float * values, int numberOfValues)
+AudioParamShape AudioParam::calculateSampleAccurateValues(ContextRenderLock & r, float * values, int numberOfValues)
 {
+    AudioParamShape shape;
     bool isSafe = r.context() && values && numberOfValues;
     if (!isSafe)
-        return;
+        return shape;
 
-    calculateFinalValues(r, values, numberOfValues, true);
+    calculateFinalValues(r, values, numberOfValues, true, &shape);
+    return shape;
 }
 
-void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int numberOfValues, bool sampleAccurate)
+void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int numberOfValues, bool sampleAccurate, AudioParamShape * shape)
 {
     bool isSafe = r.context() && values && numberOfValues;
     if (!isSafe)
@@ -107,7 +175,7 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
     if (sampleAccurate)
     {
         // Calculate sample-accurate (a-rate) intrinsic values.
-        calculateTimelineValues(r, values, numberOfValues);
+        calculateTimelineValues(r, values, numberOfValues, shape);
     }
     else
     {
@@ -142,6 +210,10 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
     // point the summing bus at the values array
     m_internalSummingBus->setChannelMemory(0, values, numberOfValues);
 
+    // While a split quantum is processed, the values are for the sub-block at this offset.
+    const int offset = r.context()->currentSubQuantumOffset();
+    ASSERT(offset + numberOfValues <= AudioNode::ProcessingSizeInFrames);
+
     for (int i = 0; i < connectionCount; ++i)
     {
         auto output = renderingOutput(r, i);
@@ -151,6 +223,20 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
         // Render audio from this output.
         AudioBus * connectionBus = output->pull(r, nullptr, AudioNode::ProcessingSizeInFrames);
 
+        // A control-rate output is summed from its points; its bus isn't rendered unless audio inputs use it.
+        if (output->controlPeriod())
+        {
+            sumControlPoints(output.get(), values, offset, numberOfValues, shape);
+            continue;
+        }
+
+        // a silent connection adds nothing, and leaves the shape of the values as it was
+        if (connectionBus->isSilent())
+            continue;
+
+        if (shape)
+            shape->kind = AudioParamShape::Varying;
+
         // Sum, with unity-gain.
         /// @TODO it was surprising in practice that the inputs are summed, as opposed to simply overriding.
         /// Summing might be useful, but pure override should be an option as well.
@@ -158,23 +244,34 @@ void AudioParam::calculateFinalValues(ContextRenderLock & r, float * values, int
         /// a signal with frequency 4, bias 440, amplitude 10, and supply that as an override to the frequency of
         /// a second oscillator. Since it's summed, the solution that works is that the first oscillator should
         /// have a bias of zero. It seems like sum or override should be a setting of some sort...
-        m_internalSummingBus->sumFrom(*connectionBus);
+        if (offset)
+            sumConnectionFrames(*connectionBus, values, offset, numberOfValues);
+        else
+            m_internalSummingBus->sumFrom(*connectionBus);
     }
 }
 
+int AudioParam::eventFramesInQuantum(ContextRenderLock & r, int bufferSize, int * frames, int maxFrames)
+{
+    if (!r.context() || !m_timeline.hasValues())
+        return 0;
+
+    return m_timeline.eventFrames(r.context()->currentTime(), r.context()->sampleRate(), bufferSize, frames, maxFrames);
+}
+
 void AudioParam::calculateTimelineValues(ContextRenderLock & r, 
-    float * values, int numberOfValues)
+    float * values, int numberOfValues, AudioParamShape * shape)
 {
     // Calculate values for this render quantum.
     // Normally numberOfValues will equal AudioNode::ProcessingSizeInFrames 
-    // (the render quantum size).
+    // (the render quantum size). The values of a sub-block start at its offset.
     double sampleRate = r.context()->sampleRate();
-    double startTime = r.context()->currentTime();
+    double startTime = r.context()->currentTime() + r.context()->currentSubQuantumOffset() / sampleRate;
     double endTime = startTime + numberOfValues / sampleRate;
 
     // Note we're running control rate at the sample-rate.
     // Pass in the current value as default value.
-    m_value = m_timeline.valuesForTimeRange(startTime, endTime, static_cast<float>(m_value), values, numberOfValues, sampleRate, sampleRate);
+    m_value = m_timeline.valuesForTimeRange(startTime, endTime, static_cast<float>(m_value), values, numberOfValues, sampleRate, sampleRate, shape);
 }
 
 void AudioParam::connect(ContextGraphLock & g, std::shared_ptr<AudioParam> param, std::shared_ptr<AudioNodeOutput> output)
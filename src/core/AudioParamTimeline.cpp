@@ -8,6 +8,7 @@
 #include "LabSound/core/Macros.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 #include "internal/AudioUtilities.h"
@@ -23,6 +24,61 @@ namespace lab
 namespace
 {
     std::mutex m_eventsMutex;
+
+    // Accumulates the shape of a block of values as its runs are written in order.
+    class ShapeBuilder
+    {
+        AudioParamShape * _shape;
+        bool _started = false;
+
+    public:
+        explicit ShapeBuilder(AudioParamShape * shape) : _shape(shape) {}
+
+        void constant(float value, size_t from, size_t to)
+        {
+            if (!_shape || from >= to)
+                return;
+            if (!_started)
+            {
+                _started = true;
+                _shape->kind = AudioParamShape::Constant;
+                _shape->value = value;
+                _shape->slope = 0;
+            }
+            else if (_shape->kind != AudioParamShape::Constant || _shape->value != value)
+                _shape->kind = AudioParamShape::Varying;
+        }
+
+        void linear(float value, float slope, size_t from, size_t to)
+        {
+            if (slope == 0)
+            {
+                constant(value, from, to);
+                return;
+            }
+            if (!_shape || from >= to)
+                return;
+            if (to - from == 1)
+                constant(value, from, to);
+            else if (!_started)
+            {
+                _started = true;
+                _shape->kind = AudioParamShape::Linear;
+                _shape->value = value;
+                _shape->slope = slope;
+            }
+            else
+                varying(from, to);
+        }
+
+        void varying(size_t from, size_t to)
+        {
+            if (!_shape || from >= to)
+                return;
+            _started = true;
+            _shape->kind = AudioParamShape::Varying;
+        }
+    };
 }
 
 void AudioParamTimeline::setValueAtTime(float value, float time)
@@ -141,16 +197,21 @@ float AudioParamTimeline::valueForContextTime(
     if (!context)
         return defaultValue;
 
+    // evaluate at the start of the sub-block being rendered, if the quantum is split
+    double sampleRate = context->sampleRate();
+    double startTime = context->currentTime() + context->currentSubQuantumOffset() / sampleRate;
+
     std::unique_lock<std::mutex> lock(m_eventsMutex, std::try_to_lock);
-    if (!lock.owns_lock() || !m_events.size() || context->currentTime() < m_events[0].time())
+    if (!lock.owns_lock() || !m_events.size() || startTime < m_events[0].time())
     {
         hasValue = false;
         return defaultValue;
     }
 
+    // valuesForTimeRange acquires the events lock itself
+    lock.unlock();
+
     // Ask for just a single value.
-    double sampleRate = context->sampleRate();
-    double startTime = context->currentTime();
     double endTime = startTime + 1.1 / sampleRate;  // time just beyond one sample-frame
     double controlRate = sampleRate / AudioNode::ProcessingSizeInFrames;  // one parameter change per render quantum
     float value = valuesForTimeRange(startTime, endTime, defaultValue, &value, 1, sampleRate, controlRate);
@@ -159,6 +220,37 @@ float AudioParamTimeline::valueForContextTime(
     return value;
 }
 
+int AudioParamTimeline::eventFrames(double startTime, double sampleRate, int bufferSize, int * frames, int maxFrames)
+{
+    if (!frames || maxFrames <= 0)
+        return 0;
+
+    std::unique_lock<std::mutex> lock(m_eventsMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return 0;
+
+    double endTime = startTime + bufferSize / sampleRate;
+    int count = 0;
+    for (auto & event : m_events)
+    {
+        // events are sorted by time
+        if (event.time() >= endTime)
+            break;
+        if (event.time() <= startTime)
+            continue;
+
+        int frame = static_cast<int>(std::ceil((event.time() - startTime) * sampleRate));
+        if (frame > 0 && frame < bufferSize)
+        {
+            frames[count++] = frame;
+            if (count == maxFrames)
+                break;
+        }
+    }
+
+    return count;
+}
+
 float AudioParamTimeline::valuesForTimeRange(
     double startTime,
     double endTime,
@@ -166,9 +258,10 @@ float AudioParamTimeline::valuesForTimeRange(
     float * values,
     size_t numberOfValues,
     double sampleRate,
-    double controlRate)
+    double controlRate,
+    AudioParamShape * shape)
 {
-    float value = valuesForTimeRangeImpl(startTime, endTime, defaultValue, values, numberOfValues, sampleRate, controlRate);
+    float value = valuesForTimeRangeImpl(startTime, endTime, defaultValue, values, numberOfValues, sampleRate, controlRate, shape);
     return value;
 }
 
@@ -179,17 +272,21 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
     float * values,
     size_t numberOfValues,
     double sampleRate,
-    double controlRate)
+    double controlRate,
+    AudioParamShape * shape)
 {
     if (!values)
         return defaultValue;
 
+    ShapeBuilder runs(shape);
+
     // Return default value if there are no events matching the desired time range.
     std::unique_lock<std::mutex> lock(m_eventsMutex, std::try_to_lock);
     if (!lock.owns_lock() || !m_events.size() || endTime <= m_events[0].time())
     {
         for (unsigned i = 0; i < numberOfValues; ++i)
             values[i] = defaultValue;
+        runs.constant(defaultValue, 0, numberOfValues);
         return defaultValue;
     }
 
@@ -205,6 +302,7 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
         double fillToTime = std::min(endTime, firstEventTime);
         size_t fillToFrame = AudioUtilities::timeToSampleFrame(fillToTime - startTime, sampleRate);
         fillToFrame = std::min(fillToFrame, numberOfValues);
+        runs.constant(defaultValue, writeIndex, fillToFrame);
         for (; writeIndex < fillToFrame; ++writeIndex)
             values[writeIndex] = defaultValue;
 
@@ -245,12 +343,18 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
         // First handle linear and exponential ramps which require looking ahead to the next event.
         if (nextEventType == ParamEvent::LinearRampToValue)
         {
-            for (; writeIndex < fillToFrame; ++writeIndex)
+            if (writeIndex < fillToFrame)
             {
+                const int frames = static_cast<int>(fillToFrame - writeIndex);
                 float x = static_cast<float>(currentTime - time1) * k;
-                value = (1 - x) * value1 + x * value2;
-                values[writeIndex] = value;
-                currentTime += sampleFrameTimeIncr;
+                float first = (1 - x) * value1 + x * value2;
+                float step = static_cast<float>((value2 - value1) * k * sampleFrameTimeIncr);
+                runs.linear(first, step, writeIndex, fillToFrame);
+
+                VectorMath::vramp(&first, &step, values + writeIndex, 1, frames);
+                writeIndex += frames;
+                value = values[writeIndex - 1];
+                currentTime += frames * sampleFrameTimeIncr;
             }
         }
         else if (nextEventType == ParamEvent::ExponentialRampToValue)
@@ -258,6 +362,7 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
             if (value1 <= 0 || value2 <= 0)
             {
                 // Handle negative values error case by propagating previous value.
+                runs.constant(value, writeIndex, fillToFrame);
                 for (; writeIndex < fillToFrame; ++writeIndex)
                     values[writeIndex] = value;
             }
@@ -273,11 +378,20 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
                 // accurate, especially if multiplier is close to 1.
                 value = value1 * powf(value2 / value1, AudioUtilities::timeToSampleFrame(currentTime - time1, sampleRate) / numSampleFrames);
 
-                for (; writeIndex < fillToFrame; ++writeIndex)
+                if (multiplier == 1)
+                    runs.constant(value, writeIndex, fillToFrame);
+                else
+                    runs.varying(writeIndex, fillToFrame);
+
+                // value * multiplier^i, stepped four frames at a time
+                if (writeIndex < fillToFrame)
                 {
-                    values[writeIndex] = value;
-                    value *= multiplier;
-                    currentTime += sampleFrameTimeIncr;
+                    const int frames = static_cast<int>(fillToFrame - writeIndex);
+                    const float zero = 0;
+                    VectorMath::vgeom(&value, &multiplier, &zero, values + writeIndex, 1, frames);
+                    writeIndex += frames;
+                    value = values[writeIndex - 1] * multiplier;
+                    currentTime += frames * sampleFrameTimeIncr;
                 }
             }
         }
@@ -294,6 +408,7 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
 
                     // Simply stay at a constant value.
                     value = event.value();
+                    runs.constant(value, writeIndex, fillToFrame);
                     for (; writeIndex < fillToFrame; ++writeIndex)
                         values[writeIndex] = value;
 
@@ -309,9 +424,25 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
                     float timeConstant = event.timeConstant();
                     float discreteTimeConstant = static_cast<float>(AudioUtilities::discreteTimeConstantForSampleRate(timeConstant, controlRate));
 
-                    for (; writeIndex < fillToFrame; ++writeIndex)
+                    // once the approach stops changing the value it never will again
+                    if (value + (target - value) * discreteTimeConstant == value)
                     {
-                        values[writeIndex] = value;
+                        runs.constant(value, writeIndex, fillToFrame);
+                        for (; writeIndex < fillToFrame; ++writeIndex)
+                            values[writeIndex] = value;
+                    }
+                    else if (writeIndex < fillToFrame)
+                    {
+                        runs.varying(writeIndex, fillToFrame);
+
+                        // The recurrence value += (target - value) * c is target + (value - target) * (1 - c)^i,
+                        // which is stepped four frames at a time.
+                        const int frames = static_cast<int>(fillToFrame - writeIndex);
+                        const float distance = value - target;
+                        const float ratio = 1 - discreteTimeConstant;
+                        VectorMath::vgeom(&distance, &ratio, &target, values + writeIndex, 1, frames);
+                        writeIndex += frames;
+                        value = values[writeIndex - 1];
                         value += (target - value) * discreteTimeConstant;
                     }
 
@@ -335,6 +466,7 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
                     {
                         // Error condition - simply propagate previous value.
                         currentTime = fillToTime;
+                        runs.constant(value, writeIndex, fillToFrame);
                         for (; writeIndex < fillToFrame; ++writeIndex)
                             values[writeIndex] = value;
                         break;
@@ -368,23 +500,31 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
 
                     // Render the stretched curve data using nearest neighbor sampling.
                     // Oversampled curve data can be provided if smoothness is desired.
-                    for (; writeIndex < fillToFrame; ++writeIndex)
+                    runs.varying(writeIndex, fillToFrame);
+                    if (writeIndex < fillToFrame)
                     {
-                        // Ideally we'd use round() from MathExtras, but we're in a tight loop here
-                        // and we're trading off precision for extra speed.
-                        unsigned curveIndex = static_cast<unsigned>(0.5 + curveVirtualIndex);
+                        // The rounded virtual indices are written as a ramp first, then replaced in place by
+                        // the curve points they select. Ideally we'd use round() from MathExtras, but we're
+                        // trading off precision for extra speed.
+                        const int frames = static_cast<int>(fillToFrame - writeIndex);
+                        float roundedIndex = 0.5f + curveVirtualIndex;
+                        VectorMath::vramp(&roundedIndex, &curvePointsPerFrame, values + writeIndex, 1, frames);
 
-                        curveVirtualIndex += curvePointsPerFrame;
+                        for (; writeIndex < fillToFrame; ++writeIndex)
+                        {
+                            unsigned curveIndex = static_cast<unsigned>(values[writeIndex]);
 
-                        // Bounds check.
-                        if (curveIndex < numberOfCurvePoints)
-                            value = curveData[curveIndex];
+                            // Bounds check.
+                            if (curveIndex < numberOfCurvePoints)
+                                value = curveData[curveIndex];
 
-                        values[writeIndex] = value;
+                            values[writeIndex] = value;
+                        }
                     }
 
                     // If there's any time left after the duration of this event and the start
                     // of the next, then just propagate the last value.
+                    runs.constant(value, writeIndex, nextEventFillToFrame);
                     for (; writeIndex < nextEventFillToFrame; ++writeIndex)
                         values[writeIndex] = value;
 
@@ -399,6 +539,7 @@ float AudioParamTimeline::valuesForTimeRangeImpl(
 
     // If there's any time left after processing the last event then just propagate the last value
     // to the end of the values buffer.
+    runs.constant(value, writeIndex, numberOfValues);
     for (; writeIndex < numberOfValues; ++writeIndex)
         values[writeIndex] = value;
 
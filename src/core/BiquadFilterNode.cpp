@@ -12,6 +12,7 @@
 
 #include "internal/Biquad.h"
 #include <algorithm>
+#include <limits>
 
 namespace lab
 {
@@ -69,10 +70,15 @@ public:
     virtual void uninitialize() override {}
 
     virtual void process(ContextRenderLock & r,  const lab::AudioBus * sourceBus, lab::AudioBus * destinationBus, int framesToProcess) override
+    {
+        process(r, sourceBus, destinationBus, framesToProcess, 0, framesToProcess);
+    }
+
+    virtual void process(ContextRenderLock & r, const lab::AudioBus * sourceBus, lab::AudioBus * destinationBus, int bufferSize, int offset, int count) override
     {
         checkForDirtyCoefficients(r);
         updateCoefficientsIfNecessary(r, true, false);
-        the_filter->process(sourceBus->channel(0)->data(), destinationBus->channel(0)->mutableData(), framesToProcess);
+        the_filter->process(sourceBus->channel(0)->data() + offset, destinationBus->channel(0)->mutableData() + offset, count);
     }
 
     virtual void reset() override {}
@@ -160,6 +166,19 @@ public:
                 detune = m_detune->value();
             }
 
+            // Sample-accurate parameters are dirty every quantum, but sparse automation
+            // usually holds them constant, so only recompute when the values change.
+            const uint32_t type = m_type->valueUint32();
+            if (!forceUpdate && freq == m_lastFrequency && q_val == m_lastQ && gain == m_lastGain
+                && detune == m_lastDetune && type == m_lastType)
+                return;
+
+            m_lastFrequency = freq;
+            m_lastQ = q_val;
+            m_lastGain = gain;
+            m_lastDetune = detune;
+            m_lastType = type;
+
             // Convert from Hertz to normalized frequency 0 -> 1.
             double nyquist = r.context()->sampleRate() * 0.5f;
             double normalizedFrequency = freq / nyquist;
@@ -172,7 +191,7 @@ public:
 
             // Configure the biquad with the new filter parameters for the appropriate type of filter.
             // clang-format off
-            switch (m_type->valueUint32())
+            switch (type)
             {
                 case FilterType::LOWPASS:   the_filter->setLowpassParams(normalizedFrequency, q_val);       break;
                 case FilterType::HIGHPASS:  the_filter->setHighpassParams(normalizedFrequency, q_val);      break;
@@ -212,6 +231,13 @@ public:
 
     bool m_hasJustReset {true};
 
+    // the values the coefficients were last computed from
+    double m_lastFrequency {std::numeric_limits<double>::quiet_NaN()};
+    double m_lastQ {0};
+    double m_lastGain {0};
+    double m_lastDetune {0};
+    uint32_t m_lastType {0};
+
     std::shared_ptr<AudioSetting> m_type;
     std::shared_ptr<AudioParam> m_frequency;
     std::shared_ptr<AudioParam> m_q;
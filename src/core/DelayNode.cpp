@@ -13,7 +13,13 @@
 namespace lab
 {
 
-static AudioSettingDescriptor s_delayTimeSettings[] = {{"delayTime", "DELY", SettingType::Float}, nullptr};
+static char const * const s_delayInterpolations[static_cast<int>(DelayInterpolation::_Count) + 1] = {
+    "Linear", "Cubic", "Allpass", nullptr};
+
+static AudioSettingDescriptor s_delayTimeSettings[] = {
+    {"delayTime",     "DELY", SettingType::Float},
+    {"interpolation", "INTP", SettingType::Enum, s_delayInterpolations},
+    nullptr};
 
 AudioNodeDescriptor * DelayNode::desc()
 {
@@ -28,7 +34,7 @@ DelayNode::DelayNode(AudioContext& ac, double maxDelayTime)
         maxDelayTime = 0;  // delay node can't predict the future
 
     m_processor = std::make_unique<DelayProcessor>(ac.sampleRate(), 
-        maxDelayTime, setting("delayTime"));
+        maxDelayTime, setting("delayTime"), setting("interpolation"));
 
     initialize();
 }
@@ -38,6 +44,11 @@ std::shared_ptr<AudioSetting> DelayNode::delayTime()
     return delayProcessor()->delayTime();
 }
 
+std::shared_ptr<AudioSetting> DelayNode::interpolation()
+{
+    return delayProcessor()->interpolation();
+}
+
 DelayProcessor * DelayNode::delayProcessor()
 {
     return static_cast<DelayProcessor *>(processor());
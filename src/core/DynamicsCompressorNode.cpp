@@ -7,6 +7,7 @@
 #include "LabSound/core/AudioContext.h"
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Registry.h"
@@ -26,11 +27,17 @@ static AudioParamDescriptor s_dcParams[] = {
     {"reduction", "REDC",   0,   -20,  0},
     {"attack",    "ATCK",   0.003, 0,  1},
     {"release",   "RELS",   0.250, 0,  1},
-    nullptr};
+    {nullptr, nullptr, 0.0, 0.0, 0.0}};
+
+static AudioSettingDescriptor s_dcSettings[] = {
+    {"bands",         "BAND", SettingType::Integer, nullptr},
+    {"lowCrossover",  "LOXO", SettingType::Float, nullptr},
+    {"highCrossover", "HIXO", SettingType::Float, nullptr},
+    {nullptr, nullptr, SettingType::None, nullptr}};
 
 AudioNodeDescriptor * DynamicsCompressorNode::desc()
 {
-    static AudioNodeDescriptor d {s_dcParams, nullptr, 2};
+    static AudioNodeDescriptor d {s_dcParams, s_dcSettings, 2};
     return &d;
 }
 
@@ -46,6 +53,13 @@ DynamicsCompressorNode::DynamicsCompressorNode(AudioContext& ac)
     m_attack = param("attack");
     m_release = param("release");
 
+    m_bands = setting("bands");
+    m_bands->setUint32(1);
+    m_lowCrossover = setting("lowCrossover");
+    m_lowCrossover->setFloat(200.f);
+    m_highCrossover = setting("highCrossover");
+    m_highCrossover->setFloat(2000.f);
+
     initialize();
 }
 
@@ -70,6 +84,10 @@ void DynamicsCompressorNode::process(ContextRenderLock &r, int bufferSize)
     m_dynamicsCompressor->setParameterValue(DynamicsCompressor::ParamAttack, attack);
     m_dynamicsCompressor->setParameterValue(DynamicsCompressor::ParamRelease, release);
 
+    m_dynamicsCompressor->setParameterValue(DynamicsCompressor::ParamBandCount, static_cast<float>(m_bands->valueUint32()));
+    m_dynamicsCompressor->setParameterValue(DynamicsCompressor::ParamLowCrossover, m_lowCrossover->valueFloat());
+    m_dynamicsCompressor->setParameterValue(DynamicsCompressor::ParamHighCrossover, m_highCrossover->valueFloat());
+
     int numberOfSourceChannels = input(0)->numberOfChannels(r);
     int numberOfActiveBusChannels = input(0)->bus(r)->numberOfChannels();
     if (numberOfActiveBusChannels != numberOfSourceChannels)
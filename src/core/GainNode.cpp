@@ -10,6 +10,7 @@
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Registry.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "internal/Assertions.h"
 
@@ -79,15 +80,34 @@ void GainNode::process(ContextRenderLock &r, int bufferSize)
         ASSERT(bufferSize <= m_sampleAccurateGainValues.size());
         if (bufferSize <= m_sampleAccurateGainValues.size())
         {
+            const int renderOffset = _self->_scheduler._renderOffset;
+            const int renderEnd = renderOffset + _self->_scheduler._renderLength;
             float* gainValues_base = m_sampleAccurateGainValues.data();
-            float* gainValues = gainValues_base + _self->_scheduler._renderOffset;
-            gain()->calculateSampleAccurateValues(r, gainValues, _self->_scheduler._renderLength);
-            if (_self->_scheduler._renderOffset > 0)
-                memset(gainValues_base, 0, sizeof(float) * _self->_scheduler._renderOffset);
-            int bzero_start = _self->_scheduler._renderOffset + _self->_scheduler._renderLength;
-            if (bzero_start < bufferSize)
-                memset(gainValues_base + bzero_start, 0, sizeof(float) * bufferSize - bzero_start);
-            outputBus->copyWithSampleAccurateGainValuesFrom(*inputBus, m_sampleAccurateGainValues.data(), bufferSize);
+            float* gainValues = gainValues_base + renderOffset;
+            AudioParamShape shape = gain()->calculateSampleAccurateValues(r, gainValues, _self->_scheduler._renderLength);
+            if (shape.isConstant())
+            {
+                // Automation is usually sparse, so most quanta have a single gain; apply it as a scalar.
+                m_lastGain = shape.value;
+                for (int i = 0; i < outputBusChannelCount; ++i)
+                {
+                    const float * source = inputBus->channel(i)->data();
+                    float * destination = outputBus->channel(i)->mutableData();
+                    if (renderOffset > 0)
+                        memset(destination, 0, sizeof(float) * renderOffset);
+                    VectorMath::vsmul(source + renderOffset, 1, &shape.value, destination + renderOffset, 1, renderEnd - renderOffset);
+                    if (renderEnd < bufferSize)
+                        memset(destination + renderEnd, 0, sizeof(float) * (bufferSize - renderEnd));
+                }
+            }
+            else
+            {
+                if (renderOffset > 0)
+                    memset(gainValues_base, 0, sizeof(float) * renderOffset);
+                if (renderEnd < bufferSize)
+                    memset(gainValues_base + renderEnd, 0, sizeof(float) * (bufferSize - renderEnd));
+                outputBus->copyWithSampleAccurateGainValuesFrom(*inputBus, m_sampleAccurateGainValues.data(), bufferSize);
+            }
         }
     }
     else
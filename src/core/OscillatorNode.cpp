@@ -20,33 +20,11 @@
 #include "LabSound/extended/VectorMath.h"
 
 #include <algorithm>
-//#include <emmintrin.h>
+#include <cmath>
+#include <cstring>
 
 using namespace lab;
 
-// https://www.musicdsp.org/en/latest/Synthesis/13-sine-calculation.html
-// phase should be between between -LAB_PI and +LAB_PI
-inline float burk_fast_sine(const double phase) 
-{
-    // Factorial coefficients.
-    const float IF3 = 1.f / (2 * 3);
-    const float IF5 = IF3 / (4 * 5);
-    const float IF7 = IF5 / (6 * 7);
-    const float IF9 = IF7 / (8 * 9);
-    const float IF11 = IF9 / (10 * 11);
-
-    // Wrap phase back into region where results are more accurate. 
-    double x = (phase > +LAB_HALF_PI) ? +(LAB_PI - phase)
-           : ((phase < -LAB_HALF_PI) ? -(LAB_PI + phase) : phase);
-
-    double x2 = (x * x);
-
-    // Taylor expansion out to x**11/11! factored into multiply-adds 
-    return static_cast<float>(
-            x * (x2 * (x2 * (x2 * (x2 * ((x2 * (-IF11)) + IF9) - IF7) + IF5) - IF3) + 1)
-        );
-}
-
 static char const * const s_types[] = {
     "None", "Sine", "FastSine", "Square", "Sawtooth", "Falling Sawtooth",
     "Triangle", "Custom", nullptr};
@@ -61,6 +39,26 @@ static AudioParamDescriptor s_opDesc[] = {
 static AudioSettingDescriptor s_osDesc[] = {
         {"type", "TYPE", SettingType::Enum, s_types}, nullptr};
 
+// The basic tables are built for this rate if the context has no device yet. Only the
+// band limiting depends on it; the pitch follows the context's rate.
+static const float s_defaultTableSampleRate = 48000.f;
+
+struct OscillatorNode::WaveSlot
+{
+    std::shared_ptr<PeriodicWave> wave;
+    WaveSlot * next = nullptr;
+
+    static void freeList(WaveSlot * slot)
+    {
+        while (slot)
+        {
+            WaveSlot * next = slot->next;
+            delete slot;
+            slot = next;
+        }
+    }
+};
+
 AudioNodeDescriptor * OscillatorNode::desc()
 {
     static AudioNodeDescriptor d {s_opDesc, s_osDesc, 1};
@@ -70,7 +68,12 @@ AudioNodeDescriptor * OscillatorNode::desc()
 OscillatorNode::OscillatorNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
 , m_phaseIncrements(AudioNode::ProcessingSizeInFrames)
+, m_biasValues(AudioNode::ProcessingSizeInFrames)
 , m_detuneValues(AudioNode::ProcessingSizeInFrames)
+, m_amplitudeValues(AudioNode::ProcessingSizeInFrames)
+, m_tablePositions(AudioNode::ProcessingSizeInFrames)
+, m_lowerWaveValues(AudioNode::ProcessingSizeInFrames)
+, m_contextSampleRate(ac.sampleRate())
 {
     m_frequency = param("frequency");
     m_detune = param("detune");
@@ -87,6 +90,11 @@ OscillatorNode::OscillatorNode(AudioContext & ac)
 OscillatorNode::~OscillatorNode()
 {
     uninitialize();
+    delete m_basicWave;
+    delete m_customWave;
+    delete m_pendingBasicWave.exchange(nullptr);
+    delete m_pendingPeriodicWave.exchange(nullptr);
+    WaveSlot::freeList(m_retiredWaves.exchange(nullptr));
 }
 
 OscillatorType OscillatorNode::type() const
@@ -96,7 +104,39 @@ OscillatorType OscillatorNode::type() const
 
 void OscillatorNode::setType(OscillatorType type)
 {
-    m_type->setUint32(static_cast<uint32_t>(type));
+    // The shared tables are looked up, or built, here rather than on the audio thread,
+    // and handed over before the type changes. The type setting's value-changed handler
+    // also lands here, just after the type has changed.
+    if (type != OscillatorType::OSCILLATOR_NONE && type != OscillatorType::CUSTOM)
+    {
+        const float sampleRate = m_contextSampleRate > 0 ? m_contextSampleRate : s_defaultTableSampleRate;
+        WaveSlot * slot = new WaveSlot;
+        slot->wave = PeriodicWave::sharedBasicWaveform(sampleRate, type);
+
+        // a wave that was published but not yet taken by the audio thread is replaced
+        delete m_pendingBasicWave.exchange(slot, std::memory_order_acq_rel);
+    }
+
+    // waves the audio thread has finished with are released here, rather than on the audio thread
+    WaveSlot::freeList(m_retiredWaves.exchange(nullptr, std::memory_order_acquire));
+
+    m_type->setUint32(static_cast<uint32_t>(type), false);
+}
+
+void OscillatorNode::setPeriodicWave(std::shared_ptr<PeriodicWave> periodicWave)
+{
+    WaveSlot * slot = new WaveSlot;
+    slot->wave = std::move(periodicWave);
+    delete m_pendingPeriodicWave.exchange(slot, std::memory_order_acq_rel);
+    setType(OscillatorType::CUSTOM);
+}
+
+void OscillatorNode::retireWave(WaveSlot * slot)
+{
+    if (!slot)
+        return;
+    slot->next = m_retiredWaves.load(std::memory_order_relaxed);
+    while (!m_retiredWaves.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {}
 }
 
 void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, int offset, int count)
@@ -107,20 +147,45 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
         outputBus->zero();
         return;
     }
-    
+
     const float sample_rate = r.context()->sampleRate();
-    
+
     int quantumFrameOffset = offset;
     int nonSilentFramesToProcess = count;
-    
+
     if (!nonSilentFramesToProcess)
     {
         outputBus->zero();
         return;
     }
-    
-    nonSilentFramesToProcess += quantumFrameOffset;
-    
+
+    // pick up the waves set since the last quantum
+    if (WaveSlot * pending = m_pendingPeriodicWave.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        retireWave(m_customWave);
+        m_customWave = pending;
+    }
+    if (WaveSlot * pending = m_pendingBasicWave.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        retireWave(m_basicWave);
+        m_basicWave = pending;
+    }
+
+    OscillatorType type = static_cast<OscillatorType>(m_type->valueUint32());
+    PeriodicWave * wave = nullptr;
+    if (type == OscillatorType::CUSTOM)
+        wave = m_customWave ? m_customWave->wave.get() : nullptr;
+    else if (type != OscillatorType::OSCILLATOR_NONE)
+        wave = m_basicWave ? m_basicWave->wave.get() : nullptr;
+
+    float * destP = outputBus->channel(0)->mutableData();
+    if (!wave)
+    {
+        memset(destP + quantumFrameOffset, 0, sizeof(float) * nonSilentFramesToProcess);
+        outputBus->clearSilentFlag();
+        return;
+    }
+
     if (bufferSize > m_phaseIncrements.size())
         m_phaseIncrements.allocate(bufferSize);
     if (bufferSize > m_detuneValues.size())
@@ -129,40 +194,57 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
         m_amplitudeValues.allocate(bufferSize);
     if (bufferSize > m_biasValues.size())
         m_biasValues.allocate(bufferSize);
-    
-    // calculate phase increments
-    float* phaseIncrements = m_phaseIncrements.data();
-    
+    if (bufferSize > m_tablePositions.size())
+        m_tablePositions.allocate(bufferSize);
+    if (bufferSize > m_lowerWaveValues.size())
+        m_lowerWaveValues.allocate(bufferSize);
+
+    // The params are evaluated for the whole quantum, so that their timelines advance
+    // in step with the context, and the frames that sound are taken from the range
+    // starting at quantumFrameOffset.
+
+    // calculate the frequencies
+    float * frequencies = m_phaseIncrements.data();
+    float frequency = 0;
+    bool constantFrequency = true;
+
     if (m_frequency->hasSampleAccurateValues())
     {
         // Get the sample-accurate frequency values in preparation for conversion to phase increments.
-        // They will be converted to phase increments below.
-        m_frequency->calculateSampleAccurateValues(r, phaseIncrements, nonSilentFramesToProcess);
+        AudioParamShape shape = m_frequency->calculateSampleAccurateValues(r, frequencies, bufferSize);
+        constantFrequency = shape.isConstant();
+        frequency = shape.value;
     }
     else
     {
         // Handle ordinary parameter smoothing/de-zippering if there are no scheduled changes.
         m_frequency->smooth(r);
-        float frequency = m_frequency->smoothedValue();
-        for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-        {
-            phaseIncrements[i] = frequency;
-        }
+        frequency = m_frequency->smoothedValue();
     }
-    
+
     if (m_detune->hasSampleAccurateValues())
     {
         // Get the sample-accurate detune values.
-        float* detuneValues = m_detuneValues.data();
-        float* offset_detunes = detuneValues + +quantumFrameOffset;
-        m_detune->calculateSampleAccurateValues(r, offset_detunes, nonSilentFramesToProcess);
-        
-        // Convert from cents to rate scalar and perform detuning
-        float k = 1.f / 1200.f;
-        VectorMath::vsmul(offset_detunes, 1, &k, offset_detunes, 1, nonSilentFramesToProcess);
-        for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+        float * detuneValues = m_detuneValues.data();
+        AudioParamShape shape = m_detune->calculateSampleAccurateValues(r, detuneValues, bufferSize);
+        if (shape.isConstant())
+        {
+            frequency *= exp2f(shape.value / 1200.f);
+        }
+        else
         {
-            phaseIncrements[i] *= powf(2, detuneValues[i]);  // FIXME: converting to expf() will be faster.
+            // Convert from cents to rate scalar and perform detuning
+            if (constantFrequency)
+            {
+                for (int i = 0; i < bufferSize; ++i)
+                    frequencies[i] = frequency;
+                constantFrequency = false;
+            }
+
+            float k = 1.f / 1200.f;
+            VectorMath::vsmul(detuneValues, 1, &k, detuneValues, 1, bufferSize);
+            VectorMath::vexp2(detuneValues, detuneValues, bufferSize);
+            VectorMath::vmul(frequencies, 1, detuneValues, 1, frequencies, 1, bufferSize);
         }
     }
     else
@@ -172,139 +254,121 @@ void OscillatorNode::process_oscillator(ContextRenderLock & r, int bufferSize, i
         float detune = m_detune->smoothedValue();
         if (fabsf(detune) > 0.01f)
         {
-            float detuneScale = powf(2, detune / 1200);
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-                phaseIncrements[i] *= detuneScale;
+            float detuneScale = exp2f(detune / 1200.f);
+            if (constantFrequency)
+                frequency *= detuneScale;
+            else
+                VectorMath::vsmul(frequencies, 1, &detuneScale, frequencies, 1, bufferSize);
         }
     }
-    
-    // convert frequencies to phase increments
-    for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-    {
-        phaseIncrements[i] = static_cast<float>(2.f * static_cast<float>(LAB_PI)* phaseIncrements[i] / sample_rate);
-    }
-    
+
     // fetch the amplitudes
-    float* amplitudes = m_amplitudeValues.data();
+    float * amplitudes = m_amplitudeValues.data();
+    AudioParamShape amplitude;
     if (m_amplitude->hasSampleAccurateValues())
     {
-        m_amplitude->calculateSampleAccurateValues(r, amplitudes + quantumFrameOffset, nonSilentFramesToProcess);
+        amplitude = m_amplitude->calculateSampleAccurateValues(r, amplitudes, bufferSize);
     }
     else
     {
         m_amplitude->smooth(r);
-        float amp = m_amplitude->smoothedValue();
-        for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            amplitudes[i] = amp;
+        amplitude = {AudioParamShape::Constant, m_amplitude->smoothedValue()};
     }
-    
+
     // fetch the bias values
-    float* bias = m_biasValues.data();
+    float * bias = m_biasValues.data();
+    AudioParamShape biasShape;
     if (m_bias->hasSampleAccurateValues())
     {
-        m_bias->calculateSampleAccurateValues(r, bias + quantumFrameOffset, nonSilentFramesToProcess);
+        biasShape = m_bias->calculateSampleAccurateValues(r, bias, bufferSize);
     }
     else
     {
         m_bias->smooth(r);
-        float b = m_bias->smoothedValue();
-        for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
+        biasShape = {AudioParamShape::Constant, m_bias->smoothedValue()};
+    }
+
+    // choose the tables for the fundamental frequency, or the highest one in the quantum
+    float tableFrequency = frequency;
+    if (!constantFrequency)
+        VectorMath::vmaxmgv(frequencies + quantumFrameOffset, 1, &tableFrequency, nonSilentFramesToProcess);
+
+    float * lowerWaveData = nullptr;
+    float * higherWaveData = nullptr;
+    float tableInterpolationFactor = 0;
+    wave->waveDataForFundamentalFrequency(tableFrequency, lowerWaveData, higherWaveData, tableInterpolationFactor);
+
+    // accumulate the phase as positions in the tables
+    const int waveSize = static_cast<int>(wave->periodicWaveSize());
+    const float tableSize = static_cast<float>(waveSize);
+    float * positions = m_tablePositions.data() + quantumFrameOffset;
+    if (constantFrequency)
+    {
+        const double increment = frequency / sample_rate;
+        const float start = static_cast<float>(phase * waveSize);
+        const float step = static_cast<float>(increment * waveSize);
+        VectorMath::vramp(&start, &step, positions, 1, nonSilentFramesToProcess);
+        phase += increment * nonSilentFramesToProcess;
+    }
+    else
+    {
+        const double scale = 1.0 / sample_rate;
+        double p = phase;
+        for (int i = 0; i < nonSilentFramesToProcess; ++i)
         {
-            bias[i] = b;
+            positions[i] = static_cast<float>(p * waveSize);
+            p += frequencies[quantumFrameOffset + i] * scale;
         }
+        phase = p;
     }
-    
-    // calculate and write the wave
-    float* destP = outputBus->channel(0)->mutableData();
-    const float pi = static_cast<float>(LAB_PI);
-    
-    OscillatorType type = static_cast<OscillatorType>(m_type->valueUint32());
-    switch (type)
+    phase -= std::floor(phase);
+    VectorMath::vwrap(positions, &tableSize, positions, nonSilentFramesToProcess);
+
+    // calculate and write the wave, interpolating between the tables for the adjacent pitch ranges
+    float * wave_values = destP + quantumFrameOffset;
+    VectorMath::vlint(higherWaveData, positions, wave_values, nonSilentFramesToProcess);
+    if (lowerWaveData != higherWaveData && tableInterpolationFactor > 0)
     {
-        case OscillatorType::SINE:
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            {
-                destP[i] = static_cast<float>(bias[i] + amplitudes[i] * static_cast<float>(sin(phase)));
-                phase += phaseIncrements[i];
-                if (phase > 2.f * pi)
-                    phase -= 2.f * pi;
-            }
-            break;
-            
-        case OscillatorType::FAST_SINE:
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            {
-                destP[i] = burk_fast_sine(phase);
-                phase += phaseIncrements[i];
-                if (phase > pi)
-                    phase -= 0.5f * pi;
-            }
-            break;
-            
-        case OscillatorType::SQUARE:
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            {
-                float amp = amplitudes[i];
-                destP[i] = static_cast<float>(bias[i] + (phase < pi ? amp : -amp));
-                phase += phaseIncrements[i];
-                if (phase > 2.f * pi)
-                    phase -= 2.f * pi;
-            }
-            break;
-            
-        case OscillatorType::SAWTOOTH:
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            {
-                float amp = amplitudes[i];
-                destP[i] = static_cast<float>(bias[i] + amp - (amp / pi * phase));
-                phase += phaseIncrements[i];
-                if (phase > 2.f * pi)
-                    phase -= 2.f * pi;
-            }
-            break;
-            
-        case OscillatorType::FALLING_SAWTOOTH:
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            {
-                float amp = amplitudes[i];
-                destP[i] = static_cast<float>(bias[i] - (amp / pi * phase));
-                phase += phaseIncrements[i];
-                if (phase > 2. * pi)
-                    phase -= 2. * pi;
-            }
-            break;
-            
-        case OscillatorType::TRIANGLE:
-            for (int i = quantumFrameOffset; i < nonSilentFramesToProcess; ++i)
-            {
-                float amp = amplitudes[i];
-                if (phase < pi)
-                    destP[i] = static_cast<float>(bias[i] - amp + (2.f * amp / pi * phase));
-                else
-                    destP[i] = static_cast<float>(bias[i] + 3.f * amp - (2.f * amp / pi *  phase));
-                
-                phase += phaseIncrements[i];
-                if (phase > 2.f * pi)
-                    phase -= 2.f * pi;
-            }
-            break;
-            
-        default: break; // other types do nothing
+        float * lower_values = m_lowerWaveValues.data();
+        const float higherScale = 1.f - tableInterpolationFactor;
+        VectorMath::vlint(lowerWaveData, positions, lower_values, nonSilentFramesToProcess);
+        VectorMath::vsmul(wave_values, 1, &higherScale, wave_values, 1, nonSilentFramesToProcess);
+        VectorMath::vsma(lower_values, 1, &tableInterpolationFactor, wave_values, 1, nonSilentFramesToProcess);
     }
-    
+
+    // scale, and offset by the bias; the falling sawtooth has always been offset by its amplitude
+    float constantOffset = biasShape.isConstant() ? biasShape.value : 0.f;
+    if (amplitude.isConstant())
+    {
+        if (amplitude.value != 1.f)
+            VectorMath::vsmul(wave_values, 1, &amplitude.value, wave_values, 1, nonSilentFramesToProcess);
+        if (type == OscillatorType::FALLING_SAWTOOTH)
+            constantOffset -= amplitude.value;
+    }
+    else
+    {
+        VectorMath::vmul(wave_values, 1, amplitudes + quantumFrameOffset, 1, wave_values, 1, nonSilentFramesToProcess);
+        if (type == OscillatorType::FALLING_SAWTOOTH)
+        {
+            const float minusOne = -1.f;
+            VectorMath::vsma(amplitudes + quantumFrameOffset, 1, &minusOne, wave_values, 1, nonSilentFramesToProcess);
+        }
+    }
+
+    if (!biasShape.isConstant())
+        VectorMath::vadd(wave_values, 1, bias + quantumFrameOffset, 1, wave_values, 1, nonSilentFramesToProcess);
+    if (constantOffset != 0.f)
+    {
+        for (int i = 0; i < nonSilentFramesToProcess; ++i)
+            wave_values[i] += constantOffset;
+    }
+
     outputBus->clearSilentFlag();
 }
 
 void OscillatorNode::process(ContextRenderLock & r, int bufferSize)
 {
-    OscillatorType type = static_cast<OscillatorType>(m_type->valueUint32());
-    if (type != OscillatorType::CUSTOM)
-    {
-        process_oscillator(r, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
-        return;
-    }
-
-    return;
+    process_oscillator(r, bufferSize, _self->_scheduler._renderOffset, _self->_scheduler._renderLength);
 }
 
 bool OscillatorNode::propagatesSilence(ContextRenderLock & r) const
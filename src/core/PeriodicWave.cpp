@@ -14,6 +14,9 @@
 #include <cmath>
 #include <exception>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
 
 // The number of bands per octave.  Each octave will have this many entries in the wave tables.
 const unsigned kNumberOfOctaveBands = 3;
@@ -44,7 +47,8 @@ PeriodicWave::PeriodicWave(const float sampleRate, OscillatorType basicWaveform)
     generateBasicWaveform(basicWaveform);
 }
 
-PeriodicWave::PeriodicWave(const float sampleRate, OscillatorType basicWaveform, std::vector<float> & real, std::vector<float> & imag)
+PeriodicWave::PeriodicWave(const float sampleRate, OscillatorType basicWaveform, std::vector<float> & real, std::vector<float> & imag,
+                           bool disableNormalization)
     : m_centsPerRange(CentsPerRange)
     , m_sampleRate(sampleRate)
 {
@@ -60,7 +64,7 @@ PeriodicWave::PeriodicWave(const float sampleRate, OscillatorType basicWaveform,
 
     if (isGood)
     {
-        createBandLimitedTables(&real[0], &imag[0], static_cast<int>(real.size()));
+        createBandLimitedTables(&real[0], &imag[0], static_cast<int>(real.size()), !disableNormalization);
     }
     else
     {
@@ -72,6 +76,34 @@ PeriodicWave::~PeriodicWave()
 {
 }
 
+std::shared_ptr<PeriodicWave> PeriodicWave::sharedBasicWaveform(float sampleRate, OscillatorType basicWaveform)
+{
+    static std::mutex cacheMutex;
+    static std::map<std::pair<float, int>, std::shared_ptr<PeriodicWave>> cache;
+
+    if (basicWaveform == OscillatorType::FAST_SINE)
+        basicWaveform = OscillatorType::SINE;
+    else if (basicWaveform == OscillatorType::FALLING_SAWTOOTH)
+        basicWaveform = OscillatorType::SAWTOOTH;
+
+    if (sampleRate <= 0.f || basicWaveform == OscillatorType::OSCILLATOR_NONE || basicWaveform >= OscillatorType::CUSTOM)
+        return {};
+
+    const auto key = std::make_pair(sampleRate, static_cast<int>(basicWaveform));
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(key);
+        if (it != cache.end())
+            return it->second;
+    }
+
+    // built outside the lock, so a lookup of tables already built never waits on a build;
+    // if another thread built the same tables meanwhile, theirs are kept
+    std::shared_ptr<PeriodicWave> wave = std::make_shared<PeriodicWave>(sampleRate, basicWaveform);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cache.emplace(key, wave).first->second;
+}
+
 unsigned PeriodicWave::periodicWaveSize() const
 {
     // Choose an appropriate wave size for the given sample rate.  This allows us to use shorter
@@ -134,7 +166,7 @@ int PeriodicWave::numberOfPartialsForRange(int rangeIndex) const
 // Convert into time-domain wave tables.
 // One table is created for each range for non-aliasing playback at different playback rates.
 // Thus, higher ranges have more high-frequency partials culled out.
-void PeriodicWave::createBandLimitedTables(const float * realData, const float * imagData, int numberOfComponents)
+void PeriodicWave::createBandLimitedTables(const float * realData, const float * imagData, int numberOfComponents, bool normalize)
 {
     float normalizationScale = 1.f;
 
@@ -177,15 +209,15 @@ void PeriodicWave::createBandLimitedTables(const float * realData, const float *
         realP[0] = 0;
         imagP[0] = 0;
 
-        // Create the band-limited table.
-        m_bandLimitedTables.push_back(std::unique_ptr<lab::AudioFloatArray>(new lab::AudioFloatArray(periodicWaveSize())));
+        // Create the band-limited table, with room for the copy of its first point.
+        m_bandLimitedTables.push_back(std::unique_ptr<lab::AudioFloatArray>(new lab::AudioFloatArray(fftSize + 1)));
 
         // Apply an inverse FFT to generate the time-domain table data.
         float * data = m_bandLimitedTables[rangeIndex]->data();
         frame.computeInverseFFT(data);
 
         // For the first range (which has the highest power), calculate its peak value then compute normalization scale.
-        if (!rangeIndex)
+        if (!rangeIndex && normalize)
         {
             float maxValue;
             vmaxmgv(data, 1, &maxValue, fftSize);
@@ -193,9 +225,26 @@ void PeriodicWave::createBandLimitedTables(const float * realData, const float *
             if (maxValue)
                 normalizationScale = 1.0f / maxValue;
         }
+        else if (!rangeIndex)
+        {
+            // Scale the table so that its power is the power of the partials it contains;
+            // this undoes whatever scaling the inverse FFT applies.
+            float expectedPower = 0;
+            int lastPartial = std::min(std::min(numberOfComponents, numberOfPartials + 1), fftSize / 2);
+            for (i = 1; i < lastPartial; ++i)
+                expectedPower += 0.5f * (realData[i] * realData[i] + imagData[i] * imagData[i]);
+
+            float power;
+            vsvesq(data, 1, &power, fftSize);
+            power /= fftSize;
+
+            if (power > 0)
+                normalizationScale = sqrtf(expectedPower / power);
+        }
 
         // Apply normalization scale.
         vsmul(data, 1, &normalizationScale, data, 1, fftSize);
+        data[fftSize] = data[0];
     }
 }
 
@@ -217,21 +266,24 @@ void PeriodicWave::generateBasicWaveform(OscillatorType shape)
     {
         float piFactor = 2 / (n * static_cast<float>(LAB_PI));
 
-        // All waveforms are odd functions with a positive slope at time 0. Hence the coefficients
-        // for cos() are always 0.
+        // The waveforms match the shapes OscillatorNode has always produced. Square and sawtooth
+        // are odd functions, so only their coefficients for sin() are non-zero; triangle is even,
+        // so only its coefficients for cos() are.
 
         // Fourier coefficients according to standard definition:
+        // a = 1/pi*integrate(f(x)*cos(n*x), x, -pi, pi)
         // b = 1/pi*integrate(f(x)*sin(n*x), x, -pi, pi)
-        //   = 2/pi*integrate(f(x)*sin(n*x), x, 0, pi)
-        // since f(x) is an odd function.
 
-        float b;  // Coefficient for sin().
+        float a = 0;  // Coefficient for cos().
+        float b = 0;  // Coefficient for sin().
 
-        // Calculate Fourier coefficients depending on the shape. Note that the overall scaling
-        // (magnitude) of the waveforms is normalized in createBandLimitedTables().
+        // Calculate Fourier coefficients depending on the shape. The coefficients are the amplitudes
+        // of the partials; the basic waveforms are not normalized, so that an amplitude of one gives
+        // the same level as the naive waveform would.
         switch (shape)
         {
             case OscillatorType::SINE:
+            case OscillatorType::FAST_SINE:
                 // Standard sine wave function.
                 b = (n == 1) ? 1.f : 0;
                 break;
@@ -247,42 +299,33 @@ void PeriodicWave::generateBasicWaveform(OscillatorType shape)
                 b = (n & 1) ? 2 * piFactor : 0;
                 break;
             case OscillatorType::SAWTOOTH:
-                // Sawtooth-shaped waveform with the first half ramping from zero to maximum and the
-                // second half from minimum to zero.
+            case OscillatorType::FALLING_SAWTOOTH:
+                // Sawtooth-shaped waveform falling from maximum at time 0 to minimum at time 2*pi,
+                // f(x) = 1 - x/pi on [0, 2*pi).
                 //
-                // b[n] = -2*(-1)^n/pi/n
-                //      = (2/(n*pi))*(-1)^(n+1)
-                b = piFactor * ((n & 1) ? 1 : -1);
+                // b[n] = 2/(n*pi)
+                b = piFactor;
                 break;
             case OscillatorType::TRIANGLE:
-                // Triangle-shaped waveform going from 0 at time 0 to 1 at time pi/2 and back to 0 at
-                // time pi.
+                // Triangle-shaped waveform going from minimum at time 0 to maximum at time pi and
+                // back to minimum at time 2*pi.
                 //
                 // See http://mathworld.wolfram.com/FourierSeriesTriangleWave.html
                 //
-                // b[n] = 8*sin(pi*k/2)/(pi*k)^2
-                //      = 8/pi^2/n^2*(-1)^((n-1)/2) for n odd and 0 otherwise
-                //      = 2*(2/(n*pi))^2 * (-1)^((n-1)/2)
-                if (n & 1)
-                {
-                    b = 2 * (piFactor * piFactor) * ((((n - 1) >> 1) & 1) ? -1 : 1);
-                }
-                else
-                {
-                    b = 0;
-                }
+                // a[n] = -8/pi^2/n^2 for n odd and 0 otherwise
+                //      = -2*(2/(n*pi))^2
+                a = (n & 1) ? -2 * (piFactor * piFactor) : 0;
                 break;
             default:
                 ASSERT_NOT_REACHED();
-                b = 0;
                 break;
         }
 
-        realP[n] = 0;
+        realP[n] = a;
         imagP[n] = b;
     }
 
-    createBandLimitedTables(realP, imagP, halfSize);
+    createBandLimitedTables(realP, imagP, halfSize, false);
 }
 
 }  // namespace lab
@@ -16,8 +16,13 @@
 #include "internal/FFTFrame.h"
 
 #include <algorithm>
+#include <chrono>
 #include <complex>
+#include <condition_variable>
+#include <cstring>
 #include <limits.h>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
@@ -32,44 +37,151 @@ const double RealtimeAnalyser::DefaultMaxDecibels = -30;
 const int RealtimeAnalyser::DefaultFFTSize = 2048;
 const int RealtimeAnalyser::MinFFTSize = 32;
 const int RealtimeAnalyser::MaxFFTSize = 2048;
-const int RealtimeAnalyser::InputBufferSize = RealtimeAnalyser::MaxFFTSize * 2;
+
+// Room for the worker to copy the latest MaxFFTSize frames while the audio thread writes up to
+// another MaxFFTSize frames, with as much again to spare; a power of two, so frames wrap with a mask.
+const int RealtimeAnalyser::InputBufferSize = RealtimeAnalyser::MaxFFTSize * 4;
+
+namespace
+{
+    const int FFTSizeCount = 7;  // MinFFTSize through MaxFFTSize
+    const std::chrono::microseconds AnalysisInterval {8333};  // 120 Hz
+
+    int sizeIndex(int fftSize)
+    {
+        int index = 0;
+        while ((RealtimeAnalyser::MinFFTSize << index) < fftSize)
+            ++index;
+        return index;
+    }
+}
+
+// AnalysisWorker runs the analyses of every RealtimeAnalyser on one thread,
+// and keeps the FFTs, windows and scratch space they share.
+class AnalysisWorker
+{
+public:
+    // The worker is never destroyed, so that analysers destroyed during static
+    // destruction can still unregister.
+    static AnalysisWorker & instance()
+    {
+        static AnalysisWorker * worker = new AnalysisWorker();
+        return *worker;
+    }
+
+    void add(RealtimeAnalyser * analyser)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_analysers.push_back(analyser);
+        if (!m_thread.joinable())
+            m_thread = std::thread(&AnalysisWorker::run, this);
+        m_wake.notify_one();
+    }
+
+    // Once this returns, the analyser will not be analysed again.
+    void remove(RealtimeAnalyser * analyser)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_analysers.erase(std::remove(m_analysers.begin(), m_analysers.end(), analyser), m_analysers.end());
+    }
+
+    FFTFrame & frame(int fftSize)
+    {
+        std::unique_ptr<FFTFrame> & frame = m_frames[sizeIndex(fftSize)];
+        if (!frame)
+            frame.reset(new FFTFrame(fftSize));
+        return *frame;
+    }
+
+    const float * window(int fftSize)
+    {
+        AudioFloatArray & window = m_windows[sizeIndex(fftSize)];
+        if (!window.size())
+        {
+            window.allocate(fftSize);
+            std::fill(window.data(), window.data() + fftSize, 1.f);
+            ApplyWindowFunctionInplace(WindowFunction::blackman, window.data(), fftSize);
+        }
+        return window.data();
+    }
+
+    float * input() { return m_input.data(); }
+    float * windowed() { return m_windowed.data(); }
+
+private:
+    AnalysisWorker()
+        : m_input(RealtimeAnalyser::MaxFFTSize)
+        , m_windowed(RealtimeAnalyser::MaxFFTSize)
+    {
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto next = std::chrono::steady_clock::now();
+        while (true)
+        {
+            if (m_analysers.empty())
+            {
+                m_wake.wait(lock);
+                next = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            for (RealtimeAnalyser * analyser : m_analysers)
+                analyser->analyse(*this);
+
+            next += AnalysisInterval;
+            const auto now = std::chrono::steady_clock::now();
+            if (next < now)
+                next = now;
+            m_wake.wait_until(lock, next);
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<RealtimeAnalyser *> m_analysers;
+    std::thread m_thread;
+
+    std::unique_ptr<FFTFrame> m_frames[FFTSizeCount];
+    AudioFloatArray m_windows[FFTSizeCount];
+    AudioFloatArray m_input;
+    AudioFloatArray m_windowed;
+};
 
 RealtimeAnalyser::RealtimeAnalyser(int fftSize)
     : m_inputBuffer(InputBufferSize)
-    , m_writeIndex(0)
+    , m_fftSize(max(min(RoundNextPow2(fftSize), MaxFFTSize), MinFFTSize))
+    , m_magnitudeBuffer(MaxFFTSize / 2)
     , m_smoothingTimeConstant(DefaultSmoothingTimeConstant)
     , m_minDecibels(DefaultMinDecibels)
     , m_maxDecibels(DefaultMaxDecibels)
 {
-    uint32_t size = max(min(RoundNextPow2(fftSize), MaxFFTSize), MinFFTSize);
-    m_fftSize = size;
-
-    m_analysisFrame = std::unique_ptr<FFTFrame>(new FFTFrame(size));
-
-    // m_magnitudeBuffer has size = fftSize / 2 because it contains floats reduced from complex values in m_analysisFrame.
-    m_magnitudeBuffer.allocate(size / 2);
+    AnalysisWorker::instance().add(this);
 }
 
-RealtimeAnalyser::~RealtimeAnalyser() {}
+RealtimeAnalyser::~RealtimeAnalyser()
+{
+    AnalysisWorker::instance().remove(this);
+}
 
 void RealtimeAnalyser::reset()
 {
-    m_writeIndex = 0;
-    m_inputBuffer.zero();
-    m_magnitudeBuffer.zero();
+    // The worker may be copying the ring, so it isn't cleared here; the worker reads
+    // the frames written before this one as silence instead.
+    m_resetFrame.store(m_writeFrame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_resetRequested.store(true, std::memory_order_release);
 }
 
 void RealtimeAnalyser::setFftSize(int fftSize)
 {
-    m_writeIndex = 0;
-
-    int size = max(min(RoundNextPow2(fftSize), MaxFFTSize), MinFFTSize);
-    m_fftSize = size;
-
-    m_analysisFrame = std::unique_ptr<FFTFrame>(new FFTFrame(size));
+    m_fftSize.store(max(min(RoundNextPow2(fftSize), MaxFFTSize), MinFFTSize), std::memory_order_relaxed);
+}
 
-    m_inputBuffer.zero();
-    m_magnitudeBuffer.allocate(size / 2);
+std::shared_ptr<const AnalyserSnapshot> RealtimeAnalyser::snapshot() const
+{
+    return std::atomic_load(&m_snapshot);
 }
 
 void RealtimeAnalyser::writeInput(ContextRenderLock & r, AudioBus * bus, int framesToProcess)
@@ -78,87 +190,114 @@ void RealtimeAnalyser::writeInput(ContextRenderLock & r, AudioBus * bus, int fra
     if (!isBusGood)
         return;
 
-    // FIXME : allow to work with non-FFTSize divisible chunking
-    bool isDestinationGood = m_writeIndex < m_inputBuffer.size() && m_writeIndex + framesToProcess <= m_inputBuffer.size();
-    ASSERT(isDestinationGood);
-    if (!isDestinationGood)
-        return;
-
-    // copy data for analysis
-    const float * source = bus->channel(0)->data();
-    float * dest = m_inputBuffer.data() + m_writeIndex;
+    const uint64_t written = m_writeFrame.load(std::memory_order_relaxed);
 
-    // The source has already been sanity checked with isBusGood above.
-    memcpy(dest, source, sizeof(float) * framesToProcess);
+    // only the latest frames fit in the ring
+    const int skipped = max(0, framesToProcess - InputBufferSize);
+    const int numberOfChannels = bus->numberOfChannels();
+    const float scale = 1.f / numberOfChannels;
 
-    // Sum all channels in one if numberOfChannels > 1.
-    const size_t numberOfChannels = bus->numberOfChannels();
-    if (numberOfChannels > 1)
+    for (int done = skipped; done < framesToProcess;)
     {
-        for (int i = 1; i < numberOfChannels; i++)
+        const int position = static_cast<int>((written + done) & (InputBufferSize - 1));
+        const int frames = min(framesToProcess - done, InputBufferSize - position);
+        float * dest = m_inputBuffer.data() + position;
+
+        // copy data for analysis, summing all channels into one
+        memcpy(dest, bus->channel(0)->data() + done, sizeof(float) * frames);
+        if (numberOfChannels > 1)
         {
-            source = bus->channel(i)->data();
-            VectorMath::vadd(dest, 1, source, 1, dest, 1, framesToProcess);
+            for (int i = 1; i < numberOfChannels; i++)
+                VectorMath::vadd(dest, 1, bus->channel(i)->data() + done, 1, dest, 1, frames);
+            VectorMath::vsmul(dest, 1, &scale, dest, 1, frames);
         }
-        const float scale = 1.f / numberOfChannels;
-        VectorMath::vsmul(dest, 1, &scale, dest, 1, framesToProcess);
+        done += frames;
     }
 
-    m_writeIndex += framesToProcess;
-    if (m_writeIndex >= InputBufferSize)
-        m_writeIndex = 0;
+    m_writeFrame.store(written + framesToProcess, std::memory_order_release);
 }
 
-void RealtimeAnalyser::doFFTAnalysis()
+void RealtimeAnalyser::analyse(AnalysisWorker & worker)
 {
-    // Unroll the input buffer into a temporary buffer, where we'll apply an analysis window followed by an FFT.
-    uint32_t fftSize = this->fftSize();
-
-    AudioFloatArray temporaryBuffer(fftSize);
-    float * inputBuffer = m_inputBuffer.data();
-    float * tempP = temporaryBuffer.data();
+    const bool resetRequested = m_resetRequested.exchange(false, std::memory_order_acquire);
+    const uint64_t written = m_writeFrame.load(std::memory_order_acquire);
+    const int fftSize = this->fftSize();
+    if (!resetRequested && written == m_analysedFrame && fftSize == m_analysedSize)
+        return;
 
-    // Take the previous fftSize values from the input buffer and copy into the temporary buffer.
-    size_t writeIndex = m_writeIndex;
-    if (writeIndex < fftSize)
-    {
-        memcpy(tempP, inputBuffer + writeIndex - fftSize + InputBufferSize, sizeof(*tempP) * (fftSize - writeIndex));
-        memcpy(tempP + fftSize - writeIndex, inputBuffer, sizeof(*tempP) * writeIndex);
-    }
-    else
-    {
-        memcpy(tempP, inputBuffer + writeIndex - fftSize, sizeof(*tempP) * fftSize);
-    }
+    if (resetRequested)
+        m_silentBefore = m_resetFrame.load(std::memory_order_relaxed);
+    if (resetRequested || fftSize != m_analysedSize)
+        m_magnitudeBuffer.zero();
+
+    // Take the previous fftSize values from the input buffer, unrolled. Frame numbers
+    // before the first frame wrap, and read the silence the ring starts with; frames
+    // before the last reset are silent.
+    float * input = worker.input();
+    const uint64_t first = written - fftSize;
+    const int position = static_cast<int>(first & (InputBufferSize - 1));
+    const int head = min(fftSize, InputBufferSize - position);
+    memcpy(input, m_inputBuffer.data() + position, sizeof(float) * head);
+    memcpy(input + head, m_inputBuffer.data(), sizeof(float) * (fftSize - head));
+
+    const int64_t silent = static_cast<int64_t>(m_silentBefore) - (static_cast<int64_t>(written) - fftSize);
+    if (silent > 0)
+        memset(input, 0, sizeof(float) * static_cast<size_t>(min<int64_t>(silent, fftSize)));
+
+    // If the audio thread has since come close enough to have overwritten the oldest
+    // frames, the copy may be torn; the next analysis will see the newer input.
+    const uint64_t writtenAfter = m_writeFrame.load(std::memory_order_acquire);
+    if (writtenAfter - first + MaxFFTSize > static_cast<uint64_t>(InputBufferSize))
+        return;
 
-    // Window the input samples.
-    ApplyWindowFunctionInplace(WindowFunction::blackman, tempP, fftSize);
+    // Window the input samples, and do the analysis.
+    float * windowed = worker.windowed();
+    VectorMath::vmul(input, 1, worker.window(fftSize), 1, windowed, 1, fftSize);
 
-    // Do the analysis.
-    m_analysisFrame->computeForwardFFT(tempP);
+    FFTFrame & frame = worker.frame(fftSize);
+    frame.computeForwardFFT(windowed);
 
-    float * realP = m_analysisFrame->realData();
-    float * imagP = m_analysisFrame->imagData();
+    float * realP = frame.realData();
+    float * imagP = frame.imagData();
 
     // Erase the packed nyquist component.
     imagP[0] = 0;
 
     // Normalize so than an input sine wave at 0dBfs registers as 0dBfs (undo FFT scaling factor).
-    const double magnitudeScale = 1.0 / DefaultFFTSize;
+    const float magnitudeScale = 1.f / DefaultFFTSize;
 
     // A value of 0 does no averaging with the previous result.  Larger values produce slower, but smoother changes.
-    double k = m_smoothingTimeConstant;
-    k = max(0.0, k);
-    k = min(1.0, k);
+    const float k = static_cast<float>(max(0.0, min(1.0, smoothingTimeConstant())));
 
     // Convert the analysis data from complex to magnitude and average with the previous result.
-    float * destination = magnitudeBuffer().data();
-    size_t n = magnitudeBuffer().size();
-    for (size_t i = 0; i < n; ++i)
+    float * destination = m_magnitudeBuffer.data();
+    const int n = fftSize / 2;
+    for (int i = 0; i < n; ++i)
     {
-        std::complex<double> c(realP[i], imagP[i]);
-        double scalarMagnitude = abs(c) * magnitudeScale;
-        destination[i] = float(k * destination[i] + (1 - k) * scalarMagnitude);
+        const float scalarMagnitude = std::sqrt(realP[i] * realP[i] + imagP[i] * imagP[i]) * magnitudeScale;
+        destination[i] = k * destination[i] + (1 - k) * scalarMagnitude;
     }
+
+    // Publish into a snapshot that no reader holds any more, or else a new one. use_count
+    // is a relaxed load, so the fence orders the last reader's reads before the refill.
+    std::shared_ptr<AnalyserSnapshot> next;
+    if (m_spare && m_spare.use_count() == 1)
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next = std::move(m_spare);
+    }
+    else
+        next = std::make_shared<AnalyserSnapshot>();
+    next->frame = written;
+    next->fftSize = fftSize;
+    next->magnitudes.assign(destination, destination + n);
+    next->timeDomain.assign(input, input + fftSize);
+    std::atomic_store(&m_snapshot, std::shared_ptr<const AnalyserSnapshot>(next));
+
+    m_spare = std::move(m_current);
+    m_current = std::move(next);
+    m_analysedFrame = written;
+    m_analysedSize = fftSize;
 }
 
 void RealtimeAnalyser::getFloatFrequencyData(std::vector<float> & destinationArray)
@@ -166,54 +305,50 @@ void RealtimeAnalyser::getFloatFrequencyData(std::vector<float> & destinationArr
     if (!destinationArray.size())
         return;
 
-    doFFTAnalysis();
+    std::shared_ptr<const AnalyserSnapshot> analysis = snapshot();
 
     // Convert from linear magnitude to floating-point decibels.
     const double minDecibels = m_minDecibels;
-    size_t sourceLength = magnitudeBuffer().size();
+    size_t sourceLength = analysis ? analysis->magnitudes.size() : frequencyBinCount();
     size_t len = min(sourceLength, destinationArray.size());
-    if (len > 0)
+    for (size_t i = 0; i < len; ++i)
     {
-        const float * source = magnitudeBuffer().data();
-        for (size_t i = 0; i < len; ++i)
-        {
-            float linearValue = source[i];
-            double dbMag = !linearValue ? minDecibels : AudioUtilities::linearToDecibels(linearValue);
-            destinationArray[i] = float(dbMag);
-        }
+        float linearValue = analysis ? analysis->magnitudes[i] : 0.f;
+        double dbMag = !linearValue ? minDecibels : AudioUtilities::linearToDecibels(linearValue);
+        destinationArray[i] = float(dbMag);
     }
 }
 
 void RealtimeAnalyser::getByteFrequencyData(std::vector<uint8_t> & destinationArray, bool resample)
 {
-    if (!destinationArray.size() || !magnitudeBuffer().size())
+    if (!destinationArray.size())
         return;
 
-    doFFTAnalysis();
+    std::shared_ptr<const AnalyserSnapshot> analysis = snapshot();
+    size_t src_size = analysis ? analysis->magnitudes.size() : frequencyBinCount();
 
-    size_t len = destinationArray.size();
+    size_t len = min(src_size, destinationArray.size());
     uint8_t * dest = &destinationArray[0];
     std::vector<uint8_t> result;
-    if (destinationArray.size() == frequencyBinCount())
+    if (destinationArray.size() == src_size)
         resample = false;
     else
     {
         if (resample) {
-            len = frequencyBinCount();
+            len = src_size;
             result.resize(len);
             dest = &result[0];
         }
     }
 
     // Convert from linear magnitude to unsigned-byte decibels.
-    size_t sourceLength = magnitudeBuffer().size();
-    const double rangeScaleFactor = m_maxDecibels == m_minDecibels ? 1 : 1 / (m_maxDecibels - m_minDecibels);
     const double minDecibels = m_minDecibels;
+    const double maxDecibels = m_maxDecibels;
+    const double rangeScaleFactor = maxDecibels == minDecibels ? 1 : 1 / (maxDecibels - minDecibels);
 
-    const float * source = magnitudeBuffer().data();
     for (size_t i = 0; i < len; ++i)
     {
-        float linearValue = source[i];
+        float linearValue = analysis ? analysis->magnitudes[i] : 0.f;
         double dbMag = !linearValue ? minDecibels : AudioUtilities::linearToDecibels(linearValue);
 
         // The range m_minDecibels to m_maxDecibels will be scaled to byte values from 0 to UCHAR_MAX.
@@ -233,7 +368,6 @@ void RealtimeAnalyser::getByteFrequencyData(std::vector<uint8_t> & destinationAr
     uint8_t * normalized_data = dest;
     dest = &destinationArray[0];
 
-    size_t src_size = frequencyBinCount();
     size_t dst_size = destinationArray.size();
 
     if (dst_size > src_size)
@@ -245,9 +379,10 @@ void RealtimeAnalyser::getByteFrequencyData(std::vector<uint8_t> & destinationAr
         for (size_t step = 0; step < steps; ++step, u += u_step)
         {
             float t = u * src_size;
-            size_t u0 = static_cast<size_t>(t);
+            size_t u0 = min(static_cast<size_t>(t), src_size - 1);
+            size_t u1 = min(u0 + 1, src_size - 1);
             t = t - static_cast<float>(u0);
-            dest[step] = static_cast<uint8_t>(normalized_data[u0] * t + normalized_data[u0 + 1] * (1.f - t));
+            dest[step] = static_cast<uint8_t>(normalized_data[u0] * t + normalized_data[u1] * (1.f - t));
         }
     }
     else
@@ -280,22 +415,11 @@ void RealtimeAnalyser::getFloatTimeDomainData(std::vector<float> & destinationAr
     if (!destinationArray.size())
         return;
 
-    size_t fftSize = this->fftSize();
+    std::shared_ptr<const AnalyserSnapshot> analysis = snapshot();
+    size_t fftSize = analysis ? analysis->timeDomain.size() : this->fftSize();
     size_t len = min(fftSize, destinationArray.size());
-    if (len > 0)
-    {
-        bool isInputBufferGood = m_inputBuffer.size() == InputBufferSize && m_inputBuffer.size() > fftSize;
-        ASSERT(isInputBufferGood);
-        if (!isInputBufferGood)
-            return;
-
-        float * inputBuffer = m_inputBuffer.data();
-        size_t writeIndex = m_writeIndex;
-
-        for (size_t i = 0; i < len; ++i)
-            // Buffer access is protected due to modulo operation.
-            destinationArray[i] = inputBuffer[(i + writeIndex - fftSize + InputBufferSize) % InputBufferSize];
-    }
+    for (size_t i = 0; i < len; ++i)
+        destinationArray[i] = analysis ? analysis->timeDomain[i] : 0.f;
 }
 // LabSound end
 
@@ -304,34 +428,23 @@ void RealtimeAnalyser::getByteTimeDomainData(std::vector<uint8_t> & destinationA
     if (!destinationArray.size())
         return;
 
-    size_t fftSize = this->fftSize();
+    std::shared_ptr<const AnalyserSnapshot> analysis = snapshot();
+    size_t fftSize = analysis ? analysis->timeDomain.size() : this->fftSize();
     size_t len = min(fftSize, destinationArray.size());
-    if (len > 0)
+    for (size_t i = 0; i < len; ++i)
     {
-        bool isInputBufferGood = m_inputBuffer.size() == InputBufferSize && m_inputBuffer.size() > fftSize;
-        ASSERT(isInputBufferGood);
-        if (!isInputBufferGood)
-            return;
-
-        float * inputBuffer = m_inputBuffer.data();
-        size_t writeIndex = m_writeIndex;
+        float value = analysis ? analysis->timeDomain[i] : 0.f;
 
-        for (size_t i = 0; i < len; ++i)
-        {
-            // Buffer access is protected due to modulo operation.
-            float value = inputBuffer[(i + writeIndex - fftSize + InputBufferSize) % InputBufferSize];
+        // Scale from nominal -1 -> +1 to unsigned byte.
+        double scaledValue = AudioNode::ProcessingSizeInFrames * (value + 1);
 
-            // Scale from nominal -1 -> +1 to unsigned byte.
-            double scaledValue = AudioNode::ProcessingSizeInFrames * (value + 1);
-
-            // Clip to valid range.
-            if (scaledValue < 0)
-                scaledValue = 0;
-            if (scaledValue > UCHAR_MAX)
-                scaledValue = UCHAR_MAX;
+        // Clip to valid range.
+        if (scaledValue < 0)
+            scaledValue = 0;
+        if (scaledValue > UCHAR_MAX)
+            scaledValue = UCHAR_MAX;
 
-            destinationArray[i] = static_cast<unsigned char>(scaledValue);
-        }
+        destinationArray[i] = static_cast<unsigned char>(scaledValue);
     }
 }
 
@@ -11,6 +11,7 @@
 #include "LabSound/core/Mixing.h"
 #include "LabSound/core/SampledAudioNode.h"
 #include "LabSound/extended/Util.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/Registry.h"
@@ -42,113 +43,66 @@ public:
     {
     }
 
-    // Handle sample-accurate panning by AudioParam automation.
-    virtual void panWithSampleAccurateValues(const AudioBus * inputBus, AudioBus * outputBus, const float * panValues, int framesToProcess)
+    // Handle sample-accurate panning by AudioParam automation. A pan that is
+    // constant across the block, as automation usually is between its events,
+    // is applied with scalar gains, and a linear ramp steps its gains by a
+    // rotation rather than evaluating cos and sin on every frame.
+    virtual void panWithSampleAccurateValues(const AudioBus * inputBus, AudioBus * outputBus, const float * panValues, AudioParamShape shape, int framesToProcess)
     {
-        size_t numberOfInputChannels = inputBus->numberOfChannels();
-
-        bool isInputSafe = inputBus && (inputBus->numberOfChannels() == Channels::Mono || 
-            inputBus->numberOfChannels() == Channels::Stereo) && framesToProcess <= inputBus->length();
-
-        ASSERT(isInputSafe);
-
-        if (!isInputSafe)
-            return;
-
-        bool isOutputSafe = outputBus && outputBus->numberOfChannels() == Channels::Stereo && framesToProcess <= outputBus->length();
-
-        ASSERT(isOutputSafe);
-
-        if (!isOutputSafe)
+        PanBusses c;
+        if (!busses(inputBus, outputBus, framesToProcess, c))
             return;
 
-        const float * sourceL = inputBus->channel(0)->data();
-        const float * sourceR = numberOfInputChannels > Channels::Mono ? inputBus->channel(1)->data() : sourceL;
-
-        float * destinationL = outputBus->channelByType(Channel::Left)->mutableData();
-        float * destinationR = outputBus->channelByType(Channel::Right)->mutableData();
-
-        if (!sourceL || !sourceR || !destinationL || !destinationR)
+        if (shape.isConstant())
+        {
+            m_pan = clampTo(shape.value, -1.0, 1.0);
+            const double panRadian = angle(m_pan, c.mono);
+            const PanGains g = gains(std::cos(panRadian), std::sin(panRadian), m_pan, c.mono);
+            mixBlock(c, g, framesToProcess);
             return;
+        }
 
-        double gainL, gainR, panRadian;
-        size_t n = framesToProcess;
-
-        // For mono source case.
-        if (numberOfInputChannels == Channels::Mono)
+        if (shape.kind == AudioParamShape::Linear)
         {
-            while (n--)
+            // The angle follows the pan linearly as long as the pan isn't clamped and,
+            // for stereo input, stays on one side of the center.
+            const double first = shape.value;
+            const double last = first + static_cast<double>(shape.slope) * (framesToProcess - 1);
+            if (first >= -1 && first <= 1 && last >= -1 && last <= 1 && (c.mono || (first <= 0) == (last <= 0)))
             {
-                float inputL = *sourceL++;
-
-                m_pan = clampTo(*panValues++, -1.0, 1.0);
-
-                // Pan from left to right [-1; 1] will be normalized as [0; 1].
-                panRadian = (m_pan * 0.5 + 0.5) * LAB_HALF_PI;
-
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
+                const double panRadian = angle(first, c.mono);
+                const double step = angle(first + shape.slope, c.mono) - panRadian;
+                const double stepCos = std::cos(step);
+                const double stepSin = std::sin(step);
+                double cosine = std::cos(panRadian);
+                double sine = std::sin(panRadian);
+
+                for (int i = 0; i < framesToProcess; ++i)
+                {
+                    mixFrame(c, gains(cosine, sine, first, c.mono), i);
 
-                *destinationL++ = static_cast<float>(inputL * gainL);
-                *destinationR++ = static_cast<float>(inputL * gainR);
+                    const double nextCosine = cosine * stepCos - sine * stepSin;
+                    sine = sine * stepCos + cosine * stepSin;
+                    cosine = nextCosine;
+                }
+                m_pan = last;
+                return;
             }
         }
-        // For stereo source case.
-        else
-        {
-            while (n--)
-            {
-                float inputL = *sourceL++;
-                float inputR = *sourceR++;
-
-                m_pan = clampTo(*panValues++, -1.0, 1.0);
 
-                // Normalize [-1; 0] to [0; 1]. Do nothing when [0; 1].
-                panRadian = (m_pan <= 0 ? m_pan + 1 : m_pan) * LAB_HALF_PI;
-
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
-
-                if (m_pan <= 0)
-                {
-                    *destinationL++ = static_cast<float>(inputL + inputR * gainL);
-                    *destinationR++ = static_cast<float>(inputR * gainR);
-                }
-                else
-                {
-                    *destinationL++ = static_cast<float>(inputL * gainL);
-                    *destinationR++ = static_cast<float>(inputR + inputL * gainR);
-                }
-            }
+        for (int i = 0; i < framesToProcess; ++i)
+        {
+            m_pan = clampTo(panValues[i], -1.0, 1.0);
+            const double panRadian = angle(m_pan, c.mono);
+            mixFrame(c, gains(std::cos(panRadian), std::sin(panRadian), m_pan, c.mono), i);
         }
     }
 
     // Handle de-zippered panning to a target value.
-    virtual void panToTargetValue(const AudioBus * inputBus, AudioBus * outputBus, float panValue, size_t framesToProcess)
+    virtual void panToTargetValue(const AudioBus * inputBus, AudioBus * outputBus, float panValue, int framesToProcess)
     {
-        size_t numberOfInputChannels = inputBus->numberOfChannels();
-
-        bool isInputSafe = inputBus && (inputBus->numberOfChannels() == Channels::Mono || inputBus->numberOfChannels() == Channels::Stereo) && framesToProcess <= inputBus->length();
-
-        ASSERT(isInputSafe);
-
-        if (!isInputSafe)
-            return;
-
-        bool isOutputSafe = outputBus && framesToProcess <= outputBus->length();
-
-        ASSERT(isOutputSafe);
-
-        if (!isOutputSafe)
-            return;
-
-        const float * sourceL = inputBus->channel(0)->data();
-        const float * sourceR = numberOfInputChannels > Channels::Mono ? inputBus->channel(1)->data() : sourceL;
-
-        float * destinationL = outputBus->channelByType(Channel::Left)->mutableData();
-        float * destinationR = outputBus->channelByType(Channel::Right)->mutableData();
-
-        if (!sourceL || !sourceR || !destinationL || !destinationR)
+        PanBusses c;
+        if (!busses(inputBus, outputBus, framesToProcess, c))
             return;
 
         float targetPan = clampTo(panValue, -1.f, 1.f);
@@ -160,76 +114,116 @@ public:
             m_pan = targetPan;
         }
 
-        double gainL, gainR, panRadian;
         const double smoothingConstant = m_smoothingConstant;
-        size_t n = framesToProcess;
-
-        // For mono source case.
-        if (numberOfInputChannels == Channels::Mono)
+        for (int i = 0; i < framesToProcess; ++i)
         {
-            while (n--)
-            {
-                float inputL = *sourceL++;
+            m_pan += (targetPan - m_pan) * smoothingConstant;
 
-                m_pan += (targetPan - m_pan) * smoothingConstant;
+            // The pan value should be checked every sample when de-zippering.
+            // See crbug.com/470559.
+            const double panRadian = angle(m_pan, c.mono);
+            mixFrame(c, gains(std::cos(panRadian), std::sin(panRadian), m_pan, c.mono), i);
+        }
+    }
 
-                // Pan from left to right [-1; 1] will be normalized as [0; 1].
-                panRadian = (m_pan * 0.5 + 0.5) * LAB_HALF_PI;
+    virtual void reset()
+    {
+        // No-op
+    }
 
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
+    virtual double tailTime(ContextRenderLock & r) const { return 0; }
+    virtual double latencyTime(ContextRenderLock & r) const { return 0; }
 
-                *destinationL++ = static_cast<float>(inputL * gainL);
-                *destinationR++ = static_cast<float>(inputL * gainR);
-            }
-        }
-        // For stereo source case.
-        else
-        {
-            while (n--)
-            {
-                float inputL = *sourceL++;
-                float inputR = *sourceR++;
+private:
+    struct PanBusses
+    {
+        const float * sourceL;
+        const float * sourceR;  // the left channel again, for mono input
+        float * destinationL;
+        float * destinationR;
+        bool mono;
+    };
 
-                m_pan += (targetPan - m_pan) * smoothingConstant;
+    // The contribution of each input channel to each output channel.
+    struct PanGains
+    {
+        double leftToLeft;
+        double rightToLeft;
+        double leftToRight;
+        double rightToRight;
+    };
 
-                // Normalize [-1; 0] to [0; 1] for the left pan position (<= 0), and
-                // do nothing when [0; 1].
+    static bool busses(const AudioBus * inputBus, AudioBus * outputBus, int framesToProcess, PanBusses & c)
+    {
+        bool isInputSafe = inputBus && (inputBus->numberOfChannels() == Channels::Mono ||
+            inputBus->numberOfChannels() == Channels::Stereo) && framesToProcess <= inputBus->length();
 
-                panRadian = (m_pan <= 0 ? m_pan + 1 : m_pan) * LAB_HALF_PI;
+        ASSERT(isInputSafe);
 
-                gainL = std::cos(panRadian);
-                gainR = std::sin(panRadian);
+        if (!isInputSafe)
+            return false;
 
-                // The pan value should be checked every sample when de-zippering.
-                // See crbug.com/470559.
-                if (m_pan <= 0)
-                {
-                    // When [-1; 0], keep left channel intact and equal-power pan the
-                    // right channel only.
-                    *destinationL++ = static_cast<float>(inputL + inputR * gainL);
-                    *destinationR++ = static_cast<float>(inputR * gainR);
-                }
-                else
-                {
-                    // When [0; 1], keep right channel intact and equal-power pan the
-                    // left channel only.
-                    *destinationL++ = static_cast<float>(inputL * gainL);
-                    *destinationR++ = static_cast<float>(inputR + inputL * gainR);
-                }
-            }
-        }
+        bool isOutputSafe = outputBus && outputBus->numberOfChannels() == Channels::Stereo && framesToProcess <= outputBus->length();
+
+        ASSERT(isOutputSafe);
+
+        if (!isOutputSafe)
+            return false;
+
+        c.mono = inputBus->numberOfChannels() == Channels::Mono;
+        c.sourceL = inputBus->channel(0)->data();
+        c.sourceR = c.mono ? c.sourceL : inputBus->channel(1)->data();
+        c.destinationL = outputBus->channelByType(Channel::Left)->mutableData();
+        c.destinationR = outputBus->channelByType(Channel::Right)->mutableData();
+
+        return c.sourceL && c.sourceR && c.destinationL && c.destinationR;
     }
 
-    virtual void reset()
+    static double angle(double pan, bool mono)
     {
-        // No-op
+        // For mono input, pan from left to right [-1; 1] will be normalized as [0; 1].
+        if (mono)
+            return (pan * 0.5 + 0.5) * LAB_HALF_PI;
+
+        // For stereo input, normalize [-1; 0] to [0; 1]. Do nothing when [0; 1].
+        return (pan <= 0 ? pan + 1 : pan) * LAB_HALF_PI;
     }
 
-    virtual double tailTime(ContextRenderLock & r) const { return 0; }
-    virtual double latencyTime(ContextRenderLock & r) const { return 0; }
+    static PanGains gains(double gainL, double gainR, double pan, bool mono)
+    {
+        if (mono)
+            return {gainL, 0, gainR, 0};
+
+        // When [-1; 0], keep left channel intact and equal-power pan the
+        // right channel only.
+        if (pan <= 0)
+            return {1, gainL, 0, gainR};
+
+        // When [0; 1], keep right channel intact and equal-power pan the
+        // left channel only.
+        return {gainL, 0, gainR, 1};
+    }
+
+    static void mixFrame(const PanBusses & c, const PanGains & g, int i)
+    {
+        c.destinationL[i] = static_cast<float>(c.sourceL[i] * g.leftToLeft + c.sourceR[i] * g.rightToLeft);
+        c.destinationR[i] = static_cast<float>(c.sourceL[i] * g.leftToRight + c.sourceR[i] * g.rightToRight);
+    }
+
+    static void mixBlock(const PanBusses & c, const PanGains & g, int framesToProcess)
+    {
+        const float gains[4] = {static_cast<float>(g.leftToLeft), static_cast<float>(g.rightToLeft),
+                                static_cast<float>(g.leftToRight), static_cast<float>(g.rightToRight)};
+
+        VectorMath::vsmul(c.sourceL, 1, &gains[0], c.destinationL, 1, framesToProcess);
+        if (gains[1] != 0.f)
+            VectorMath::vsma(c.sourceR, 1, &gains[1], c.destinationL, 1, framesToProcess);
+
+        VectorMath::vsmul(c.sourceL, 1, &gains[2], c.destinationR, 1, framesToProcess);
+        if (gains[3] != 0.f)
+            VectorMath::vsma(c.sourceR, 1, &gains[3], c.destinationR, 1, framesToProcess);
+    }
 
-private:
     bool m_isFirstRender = true;
     double m_pan = 0.0;
 
@@ -295,8 +289,8 @@ void StereoPannerNode::process(ContextRenderLock & r, int bufferSize)
         if (bufferSize <= m_sampleAccuratePanValues->size())
         {
             float * panValues = m_sampleAccuratePanValues->data();
-            m_pan->calculateSampleAccurateValues(r, panValues, bufferSize);
-            m_stereoPanner->panWithSampleAccurateValues(inputBus, outputBus, panValues, bufferSize);
+            AudioParamShape shape = m_pan->calculateSampleAccurateValues(r, panValues, bufferSize);
+            m_stereoPanner->panWithSampleAccurateValues(inputBus, outputBus, panValues, shape, bufferSize);
         }
     }
     else
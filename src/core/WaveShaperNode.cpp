@@ -6,34 +6,79 @@
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/extended/Registry.h"
+#include "LabSound/extended/VectorMath.h"
 #include "internal/Assertions.h"
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <vector>
-#include "internal/UpSampler.h" //ouch..how to hide internal from calling application?
-#include "internal/DownSampler.h"
+#include "internal/HalfBandFilter.h" //ouch..how to hide internal from calling application?
 
 namespace lab {
+
+// The points of a curve, followed by a copy of the last point, so that an
+// interpolated read at the end of the curve stays in the table.
+struct WaveShaperNode::Curve
+{
+    std::vector<float> points;
+    int length = 0;
+    Curve * next = nullptr;
+
+    static void freeList(Curve * curve)
+    {
+        while (curve)
+        {
+            Curve * next = curve->next;
+            delete curve;
+            curve = next;
+        }
+    }
+};
+
+namespace
+{
+    // The stage between the base rate and 2x passes everything up to 0.46 of the
+    // base rate. The stage between 2x and 4x only has to pass the base band, so its
+    // transition is wide and it needs fewer sections for the same rejection.
+    const int OuterStageCoefficients = 8;
+    const double OuterStageTransition = 0.04;
+    const int InnerStageCoefficients = 4;
+    const double InnerStageTransition = 0.25;
+}
+
+struct OverSamplingChannel
+{
+    HalfBandFilter m_upSampler {OuterStageCoefficients, OuterStageTransition};
+    HalfBandFilter m_downSampler {OuterStageCoefficients, OuterStageTransition};
+    HalfBandFilter m_upSampler2 {InnerStageCoefficients, InnerStageTransition};
+    HalfBandFilter m_downSampler2 {InnerStageCoefficients, InnerStageTransition};
+
+    void reset()
+    {
+        m_upSampler.reset();
+        m_downSampler.reset();
+        m_upSampler2.reset();
+        m_downSampler2.reset();
+    }
+};
+
 struct OverSamplingArrays
 {
-    std::shared_ptr<AudioFloatArray> m_tempBuffer;
-    std::shared_ptr<AudioFloatArray> m_tempBuffer2;
-    std::shared_ptr<UpSampler> m_upSampler;
-    std::shared_ptr<DownSampler> m_downSampler;
-    std::shared_ptr<UpSampler> m_upSampler2;
-    std::shared_ptr<DownSampler> m_downSampler2;
+    AudioFloatArray m_tempBuffer;
+    AudioFloatArray m_tempBuffer2;
+    std::vector<std::unique_ptr<OverSamplingChannel>> m_channels;
 };
 
 static void* createOversamplingArrays()
 {
     struct OverSamplingArrays * osa = new struct OverSamplingArrays;
-    int renderQuantumSize = 128;  // from https://www.w3.org/TR/webaudio/#render-quantum-size
-    osa->m_tempBuffer = std::make_shared<AudioFloatArray>(renderQuantumSize * 2);
-    osa->m_tempBuffer2 = std::make_shared<AudioFloatArray>(renderQuantumSize * 4);
-    osa->m_upSampler = std::make_shared<UpSampler>(renderQuantumSize);
-    osa->m_downSampler = std::make_shared<DownSampler>(renderQuantumSize * 2);
-    osa->m_upSampler2 = std::make_shared<UpSampler>(renderQuantumSize * 2);
-    osa->m_downSampler2 = std::make_shared<DownSampler>(renderQuantumSize * 4);
+    int renderQuantumSize = AudioNode::ProcessingSizeInFrames;
+    osa->m_tempBuffer.allocate(renderQuantumSize * 2);
+    osa->m_tempBuffer2.allocate(renderQuantumSize * 4);
+
+    // Each channel has its own resampler state.
+    for (int i = 0; i < AudioBus::MaxChannels; ++i)
+        osa->m_channels.emplace_back(new OverSamplingChannel);
     return (void *) osa;
 }
 
@@ -42,16 +87,18 @@ AudioNodeDescriptor * WaveShaperNode::desc()
     static AudioNodeDescriptor d {nullptr, nullptr, 1};
     return &d;
 }
-    
+
 WaveShaperNode::WaveShaperNode(AudioContext& ac)
 : AudioNode(ac, *desc())
+, m_positions(AudioNode::ProcessingSizeInFrames * 4)
 {
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
     initialize();
 }
-    
+
 WaveShaperNode::WaveShaperNode(AudioContext & ac, AudioNodeDescriptor const & desc)
 : AudioNode(ac, desc)
+, m_positions(AudioNode::ProcessingSizeInFrames * 4)
 {
     addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
     initialize();
@@ -59,96 +106,110 @@ WaveShaperNode::WaveShaperNode(AudioContext & ac, AudioNodeDescriptor const & de
 
 WaveShaperNode::~WaveShaperNode()
 {
-    delete (OverSamplingArrays*) m_oversamplingArrays;
+    delete (OverSamplingArrays*) m_oversamplingArrays.load();
+    delete m_curve;
+    delete m_pendingCurve.exchange(nullptr);
+    Curve::freeList(m_retiredCurves.exchange(nullptr));
+}
+
+void WaveShaperNode::setOversample(OverSampleType oversample)
+{
+    // the arrays are published before the type that reads them
+    if (oversample != OverSampleType::NONE && !m_oversamplingArrays.load(std::memory_order_acquire))
+    {
+        void * osa = createOversamplingArrays();
+        void * expected = nullptr;
+        if (!m_oversamplingArrays.compare_exchange_strong(expected, osa, std::memory_order_acq_rel))
+            delete (OverSamplingArrays *) osa;
+    }
+    m_oversample = oversample;
 }
 
 void WaveShaperNode::setCurve(std::vector<float> & curve)
 {
-    std::lock_guard<std::mutex> lock(_curveMutex);
-    m_newCurve = curve;
-    _newCurveReady = 1;
+    Curve * newCurve = new Curve;
+    newCurve->length = static_cast<int>(curve.size());
+    newCurve->points.resize(curve.size() + 1);
+    std::copy(curve.begin(), curve.end(), newCurve->points.begin());
+    newCurve->points.back() = curve.size() ? curve.back() : 0.f;
+
+    // Curves the audio thread has finished with are freed here, rather than on the audio thread.
+    Curve::freeList(m_retiredCurves.exchange(nullptr, std::memory_order_acquire));
+
+    // A curve that was published but not yet taken by the audio thread is replaced.
+    delete m_pendingCurve.exchange(newCurve, std::memory_order_acq_rel);
 }
 
 void WaveShaperNode::processCurve(const float* source, float* destination, int framesToProcess)
 {
-    float const* curveData = m_curve.data();
-    int curveLength = static_cast<int>(m_curve.size());
-
-    ASSERT(curveData);
+    const Curve * curve = m_curve;
 
-    if (!curveData || !curveLength)
+    if (!curve || !curve->length)
     {
         memcpy(destination, source, sizeof(float) * framesToProcess);
         return;
     }
 
-    // Apply waveshaping curve.
-    for (int i = 0; i < framesToProcess; ++i)
-    {
-        const float input = source[i];
+    ASSERT(framesToProcess <= m_positions.size());
 
-        // Calculate an index based on input -1 -> +1 with 0 being at the center of the curve data.
-        int index = static_cast<int>( (curveLength * (input + 1)) / 2 );
+    // Calculate a position based on input -1 -> +1 with 0 being at the center of the curve data.
+    // Clamping the position takes care of input outside of nominal range -1 -> +1.
+    const float scale = 0.5f * static_cast<float>(curve->length - 1);
+    const float last = static_cast<float>(curve->length - 1);
+    float * positions = m_positions.data();
+    for (int i = 0; i < framesToProcess; ++i)
+        positions[i] = std::min(last, std::max(0.f, scale * source[i] + scale));
 
-        // Clip index to the input range of the curve.
-        // This takes care of input outside of nominal range -1 -> +1
-        index = std::max(index, 0);
-        index = std::min(index, curveLength - 1);
-        destination[i] = curveData[index];
-    }
+    // Apply waveshaping curve.
+    VectorMath::vlint(curve->points.data(), positions, destination, framesToProcess);
 }
-// https://github.com/WebKit/WebKit/blob/main/Source/WebCore/Modules/webaudio/WaveShaperDSPKernel.cpp
-void WaveShaperNode::processCurve2x(const float * source, float * destination, int framesToProcess)
+
+void WaveShaperNode::processCurve2x(int channel, const float * source, float * destination, int framesToProcess)
 {
-    OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays;
-    
-    auto hold_buffer_pointer = osa->m_tempBuffer;
-    auto hold_sampler = osa->m_upSampler;
-    float * tempP = osa->m_tempBuffer->data();
+    OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays.load(std::memory_order_acquire);
+    OverSamplingChannel & resamplers = *osa->m_channels[channel];
+    float * tempP = osa->m_tempBuffer.data();
 
-    osa->m_upSampler->process(source, tempP, framesToProcess);
+    resamplers.m_upSampler.upsample(source, tempP, framesToProcess);
 
     // Process at 2x up-sampled rate.
     processCurve(tempP, tempP, framesToProcess * 2);
 
-    osa->m_downSampler->process(tempP, destination, framesToProcess * 2);
+    resamplers.m_downSampler.downsample(tempP, destination, framesToProcess);
 }
 
-void WaveShaperNode::processCurve4x(const float * source, float * destination, int framesToProcess)
+void WaveShaperNode::processCurve4x(int channel, const float * source, float * destination, int framesToProcess)
 {
-    OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays;
-
-    auto hold_buffer_pointer = osa->m_tempBuffer;
-    auto hold_buffer_pointer2 = osa->m_tempBuffer2;
-    auto hold_sampler = osa->m_upSampler;
-    auto hold_sampler2 = osa->m_upSampler2;
-
-    
-    float * tempP = osa->m_tempBuffer->data();
-    float * tempP2 = osa->m_tempBuffer2->data();
+    OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays.load(std::memory_order_acquire);
+    OverSamplingChannel & resamplers = *osa->m_channels[channel];
+    float * tempP = osa->m_tempBuffer.data();
+    float * tempP2 = osa->m_tempBuffer2.data();
 
-    osa->m_upSampler->process(source, tempP, framesToProcess);
-    osa->m_upSampler2->process(tempP, tempP2, framesToProcess * 2);
+    resamplers.m_upSampler.upsample(source, tempP, framesToProcess);
+    resamplers.m_upSampler2.upsample(tempP, tempP2, framesToProcess * 2);
 
     // Process at 4x up-sampled rate.
     processCurve(tempP2, tempP2, framesToProcess * 4);
 
-    osa->m_downSampler2->process(tempP2, tempP, framesToProcess * 4);
-    osa->m_downSampler->process(tempP, destination, framesToProcess * 2);
+    resamplers.m_downSampler2.downsample(tempP2, tempP, framesToProcess * 2);
+    resamplers.m_downSampler.downsample(tempP, destination, framesToProcess);
 }
 
 void WaveShaperNode::process(ContextRenderLock & r, int bufferSize)
 {
-    if (_newCurveReady)
+    if (Curve * newCurve = m_pendingCurve.exchange(nullptr, std::memory_order_acq_rel))
     {
         // this could cause a pop, but setting a curve should be extremely rare
-        std::lock_guard<std::mutex> lock(_curveMutex);
-        std::swap(m_curve, m_newCurve);
-        _newCurveReady = 0;
+        if (m_curve)
+        {
+            m_curve->next = m_retiredCurves.load(std::memory_order_relaxed);
+            while (!m_retiredCurves.compare_exchange_weak(m_curve->next, m_curve, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+        m_curve = newCurve;
     }
 
     AudioBus* destinationBus = output(0)->bus(r);
-    if (!isInitialized() || !m_curve.size())
+    if (!isInitialized() || !m_curve || !m_curve->length)
     {
         destinationBus->zero();
         return;
@@ -168,31 +229,53 @@ void WaveShaperNode::process(ContextRenderLock & r, int bufferSize)
         output(0)->setNumberOfChannels(r, srcChannelCount);
         destinationBus = output(0)->bus(r);
     }
-    if (m_oversample != OverSampleType::NONE && !m_oversamplingArrays)
-         m_oversamplingArrays = createOversamplingArrays();
+
+    const OverSampleType oversample = m_oversample;
+    int oversampledChannels = 0;
+    if (oversample != OverSampleType::NONE)
+    {
+        OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays.load(std::memory_order_acquire);
+        ASSERT(osa);
+        oversampledChannels = std::min(srcChannelCount, static_cast<int>(osa->m_channels.size()));
+
+        // Resamplers that were idle hold stale state.
+        if (oversample != m_lastOversample)
+        {
+            for (auto & channel : osa->m_channels)
+                channel->reset();
+        }
+    }
+    m_lastOversample = oversample;
 
     for (int i = 0; i < srcChannelCount; ++i)
     {
         const float * source = sourceBus->channel(i)->data();
         float * destination = destinationBus->channel(i)->mutableData();
         int framesToProcess = bufferSize;
-        switch (m_oversample)
+        switch (i < oversampledChannels ? oversample : OverSampleType::NONE)
         {
             case OverSampleType::NONE:
                 processCurve(source, destination, framesToProcess);
                 break;
             case OverSampleType::_2X :
-                processCurve2x(source, destination, framesToProcess);
+                processCurve2x(i, source, destination, framesToProcess);
                 break;
             case OverSampleType::_4X :
-                processCurve4x(source, destination, framesToProcess);
+                processCurve4x(i, source, destination, framesToProcess);
                 break;
 
             default:
                 ASSERT_NOT_REACHED();
         }
+    }
+}
 
-        //processCurve( sourceBus->channel(i)->data(), destinationBus->channel(i)->mutableData(), bufferSize);
+void WaveShaperNode::reset(ContextRenderLock &)
+{
+    if (OverSamplingArrays * osa = (OverSamplingArrays *) m_oversamplingArrays.load(std::memory_order_acquire))
+    {
+        for (auto & channel : osa->m_channels)
+            channel->reset();
     }
 }
 
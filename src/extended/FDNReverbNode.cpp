@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/FDNReverbNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/Macros.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Assertions.h"
+#include "internal/DelayLine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+static AudioParamDescriptor s_fdnParams[] = {
+    {"decayTime",  "DCAY", 2.0, 0.05, 100.0},
+    {"damping",    "DAMP", 0.5,  0.0,   1.0},
+    {"modulation", "MODU", 0.5,  0.0,   1.0},
+    {nullptr, nullptr, 0.0, 0.0, 0.0}};
+
+static AudioSettingDescriptor s_fdnSettings[] = {
+    {"lines", "LINE", SettingType::Integer, nullptr},
+    {"size",  "SIZE", SettingType::Float, nullptr},
+    {nullptr, nullptr, SettingType::None, nullptr}};
+
+AudioNodeDescriptor * FDNReverbNode::desc()
+{
+    static AudioNodeDescriptor d {s_fdnParams, s_fdnSettings, 1};
+    return &d;
+}
+
+namespace
+{
+    // Line lengths at a size of one, in milliseconds. They are spread over a
+    // range and share no common factors, so the echoes don't pile up on each
+    // other; eight lines use every other length.
+    const float LineLengthsMs[FDNReverbNode::MaxLines] = {
+        29.7f, 33.1f, 37.3f, 41.9f, 44.3f, 47.9f, 53.3f, 57.1f,
+        61.7f, 66.1f, 70.3f, 74.9f, 79.7f, 85.1f, 91.3f, 97.9f};
+
+    const float MinSize = 0.25f;
+    const float MaxSize = 2.f;
+
+    // The deepest modulation of the line lengths, and the slowest modulation rate.
+    const float MaxModulationTime = 0.00025f;
+    const float ModulationRate = 0.31f;
+
+    // The low pass pole at full damping.
+    const float MaxDampingPole = 0.85f;
+
+    int ModulationFrames(float sampleRate)
+    {
+        return static_cast<int>(std::ceil(MaxModulationTime * sampleRate));
+    }
+
+    // the read for a quantum must not reach into the quantum being computed
+    int MinLength(float sampleRate)
+    {
+        return AudioNode::ProcessingSizeInFrames + ModulationFrames(sampleRate) + 4;
+    }
+}
+
+struct FDNReverbNode::Line
+{
+    DelayLine delayLine;
+    DelayLine::Tap tap;
+    AudioFloatArray signal {AudioNode::ProcessingSizeInFrames};
+    AudioFloatArray delays {AudioNode::ProcessingSizeInFrames};
+    int length = 0;  // frames
+    float lowpass = 0;
+    float modulationRate = 0;  // hz
+    double modulationPhase = 0;
+};
+
+FDNReverbNode::FDNReverbNode(AudioContext & ac)
+    : AudioNode(ac, *desc())
+{
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+    _decayTime = param("decayTime");
+    _damping = param("damping");
+    _modulation = param("modulation");
+
+    _lines = setting("lines");
+    _lines->setUint32(8);
+    _size = setting("size");
+    _size->setFloat(1.f);
+
+    // Every line is allocated for the longest length at the largest size, so
+    // changing the number of lines or the size only changes the lengths in use.
+    const float sampleRate = ac.sampleRate();
+    const int maxLength = std::max(MinLength(sampleRate), static_cast<int>(LineLengthsMs[MaxLines - 1] * MaxSize * 0.001f * sampleRate) + 1);
+    for (int i = 0; i < MaxLines; ++i)
+    {
+        std::unique_ptr<Line> line(new Line);
+        line->delayLine.allocate(maxLength + ModulationFrames(sampleRate), AudioNode::ProcessingSizeInFrames);
+        _network.push_back(std::move(line));
+    }
+
+    initialize();
+}
+
+FDNReverbNode::~FDNReverbNode()
+{
+    uninitialize();
+}
+
+double FDNReverbNode::tailTime(ContextRenderLock &) const
+{
+    return _decayTime->value() + LineLengthsMs[MaxLines - 1] * MaxSize * 0.001;
+}
+
+void FDNReverbNode::configure(float sampleRate, int lineCount, float size)
+{
+    const int minLength = MinLength(sampleRate);
+    const int stride = MaxLines / lineCount;
+
+    if (lineCount != _lineCount || sampleRate != _configuredSampleRate)
+    {
+        // a new network starts from silence
+        for (int i = 0; i < lineCount; ++i)
+        {
+            Line & line = *_network[i];
+            line.delayLine.reset();
+            line.tap = {};
+            line.lowpass = 0;
+            line.modulationRate = ModulationRate * (1.f + 0.137f * i);
+            line.modulationPhase = LAB_TAU * i / lineCount;
+        }
+        _lineCount = lineCount;
+        _configuredSampleRate = sampleRate;
+    }
+
+    for (int i = 0; i < lineCount; ++i)
+    {
+        // odd lengths, so no two lines share a factor of two; the line clamps a
+        // length it wasn't allocated for, if the sample rate has since risen
+        Line & line = *_network[i];
+        const int length = static_cast<int>(LineLengthsMs[i * stride] * size * 0.001f * sampleRate) | 1;
+        const int maxLength = line.delayLine.maxDelayFrames() - ModulationFrames(sampleRate);
+        line.length = std::min(maxLength, std::max(minLength, length));
+    }
+    _configuredSize = size;
+}
+
+void FDNReverbNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+    ASSERT(outputBus);
+
+    if (!isInitialized())
+    {
+        outputBus->zero();
+        return;
+    }
+
+    if (outputBus->numberOfChannels() != 2)
+    {
+        output(0)->setNumberOfChannels(r, 2);
+        outputBus = output(0)->bus(r);
+    }
+
+    const float sampleRate = r.context()->sampleRate();
+    const int lineCount = _lines->valueUint32() > 8 ? 16 : 8;
+    const float size = std::max(MinSize, std::min(MaxSize, _size->valueFloat()));
+    if (lineCount != _lineCount || size != _configuredSize || sampleRate != _configuredSampleRate)
+        configure(sampleRate, lineCount, size);
+
+    ASSERT(bufferSize <= AudioNode::ProcessingSizeInFrames);
+    const int frames = std::min(bufferSize, static_cast<int>(AudioNode::ProcessingSizeInFrames));
+
+    // the input feeds the even lines from the left, and the odd lines from the right
+    const float * inputs[2] = {nullptr, nullptr};
+    if (input(0)->isConnected())
+    {
+        AudioBus * inputBus = input(0)->bus(r);
+        const int inputChannels = inputBus->numberOfChannels();
+        if (inputChannels > 0 && !inputBus->isSilent())
+        {
+            inputs[0] = inputBus->channel(0)->data();
+            inputs[1] = inputChannels > 1 ? inputBus->channel(1)->data() : inputs[0];
+        }
+    }
+
+    const float decayTime = std::max(0.01f, _decayTime->value());
+    const float pole = MaxDampingPole * std::max(0.f, std::min(1.f, _damping->value()));
+    const float modulationFrames = MaxModulationTime * sampleRate * std::max(0.f, std::min(1.f, _modulation->value()));
+
+    // the Hadamard matrix is orthogonal once scaled by 1 / sqrt(N); the scale is folded into the line gains
+    const float mixScale = 1.f / std::sqrt(static_cast<float>(lineCount));
+    const float inputScale = mixScale;
+    const float outputScale = 2.f * mixScale;
+
+    float * outputs[2] = {outputBus->channel(0)->mutableData(), outputBus->channel(1)->mutableData()};
+    memset(outputs[0], 0, sizeof(float) * bufferSize);
+    memset(outputs[1], 0, sizeof(float) * bufferSize);
+
+    for (int i = 0; i < lineCount; ++i)
+    {
+        Line & line = *_network[i];
+        float * signal = line.signal.data();
+
+        // The line was last written a quantum ago, so reading it at length - frames
+        // returns the frames written length frames before the ones now computed.
+        const float delay = static_cast<float>(line.length - frames);
+        if (modulationFrames > 0.f)
+        {
+            const double phaseStep = LAB_TAU * line.modulationRate * frames / sampleRate;
+            const float start = delay + modulationFrames * static_cast<float>(std::sin(line.modulationPhase));
+            const float end = delay + modulationFrames * static_cast<float>(std::sin(line.modulationPhase + phaseStep));
+            const float step = (end - start) / frames;
+            VectorMath::vramp(&start, &step, line.delays.data(), 1, frames);
+            line.delayLine.read(line.tap, DelayInterpolation::Linear, line.delays.data(), signal, frames);
+
+            line.modulationPhase += phaseStep;
+            if (line.modulationPhase > LAB_TAU)
+                line.modulationPhase -= LAB_TAU;
+        }
+        else
+            line.delayLine.read(line.tap, DelayInterpolation::Linear, static_cast<double>(delay), signal, frames);
+
+        VectorMath::vadd(signal, 1, outputs[i & 1], 1, outputs[i & 1], 1, frames);
+
+        // damping, then the gain that decays the line by 60dB over the decay time
+        const float gain = mixScale * std::pow(10.f, -3.f * line.length / (decayTime * sampleRate));
+        float lowpass = line.lowpass;
+        for (int j = 0; j < frames; ++j)
+        {
+            lowpass = signal[j] + pole * (lowpass - signal[j]);
+            signal[j] = gain * lowpass;
+        }
+        line.lowpass = lowpass;
+    }
+
+    // mix the lines with a fast Walsh-Hadamard transform
+    for (int half = 1; half < lineCount; half *= 2)
+        for (int i = 0; i < lineCount; i += 2 * half)
+            for (int j = i; j < i + half; ++j)
+                VectorMath::vbfly(_network[j]->signal.data(), _network[j + half]->signal.data(), frames);
+
+    for (int i = 0; i < lineCount; ++i)
+    {
+        Line & line = *_network[i];
+        if (inputs[i & 1])
+            VectorMath::vsma(inputs[i & 1], 1, &inputScale, line.signal.data(), 1, frames);
+        line.delayLine.write(line.signal.data(), frames);
+    }
+
+    VectorMath::vsmul(outputs[0], 1, &outputScale, outputs[0], 1, frames);
+    VectorMath::vsmul(outputs[1], 1, &outputScale, outputs[1], 1, frames);
+    outputBus->clearSilentFlag();
+}
+
+void FDNReverbNode::reset(ContextRenderLock &)
+{
+    for (auto & line : _network)
+    {
+        line->delayLine.reset();
+        line->tap = {};
+        line->lowpass = 0;
+    }
+}
+
+}  // namespace lab
@@ -10,20 +10,54 @@
 #include "LabSound/core/WindowFunctions.h"
 
 #include "LabSound/extended/AudioContextLock.h"
-#include "LabSound/extended/Util.h"
 
 #include "internal/Assertions.h"
-#include "internal/AudioUtilities.h"
+#include "internal/GrainPool.h"
+#include "internal/RandomGenerator.h"
+
+#include <algorithm>
+#include <cmath>
 
 using namespace lab;
 
 
+namespace
+{
+    // the params, in the order their values are kept in param_values
+    enum GrainParam
+    {
+        NumGrainsValues,
+        DurationValues,
+        PositionMinValues,
+        PositionMaxValues,
+        PlaybackFrequencyValues,
+        DensityValues,
+        JitterValues,
+        PanSpreadValues,
+        GrainParamCount
+    };
+
+    // the smallest gap between grains, in frames, so that full jitter can't stall the scheduler
+    const double MinGrainInterval = 1.0 / 16.0;
+
+    struct GrainParamValues
+    {
+        AudioParamShape shape;
+        const float * values;
+
+        float at(int frame) const { return shape.isConstant() ? shape.value : values[frame]; }
+    };
+}
+
 static AudioParamDescriptor s_GranulationParams[] = {
-    {"NumGrains",         "NGRN", 8.f,  1.f,  256.f},
-    {"GrainDuration",     "GDUR", 0.5f, 0.01f,  0.5f},
-    {"PositionMin",       "GMIN", 0.0f, 0.0f,   1.0f},
-    {"PositionMax",       "GMAX", 1.0f, 0.0f,   1.0f},
-    {"PlaybackFrequency", "FREQ", 1.0f, 0.01f, 12.0f},
+    {"NumGrains",         "NGRN",  8.f,  1.f, static_cast<float>(GrainPool::MaxGrains)},
+    {"GrainDuration",     "GDUR",  0.5f, 0.01f,  0.5f},
+    {"PositionMin",       "GMIN",  0.0f, 0.0f,   1.0f},
+    {"PositionMax",       "GMAX",  1.0f, 0.0f,   1.0f},
+    {"PlaybackFrequency", "FREQ",  1.0f, 0.01f, 12.0f},
+    {"Density",           "DENS", 16.0f, 0.0f, 48000.0f},
+    {"Jitter",            "JITR",  0.0f, 0.0f,   1.0f},
+    {"PanSpread",         "PANS",  0.0f, 0.0f,   1.0f},
     {nullptr}};
 
 static AudioSettingDescriptor s_GranulationSettings[] = {
@@ -39,6 +73,9 @@ AudioNodeDescriptor * GranulationNode::desc()
 
 GranulationNode::GranulationNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
+, grain_pool(new GrainPool())
+, random_generator(new RandomGenerator())
+, param_values(AudioNode::ProcessingSizeInFrames * GrainParamCount)
 {
     // Sample that will be granulated
     grainSourceBus = setting("GrainSource");
@@ -47,10 +84,10 @@ GranulationNode::GranulationNode(AudioContext & ac)
     windowFunc = setting("WindowFunction");
     windowFunc->setEnumeration(static_cast<int>(WindowFunction::bartlett), true);
 
-    // Total number of grains that will be allocated
+    // The most grains that may sound at once
     numGrains = param("NumGrains");
 
-    // Duration of each grain in seconds (currently fixed but ideally will be configurable per-grain)
+    // Duration of each grain in seconds
     grainDuration = param("GrainDuration");
 
     // The min/max positional offset (given in a normalized 0-1 range) from which a grain should
@@ -62,6 +99,13 @@ GranulationNode::GranulationNode(AudioContext & ac)
     // How fast the grain should play, given as a multiplier. Useful for pitch-shifting effects.
     grainPlaybackFreq = param("PlaybackFrequency");
 
+    // Grains per second, and the randomness of the time between them, from 0 to 1
+    grainDensity = param("Density");
+    grainJitter = param("Jitter");
+
+    // How far either side of the center grains may be panned, from 0 to 1
+    grainPanSpread = param("PanSpread");
+
     initialize();
 }
 
@@ -72,114 +116,85 @@ GranulationNode::~GranulationNode()
 
 void GranulationNode::reset(ContextRenderLock&)
 {
-
+    grain_pool->clear();
+    next_grain = 0;
 }
 
-bool GranulationNode::RenderGranulation(ContextRenderLock & r, AudioBus * out_bus, int destinationFrameOffset, int numberOfFrames)
+void GranulationNode::scheduleGrains(ContextRenderLock & r, int bufferSize, int offset, int count, int channelCount)
 {
-    if (!r.context())
-        return false;
+    if (bufferSize * GrainParamCount > param_values.size())
+        param_values.allocate(bufferSize * GrainParamCount);
 
-    // Sanity check destinationFrameOffset, numberOfFrames.
-    const int destinationLength = out_bus->length();
+    const std::shared_ptr<AudioParam> params[GrainParamCount] = {
+        numGrains, grainDuration, grainPositionMin, grainPositionMax,
+        grainPlaybackFreq, grainDensity, grainJitter, grainPanSpread};
 
-    bool isLengthGood = destinationLength <= 4096 && numberOfFrames <= 4096;
-    ASSERT(isLengthGood);
-    if (!isLengthGood)
-        return false;
-
-    bool isOffsetGood = destinationFrameOffset <= destinationLength && destinationFrameOffset + numberOfFrames <= destinationLength;
-    ASSERT(isOffsetGood);
-    if (!isOffsetGood)
-        return false;
-
-    if (!out_bus) return false;
-
-    float * mono_destination = out_bus->channel(0)->mutableData();
+    GrainParamValues values[GrainParamCount];
+    for (int p = 0; p < GrainParamCount; ++p)
+    {
+        float * destination = param_values.data() + p * bufferSize;
+        values[p].values = destination + offset;
+        values[p].shape = {AudioParamShape::Constant, params[p]->value()};
+        if (params[p]->hasSampleAccurateValues())
+            values[p].shape = params[p]->calculateSampleAccurateValues(r, destination, bufferSize);
+    }
 
-    // @fixme - this vector
-    std::vector<float> grain_sum_buffer(numberOfFrames, 0.f);
+    const float sampleRate = r.context()->sampleRate();
+    const int sourceLength = grain_pool->sourceLength();
+    const float sourceRate = grain_pool->sourceSampleRate() > 0 ? grain_pool->sourceSampleRate() : sampleRate;
 
+    while (next_grain < count)
     {
-        for (int i = 0; i < grain_pool.size(); ++i)
+        const int frame = std::max(0, static_cast<int>(next_grain));
+
+        const float density = values[DensityValues].at(frame);
+        if (!(density > 0.f))
         {
-            grain_pool[i].tick(grain_sum_buffer.data(), static_cast<int>(grain_sum_buffer.size()));
+            // nothing to play; look again on the next frame
+            next_grain = frame + 1;
+            continue;
         }
 
-        for (int f = 0; f < numberOfFrames; ++f)
+        const float duration = std::max(0.01f, std::min(0.5f, values[DurationValues].at(frame)));
+        const float maxGrains = std::max(1.f, std::min(static_cast<float>(GrainPool::MaxGrains), values[NumGrainsValues].at(frame)));
+
+        if (grain_pool->count() < static_cast<int>(maxGrains))
         {
-            grain_sum_buffer[f] /= static_cast<float>(grain_pool.size());
-            mono_destination[f] = grain_sum_buffer[f]; // @todo - memcpy
+            float low = std::max(0.f, std::min(1.f, values[PositionMinValues].at(frame)));
+            float high = std::max(0.f, std::min(1.f, values[PositionMaxValues].at(frame)));
+            if (high < low)
+                std::swap(low, high);
+
+            const float spread = std::max(0.f, std::min(1.f, values[PanSpreadValues].at(frame)));
+            const float overlap = std::max(1.f, std::min(maxGrains, density * duration));
+
+            GrainPool::Grain grain;
+            grain.delay = frame;
+            grain.length = static_cast<int>(duration * sampleRate);
+            grain.position = static_cast<double>(random_generator->nextFloat(low, high)) * sourceLength;
+            grain.increment = std::max(0.f, values[PlaybackFrequencyValues].at(frame)) * sourceRate / sampleRate;
+            grain.gain = 1.f / std::sqrt(overlap);
+            grain.pan = spread * random_generator->nextFloat(-1.f, 1.f);
+            grain_pool->start(grain, channelCount);
         }
 
-        // Optional grain culling when they're "done"
-        // if (!grain_pool.empty())
-        // {
-        //     auto it = std::remove_if(std::begin(grain_pool), std::end(grain_pool), [this](const grain & g)
-        //     {
-        //         return g.in_use;
-        //     });
-        //     grain_pool.erase(it, std::end(grain_pool));
-        // }
+        const float jitter = std::max(0.f, std::min(1.f, values[JitterValues].at(frame)));
+        const double interval = sampleRate / density * (1.f + jitter * random_generator->nextFloat(-1.f, 1.f));
+        next_grain += std::max(interval, MinGrainInterval);
     }
 
-    out_bus->clearSilentFlag();
-
-    return true;
+    next_grain -= count;
 }
 
 bool GranulationNode::setGrainSource(ContextRenderLock & r, std::shared_ptr<AudioBus> buffer)
 {
     ASSERT(grainSourceBus);
 
-    // Granulation Settings Sanity Check
-    /// @fixme these values should be per sample, not per quantum
-    /// -or- they should be settings if they don't vary per sample
-    std::cout << "GranulationNode::WindowFunction    " << s_window_types[windowFunc->valueUint32()] << std::endl;
-    std::cout << "GranulationNode::numGrains         " << numGrains->value() << std::endl;
-    std::cout << "GranulationNode::grainDuration     " << grainDuration->value() << std::endl;
-    std::cout << "GranulationNode::grainPositionMin  " << grainPositionMin->value() << std::endl;
-    std::cout << "GranulationNode::grainPositionMax  " << grainPositionMax->value() << std::endl;
-    std::cout << "GranulationNode::grainPlaybackFreq " << grainPlaybackFreq->value() << std::endl;
-
     grainSourceBus->setBus(buffer.get());
-    output(0)->setNumberOfChannels(r, buffer ? buffer->numberOfChannels() : 0);
-
-    // Compute useful values
-    /// @fixme these values should be per sample, not per quantum
-    /// -or- they should be settings if they don't vary per sample
-    const float grain_duration_seconds = grainDuration->value();
-    const uint64_t grain_duration_samples = static_cast<uint64_t>(grain_duration_seconds * r.context()->sampleRate());
-
-    // Setup window/envelope
-    std::vector<float> grain_window(grain_duration_samples, 1.f);
-    lab::ApplyWindowFunctionInplace(static_cast<WindowFunction>(windowFunc->valueUint32()), grain_window.data(), static_cast<int>(grain_window.size()));
-
-    window_bus.reset(new lab::AudioBus(1, static_cast<int>(grain_duration_samples)));
-    window_bus->setSampleRate(r.context()->sampleRate());
-
-    float * windowData = window_bus->channel(0)->mutableData();
-    for (uint32_t sample = 0; sample < grain_window.size(); ++sample)
-    {
-        windowData[sample] = grain_window[sample];
-    }
-
-    // Setup grains
-    UniformRandomGenerator rnd;
-    auto sample_to_granulate = grainSourceBus->valueBus();
-    
-    int ng = static_cast<int>(numGrains->value());
-    for (int i = 0; i < ng; ++i)
-    {
-        /// @fixme these values should be per sample, not per quantum
-        /// -or- they should be settings if they don't vary per sample
-        const float random_pos_offset = rnd.random_float(grainPositionMin->value(), grainPositionMax->value());
-        
-        printf("grain offset %f\n", random_pos_offset);
-        
-        grain_pool.emplace_back(grain(sample_to_granulate, window_bus, r.context()->sampleRate(), random_pos_offset, grain_duration_seconds, grainPlaybackFreq->value()));
-    }
+    grain_pool->setSource(buffer.get());
+    next_grain = 0;
 
+    output(0)->setNumberOfChannels(r, buffer ? std::max(2, buffer->numberOfChannels()) : 0);
     return true;
 }
 
@@ -187,7 +202,7 @@ void GranulationNode::process(ContextRenderLock& r, int bufferSize)
 {
     AudioBus * outputBus = output(0)->bus(r);
 
-    if (!isInitialized() || !outputBus->numberOfChannels()) 
+    if (!isInitialized() || !outputBus->numberOfChannels() || !grain_pool->sourceLength())
     {
         outputBus->zero();
         return;
@@ -196,17 +211,20 @@ void GranulationNode::process(ContextRenderLock& r, int bufferSize)
     int quantumFrameOffset = _self->_scheduler._renderOffset;
     int bufferFramesToProcess = _self->_scheduler._renderLength;
 
+    outputBus->zero();
     if (!bufferFramesToProcess)
-    {
-        outputBus->zero();
         return;
-    }
 
-    if (!RenderGranulation(r, outputBus, quantumFrameOffset, bufferFramesToProcess))
-    {
-        outputBus->zero();
-        return;
-    }
+    grain_pool->setWindow(static_cast<WindowFunction>(windowFunc->valueUint32()));
+
+    const int channelCount = std::min(AudioBus::MaxChannels, outputBus->numberOfChannels());
+    scheduleGrains(r, bufferSize, quantumFrameOffset, bufferFramesToProcess, channelCount);
+
+    float * channels[AudioBus::MaxChannels];
+    for (int c = 0; c < channelCount; ++c)
+        channels[c] = outputBus->channel(c)->mutableData() + quantumFrameOffset;
+    grain_pool->render(channels, channelCount, bufferFramesToProcess);
+
     outputBus->clearSilentFlag();
 }
     
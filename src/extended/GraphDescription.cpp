@@ -0,0 +1,845 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/GraphDescription.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioDevice.h"
+#include "LabSound/core/AudioNode.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/SampledAudioNode.h"
+#include "LabSound/extended/Logging.h"
+#include "LabSound/extended/Registry.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace lab {
+
+namespace {
+
+    const uint16_t kBinaryVersion = 1;
+    const uint16_t kUntyped = 0xfffe;  // a key that has not been given a type yet
+
+    bool IsLittleEndian()
+    {
+        const uint16_t probe = 1;
+        uint8_t first;
+        memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    int ParamSlot(AudioNodeDescriptor const * desc, const std::string & name)
+    {
+        if (!desc || !desc->params)
+            return -1;
+        int slot = 0;
+        for (AudioParamDescriptor const * p = desc->params; p->name; ++p, ++slot)
+            if (name == p->name || (p->shortName && name == p->shortName))
+                return slot;
+        return -1;
+    }
+
+    int SettingSlot(AudioNodeDescriptor const * desc, const std::string & name)
+    {
+        if (!desc || !desc->settings)
+            return -1;
+        int slot = 0;
+        for (AudioSettingDescriptor const * s = desc->settings; s->name; ++s, ++slot)
+            if (name == s->name || (s->shortName && name == s->shortName))
+                return slot;
+        return -1;
+    }
+
+    std::vector<std::string> ParamNames(AudioNodeDescriptor const * desc)
+    {
+        std::vector<std::string> names;
+        if (desc && desc->params)
+            for (AudioParamDescriptor const * p = desc->params; p->name; ++p)
+                names.push_back(p->name);
+        return names;
+    }
+
+    std::vector<std::string> SettingNames(AudioNodeDescriptor const * desc)
+    {
+        std::vector<std::string> names;
+        if (desc && desc->settings)
+            for (AudioSettingDescriptor const * s = desc->settings; s->name; ++s)
+                names.push_back(s->name);
+        return names;
+    }
+
+    std::string Trim(const std::string & s)
+    {
+        size_t b = s.find_first_not_of(" \t\r");
+        if (b == std::string::npos)
+            return {};
+        size_t e = s.find_last_not_of(" \t\r");
+        return s.substr(b, e - b + 1);
+    }
+
+    std::vector<std::string> Split(const std::string & s, char separator)
+    {
+        std::vector<std::string> parts;
+        std::stringstream ss(s);
+        std::string part;
+        while (std::getline(ss, part, separator))
+            parts.push_back(Trim(part));
+        return parts;
+    }
+
+    bool EqualNoCase(const std::string & a, const char * b)
+    {
+        size_t i = 0;
+        for (; i < a.size() && b[i]; ++i)
+            if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+                return false;
+        return i == a.size() && !b[i];
+    }
+
+    bool ParseFloat(const std::string & s, float & value)
+    {
+        if (s.empty())
+            return false;
+        char * end = nullptr;
+        value = strtof(s.c_str(), &end);
+        return end && *end == '\0';
+    }
+
+    bool ParseInteger(const std::string & s, int & value)
+    {
+        if (s.empty())
+            return false;
+        char * end = nullptr;
+        value = static_cast<int>(strtol(s.c_str(), &end, 10));
+        return end && *end == '\0';
+    }
+
+    GraphDescription::Op MakeOp(GraphDescription::OpCode code, int node, int slot = 0, int source = 0, int aux = 0)
+    {
+        GraphDescription::Op op;
+        memset(&op, 0, sizeof(op));
+        op.code = code;
+        op.node = static_cast<uint16_t>(node);
+        op.slot = static_cast<uint16_t>(slot);
+        op.source = static_cast<uint16_t>(source);
+        op.aux = static_cast<uint8_t>(aux);
+        return op;
+    }
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+// text
+
+struct GraphTextParser
+{
+    enum class Component
+    {
+        None,
+        Type,
+        Schedule,
+        Meta
+    };
+
+    struct Connection
+    {
+        int line;
+        std::vector<std::string> chain;
+    };
+
+    GraphDescription & g;
+    NodeRegistry & registry;
+    int line = 0;
+    std::vector<Connection> connections;
+
+    GraphTextParser(GraphDescription & g) : g(g), registry(NodeRegistry::Instance()) {}
+
+    [[noreturn]] void fail(int at, const std::string & message)
+    {
+        throw std::runtime_error("graph description line " + std::to_string(at) + ": " + message);
+    }
+
+    int nodeFor(const std::string & name)
+    {
+        auto i = g._nodeIndex.find(name);
+        if (i != g._nodeIndex.end())
+            return i->second;
+        if (g._nodes.size() >= GraphDescription::kDestinationType - 1)
+            fail(line, "too many nodes");
+        int index = static_cast<int>(g._nodes.size());
+        g._nodes.push_back({name, kUntyped});
+        g._nodeIndex[name] = index;
+        return index;
+    }
+
+    uint16_t typeFor(int registryIndex)
+    {
+        for (size_t i = 0; i < g._types.size(); ++i)
+            if (g._types[i].registryIndex == registryIndex)
+                return static_cast<uint16_t>(i);
+        g._types.push_back({registry.Name(registryIndex), registryIndex});
+        return static_cast<uint16_t>(g._types.size() - 1);
+    }
+
+    AudioNodeDescriptor const * descriptorOf(int node)
+    {
+        uint16_t type = g._nodes[node].type;
+        if (type == kUntyped || type == GraphDescription::kDestinationType)
+            return nullptr;
+        return registry.Descriptor(g._types[type].registryIndex);
+    }
+
+    void typeNode(int node, const std::string & typeName)
+    {
+        uint16_t type;
+        if (typeName == "DefaultAudio" || typeName == AudioDestinationNode::static_name())
+            type = GraphDescription::kDestinationType;
+        else
+        {
+            int registryIndex = registry.TypeIndex(typeName);
+            if (registryIndex < 0)
+                fail(line, "unknown node type " + typeName);
+            type = typeFor(registryIndex);
+        }
+
+        uint16_t & current = g._nodes[node].type;
+        if (current != kUntyped && current != type)
+            fail(line, g._nodes[node].name + " already has a type");
+        current = type;
+    }
+
+    void parseValue(int node, const std::string & name, const std::string & value)
+    {
+        if (g._nodes[node].type == GraphDescription::kDestinationType)
+            fail(line, "the destination has no parameters");
+
+        AudioNodeDescriptor const * desc = descriptorOf(node);
+
+        int slot = ParamSlot(desc, name);
+        if (slot >= 0)
+        {
+            if (value.find_first_of(",;") == std::string::npos)
+            {
+                GraphDescription::Op op = MakeOp(GraphDescription::OpCode::SetParam, node, slot);
+                if (!ParseFloat(value, op.a))
+                    fail(line, "expected a number for " + name);
+                g._ops.push_back(op);
+                return;
+            }
+
+            for (auto & key : Split(value, ';'))
+            {
+                if (key.empty())
+                    continue;
+                auto tv = Split(key, ',');
+                GraphDescription::Op op = MakeOp(GraphDescription::OpCode::SetParamAtTime, node, slot);
+                if (tv.size() != 2 || !ParseFloat(tv[0], op.a) || !ParseFloat(tv[1], op.b))
+                    fail(line, "expected time, value pairs for " + name);
+                g._ops.push_back(op);
+            }
+            return;
+        }
+
+        slot = SettingSlot(desc, name);
+        if (slot < 0)
+            fail(line, registry.Name(g._types[g._nodes[node].type].registryIndex) + " has no parameter or setting " + name);
+
+        AudioSettingDescriptor const & setting = desc->settings[slot];
+        GraphDescription::Op op = MakeOp(GraphDescription::OpCode::SetSetting, node, slot);
+        int i = 0;
+        switch (setting.type)
+        {
+            case SettingType::Bool:
+                op.aux = GraphDescription::SettingBool;
+                if (value == "true" || value == "1") op.bits = 1;
+                else if (value == "false" || value == "0") op.bits = 0;
+                else fail(line, "expected true or false for " + name);
+                break;
+            case SettingType::Integer:
+                op.aux = GraphDescription::SettingInteger;
+                if (!ParseInteger(value, i))
+                    fail(line, "expected an integer for " + name);
+                op.bits = static_cast<uint32_t>(i);
+                break;
+            case SettingType::Float:
+                op.aux = GraphDescription::SettingFloat;
+                if (!ParseFloat(value, op.a))
+                    fail(line, "expected a number for " + name);
+                break;
+            case SettingType::Enum:
+            {
+                op.aux = GraphDescription::SettingEnum;
+                int index = -1;
+                if (setting.enums)
+                    for (int e = 0; setting.enums[e]; ++e)
+                        if (EqualNoCase(value, setting.enums[e]))
+                            index = e;
+                if (index < 0 && !ParseInteger(value, index))
+                    fail(line, value + " is not a value of " + name);
+                op.bits = static_cast<uint32_t>(index);
+                break;
+            }
+            default:
+                fail(line, "setting " + name + " can't be given in a description");
+        }
+        g._ops.push_back(op);
+    }
+
+    void parseSchedule(int node, const std::string & name, const std::string & value)
+    {
+        GraphDescription::OpCode code;
+        if (name == "start")
+            code = GraphDescription::OpCode::Start;
+        else if (name == "stop")
+            code = GraphDescription::OpCode::Stop;
+        else
+            fail(line, "expected start or stop, not " + name);
+
+        for (auto & when : Split(value, ','))
+        {
+            GraphDescription::Op op = MakeOp(code, node);
+            if (!ParseFloat(when, op.a))
+                fail(line, "expected times for " + name);
+            g._ops.push_back(op);
+        }
+    }
+
+    // resolves "name" or "name:port"; port is -1 if absent
+    int endpoint(int at, const std::string & text, std::string & port)
+    {
+        size_t colon = text.find(':');
+        std::string name = Trim(text.substr(0, colon));
+        port = colon == std::string::npos ? std::string() : Trim(text.substr(colon + 1));
+        auto i = g._nodeIndex.find(name);
+        if (i == g._nodeIndex.end())
+            fail(at, "unknown node " + name);
+        return i->second;
+    }
+
+    void resolveConnections()
+    {
+        for (auto & c : connections)
+        {
+            for (size_t i = 0; i + 1 < c.chain.size(); ++i)
+            {
+                std::string sourcePort, destinationPort;
+                int source = endpoint(c.line, c.chain[i], sourcePort);
+                int destination = endpoint(c.line, c.chain[i + 1], destinationPort);
+
+                int output = 0;
+                if (!sourcePort.empty() && (!ParseInteger(sourcePort, output) || output < 0 || output > 255))
+                    fail(c.line, "expected an output index, not " + sourcePort);
+
+                int input = 0;
+                if (destinationPort.empty() || ParseInteger(destinationPort, input))
+                {
+                    if (input < 0 || input > 0xffff)
+                        fail(c.line, "input index out of range");
+                    g._ops.push_back(MakeOp(GraphDescription::OpCode::Connect, destination, input, source, output));
+                    continue;
+                }
+
+                int slot = ParamSlot(descriptorOf(destination), destinationPort);
+                if (slot < 0)
+                    fail(c.line, g._nodes[destination].name + " has no parameter " + destinationPort);
+                g._ops.push_back(MakeOp(GraphDescription::OpCode::ConnectParam, destination, slot, source, output));
+            }
+        }
+    }
+
+    void parse(const std::string & text)
+    {
+        std::stringstream lines(text);
+        std::string raw;
+
+        int node = -1;
+        int componentIndent = -1;
+        Component component = Component::None;
+        std::string metaComponent;
+
+        while (std::getline(lines, raw))
+        {
+            ++line;
+            size_t hash = raw.find('#');
+            if (hash != std::string::npos)
+                raw.resize(hash);
+
+            int indent = 0;
+            size_t first = 0;
+            for (; first < raw.size() && (raw[first] == ' ' || raw[first] == '\t'); ++first)
+                indent += raw[first] == '\t' ? 4 : 1;
+            std::string content = Trim(raw.substr(first));
+            if (content.empty())
+                continue;
+
+            if (content[0] == '>')
+            {
+                Connection c {line, {}};
+                for (auto & part : Split(content.substr(1), '>'))
+                    c.chain.push_back(part);
+                if (c.chain.size() < 2)
+                    fail(line, "a connection needs a source and a destination");
+                for (auto & part : c.chain)
+                    if (part.empty())
+                        fail(line, "empty connection endpoint");
+                connections.push_back(std::move(c));
+                node = -1;
+                continue;
+            }
+
+            if (indent == 0)
+            {
+                if (content.find_first_of(" \t") != std::string::npos)
+                    fail(line, "a key is a single word");
+                node = nodeFor(content);
+                componentIndent = -1;
+                component = Component::None;
+                continue;
+            }
+
+            if (node < 0)
+                fail(line, "indented line without a key");
+
+            if (componentIndent < 0 || indent <= componentIndent)
+            {
+                if (content.find_first_of(" \t") != std::string::npos)
+                    fail(line, "a component is a single word");
+                componentIndent = indent;
+                if (content == "schedule")
+                    component = Component::Schedule;
+                else if (isupper(static_cast<unsigned char>(content[0])))
+                {
+                    typeNode(node, content);
+                    component = Component::Type;
+                }
+                else
+                {
+                    metaComponent = content;
+                    component = Component::Meta;
+                }
+                continue;
+            }
+
+            size_t space = content.find_first_of(" \t");
+            std::string name = content.substr(0, space);
+            std::string value = space == std::string::npos ? std::string() : Trim(content.substr(space));
+
+            switch (component)
+            {
+                case Component::Type: parseValue(node, name, value); break;
+                case Component::Schedule: parseSchedule(node, name, value); break;
+                case Component::Meta: g._meta.push_back({static_cast<uint16_t>(node), metaComponent, name, value}); break;
+                default: fail(line, "unexpected line");
+            }
+        }
+
+        for (auto & n : g._nodes)
+            if (n.type == kUntyped)
+                fail(line, n.name + " has no type");
+
+        resolveConnections();
+    }
+};
+
+GraphDescription GraphDescription::FromText(const std::string & text)
+{
+    GraphDescription g;
+    GraphTextParser(g).parse(text);
+    return g;
+}
+
+//---------------------------------------------------------------------------
+// binary
+
+namespace {
+
+    class BinaryWriter
+    {
+        std::vector<uint8_t> _data;
+        std::string _strings;
+        std::unordered_map<std::string, uint32_t> _offsets;
+
+    public:
+        uint32_t string(const std::string & s)
+        {
+            auto i = _offsets.find(s);
+            if (i != _offsets.end())
+                return i->second;
+            uint32_t offset = static_cast<uint32_t>(_strings.size());
+            _strings.append(s);
+            _strings.push_back('\0');
+            _offsets[s] = offset;
+            return offset;
+        }
+
+        void write(const void * p, size_t n)
+        {
+            const uint8_t * b = static_cast<const uint8_t *>(p);
+            _data.insert(_data.end(), b, b + n);
+        }
+
+        template <typename T>
+        void write(const T & v) { write(&v, sizeof(T)); }
+
+        std::vector<uint8_t> finish(GraphDescription::BinaryHeader header)
+        {
+            header.stringBytes = static_cast<uint32_t>(_strings.size());
+            std::vector<uint8_t> result(sizeof(header));
+            memcpy(result.data(), &header, sizeof(header));
+            result.insert(result.end(), _data.begin(), _data.end());
+            result.insert(result.end(), _strings.begin(), _strings.end());
+            return result;
+        }
+    };
+
+    class BinaryReader
+    {
+        const uint8_t * _data;
+        size_t _size;
+        size_t _cursor = 0;
+        const char * _strings = nullptr;
+        size_t _stringBytes = 0;
+
+    public:
+        BinaryReader(const void * data, size_t size) : _data(static_cast<const uint8_t *>(data)), _size(size) {}
+
+        [[noreturn]] static void fail(const std::string & message)
+        {
+            throw std::runtime_error("graph description binary: " + message);
+        }
+
+        void read(void * p, size_t n)
+        {
+            if (n > _size - _cursor)
+                fail("truncated");
+            memcpy(p, _data + _cursor, n);
+            _cursor += n;
+        }
+
+        template <typename T>
+        T read()
+        {
+            T v;
+            read(&v, sizeof(T));
+            return v;
+        }
+
+        void setStrings(size_t bytes)
+        {
+            if (bytes > _size - _cursor)
+                fail("truncated");
+            _size -= bytes;
+            _strings = reinterpret_cast<const char *>(_data + _size);
+            _stringBytes = bytes;
+        }
+
+        std::string string(uint32_t offset) const
+        {
+            if (offset >= _stringBytes)
+                fail("string offset out of range");
+            const void * end = memchr(_strings + offset, 0, _stringBytes - offset);
+            if (!end)
+                fail("unterminated string");
+            return std::string(_strings + offset, static_cast<const char *>(end));
+        }
+    };
+
+    // maps slots as written to slots as registered; empty if they are the same
+    std::vector<int> SlotRemap(const std::vector<std::string> & written, const std::vector<std::string> & registered)
+    {
+        if (written == registered)
+            return {};
+
+        std::vector<int> remap(written.size(), -1);
+        for (size_t i = 0; i < written.size(); ++i)
+            for (size_t j = 0; j < registered.size(); ++j)
+                if (written[i] == registered[j])
+                    remap[i] = static_cast<int>(j);
+        return remap;
+    }
+
+}  // namespace
+
+std::vector<uint8_t> GraphDescription::toBinary() const
+{
+    if (!IsLittleEndian())
+        throw std::runtime_error("graph description binaries are little endian");
+
+    NodeRegistry & registry = NodeRegistry::Instance();
+    BinaryWriter w;
+
+    for (auto & t : _types)
+    {
+        AudioNodeDescriptor const * desc = registry.Descriptor(t.registryIndex);
+        auto params = ParamNames(desc);
+        auto settings = SettingNames(desc);
+        w.write(w.string(t.name));
+        w.write(static_cast<uint16_t>(params.size()));
+        w.write(static_cast<uint16_t>(settings.size()));
+        for (auto & p : params)
+            w.write(w.string(p));
+        for (auto & s : settings)
+            w.write(w.string(s));
+    }
+
+    for (auto & n : _nodes)
+    {
+        w.write(w.string(n.name));
+        w.write(n.type);
+        w.write(static_cast<uint16_t>(0));
+    }
+
+    if (!_ops.empty())
+        w.write(_ops.data(), _ops.size() * sizeof(Op));
+
+    for (auto & m : _meta)
+    {
+        w.write(static_cast<uint32_t>(m.node));
+        w.write(w.string(m.component));
+        w.write(w.string(m.key));
+        w.write(w.string(m.value));
+    }
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LSGB", 4);
+    header.version = kBinaryVersion;
+    header.typeCount = static_cast<uint32_t>(_types.size());
+    header.nodeCount = static_cast<uint32_t>(_nodes.size());
+    header.opCount = static_cast<uint32_t>(_ops.size());
+    header.metaCount = static_cast<uint32_t>(_meta.size());
+    return w.finish(header);
+}
+
+GraphDescription GraphDescription::FromBinary(const void * data, size_t size)
+{
+    if (!IsLittleEndian())
+        throw std::runtime_error("graph description binaries are little endian");
+
+    BinaryReader r(data, size);
+    auto header = r.read<BinaryHeader>();
+    if (memcmp(header.magic, "LSGB", 4))
+        r.fail("not a graph description");
+    if (header.version != kBinaryVersion)
+        r.fail("unsupported version " + std::to_string(header.version));
+    if (header.nodeCount >= kDestinationType || header.typeCount >= kDestinationType)
+        r.fail("too many nodes");
+    r.setStrings(header.stringBytes);
+
+    NodeRegistry & registry = NodeRegistry::Instance();
+    GraphDescription g;
+
+    // resolve each type, and its slots, once
+    std::vector<std::vector<int>> paramRemaps(header.typeCount);
+    std::vector<std::vector<int>> settingRemaps(header.typeCount);
+    std::vector<std::vector<std::string>> writtenParams(header.typeCount);
+    std::vector<std::vector<std::string>> writtenSettings(header.typeCount);
+    g._types.reserve(header.typeCount);
+    for (uint32_t t = 0; t < header.typeCount; ++t)
+    {
+        std::string name = r.string(r.read<uint32_t>());
+        uint16_t paramCount = r.read<uint16_t>();
+        uint16_t settingCount = r.read<uint16_t>();
+        for (int i = 0; i < paramCount; ++i)
+            writtenParams[t].push_back(r.string(r.read<uint32_t>()));
+        for (int i = 0; i < settingCount; ++i)
+            writtenSettings[t].push_back(r.string(r.read<uint32_t>()));
+
+        int registryIndex = registry.TypeIndex(name);
+        if (registryIndex < 0)
+            r.fail("unknown node type " + name);
+
+        AudioNodeDescriptor const * desc = registry.Descriptor(registryIndex);
+        paramRemaps[t] = SlotRemap(writtenParams[t], ParamNames(desc));
+        settingRemaps[t] = SlotRemap(writtenSettings[t], SettingNames(desc));
+        g._types.push_back({std::move(name), registryIndex});
+    }
+
+    g._nodes.reserve(header.nodeCount);
+    for (uint32_t n = 0; n < header.nodeCount; ++n)
+    {
+        std::string name = r.string(r.read<uint32_t>());
+        uint16_t type = r.read<uint16_t>();
+        r.read<uint16_t>();
+        if (type != kDestinationType && type >= header.typeCount)
+            r.fail("node type out of range");
+        g._nodeIndex[name] = static_cast<int>(n);
+        g._nodes.push_back({std::move(name), type});
+    }
+
+    g._ops.resize(header.opCount);
+    if (header.opCount)
+        r.read(g._ops.data(), header.opCount * sizeof(Op));
+
+    for (auto & op : g._ops)
+    {
+        if (op.node >= header.nodeCount)
+            r.fail("op node out of range");
+
+        const uint16_t type = g._nodes[op.node].type;
+        auto remap = [&](const std::vector<std::vector<int>> & remaps, const std::vector<std::vector<std::string>> & written)
+        {
+            if (type == kDestinationType || op.slot >= written[type].size())
+                r.fail("op slot out of range");
+            const std::vector<int> & m = remaps[type];
+            if (m.empty())
+                return;
+            if (m[op.slot] < 0)
+                r.fail(g._types[type].name + " no longer has " + written[type][op.slot]);
+            op.slot = static_cast<uint16_t>(m[op.slot]);
+        };
+
+        switch (op.code)
+        {
+            case OpCode::SetParam:
+            case OpCode::SetParamAtTime:
+                remap(paramRemaps, writtenParams);
+                break;
+            case OpCode::SetSetting:
+                if (op.aux > SettingEnum)
+                    r.fail("unknown setting value");
+                remap(settingRemaps, writtenSettings);
+                break;
+            case OpCode::ConnectParam:
+                remap(paramRemaps, writtenParams);
+                // fall through
+            case OpCode::Connect:
+                if (op.source >= header.nodeCount)
+                    r.fail("op source out of range");
+                break;
+            case OpCode::Start:
+            case OpCode::Stop:
+                break;
+            default:
+                r.fail("unknown op");
+        }
+    }
+
+    g._meta.reserve(header.metaCount);
+    for (uint32_t m = 0; m < header.metaCount; ++m)
+    {
+        uint32_t node = r.read<uint32_t>();
+        if (node >= header.nodeCount)
+            r.fail("meta node out of range");
+        std::string component = r.string(r.read<uint32_t>());
+        std::string key = r.string(r.read<uint32_t>());
+        std::string value = r.string(r.read<uint32_t>());
+        g._meta.push_back({static_cast<uint16_t>(node), std::move(component), std::move(key), std::move(value)});
+    }
+
+    return g;
+}
+
+//---------------------------------------------------------------------------
+// instantiation
+
+int GraphDescription::nodeIndex(const std::string & name) const
+{
+    auto i = _nodeIndex.find(name);
+    return i == _nodeIndex.end() ? -1 : i->second;
+}
+
+GraphDescription::Instance GraphDescription::instantiate(AudioContext & ac) const
+{
+    NodeRegistry & registry = NodeRegistry::Instance();
+    Instance instance;
+    instance.nodes.resize(_nodes.size());
+
+    for (size_t i = 0; i < _nodes.size(); ++i)
+    {
+        const Node & n = _nodes[i];
+        if (n.type == kDestinationType)
+        {
+            instance.nodes[i] = ac.destinationNode();
+            if (!instance.nodes[i])
+                throw std::runtime_error("graph description: the context has no destination for " + n.name);
+            continue;
+        }
+
+        const NodeType & t = _types[n.type];
+        AudioNode * node = registry.Create(t.registryIndex, ac);
+        if (!node)
+            throw std::runtime_error("graph description: " + t.name + " can't be created from a description");
+        DeleteNodeFn deleter = registry.Deleter(t.registryIndex);
+        instance.nodes[i] = std::shared_ptr<AudioNode>(node, [deleter](AudioNode * p) { deleter(p); });
+    }
+
+    AudioContext::GraphTransaction transaction;
+    for (const Op & op : _ops)
+    {
+        AudioNode * node = instance.nodes[op.node].get();
+        switch (op.code)
+        {
+            case OpCode::SetParam:
+                node->param(op.slot)->setValue(op.a);
+                break;
+
+            case OpCode::SetParamAtTime:
+                node->param(op.slot)->setValueAtTime(op.b, op.a);
+                break;
+
+            case OpCode::SetSetting:
+            {
+                std::shared_ptr<AudioSetting> setting = node->setting(op.slot);
+                switch (op.aux)
+                {
+                    case SettingBool: setting->setBool(op.bits != 0); break;
+                    case SettingInteger: setting->setUint32(op.bits); break;
+                    case SettingFloat: setting->setFloat(op.a); break;
+                    case SettingEnum: setting->setEnumeration(static_cast<int>(op.bits)); break;
+                }
+                break;
+            }
+
+            case OpCode::Connect:
+                transaction.connect(instance.nodes[op.node], instance.nodes[op.source], op.slot, op.aux);
+                break;
+
+            case OpCode::ConnectParam:
+                transaction.connectParam(node->param(op.slot), instance.nodes[op.source], op.aux);
+                break;
+
+            case OpCode::Start:
+            case OpCode::Stop:
+            {
+                // SampledAudioNode::start is absolute; schedule is relative, as AudioScheduledSourceNode::start is
+                if (SampledAudioNode * sampled = dynamic_cast<SampledAudioNode *>(node))
+                {
+                    if (op.code == OpCode::Start)
+                        sampled->schedule(op.a);
+                    else
+                        sampled->stop(op.a);
+                }
+                else if (AudioScheduledSourceNode * scheduled = dynamic_cast<AudioScheduledSourceNode *>(node))
+                {
+                    if (op.code == OpCode::Start)
+                        scheduled->start(op.a);
+                    else
+                        scheduled->stop(op.a);
+                }
+                else
+                    LOG_ERROR("graph description: %s is not a scheduled node", _nodes[op.node].name.c_str());
+                break;
+            }
+        }
+    }
+
+    if (transaction.size())
+        instance.connected = ac.commit(std::move(transaction));
+    else
+    {
+        std::promise<void> none;
+        none.set_value();
+        instance.connected = none.get_future();
+    }
+
+    return instance;
+}
+
+}  // namespace lab
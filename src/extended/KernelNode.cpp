@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/KernelNode.h"
+
+#include <algorithm>
+
+namespace lab
+{
+
+KernelParams::KernelParams(int paramCount)
+    : m_storage(AudioNode::ProcessingSizeInFrames * paramCount)
+    , m_pointers(paramCount, nullptr)
+    , m_shapes(paramCount)
+{
+}
+
+void KernelParams::evaluate(ContextRenderLock & r, std::vector<std::shared_ptr<AudioParam>> const & params, int bufferSize)
+{
+    const int count = std::min(static_cast<int>(params.size()), static_cast<int>(m_pointers.size()));
+    if (bufferSize * count > m_storage.size())
+        m_storage.allocate(bufferSize * count);
+
+    for (int p = 0; p < count; ++p)
+    {
+        float * values = m_storage.data() + p * bufferSize;
+        m_pointers[p] = values;
+
+        AudioParam & param = *params[p];
+        if (param.hasSampleAccurateValues())
+            m_shapes[p] = param.calculateSampleAccurateValues(r, values, bufferSize);
+        else
+        {
+            // a steady value is written out too, so that every kernel may simply read the arrays
+            m_shapes[p] = {AudioParamShape::Constant, param.value()};
+            std::fill(values, values + bufferSize, m_shapes[p].value);
+        }
+    }
+}
+
+}  // namespace lab
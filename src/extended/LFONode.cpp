@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/LFONode.h"
+
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/Macros.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+static char const * const s_lfoTypes[OscillatorType::_OscillatorTypeCount + 1] = {
+    "None", "Sine", "FastSine", "Square", "Sawtooth", "Falling Sawtooth",
+    "Triangle", "Custom", nullptr};
+
+static AudioParamDescriptor s_lfoParams[] = {
+    {"frequency", "FREQ", 1.0,        0.0,   1000.0},
+    {"amplitude", "AMPL", 1.0,        0.0, 100000.0},
+    {"bias",      "BIAS", 0.0, -1000000.0, 100000.0},
+    {nullptr, nullptr, 0.0, 0.0, 0.0}};
+
+static AudioSettingDescriptor s_lfoSettings[] = {
+    {"type",   "TYPE", SettingType::Enum, s_lfoTypes},
+    {"period", "PERD", SettingType::Integer, nullptr},
+    {nullptr, nullptr, SettingType::None, nullptr}};
+
+AudioNodeDescriptor * LFONode::desc()
+{
+    static AudioNodeDescriptor d {s_lfoParams, s_lfoSettings, 1};
+    return &d;
+}
+
+LFONode::LFONode(AudioContext & ac)
+    : AudioScheduledSourceNode(ac, *desc())
+    , _frequencyValues(AudioNode::ProcessingSizeInFrames)
+    , _amplitudeValues(AudioNode::ProcessingSizeInFrames)
+    , _biasValues(AudioNode::ProcessingSizeInFrames)
+{
+    _frequency = param("frequency");
+    _amplitude = param("amplitude");
+    _bias = param("bias");
+
+    _type = setting("type");
+    _type->setUint32(static_cast<uint32_t>(OscillatorType::SINE));
+    _period = setting("period");
+    _period->setUint32(16);
+
+    // allocates the control points here, rather than on the first render
+    output(0)->setControlPeriod(std::max(2u, _period->valueUint32()));
+
+    initialize();
+}
+
+LFONode::~LFONode()
+{
+    uninitialize();
+}
+
+OscillatorType LFONode::type() const
+{
+    return OscillatorType(_type->valueUint32());
+}
+
+void LFONode::setType(OscillatorType type)
+{
+    if (type >= OscillatorType::_OscillatorTypeCount)
+        throw std::out_of_range("LFO type exceeds known oscillator types");
+
+    _type->setUint32(static_cast<uint32_t>(type));
+}
+
+void LFONode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioNodeOutput * out = output(0).get();
+    out->setControlPeriod(std::max(2u, _period->valueUint32()));
+
+    const int period = out->controlPeriod();
+    const int pointCount = out->controlPointCount();
+    float * points = out->controlPoints();
+
+    const int renderStart = _self->_scheduler._renderOffset;
+    const int renderEnd = renderStart + _self->_scheduler._renderLength;
+
+    // the node's own parameters are evaluated at full rate only if they are automated or driven
+    const bool frequencyIsSampleAccurate = _frequency->hasSampleAccurateValues();
+    const bool amplitudeIsSampleAccurate = _amplitude->hasSampleAccurateValues();
+    const bool biasIsSampleAccurate = _bias->hasSampleAccurateValues();
+    if (frequencyIsSampleAccurate)
+        _frequency->calculateSampleAccurateValues(r, _frequencyValues.data(), bufferSize);
+    if (amplitudeIsSampleAccurate)
+        _amplitude->calculateSampleAccurateValues(r, _amplitudeValues.data(), bufferSize);
+    if (biasIsSampleAccurate)
+        _bias->calculateSampleAccurateValues(r, _biasValues.data(), bufferSize);
+
+    const double framesPerSecond = r.context()->sampleRate();
+    const OscillatorType type = static_cast<OscillatorType>(_type->valueUint32());
+
+    for (int i = 0; i < pointCount; ++i)
+    {
+        // the last point is the first frame of the next quantum
+        const int frame = i * period;
+        const bool active = frame >= renderStart && (frame < renderEnd || (frame == bufferSize && renderEnd == bufferSize));
+        if (!active)
+        {
+            points[i] = 0;
+            continue;
+        }
+
+        const int valueFrame = std::min(frame, bufferSize - 1);
+        const float frequency = frequencyIsSampleAccurate ? _frequencyValues[valueFrame] : _frequency->value();
+        const float amplitude = amplitudeIsSampleAccurate ? _amplitudeValues[valueFrame] : _amplitude->value();
+        const float bias = biasIsSampleAccurate ? _biasValues[valueFrame] : _bias->value();
+
+        const float phase = static_cast<float>(_phase);
+        float wave = 0;
+        switch (type)
+        {
+            case OscillatorType::SINE:
+            case OscillatorType::FAST_SINE: wave = std::sin(static_cast<float>(LAB_TAU) * phase); break;
+            case OscillatorType::SQUARE: wave = phase < 0.5f ? 1.f : -1.f; break;
+            case OscillatorType::SAWTOOTH: wave = 1.f - 2.f * phase; break;
+            case OscillatorType::FALLING_SAWTOOTH: wave = -2.f * phase; break;
+            case OscillatorType::TRIANGLE: wave = phase < 0.5f ? 4.f * phase - 1.f : 3.f - 4.f * phase; break;
+            default: break;
+        }
+        points[i] = bias + amplitude * wave;
+
+        // the phase at the last point carries over to the first point of the next quantum
+        if (i < pointCount - 1)
+        {
+            _phase += frequency * period / framesPerSecond;
+            _phase -= std::floor(_phase);
+        }
+    }
+
+    // audio inputs need the signal itself; connected parameters use the points
+    if (out->renderingFanOutCount() > 0)
+        out->expandControlPoints(r);
+}
+
+}  // namespace lab
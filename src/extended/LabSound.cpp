@@ -267,6 +267,11 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext& ac)->AudioNode* { return new DiodeNode(ac); },
             [](AudioNode* n) { delete n; });
         
+        reg.Register(
+            FDNReverbNode::static_name(), FDNReverbNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new FDNReverbNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             FunctionNode::static_name(), FunctionNode::desc(),
             [](AudioContext& ac)->AudioNode* { return new FunctionNode(ac); },
@@ -277,6 +282,16 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext& ac)->AudioNode* { return new GranulationNode(ac); },
             [](AudioNode* n) { delete n; });
         
+        reg.Register(
+            LFONode::static_name(), LFONode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new LFONode(ac); },
+            [](AudioNode * n) { delete n; });
+
+        reg.Register(
+            MultiTapDelayNode::static_name(), MultiTapDelayNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new MultiTapDelayNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             NoiseNode::static_name(), NoiseNode::desc(),
            [](AudioContext& ac)->AudioNode* { return new NoiseNode(ac); },
@@ -287,6 +302,11 @@ void LabSoundRegistryInit(lab::NodeRegistry& reg)
             [](AudioContext & ac) -> AudioNode * { return new PeakCompNode(ac); },
             [](AudioNode * n) { delete n; });
 
+        reg.Register(
+            PolyphonicNode::static_name(), PolyphonicNode::desc(),
+            [](AudioContext & ac) -> AudioNode * { return new PolyphonicNode(ac); },
+            [](AudioNode * n) { delete n; });
+
         reg.Register(
             PolyBLEPNode::static_name(), PolyBLEPNode::desc(),
             [](AudioContext & ac) -> AudioNode * { return new PolyBLEPNode(ac); },
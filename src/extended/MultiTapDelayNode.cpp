@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/MultiTapDelayNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioSetting.h"
+
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/Assertions.h"
+#include "internal/AudioUtilities.h"
+#include "internal/DelayLine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace lab
+{
+
+static char const * const s_multiTapInterpolations[static_cast<int>(DelayInterpolation::_Count) + 1] = {
+    "Linear", "Cubic", "Allpass", nullptr};
+
+static AudioParamDescriptor s_multiTapParams[] = {
+    {"delayTime1", "DLY1", 0.0, 0.0, 1000.0},
+    {"gain1",      "GAN1", 1.0, -10.0, 10.0},
+    {"delayTime2", "DLY2", 0.0, 0.0, 1000.0},
+    {"gain2",      "GAN2", 0.0, -10.0, 10.0},
+    {"delayTime3", "DLY3", 0.0, 0.0, 1000.0},
+    {"gain3",      "GAN3", 0.0, -10.0, 10.0},
+    {"delayTime4", "DLY4", 0.0, 0.0, 1000.0},
+    {"gain4",      "GAN4", 0.0, -10.0, 10.0},
+    {nullptr, nullptr, 0.0, 0.0, 0.0}};
+
+static AudioSettingDescriptor s_multiTapSettings[] = {
+    {"interpolation", "INTP", SettingType::Enum, s_multiTapInterpolations},
+    {nullptr, nullptr, SettingType::None, nullptr}};
+
+AudioNodeDescriptor * MultiTapDelayNode::desc()
+{
+    static AudioNodeDescriptor d {s_multiTapParams, s_multiTapSettings, 1};
+    return &d;
+}
+
+struct MultiTapDelayNode::Line
+{
+    DelayLine delayLine;
+    DelayLine::Tap taps[TapCount];
+};
+
+MultiTapDelayNode::MultiTapDelayNode(AudioContext & ac, double maxDelayTime, int maxChannels)
+    : AudioNode(ac, *desc())
+    , _maxDelayTime(std::max(0.0, maxDelayTime))
+    , _tapOutput(AudioNode::ProcessingSizeInFrames)
+{
+    addInput(std::unique_ptr<AudioNodeInput>(new AudioNodeInput(this)));
+
+    static char const * const timeNames[TapCount] = {"delayTime1", "delayTime2", "delayTime3", "delayTime4"};
+    static char const * const gainNames[TapCount] = {"gain1", "gain2", "gain3", "gain4"};
+    for (int t = 0; t < TapCount; ++t)
+    {
+        _delayTimes[t] = param(timeNames[t]);
+        _gains[t] = param(gainNames[t]);
+        _delayFrames[t].allocate(AudioNode::ProcessingSizeInFrames);
+        _gainValues[t].allocate(AudioNode::ProcessingSizeInFrames);
+    }
+
+    _interpolation = setting("interpolation");
+
+    // the lines are allocated here, so that rendering never allocates
+    const int maxDelayFrames = static_cast<int>(AudioUtilities::timeToSampleFrame(_maxDelayTime, ac.sampleRate()));
+    _lines.resize(std::max(1, maxChannels));
+    for (auto & line : _lines)
+    {
+        line.reset(new Line);
+        line->delayLine.allocate(maxDelayFrames, AudioNode::ProcessingSizeInFrames);
+    }
+
+    initialize();
+}
+
+MultiTapDelayNode::~MultiTapDelayNode()
+{
+    uninitialize();
+}
+
+std::shared_ptr<AudioParam> MultiTapDelayNode::delayTime(int tap) const
+{
+    if (tap < 0 || tap >= TapCount)
+        throw std::out_of_range("MultiTapDelayNode tap index out of range");
+    return _delayTimes[tap];
+}
+
+std::shared_ptr<AudioParam> MultiTapDelayNode::gain(int tap) const
+{
+    if (tap < 0 || tap >= TapCount)
+        throw std::out_of_range("MultiTapDelayNode tap index out of range");
+    return _gains[tap];
+}
+
+void MultiTapDelayNode::process(ContextRenderLock & r, int bufferSize)
+{
+    AudioBus * outputBus = output(0)->bus(r);
+    ASSERT(outputBus);
+
+    if (!isInitialized() || !input(0)->isConnected())
+    {
+        outputBus->zero();
+        return;
+    }
+
+    AudioBus * inputBus = input(0)->bus(r);
+    const int channelCount = inputBus->numberOfChannels();
+    if (!channelCount)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    if (outputBus->numberOfChannels() != channelCount)
+    {
+        output(0)->setNumberOfChannels(r, channelCount);
+        outputBus = output(0)->bus(r);
+    }
+
+    const float sampleRate = r.context()->sampleRate();
+
+    ASSERT(bufferSize <= AudioNode::ProcessingSizeInFrames);
+    const int frames = std::min(bufferSize, static_cast<int>(AudioNode::ProcessingSizeInFrames));
+    const DelayInterpolation interpolation = static_cast<DelayInterpolation>(_interpolation->valueUint32());
+
+    // The taps are evaluated once and read from every channel's line.
+    AudioParamShape timeShapes[TapCount];
+    AudioParamShape gainShapes[TapCount];
+    bool tapIsActive[TapCount];
+    for (int t = 0; t < TapCount; ++t)
+    {
+        if (_gains[t]->hasSampleAccurateValues())
+            gainShapes[t] = _gains[t]->calculateSampleAccurateValues(r, _gainValues[t].data(), frames);
+        else
+            gainShapes[t] = {AudioParamShape::Constant, _gains[t]->value()};
+
+        tapIsActive[t] = !gainShapes[t].isConstant() || gainShapes[t].value != 0.f;
+        if (!tapIsActive[t])
+            continue;
+
+        if (_delayTimes[t]->hasSampleAccurateValues())
+            timeShapes[t] = _delayTimes[t]->calculateSampleAccurateValues(r, _delayFrames[t].data(), frames);
+        else
+            timeShapes[t] = {AudioParamShape::Constant, _delayTimes[t]->value()};
+
+        // the line clamps the delay to its length
+        if (!timeShapes[t].isConstant())
+            VectorMath::vsmul(_delayFrames[t].data(), 1, &sampleRate, _delayFrames[t].data(), 1, frames);
+    }
+
+    const int lineCount = std::min(channelCount, static_cast<int>(_lines.size()));
+    for (int c = lineCount; c < channelCount; ++c)
+        outputBus->channel(c)->zero();
+
+    for (int c = 0; c < lineCount; ++c)
+    {
+        Line & line = *_lines[c];
+        float * destination = outputBus->channel(c)->mutableData();
+        line.delayLine.write(inputBus->channel(c)->data(), frames);
+
+        bool first = true;
+        for (int t = 0; t < TapCount; ++t)
+        {
+            if (!tapIsActive[t])
+                continue;
+
+            float * tapOutput = _tapOutput.data();
+            if (timeShapes[t].isConstant())
+                line.delayLine.read(line.taps[t], interpolation, static_cast<double>(timeShapes[t].value) * sampleRate, tapOutput, frames);
+            else
+                line.delayLine.read(line.taps[t], interpolation, _delayFrames[t].data(), tapOutput, frames);
+
+            if (gainShapes[t].isConstant())
+            {
+                if (first)
+                    VectorMath::vsmul(tapOutput, 1, &gainShapes[t].value, destination, 1, frames);
+                else
+                    VectorMath::vsma(tapOutput, 1, &gainShapes[t].value, destination, 1, frames);
+            }
+            else if (first)
+                VectorMath::vmul(tapOutput, 1, _gainValues[t].data(), 1, destination, 1, frames);
+            else
+            {
+                VectorMath::vmul(tapOutput, 1, _gainValues[t].data(), 1, tapOutput, 1, frames);
+                VectorMath::vadd(tapOutput, 1, destination, 1, destination, 1, frames);
+            }
+            first = false;
+        }
+
+        if (first)
+            memset(destination, 0, sizeof(float) * bufferSize);
+    }
+
+    outputBus->clearSilentFlag();
+}
+
+void MultiTapDelayNode::reset(ContextRenderLock &)
+{
+    for (auto & line : _lines)
+    {
+        line->delayLine.reset();
+        for (auto & tap : line->taps)
+            tap = {};
+    }
+}
+
+}  // namespace lab
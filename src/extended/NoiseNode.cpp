@@ -8,6 +8,10 @@
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSetting.h"
 
+#include "internal/RandomGenerator.h"
+
+#include <algorithm>
+
 using namespace std;
 using namespace lab;
 
@@ -17,7 +21,10 @@ namespace lab
 static char const * const s_noiseTypes[NoiseNode::NoiseType::_Count + 1] = {
     "White", "Pink", "Brown", nullptr};
 
-static AudioSettingDescriptor s_nSettings[] = {{"type", "TYPE", SettingType::Enum, s_noiseTypes}, nullptr};
+static AudioSettingDescriptor s_nSettings[] = {
+    {"type", "TYPE", SettingType::Enum, s_noiseTypes},
+    {"seed", "SEED", SettingType::Integer, nullptr},
+    {nullptr, nullptr, SettingType::None, nullptr}};
 
 AudioNodeDescriptor * NoiseNode::desc()
 {
@@ -29,6 +36,14 @@ NoiseNode::NoiseNode(AudioContext & ac)
     : AudioScheduledSourceNode(ac, *desc())
 {
     _type = setting("type");
+    _seed = setting("seed");
+    _seed->setValueChanged([this]() { _reseed = true; });
+
+    // a generator for every channel the output could have, so rendering never allocates one
+    for (int i = 0; i < AudioBus::MaxChannels; ++i)
+        _generators.emplace_back(new RandomGenerator());
+    reseed();
+
     initialize();
 }
 
@@ -50,6 +65,24 @@ NoiseNode::NoiseType NoiseNode::type() const
     return NoiseType(_type->valueUint32());
 }
 
+uint32_t NoiseNode::seed() const
+{
+    return _seed->valueUint32();
+}
+
+void NoiseNode::setSeed(uint32_t seed)
+{
+    _seed->setUint32(seed);
+}
+
+void NoiseNode::reseed()
+{
+    // each channel's stream is seeded from the seed and the channel index
+    const uint32_t seed = _seed->valueUint32();
+    for (size_t i = 0; i < _generators.size(); ++i)
+        _generators[i]->seed(seed + static_cast<uint32_t>(i) * 0x9e3779b9u);
+}
+
 void NoiseNode::process(ContextRenderLock &r, int bufferSize)
 {
     AudioBus * outputBus = output(0)->bus(r);
@@ -69,64 +102,33 @@ void NoiseNode::process(ContextRenderLock &r, int bufferSize)
         return;
     }
 
-    float * destP = outputBus->channel(0)->mutableData();
-    if (!destP) {
-        outputBus->zero();
-        return;
-    }
-
-    // Start rendering at the correct offset.
-    destP += quantumFrameOffset;
-    int n = nonSilentFramesToProcess;
+    const int numberOfChannels = std::min(outputBus->numberOfChannels(), static_cast<int>(_generators.size()));
+    if (_reseed.exchange(false))
+        reseed();
 
-    switch (NoiseType(_type->valueUint32()))
+    const NoiseType noiseType = NoiseType(_type->valueUint32());
+    for (int c = 0; c < numberOfChannels; ++c)
     {
-            // reference: http://noisehack.com/generate-noise-web-audio-api/
-        case WHITE:
-            while (n--)
-            {
-                float white = ((float) ((whiteSeed & 0x7fffffff) - 0x40000000)) * (float) (1.0f / 0x40000000);
-                white = (white * 0.5f) - 1.0f;
-                *destP++ = white;
-                whiteSeed = whiteSeed * 435898247 + 382842987;
-            }
-            break;
-        case PINK:
-            while (n--)
-            {
-                float white = ((float) ((whiteSeed & 0x7fffffff) - 0x40000000)) * (float) (1.0f / 0x40000000);
-                white = (white * 0.5f) - 1.0f;
-                whiteSeed = whiteSeed * 435898247 + 382842987;
-
-                pink0 = 0.99886f * pink0 + white * 0.0555179f;
-                pink1 = 0.99332f * pink1 + white * 0.0750759f;
-                pink2 = 0.96900f * pink2 + white * 0.1538520f;
-                pink3 = 0.86650f * pink3 + white * 0.3104856f;
-                pink4 = 0.55000f * pink4 + white * 0.5329522f;
-                pink5 = -0.7616f * pink5 - white * 0.0168980f;
-                *destP++ = (pink0 + pink1 + pink2 + pink3 + pink4 + pink5 + pink6 + (white * 0.5362f)) * 0.11f;  // .11 roughly compensates gain
-                pink6 = white * 0.115926f;
-            }
-            break;
-        case BROWN:
-            while (n--)
-            {
-                float white = ((float) ((whiteSeed & 0x7fffffff) - 0x40000000)) * (float) (1.0f / 0x40000000);
-                white = (white * 0.5f) - 1.0f;
-                whiteSeed = whiteSeed * 435898247 + 382842987;
-                float brown = (lastBrown + (0.02f * white)) / 1.02f;
-                *destP++ = brown * 3.5f;  // roughly compensate for gain
-                lastBrown = brown;
-            }
-            break;
-        default:
-            throw std::invalid_argument("Invalid type specified");
+        // Start rendering at the correct offset.
+        float * destP = outputBus->channel(c)->mutableData() + quantumFrameOffset;
+        RandomGenerator & generator = *_generators[c];
+
+        // reference: http://noisehack.com/generate-noise-web-audio-api/
+        switch (noiseType)
+        {
+            case WHITE: generator.white(destP, nonSilentFramesToProcess); break;
+            case PINK: generator.pink(destP, nonSilentFramesToProcess); break;
+            case BROWN: generator.brown(destP, nonSilentFramesToProcess); break;
+            default:
+                throw std::invalid_argument("Invalid type specified");
+        }
     }
     outputBus->clearSilentFlag();
 }
 
 void NoiseNode::reset(ContextRenderLock &)
 {
+    reseed();
 }
 
 bool NoiseNode::propagatesSilence(ContextRenderLock & r) const
@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "LabSound/extended/PolyphonicNode.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioNodeInput.h"
+#include "LabSound/core/AudioNodeOutput.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioScheduledSourceNode.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/core/SampledAudioNode.h"
+#include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/Registry.h"
+
+#include "concurrentqueue/concurrentqueue.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace lab
+{
+
+static char const * const s_stealing[] = {"None", "Oldest", "Quietest", nullptr};
+
+static AudioSettingDescriptor s_polyphonicSettings[] = {
+    {"stealing", "STEL", SettingType::Enum, s_stealing},
+    {nullptr, nullptr, SettingType::None, nullptr}};
+
+AudioNodeDescriptor * PolyphonicNode::desc()
+{
+    static AudioNodeDescriptor d {nullptr, s_polyphonicSettings, 2};
+    return &d;
+}
+
+namespace
+{
+    enum VoiceState : int
+    {
+        Idle,
+        Held,
+        Releasing
+    };
+
+    // a releasing voice whose output stays below about -100 dB for this many
+    // quanta has finished its release
+    const float kSilentLevel = 1e-5f;
+    const int kSilentQuantaToIdle = 8;
+
+    struct Voice
+    {
+        GraphDescription::Instance instance;
+
+        // connected to the voice's output node, but not one of the polyphonic
+        // node's inputs, so that it is pulled only while the voice sounds
+        std::shared_ptr<AudioNodeInput> input;
+
+        // cached for the default note handlers
+        std::vector<std::shared_ptr<AudioParam>> gates;
+        std::vector<std::shared_ptr<AudioParam>> velocities;
+        std::vector<AudioScheduledSourceNode *> scheduled;
+
+        // written by the thread starting and ending notes, read by the render thread
+        std::atomic<int> state {Idle};
+        double releaseTime = 0;  // context time; published by the store to state
+
+        // written by the render thread
+        std::atomic<float> level {0.f};
+        int silentQuanta = 0;
+
+        // used only by the thread starting and ending notes
+        int key = -1;
+        uint64_t order = 0;
+    };
+
+    // The voices of one setVoices call. The render thread and the note thread
+    // share a bank through shared pointers; a bank the render thread retires is
+    // returned to be released off the render thread.
+    struct VoiceBank
+    {
+        std::vector<std::unique_ptr<Voice>> voices;
+    };
+
+}  // namespace
+
+struct PolyphonicNode::Internals
+{
+    explicit Internals(AudioContext & ac)
+        : ac(ac.audioContextInterface())
+    {
+    }
+
+    std::weak_ptr<AudioContext::AudioContextInterface> ac;
+
+    // note thread
+    std::mutex noteMutex;
+    std::shared_ptr<VoiceBank> bank;
+    float sampleRate = 44100.f;
+    uint64_t nextOrder = 1;
+    VoiceHandler onStart;
+    VoiceHandler onRelease;
+
+    // render thread
+    std::shared_ptr<VoiceBank> renderBank;
+
+    moodycamel::ConcurrentQueue<std::shared_ptr<VoiceBank>> incoming;
+    moodycamel::ConcurrentQueue<std::shared_ptr<VoiceBank>> retired;
+
+    double now() const
+    {
+        auto i = ac.lock();
+        return i ? i->currentTime() : 0.;
+    }
+};
+
+static void DefaultStart(Voice & voice, float velocity, double time, double when, float sampleRate)
+{
+    // drop the gate for one sample so that a voice taken over while its gate
+    // is still open retriggers
+    for (auto & gate : voice.gates)
+    {
+        gate->setValueAtTime(0.f, static_cast<float>(time));
+        gate->setValueAtTime(1.f, static_cast<float>(time + 1.0 / sampleRate));
+    }
+    for (auto & v : voice.velocities)
+        v->setValueAtTime(velocity, static_cast<float>(time));
+
+    // SampledAudioNode::start is absolute; schedule is relative, as AudioScheduledSourceNode::start is
+    for (AudioScheduledSourceNode * node : voice.scheduled)
+    {
+        if (SampledAudioNode * sampled = dynamic_cast<SampledAudioNode *>(node))
+            sampled->schedule(static_cast<float>(when));
+        else
+            node->start(static_cast<float>(when));
+    }
+}
+
+static void DefaultRelease(Voice & voice, double time, double when)
+{
+    for (auto & gate : voice.gates)
+        gate->setValueAtTime(0.f, static_cast<float>(time));
+
+    if (!voice.gates.empty())
+        return;
+
+    for (AudioScheduledSourceNode * node : voice.scheduled)
+        node->stop(static_cast<float>(when));
+}
+
+PolyphonicNode::PolyphonicNode(AudioContext & ac)
+    : AudioNode(ac, *desc())
+    , _internals(new Internals(ac))
+{
+    _stealing = setting("stealing");
+    _stealing->setEnumeration(static_cast<int>(VoiceStealing::Oldest));
+    initialize();
+}
+
+PolyphonicNode::~PolyphonicNode()
+{
+    uninitialize();
+}
+
+void PolyphonicNode::setVoices(AudioContext & ac, std::shared_ptr<const GraphDescription> voice,
+                               const std::string & outputNode, int count)
+{
+    if (!voice)
+        throw std::invalid_argument("PolyphonicNode: no voice description");
+
+    const int outputIndex = voice->nodeIndex(outputNode);
+    if (outputIndex < 0)
+        throw std::invalid_argument("PolyphonicNode: the voice has no node named " + outputNode);
+
+    for (const GraphDescription::Node & n : voice->nodes())
+        if (n.type == GraphDescription::kDestinationType)
+            throw std::invalid_argument("PolyphonicNode: a voice can't use the destination, " + n.name);
+
+    // all of the instancing happens here, on the calling thread
+    auto bank = std::make_shared<VoiceBank>();
+    bank->voices.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        std::unique_ptr<Voice> v(new Voice);
+        v->instance = voice->instantiate(ac);
+        if (!v->instance.nodes[outputIndex]->numberOfOutputs())
+            throw std::invalid_argument("PolyphonicNode: the voice output " + outputNode + " has no outputs");
+        v->input = std::make_shared<AudioNodeInput>(this);
+
+        for (auto & node : v->instance.nodes)
+        {
+            if (auto gate = node->param("gate"))
+                v->gates.push_back(gate);
+            if (auto velocity = node->param("velocity"))
+                v->velocities.push_back(velocity);
+            if (auto scheduled = dynamic_cast<AudioScheduledSourceNode *>(node.get()))
+                v->scheduled.push_back(scheduled);
+        }
+        bank->voices.emplace_back(std::move(v));
+    }
+
+    AudioContext::GraphTransaction transaction;
+    for (auto & v : bank->voices)
+        transaction.connectInput(v->input, v->instance.nodes[outputIndex]);
+    ac.commit(std::move(transaction));
+
+    std::shared_ptr<VoiceBank> old;
+    while (_internals->retired.try_dequeue(old))
+        old.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(_internals->noteMutex);
+        _internals->bank = bank;
+        _internals->sampleRate = ac.sampleRate();
+    }
+    _internals->incoming.enqueue(std::move(bank));
+}
+
+void PolyphonicNode::setVoiceHandlers(VoiceHandler onStart, VoiceHandler onRelease)
+{
+    std::lock_guard<std::mutex> lock(_internals->noteMutex);
+    _internals->onStart = onStart;
+    _internals->onRelease = onRelease;
+}
+
+int PolyphonicNode::noteOn(int key, float velocity, double when)
+{
+    std::lock_guard<std::mutex> lock(_internals->noteMutex);
+    VoiceBank * bank = _internals->bank.get();
+    if (!bank || bank->voices.empty())
+        return -1;
+
+    // prefer an idle voice, then the voice that has been releasing longest,
+    // then steal a held one
+    int idle = -1, releasing = -1, oldest = -1, quietest = -1;
+    for (int i = 0; i < static_cast<int>(bank->voices.size()); ++i)
+    {
+        const Voice & v = *bank->voices[i];
+        const int state = v.state.load(std::memory_order_acquire);
+        if (state == Idle)
+        {
+            idle = i;
+            break;
+        }
+        if (state == Releasing)
+        {
+            if (releasing < 0 || v.releaseTime < bank->voices[releasing]->releaseTime)
+                releasing = i;
+        }
+        else
+        {
+            if (oldest < 0 || v.order < bank->voices[oldest]->order)
+                oldest = i;
+            if (quietest < 0 || v.level.load(std::memory_order_relaxed) < bank->voices[quietest]->level.load(std::memory_order_relaxed))
+                quietest = i;
+        }
+    }
+
+    int chosen = idle >= 0 ? idle : releasing;
+    if (chosen < 0)
+    {
+        switch (VoiceStealing(_stealing->valueUint32()))
+        {
+            case VoiceStealing::Oldest: chosen = oldest; break;
+            case VoiceStealing::Quietest: chosen = quietest; break;
+            default: break;
+        }
+    }
+    if (chosen < 0)
+        return -1;
+
+    Voice & v = *bank->voices[chosen];
+    v.key = key;
+    v.order = _internals->nextOrder++;
+
+    const double time = _internals->now() + when;
+    if (_internals->onStart)
+        _internals->onStart(v.instance, key, velocity, when);
+    else
+        DefaultStart(v, velocity, time, when, _internals->sampleRate);
+
+    // a voice going idle on the render thread meanwhile is simply taken
+    v.state.store(Held, std::memory_order_release);
+    return chosen;
+}
+
+void PolyphonicNode::release(int index, double when)
+{
+    Voice & v = *_internals->bank->voices[index];
+    const double time = _internals->now() + when;
+    if (_internals->onRelease)
+        _internals->onRelease(v.instance, v.key, 0.f, when);
+    else
+        DefaultRelease(v, time, when);
+
+    v.key = -1;
+    v.releaseTime = time;
+    v.state.store(Releasing, std::memory_order_release);
+}
+
+void PolyphonicNode::noteOff(int key, double when)
+{
+    std::lock_guard<std::mutex> lock(_internals->noteMutex);
+    VoiceBank * bank = _internals->bank.get();
+    if (!bank)
+        return;
+
+    for (int i = 0; i < static_cast<int>(bank->voices.size()); ++i)
+    {
+        const Voice & v = *bank->voices[i];
+        if (v.key == key && v.state.load(std::memory_order_acquire) == Held)
+            release(i, when);
+    }
+}
+
+void PolyphonicNode::allNotesOff(double when)
+{
+    std::lock_guard<std::mutex> lock(_internals->noteMutex);
+    VoiceBank * bank = _internals->bank.get();
+    if (!bank)
+        return;
+
+    for (int i = 0; i < static_cast<int>(bank->voices.size()); ++i)
+        if (bank->voices[i]->state.load(std::memory_order_acquire) == Held)
+            release(i, when);
+}
+
+int PolyphonicNode::voiceCount() const
+{
+    std::lock_guard<std::mutex> lock(_internals->noteMutex);
+    return _internals->bank ? static_cast<int>(_internals->bank->voices.size()) : 0;
+}
+
+int PolyphonicNode::sounding() const
+{
+    std::lock_guard<std::mutex> lock(_internals->noteMutex);
+    int count = 0;
+    if (_internals->bank)
+        for (auto & v : _internals->bank->voices)
+            if (v->state.load(std::memory_order_relaxed) != Idle)
+                ++count;
+    return count;
+}
+
+void PolyphonicNode::process(ContextRenderLock & r, int bufferSize)
+{
+    std::shared_ptr<VoiceBank> bank;
+    while (_internals->incoming.try_dequeue(bank))
+    {
+        if (_internals->renderBank)
+            _internals->retired.enqueue(std::move(_internals->renderBank));
+        _internals->renderBank = std::move(bank);
+    }
+
+    AudioBus * outputBus = output(0)->bus(r);
+    outputBus->zero();
+
+    if (!isInitialized() || !_internals->renderBank)
+        return;
+
+    const double now = r.context()->currentTime();
+    bool sounding = false;
+
+    for (auto & vp : _internals->renderBank->voices)
+    {
+        Voice & v = *vp;
+        const int state = v.state.load(std::memory_order_acquire);
+        if (state == Idle)
+            continue;
+
+        // only the voices that are sounding are pulled; the rest of the
+        // bank is outside of the render traversal entirely
+        AudioBus * voiceBus = v.input->pull(r, nullptr, bufferSize);
+        const float level = voiceBus ? voiceBus->maxAbsValue() : 0.f;
+        v.level.store(level, std::memory_order_relaxed);
+
+        if (voiceBus && !voiceBus->isSilent())
+        {
+            outputBus->sumFrom(*voiceBus);
+            sounding = true;
+        }
+
+        if (state == Held || now < v.releaseTime)
+        {
+            v.silentQuanta = 0;
+            continue;
+        }
+
+        v.silentQuanta = level < kSilentLevel ? v.silentQuanta + 1 : 0;
+
+        bool finished = !v.scheduled.empty();
+        for (AudioScheduledSourceNode * node : v.scheduled)
+        {
+            if (node->isPlayingOrScheduled())
+            {
+                finished = false;
+                break;
+            }
+        }
+
+        if (finished || v.silentQuanta >= kSilentQuantaToIdle)
+        {
+            // fails if the voice was taken by a new note in the meantime
+            int expected = Releasing;
+            if (v.state.compare_exchange_strong(expected, Idle, std::memory_order_acq_rel))
+            {
+                v.level.store(0.f, std::memory_order_relaxed);
+                v.silentQuanta = 0;
+            }
+        }
+    }
+
+    if (sounding)
+        outputBus->clearSilentFlag();
+}
+
+}  // namespace lab
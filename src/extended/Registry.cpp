@@ -1,6 +1,13 @@
 
 #include "LabSound/extended/Registry.h"
+#include "LabSound/core/AudioContext.h"
+#include "LabSound/core/AudioParam.h"
+#include "LabSound/core/AudioSetting.h"
+#include "LabSound/extended/AudioContextLock.h"
 
+#include "concurrentqueue/concurrentqueue.h"
+
+#include <atomic>
 #include <cstdio>
 #include <memory>
 #include <map>
@@ -27,9 +34,159 @@ struct NodeDescriptor
     DeleteNodeFn d;
 };
 
+// The released nodes of one type in one context
+struct NodePool
+{
+    DeleteNodeFn deleter = nullptr;
+    std::weak_ptr<AudioContext::AudioContextInterface> context;
+    std::atomic<int> const * capacity = nullptr;
+    std::atomic<bool> closed {false};
+
+    moodycamel::ConcurrentQueue<AudioNode *> free;
+    std::atomic<int> size {0};
+
+    // nodes whose last reference has been dropped, waiting to be reset and
+    // pooled, or deleted, by reclaim
+    moodycamel::ConcurrentQueue<AudioNode *> released;
+
+    // the values the type's nodes are constructed with, captured from the
+    // first node the pool creates
+    std::once_flag captured;
+    std::vector<float> params;
+    struct SettingValue
+    {
+        bool b;
+        uint32_t i;
+        float f;
+    };
+    std::vector<SettingValue> settings;
+
+    ~NodePool()
+    {
+        AudioNode * node;
+        while (free.try_dequeue(node))
+            deleter(node);
+        while (released.try_dequeue(node))
+            deleter(node);
+    }
+
+    void capture(AudioNode * node)
+    {
+        for (auto & p : node->params())
+            params.push_back(p->value());
+        for (auto & s : node->settings())
+            settings.push_back({s->valueBool(), s->valueUint32(), s->valueFloat()});
+    }
+
+    void restore(AudioNode * node) const
+    {
+        for (int i = 0; i < static_cast<int>(params.size()); ++i)
+        {
+            std::shared_ptr<AudioParam> p = node->param(i);
+            p->setValue(params[i]);
+            p->resetSmoothedValue();
+        }
+        for (int i = 0; i < static_cast<int>(settings.size()); ++i)
+        {
+            std::shared_ptr<AudioSetting> s = node->setting(i);
+            switch (s->type())
+            {
+                case SettingType::Bool: s->setBool(settings[i].b); break;
+                case SettingType::Integer: s->setUint32(settings[i].i); break;
+                case SettingType::Float: s->setFloat(settings[i].f); break;
+                case SettingType::Enum: s->setEnumeration(static_cast<int>(settings[i].i)); break;
+                default: break;
+            }
+        }
+    }
+
+    // Called where the last reference to an acquired node is released, which
+    // may be the render thread, so the node is only queued; reclaim resets or
+    // deletes it later.
+    static void release(std::shared_ptr<NodePool> const & pool, AudioNode * node)
+    {
+        pool->released.enqueue(node);
+    }
+
+    // Runs on a thread acquiring nodes. Released nodes are reset, under the
+    // render lock r, and pooled; those that can't be pooled, and all of them
+    // if r is null, are deleted.
+    void reclaim(ContextRenderLock * r)
+    {
+        AudioNode * node;
+        while (released.try_dequeue(node))
+        {
+            if (r
+                && !closed.load(std::memory_order_acquire)
+                && !context.expired()
+                && size.load(std::memory_order_relaxed) < capacity->load(std::memory_order_relaxed)
+                && node->resetForReuse(*r))
+            {
+                size.fetch_add(1, std::memory_order_relaxed);
+                free.enqueue(node);
+            }
+            else
+                deleter(node);
+        }
+    }
+
+    // closes the pool, deleting the nodes it holds
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        AudioNode * node;
+        while (free.try_dequeue(node))
+        {
+            size.fetch_sub(1, std::memory_order_relaxed);
+            deleter(node);
+        }
+        reclaim(nullptr);
+    }
+};
+
 struct NodeRegistry::Detail
 {
-    std::map<std::string, NodeDescriptor> descriptors;
+    std::map<std::string, int> indices;
+    std::vector<NodeDescriptor> descriptors;
+
+    // keyed by context id and type index
+    std::mutex poolMutex;
+    std::map<std::pair<int, int>, std::shared_ptr<NodePool>> pools;
+    std::atomic<int> poolCapacity {256};
+
+    // Closed pools whose nodes may still be in use. They are kept here until
+    // their last node is deleted, so that the render thread never deletes a pool.
+    std::vector<std::shared_ptr<NodePool>> closedPools;
+
+    void closePool(std::shared_ptr<NodePool> pool)
+    {
+        pool->close();
+        closedPools.push_back(std::move(pool));
+    }
+
+    void removeExpiredPools()
+    {
+        for (auto i = pools.begin(); i != pools.end();)
+        {
+            if (i->second->context.expired())
+            {
+                closePool(i->second);
+                i = pools.erase(i);
+            }
+            else
+                ++i;
+        }
+
+        // a closed pool only referred to from here has no nodes left in use
+        for (auto i = closedPools.begin(); i != closedPools.end();)
+        {
+            (*i)->reclaim(nullptr);
+            if (i->use_count() == 1)
+                i = closedPools.erase(i);
+            else
+                ++i;
+        }
+    }
 };
 
 
@@ -46,35 +203,177 @@ NodeRegistry::~NodeRegistry()
 bool NodeRegistry::Register(char const* const name, AudioNodeDescriptor* desc, CreateNodeFn c, DeleteNodeFn d)
 {
     printf("Registering %s\n", name);
-    _detail->descriptors[name] = { name, desc, c, d };
+    auto i = _detail->indices.find(name);
+    if (i != _detail->indices.end())
+    {
+        _detail->descriptors[i->second] = { name, desc, c, d };
+        return true;
+    }
+
+    _detail->indices[name] = static_cast<int>(_detail->descriptors.size());
+    _detail->descriptors.push_back({ name, desc, c, d });
     return true;
 }
 
 std::vector<std::string> NodeRegistry::Names() const
 {
     std::vector<std::string> names;
-    for (const auto& i : _detail->descriptors)
-        names.push_back(i.second.name);
+    for (const auto& i : _detail->indices)
+        names.push_back(i.first);
 
     return names;
 }
 
 lab::AudioNode* NodeRegistry::Create(const std::string& n, lab::AudioContext& ac)
 {
-    auto i = _detail->descriptors.find(n);
-    if (i == _detail->descriptors.end())
+    return Create(TypeIndex(n), ac);
+}
+
+AudioNodeDescriptor const * const NodeRegistry::Descriptor(const std::string & n) const
+{
+    return Descriptor(TypeIndex(n));
+}
+
+int NodeRegistry::TypeIndex(const std::string& n) const
+{
+    auto i = _detail->indices.find(n);
+    if (i == _detail->indices.end())
+        return -1;
+
+    return i->second;
+}
+
+int NodeRegistry::TypeCount() const
+{
+    return static_cast<int>(_detail->descriptors.size());
+}
+
+std::string const & NodeRegistry::Name(int typeIndex) const
+{
+    static const std::string none;
+    if (typeIndex < 0 || typeIndex >= TypeCount())
+        return none;
+
+    return _detail->descriptors[typeIndex].name;
+}
+
+lab::AudioNode* NodeRegistry::Create(int typeIndex, lab::AudioContext& ac)
+{
+    if (typeIndex < 0 || typeIndex >= TypeCount())
         return nullptr;
 
-    return i->second.c(ac);
+    return _detail->descriptors[typeIndex].c(ac);
 }
 
-AudioNodeDescriptor const * const NodeRegistry::Descriptor(const std::string & n) const
+AudioNodeDescriptor const * const NodeRegistry::Descriptor(int typeIndex) const
+{
+    if (typeIndex < 0 || typeIndex >= TypeCount())
+        return nullptr;
+
+    return _detail->descriptors[typeIndex].desc;
+}
+
+DeleteNodeFn NodeRegistry::Deleter(int typeIndex) const
 {
-    auto i = _detail->descriptors.find(n);
-    if (i == _detail->descriptors.end())
+    if (typeIndex < 0 || typeIndex >= TypeCount())
         return nullptr;
 
-    return i->second.desc;
+    return _detail->descriptors[typeIndex].d;
+}
+
+std::shared_ptr<AudioNode> NodeRegistry::Acquire(int typeIndex, AudioContext & ac)
+{
+    if (typeIndex < 0 || typeIndex >= TypeCount())
+        return {};
+
+    std::weak_ptr<AudioContext::AudioContextInterface> context = ac.audioContextInterface();
+    auto contextInterface = context.lock();
+    if (!contextInterface)
+        return {};
+
+    std::shared_ptr<NodePool> pool;
+    {
+        std::lock_guard<std::mutex> lock(_detail->poolMutex);
+        if (!_detail->closedPools.empty())
+            _detail->removeExpiredPools();
+
+        const std::pair<int, int> key {contextInterface->contextId(), typeIndex};
+        auto i = _detail->pools.find(key);
+        if (i != _detail->pools.end())
+            pool = i->second;
+        else
+        {
+            _detail->removeExpiredPools();
+            pool = std::make_shared<NodePool>();
+            pool->deleter = _detail->descriptors[typeIndex].d;
+            pool->context = context;
+            pool->capacity = &_detail->poolCapacity;
+            _detail->pools[key] = pool;
+        }
+    }
+
+    // the nodes released since the last acquire are reset here, rather than
+    // on whatever thread dropped them
+    if (pool->released.size_approx())
+    {
+        ContextRenderLock r(&ac, "NodeRegistry::Acquire");
+        pool->reclaim(&r);
+    }
+
+    AudioNode * node = nullptr;
+    if (pool->free.try_dequeue(node))
+    {
+        pool->size.fetch_sub(1, std::memory_order_relaxed);
+        pool->restore(node);
+    }
+    else
+    {
+        node = Create(typeIndex, ac);
+        if (!node)
+            return {};
+        std::call_once(pool->captured, [&]() { pool->capture(node); });
+    }
+
+    return std::shared_ptr<AudioNode>(node, [pool](AudioNode * n) { NodePool::release(pool, n); });
+}
+
+std::shared_ptr<AudioNode> NodeRegistry::Acquire(const std::string & n, AudioContext & ac)
+{
+    return Acquire(TypeIndex(n), ac);
+}
+
+void NodeRegistry::Reserve(int typeIndex, AudioContext & ac, int count)
+{
+    // acquiring all of them before releasing any creates count nodes
+    std::vector<std::shared_ptr<AudioNode>> nodes;
+    nodes.reserve(count);
+    for (int i = 0; i < count; ++i)
+        nodes.push_back(Acquire(typeIndex, ac));
+}
+
+void NodeRegistry::SetPoolCapacity(int capacity)
+{
+    _detail->poolCapacity.store(capacity);
+}
+
+void NodeRegistry::ClearPools(AudioContext & ac)
+{
+    auto contextInterface = ac.audioContextInterface().lock();
+    const int id = contextInterface ? contextInterface->contextId() : -1;
+
+    std::lock_guard<std::mutex> lock(_detail->poolMutex);
+    _detail->removeExpiredPools();
+    for (auto i = _detail->pools.begin(); i != _detail->pools.end();)
+    {
+        if (i->first.first == id)
+        {
+            // nodes released after this are deleted rather than pooled
+            _detail->closePool(i->second);
+            i = _detail->pools.erase(i);
+        }
+        else
+            ++i;
+    }
 }
 
 
@@ -179,33 +179,36 @@
 #include "LabSound/core/AudioBus.h"
 #include "LabSound/core/AudioSetting.h"
 
+#include "LabSound/extended/VectorMath.h"
+
+#include "internal/RandomGenerator.h"
+
+#include <algorithm>
 #include <math.h>
 #include <memory.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 
 using namespace std;
 using namespace lab;
 using namespace lab;
 
-inline uint32_t rnd(uint32_t n)
+// uniform in [0, n]
+inline uint32_t rnd(RandomGenerator & random, uint32_t n)
 {
-    if (n == 1)
-        return ((rand() & 0x7fff) > 0x3fff) ? 1 : 0;
-    return rand() % (n + 1);
+    return random.nextUint32(n);
 }
 
 #define PI 3.14159265f
 
-inline float frnd(float range)
+inline float frnd(RandomGenerator & random, float range)
 {
-    return (float) rnd(10000) / 10000 * range;
+    return random.nextFloat() * range;
 }
 
-inline float rndr(float from, float to)
+inline float rndr(RandomGenerator & random, float from, float to)
 {
-    return frnd(1) * (to - from) + from;
+    return random.nextFloat(from, to);
 }
 
 inline float sqr(float a)
@@ -221,6 +224,84 @@ inline float flurp(float a)
     return a / (1.0f - a);
 }
 
+// sfxr ran its oscillator and filters at eight times the output rate, and averaged
+// the supersamples. The engine now runs at the output rate; the waveforms are band
+// limited instead, and the filters are designed to match the supersampled ones.
+const int Supersampling = 8;
+
+const int SynthChunkFrames = 128;
+
+// the low pass filter coefficients are updated once per block of this many frames
+const int ControlFrames = 16;
+
+// the phaser delays up to 1023 supersamples, which is under 128 frames
+const int PhaserFrames = 256;
+
+// The highest oscillator increment is just under Nyquist, and the PolyBLEP divides by the increment.
+const float MaxIncrement = 0.4999f;
+
+// The PolyBLEP residual for a rising step of two at phase zero, for a phase t in [0, 1).
+inline float polyBlep(float t, float dt)
+{
+    if (t < dt)
+    {
+        const float x = t / dt;
+        return x + x - x * x - 1.f;
+    }
+    if (t > 1.f - dt)
+    {
+        const float x = (t - 1.f) / dt;
+        return x * x + x + x + 1.f;
+    }
+    return 0.f;
+}
+
+// The resonant low pass of sfxr is, per supersample,
+//     d += (x - p) * w;  d -= d * damping;  p += d;
+// which has two poles, the roots of z^2 - (1 + a - a w) z + a, where a = 1 - damping.
+// Over the supersamples of a frame they become z^8, so at the output rate the filter
+// has those poles, and a zero at Nyquist in place of the averaging of the supersamples:
+//     y[n] = b0 (x[n] + x[n-1]) + c1 y[n-1] - c2 y[n-2]
+// Its gain at DC is one, as before. As w is at most 0.1, the poles stay below Nyquist.
+// As w falls, the poles near one, and the filter is run in double precision to keep it stable.
+inline void lowPassCoefficients(float w, float damping, double & b0, double & c1, double & c2)
+{
+    const double a = 1.0 - damping;
+    const double half = 0.5 * (1.0 + a * (1.0 - w));
+    const double discriminant = half * half - a;
+
+    double sum;  // of the poles, raised to the eighth
+    if (discriminant < 0)
+    {
+        double re = half, im = sqrt(-discriminant);
+        for (int i = 0; i < 3; ++i)
+        {
+            const double squared = re * re - im * im;
+            im = 2.0 * re * im;
+            re = squared;
+        }
+        sum = 2.0 * re;
+    }
+    else
+    {
+        double z1 = half + sqrt(discriminant), z2 = half - sqrt(discriminant);
+        for (int i = 0; i < 3; ++i)
+        {
+            z1 *= z1;
+            z2 *= z2;
+        }
+        sum = z1 + z2;
+    }
+
+    // the product of the poles is a, raised to the eighth as c2
+    double product = a * a;
+    product *= product;
+
+    c1 = sum;
+    c2 = product * product;
+    b0 = 0.5 * (1.0 - sum + c2);
+}
+
 class SfxrNode::Sfxr
 {
 public:
@@ -262,12 +343,11 @@ public:
     float sound_vol;
 
     bool playing_sample;
-    int phase;
+    float phase;  // of the oscillator, in supersamples
     double fperiod;
     double fmaxperiod;
     double fslide;
     double fdslide;
-    int period;
     float square_duty;
     float square_slide;
     int env_stage;
@@ -277,11 +357,13 @@ public:
     float fphase;
     float fdphase;
     int iphase;
-    float phaser_buffer[1024];
+    float phaser_buffer[PhaserFrames];
     int ipp;
     float noise_buffer[32];
     float fltp;
-    float fltdp;
+    double fltp_x1;  // the previous input and outputs of the low pass filter
+    double fltp_y1;
+    double fltp_y2;
     float fltw;
     float fltw_d;
     float fltdmp;
@@ -297,17 +379,43 @@ public:
     int arp_limit;
     double arp_mod;
 
-    int wav_bits;
-    int wav_freq;
+    // the noise waveform is drawn from random, and the presets from presetRandom,
+    // so that the audio thread and the caller of a preset don't share a generator
+    RandomGenerator random;
+    RandomGenerator presetRandom {RandomGenerator::DefaultSeed + 1};
 
-    int file_sampleswritten;
-    float filesample;
-    int fileacc;
+    // the parameters of each frame, as they evolve over a chunk
+    struct Controls
+    {
+        alignas(16) float period[SynthChunkFrames];  // of the oscillator, in supersamples
+        alignas(16) float duty[SynthChunkFrames];
+        alignas(16) float envelope[SynthChunkFrames];
+        alignas(16) float phaserDelay[SynthChunkFrames];  // in frames
+        alignas(16) float highPass[SynthChunkFrames];     // the pole of the high pass filter
+        alignas(16) float lowPass[SynthChunkFrames];      // the w of the low pass filter
+    };
 
     void ResetParams();
     void ResetSample(bool restart);
     void PlaySample();
-    void SynthSample(size_t length, float * buffer, FILE * file);
+    void SynthSample(size_t length, float * buffer);
+
+private:
+    // As in sfxr, the phase counts supersamples, and the position in the cycle is the
+    // phase over the current period, so a changing period stretches the cycle in progress.
+    // Returns the position at the start of the frame, and advances the phase over it.
+    float Advance(float period)
+    {
+        if (phase >= period)
+            phase = fmodf(phase, period);
+        const float t = phase / period;
+        phase += Supersampling;
+        return t;
+    }
+
+    int EvolveControls(int frames, Controls & controls);
+    void Oscillate(int frames, const Controls & controls, float * buffer);
+    void Filter(int frames, const Controls & controls, float * buffer);
 };
 
 void SfxrNode::Sfxr::ResetParams()
@@ -345,8 +453,6 @@ void SfxrNode::Sfxr::ResetParams()
     p_arp_speed = 0.0f;
     p_arp_mod = 0.0f;
 
-    wav_bits = 16;
-    wav_freq = 44100;
     sound_vol = 0.5f;
     master_vol = 0.05f;
 }
@@ -356,7 +462,6 @@ void SfxrNode::Sfxr::ResetSample(bool restart)
     if (!restart)
         phase = 0;
     fperiod = 100.0 / (p_base_freq * p_base_freq + 0.001);
-    period = (int) fperiod;
     fmaxperiod = 100.0 / (p_freq_limit * p_freq_limit + 0.001);
     fslide = 1.0 - pow((double) p_freq_ramp, 3.0) * 0.01;
     fdslide = -pow((double) p_freq_dramp, 3.0) * 0.000001;
@@ -374,7 +479,9 @@ void SfxrNode::Sfxr::ResetSample(bool restart)
     {
         // reset filter
         fltp = 0.0f;
-        fltdp = 0.0f;
+        fltp_x1 = 0.0;
+        fltp_y1 = 0.0;
+        fltp_y2 = 0.0;
         fltw = pow(p_lpf_freq, 3.0f) * 0.1f;
         fltw_d = 1.0f + p_lpf_ramp * 0.0001f;
         fltdmp = 5.0f / (1.0f + pow(p_lpf_resonance, 2.0f) * 20.0f) * (0.01f + fltw);
@@ -400,11 +507,10 @@ void SfxrNode::Sfxr::ResetSample(bool restart)
         if (p_pha_ramp < 0.0f) fdphase = -fdphase;
         iphase = abs((int) fphase);
         ipp = 0;
-        for (int i = 0; i < 1024; i++)
+        for (int i = 0; i < PhaserFrames; i++)
             phaser_buffer[i] = 0.0f;
 
-        for (int i = 0; i < 32; i++)
-            noise_buffer[i] = frnd(2.0f) - 1.0f;
+        random.white(noise_buffer, 32);
 
         rep_time = 0;
         rep_limit = (int) (pow(1.0f - p_repeat_speed, 2.0f) * 20000 + 32);
@@ -419,12 +525,12 @@ void SfxrNode::Sfxr::PlaySample()
     playing_sample = true;
 }
 
-void SfxrNode::Sfxr::SynthSample(size_t length, float * buffer, FILE * file)
+int SfxrNode::Sfxr::EvolveControls(int frames, Controls & controls)
 {
-    for (int i = 0; i < length; i++)
+    for (int i = 0; i < frames; i++)
     {
         if (!playing_sample)
-            break;
+            return i;
 
         rep_time++;
         if (rep_limit != 0 && rep_time >= rep_limit)
@@ -454,11 +560,14 @@ void SfxrNode::Sfxr::SynthSample(size_t length, float * buffer, FILE * file)
             vib_phase += vib_speed;
             rfperiod = static_cast<float>(fperiod * (1.0 + sin(vib_phase) * vib_amp));
         }
-        period = (int) rfperiod;
-        if (period < 8) period = 8;
+        // sfxr's periods are whole supersamples
+        controls.period[i] = std::max(floorf(rfperiod), ceilf(Supersampling / MaxIncrement));
+
         square_duty += square_slide;
         if (square_duty < 0.0f) square_duty = 0.0f;
         if (square_duty > 0.5f) square_duty = 0.5f;
+        controls.duty[i] = square_duty;
+
         // volume envelope
         env_time++;
         if (env_time > env_length[env_stage])
@@ -471,14 +580,16 @@ void SfxrNode::Sfxr::SynthSample(size_t length, float * buffer, FILE * file)
         if (env_stage == 0)
             env_vol = (float) env_time / env_length[0];
         if (env_stage == 1)
-            env_vol = 1.0f + pow(1.0f - (float) env_time / env_length[1], 1.0f) * 2.0f * p_env_punch;
+            env_vol = 1.0f + (1.0f - (float) env_time / env_length[1]) * 2.0f * p_env_punch;
         if (env_stage == 2)
             env_vol = 1.0f - (float) env_time / env_length[2];
+        controls.envelope[i] = env_vol;
 
         // phaser step
         fphase += fdphase;
         iphase = abs((int) fphase);
         if (iphase > 1023) iphase = 1023;
+        controls.phaserDelay[i] = static_cast<float>(iphase) / Supersampling;
 
         if (flthp_d != 0.0f)
         {
@@ -486,103 +597,171 @@ void SfxrNode::Sfxr::SynthSample(size_t length, float * buffer, FILE * file)
             if (flthp < 0.00001f) flthp = 0.00001f;
             if (flthp > 0.1f) flthp = 0.1f;
         }
+        // the high pass pole applied once per supersample
+        float pole = 1.0f - flthp;
+        pole *= pole;
+        pole *= pole;
+        controls.highPass[i] = pole * pole;
+
+        // the low pass sweeps once per supersample
+        float sweep = fltw_d * fltw_d;
+        sweep *= sweep;
+        fltw *= sweep * sweep;
+        if (fltw < 0.0f) fltw = 0.0f;
+        if (fltw > 0.1f) fltw = 0.1f;
+        controls.lowPass[i] = fltw;
+    }
+    return frames;
+}
 
-        float ssample = 0.0f;
-        for (int si = 0; si < 8; si++)  // 8x supersampling
-        {
-            float sample = 0.0f;
-            phase++;
-            if (phase >= period)
-            {
-                //                phase=0;
-                phase %= period;
-                if (wave_type == NOISE)
-                    for (int i = 0; i < 32; i++)
-                        noise_buffer[i] = frnd(2.0f) - 1.0f;
-            }
-            // base waveform
-            float fp = (float) phase / period;
-            switch (wave_type)
+void SfxrNode::Sfxr::Oscillate(int frames, const Controls & controls, float * buffer)
+{
+    switch (wave_type)
+    {
+        case SQUARE:
+            for (int i = 0; i < frames; i++)
             {
-                case 0:  // square
-                    if (fp < square_duty)
-                        sample = 0.5f;
-                    else
-                        sample = -0.5f;
-                    break;
-                case 1:  // sawtooth
-                    sample = 1.0f - fp * 2;
-                    break;
-                case 2:  // sine
-                    sample = (float) sin(fp * 2 * PI);
-                    break;
-                case 3:  // noise
-                    sample = noise_buffer[phase * 32 / period];
-                    break;
+                const float dt = Supersampling / controls.period[i];
+                const float t = Advance(controls.period[i]);
+                const float duty = controls.duty[i];
+                float t2 = t - duty;
+                if (t2 < 0.0f) t2 += 1.0f;
+                // a rising step of one at the start of the cycle, and a falling one at the duty
+                buffer[i] = (t < duty ? 0.5f : -0.5f) + 0.5f * (polyBlep(t, dt) - polyBlep(t2, dt));
             }
-            // lp filter
-            float pp = fltp;
-            fltw *= fltw_d;
-            if (fltw < 0.0f) fltw = 0.0f;
-            if (fltw > 0.1f) fltw = 0.1f;
-            if (p_lpf_freq != 1.0f)
+            break;
+        case SAWTOOTH:
+            for (int i = 0; i < frames; i++)
             {
-                fltdp += (sample - fltp) * fltw;
-                fltdp -= fltdp * fltdmp;
+                const float dt = Supersampling / controls.period[i];
+                const float t = Advance(controls.period[i]);
+                buffer[i] = 1.0f - 2.0f * t + polyBlep(t, dt);
             }
-            else
+            break;
+        case SINE:
+            for (int i = 0; i < frames; i++)
+                buffer[i] = sinf(Advance(controls.period[i]) * 2 * PI);
+            break;
+        case NOISE:
+            // Each of the 32 noise values is held for a 32nd of a cycle, and they are
+            // drawn afresh every cycle. The values are averaged over each frame, which
+            // is what the supersampling approximated.
+            for (int i = 0; i < frames; i++)
             {
-                fltp = sample;
-                fltdp = 0.0f;
+                const float period = controls.period[i];
+                if (phase >= period)
+                {
+                    phase = fmodf(phase, period);
+                    random.white(noise_buffer, 32);
+                }
+
+                const float span = 32.0f * Supersampling / period;
+                float position = 32.0f * phase / period;
+                float remaining = span;
+                int index = std::min(static_cast<int>(position), 31);
+                float sum = 0.0f;
+                while (position + remaining >= static_cast<float>(index + 1))
+                {
+                    const float step = static_cast<float>(index + 1) - position;
+                    sum += noise_buffer[index] * step;
+                    remaining -= step;
+                    position = static_cast<float>(index + 1);
+                    if (++index == 32)
+                    {
+                        index = 0;
+                        position = 0.0f;
+                        random.white(noise_buffer, 32);
+                    }
+                }
+                sum += noise_buffer[index] * remaining;
+                buffer[i] = sum / span;
+                phase = (position + remaining) * period * (1.0f / 32.0f);
             }
-            fltp += fltdp;
+            break;
+        default:
+            memset(buffer, 0, sizeof(float) * frames);
+            break;
+    }
+}
+
+void SfxrNode::Sfxr::Filter(int frames, const Controls & controls, float * buffer)
+{
+    const bool lowPass = p_lpf_freq != 1.0f;
+    double x1 = fltp_x1;
+    double y1 = fltp_y1;
+    double y2 = fltp_y2;
+
+    for (int start = 0; start < frames; start += ControlFrames)
+    {
+        const int end = std::min(start + ControlFrames, frames);
+
+        double b0 = 1.0, c1 = 0.0, c2 = 0.0;
+        if (lowPass)
+            lowPassCoefficients(controls.lowPass[start], fltdmp, b0, c1, c2);
+
+        for (int i = start; i < end; i++)
+        {
+            float sample = buffer[i];
+
+            // lp filter
+            const float pp = fltp;
+            const double y = lowPass ? b0 * (sample + x1) + c1 * y1 - c2 * y2 : sample;
+            x1 = sample;
+            y2 = y1;
+            y1 = y;
+            fltp = static_cast<float>(y);
+
             // hp filter
-            fltphp += fltp - pp;
-            fltphp -= fltphp * flthp;
+            fltphp = controls.highPass[i] * (fltphp + fltp - pp);
             sample = fltphp;
-            // phaser
-            phaser_buffer[ipp & 1023] = sample;
-            sample += phaser_buffer[(ipp - iphase + 1024) & 1023];
-            ipp = (ipp + 1) & 1023;
-            // final accumulation and envelope application
-            ssample += sample * env_vol;
+
+            // phaser, with the delay interpolated between frames
+            phaser_buffer[ipp] = sample;
+            const float delay = controls.phaserDelay[i];
+            const int whole = static_cast<int>(delay);
+            const float fraction = delay - static_cast<float>(whole);
+            const float d0 = phaser_buffer[(ipp - whole) & (PhaserFrames - 1)];
+            const float d1 = phaser_buffer[(ipp - whole - 1) & (PhaserFrames - 1)];
+            sample += d0 + (d1 - d0) * fraction;
+            ipp = (ipp + 1) & (PhaserFrames - 1);
+
+            buffer[i] = sample;
         }
-        ssample = ssample / 8 * master_vol;
+    }
 
-        ssample *= 2.0f * sound_vol;
+    fltp_x1 = x1;
+    fltp_y1 = y1;
+    fltp_y2 = y2;
+}
 
-        if (buffer != NULL)
+void SfxrNode::Sfxr::SynthSample(size_t length, float * buffer)
+{
+    Controls controls;
+    const float gain = master_vol * 2.0f * sound_vol;
+    const float minusOne = -1.0f;
+    const float one = 1.0f;
+
+    for (size_t start = 0; start < length; start += SynthChunkFrames)
+    {
+        float * dest = buffer + start;
+        const int frames = static_cast<int>(std::min(static_cast<size_t>(SynthChunkFrames), length - start));
+
+        // the parameters evolve first, so that the oscillator and filters run without branching on them
+        const int count = EvolveControls(frames, controls);
+        if (count)
         {
-            if (ssample > 1.0f) ssample = 1.0f;
-            if (ssample < -1.0f) ssample = -1.0f;
-            *buffer++ = ssample;
+            Oscillate(count, controls, dest);
+            Filter(count, controls, dest);
+
+            // final accumulation and envelope application
+            VectorMath::vmul(dest, 1, controls.envelope, 1, dest, 1, count);
+            VectorMath::vsmul(dest, 1, &gain, dest, 1, count);
+            VectorMath::vclip(dest, 1, &minusOne, &one, dest, 1, count);
         }
-        if (file != NULL)
+        if (count < frames)
         {
-            // quantize depending on format
-            // accumulate/count to accomodate variable sample rate?
-            ssample *= 4.0f;  // arbitrary gain to get reasonable output volume...
-            if (ssample > 1.0f) ssample = 1.0f;
-            if (ssample < -1.0f) ssample = -1.0f;
-            filesample += ssample;
-            fileacc++;
-            if (wav_freq == 44100 || fileacc == 2)
-            {
-                filesample /= fileacc;
-                fileacc = 0;
-                if (wav_bits == 16)
-                {
-                    short isample = (short) (filesample * 32000);
-                    fwrite(&isample, 1, 2, file);
-                }
-                else
-                {
-                    unsigned char isample = (unsigned char) (filesample * 127 + 128);
-                    fwrite(&isample, 1, 1, file);
-                }
-                filesample = 0.0f;
-            }
-            file_sampleswritten++;
+            memset(dest + count, 0, sizeof(float) * (frames - count));
+            break;
         }
     }
 }
@@ -695,6 +874,7 @@ SfxrNode::SfxrNode(AudioContext & ac)
 SfxrNode::~SfxrNode()
 {
     uninitialize();
+    delete sfxr;
 }
 
 void SfxrNode::process(ContextRenderLock &r, int bufferSize)
@@ -779,18 +959,7 @@ void SfxrNode::process(ContextRenderLock &r, int bufferSize)
 #undef UPDATE
 
     memset(destP, 0, sizeof(float) * n);
-    sfxr->SynthSample(n, destP, NULL);
-
-    /// @TODO check - does this really need clamping? If yes, should there be a comopressor of some sort here?
-    while (n--)
-    {
-        float f = destP[n];
-        if (f < -1.0f)
-            f = -1.0f;
-        else if (f > 1.0f)
-            f = 1.0f;
-        destP[n] = f;
-    }
+    sfxr->SynthSample(n, destP);
 
     outputBus->clearSilentFlag();
 }
@@ -855,258 +1024,265 @@ void SfxrNode::setDefaultBeep()
 
     // Sample parameters
     sfxr->sound_vol = 0.5f;
-    sfxr->wav_freq = 44100;
-    sfxr->wav_bits = 16;
 }
 
 void SfxrNode::coin()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
-    _startFrequency->setValue(0.4f + frnd(0.5f));
+    _startFrequency->setValue(0.4f + frnd(random, 0.5f));
     _attack->setValue(0);
     _sustainTime->setValue(0.1f);
-    _decayTime->setValue(0.1f + frnd(0.4f));
-    _sustainPunch->setValue(0.3f + frnd(0.3f));
-    if (rnd(1))
+    _decayTime->setValue(0.1f + frnd(random, 0.4f));
+    _sustainPunch->setValue(0.3f + frnd(random, 0.3f));
+    if (rnd(random, 1))
     {
-        _changeSpeed->setValue(0.5f + frnd(0.2f));
-        _changeAmount->setValue(0.2f + frnd(0.4f));
+        _changeSpeed->setValue(0.5f + frnd(random, 0.2f));
+        _changeAmount->setValue(0.2f + frnd(random, 0.4f));
     }
 }
 
 /// @TODO the audioParams should be read into buffers in the case that they are time varying
 void SfxrNode::laser()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
-    _waveType->setEnumeration(rnd(2));
-    if (_waveType->valueUint32() == SINE && rnd(1))
-        _waveType->setEnumeration(rnd(1));
-    if (rnd(2) == 0)
+    _waveType->setEnumeration(rnd(random, 2));
+    if (_waveType->valueUint32() == SINE && rnd(random, 1))
+        _waveType->setEnumeration(rnd(random, 1));
+    if (rnd(random, 2) == 0)
     {
-        _startFrequency->setValue(0.3f + frnd(0.6f));
-        _minFrequency->setValue(frnd(0.1f));
-        _slide->setValue(-0.35f - frnd(0.3f));
+        _startFrequency->setValue(0.3f + frnd(random, 0.6f));
+        _minFrequency->setValue(frnd(random, 0.1f));
+        _slide->setValue(-0.35f - frnd(random, 0.3f));
     }
     else
     {
         ContextRenderLock r(nullptr, "laser");
         /// @fixme these values should be per sample, not per quantum
         /// -or- they should be settings if they don't vary per sample
-        _startFrequency->setValue(0.5f + frnd(0.5f));
-        _minFrequency->setValue(_startFrequency->value() - 0.2f - frnd(0.6f));
+        _startFrequency->setValue(0.5f + frnd(random, 0.5f));
+        _minFrequency->setValue(_startFrequency->value() - 0.2f - frnd(random, 0.6f));
         if (_minFrequency->value() < 0.2f) _minFrequency->setValue(0.2f);
-        _slide->setValue(-0.15f - frnd(0.2f));
+        _slide->setValue(-0.15f - frnd(random, 0.2f));
     }
-    if (rnd(1))
+    if (rnd(random, 1))
     {
-        _squareDuty->setValue(frnd(0.5f));
-        _dutySweep->setValue(frnd(0.2f));
+        _squareDuty->setValue(frnd(random, 0.5f));
+        _dutySweep->setValue(frnd(random, 0.2f));
     }
     else
     {
-        _squareDuty->setValue(0.4f + frnd(0.5f));
-        _dutySweep->setValue(-frnd(0.7f));
+        _squareDuty->setValue(0.4f + frnd(random, 0.5f));
+        _dutySweep->setValue(-frnd(random, 0.7f));
     }
     _attack->setValue(0);
-    _sustainTime->setValue(0.1f + frnd(0.2f));
-    _decayTime->setValue(frnd(0.4f));
-    if (rnd(1))
-        _sustainPunch->setValue(frnd(0.3f));
-    if (rnd(2) == 0)
+    _sustainTime->setValue(0.1f + frnd(random, 0.2f));
+    _decayTime->setValue(frnd(random, 0.4f));
+    if (rnd(random, 1))
+        _sustainPunch->setValue(frnd(random, 0.3f));
+    if (rnd(random, 2) == 0)
     {
-        _phaserOffset->setValue(frnd(0.2f));
-        _phaserSweep->setValue(-frnd(0.2f));
+        _phaserOffset->setValue(frnd(random, 0.2f));
+        _phaserSweep->setValue(-frnd(random, 0.2f));
     }
-    _hpFilterCutoff->setValue(frnd(0.3f));
+    _hpFilterCutoff->setValue(frnd(random, 0.3f));
 }
 
 void SfxrNode::explosion()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
     _waveType->setEnumeration(NOISE);
-    if (rnd(1))
+    if (rnd(random, 1))
     {
-        _startFrequency->setValue(sqr(0.1f + frnd(0.4f)));
-        _slide->setValue(-0.1f + frnd(0.4f));
+        _startFrequency->setValue(sqr(0.1f + frnd(random, 0.4f)));
+        _slide->setValue(-0.1f + frnd(random, 0.4f));
     }
     else
     {
-        _startFrequency->setValue(sqr(0.2f + frnd(0.7f)));
-        _slide->setValue(-0.2f - frnd(0.2f));
+        _startFrequency->setValue(sqr(0.2f + frnd(random, 0.7f)));
+        _slide->setValue(-0.2f - frnd(random, 0.2f));
     }
-    if (rnd(4) == 0)
+    if (rnd(random, 4) == 0)
         _slide->setValue(0);
-    if (rnd(2) == 0)
-        _repeatSpeed->setValue(0.3f + frnd(0.5f));
+    if (rnd(random, 2) == 0)
+        _repeatSpeed->setValue(0.3f + frnd(random, 0.5f));
     _attack->setValue(0);
-    _sustainTime->setValue(0.1f + frnd(0.3f));
-    _decayTime->setValue(frnd(0.5f));
-    if (rnd(1))
+    _sustainTime->setValue(0.1f + frnd(random, 0.3f));
+    _decayTime->setValue(frnd(random, 0.5f));
+    if (rnd(random, 1))
     {
-        _phaserOffset->setValue(-0.3f + frnd(0.9f));
-        _phaserSweep->setValue(-frnd(0.3f));
+        _phaserOffset->setValue(-0.3f + frnd(random, 0.9f));
+        _phaserSweep->setValue(-frnd(random, 0.3f));
     }
-    _sustainPunch->setValue(0.2f + frnd(0.6f));
-    if (rnd(1))
+    _sustainPunch->setValue(0.2f + frnd(random, 0.6f));
+    if (rnd(random, 1))
     {
-        _vibratoDepth->setValue(frnd(0.7f));
-        _vibratoSpeed->setValue(frnd(0.6f));
+        _vibratoDepth->setValue(frnd(random, 0.7f));
+        _vibratoSpeed->setValue(frnd(random, 0.6f));
     }
-    if (rnd(2) == 0)
+    if (rnd(random, 2) == 0)
     {
-        _changeSpeed->setValue(0.6f + frnd(0.3f));
-        _changeAmount->setValue(0.8f - frnd(1.6f));
+        _changeSpeed->setValue(0.6f + frnd(random, 0.3f));
+        _changeAmount->setValue(0.8f - frnd(random, 1.6f));
     }
 }
 
 void SfxrNode::powerUp()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
-    if (rnd(1))
+    if (rnd(random, 1))
     {
         _waveType->setEnumeration(SAWTOOTH);
         _squareDuty->setValue(1);
     }
     else
     {
-        _squareDuty->setValue(frnd(0.6f));
+        _squareDuty->setValue(frnd(random, 0.6f));
     }
-    _startFrequency->setValue(0.2f + frnd(0.3f));
-    if (rnd(1))
+    _startFrequency->setValue(0.2f + frnd(random, 0.3f));
+    if (rnd(random, 1))
     {
-        _slide->setValue(0.1f + frnd(0.4f));
-        _repeatSpeed->setValue(0.4f + frnd(0.4f));
+        _slide->setValue(0.1f + frnd(random, 0.4f));
+        _repeatSpeed->setValue(0.4f + frnd(random, 0.4f));
     }
     else
     {
-        _slide->setValue(0.05f + frnd(0.2f));
-        if (rnd(1))
+        _slide->setValue(0.05f + frnd(random, 0.2f));
+        if (rnd(random, 1))
         {
-            _vibratoDepth->setValue(frnd(0.7f));
-            _vibratoSpeed->setValue(frnd(0.6f));
+            _vibratoDepth->setValue(frnd(random, 0.7f));
+            _vibratoSpeed->setValue(frnd(random, 0.6f));
         }
     }
     _attack->setValue(0);
-    _sustainTime->setValue(frnd(0.4f));
-    _decayTime->setValue(0.1f + frnd(0.4f));
+    _sustainTime->setValue(frnd(random, 0.4f));
+    _decayTime->setValue(0.1f + frnd(random, 0.4f));
 }
 
 /// @TODO remove need for context lock see above
 void SfxrNode::hit()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
-    _waveType->setEnumeration(rnd(2));
+    _waveType->setEnumeration(rnd(random, 2));
     if (_waveType->valueUint32() == SINE)
         _waveType->setEnumeration(NOISE);
     if (_waveType->valueUint32() == SQUARE)
-        _squareDuty->setValue(frnd(0.6f));
+        _squareDuty->setValue(frnd(random, 0.6f));
     if (_waveType->valueUint32() == SAWTOOTH)
         _squareDuty->setValue(1);
-    _startFrequency->setValue(0.2f + frnd(0.6f));
-    _slide->setValue(-0.3f - frnd(0.4f));
+    _startFrequency->setValue(0.2f + frnd(random, 0.6f));
+    _slide->setValue(-0.3f - frnd(random, 0.4f));
     _attack->setValue(0);
-    _sustainTime->setValue(frnd(0.1f));
-    _decayTime->setValue(0.1f + frnd(0.2f));
-    if (rnd(1))
-        _hpFilterCutoff->setValue(frnd(0.3f));
+    _sustainTime->setValue(frnd(random, 0.1f));
+    _decayTime->setValue(0.1f + frnd(random, 0.2f));
+    if (rnd(random, 1))
+        _hpFilterCutoff->setValue(frnd(random, 0.3f));
 }
 
 void SfxrNode::jump()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
     _waveType->setEnumeration(SQUARE);
-    _squareDuty->setValue(frnd(0.6f));
-    _startFrequency->setValue(0.3f + frnd(0.3f));
-    _slide->setValue(0.1f + frnd(0.2f));
+    _squareDuty->setValue(frnd(random, 0.6f));
+    _startFrequency->setValue(0.3f + frnd(random, 0.3f));
+    _slide->setValue(0.1f + frnd(random, 0.2f));
     _attack->setValue(0);
-    _sustainTime->setValue(0.1f + frnd(0.3f));
-    _decayTime->setValue(0.1f + frnd(0.2f));
-    if (rnd(1))
-        _hpFilterCutoff->setValue(frnd(0.3f));
-    if (rnd(1))
-        _lpFilterCutoff->setValue(1 - frnd(0.6f));
+    _sustainTime->setValue(0.1f + frnd(random, 0.3f));
+    _decayTime->setValue(0.1f + frnd(random, 0.2f));
+    if (rnd(random, 1))
+        _hpFilterCutoff->setValue(frnd(random, 0.3f));
+    if (rnd(random, 1))
+        _lpFilterCutoff->setValue(1 - frnd(random, 0.6f));
 }
 
 /// @TODO remove need for context lock see above
 void SfxrNode::select()
 {
+    RandomGenerator & random = sfxr->presetRandom;
     setDefaultBeep();
-    _waveType->setEnumeration(rnd(1));
+    _waveType->setEnumeration(rnd(random, 1));
     if (_waveType->valueUint32() == SQUARE)
-        _squareDuty->setValue(frnd(0.6f));
+        _squareDuty->setValue(frnd(random, 0.6f));
     else
         _squareDuty->setValue(1);
-    _startFrequency->setValue(0.2f + frnd(0.4f));
+    _startFrequency->setValue(0.2f + frnd(random, 0.4f));
     _attack->setValue(0);
-    _sustainTime->setValue(0.1f + frnd(0.1f));
-    _decayTime->setValue(frnd(0.2f));
+    _sustainTime->setValue(0.1f + frnd(random, 0.1f));
+    _decayTime->setValue(frnd(random, 0.2f));
     _hpFilterCutoff->setValue(0.1f);
 }
 
 void SfxrNode::mutate()
 {
-    if (rnd(1)) _startFrequency->setValue(_startFrequency->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _slide->setValue(_slide->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _deltaSlide->setValue(_deltaSlide->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _squareDuty->setValue(_squareDuty->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _dutySweep->setValue(_dutySweep->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _vibratoDepth->setValue(_vibratoDepth->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _vibratoSpeed->setValue(_vibratoSpeed->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _attack->setValue(_attack->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _sustainTime->setValue(_sustainTime->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _decayTime->setValue(_decayTime->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _sustainPunch->setValue(_sustainPunch->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _lpFilterResonance->setValue(_lpFilterResonance->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _lpFilterCutoff->setValue(_lpFilterCutoff->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _lpFilterCutoffSweep->setValue(_lpFilterCutoffSweep->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _hpFilterCutoff->setValue(_hpFilterCutoff->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _hpFilterCutoffSweep->setValue(_hpFilterCutoffSweep->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _phaserOffset->setValue(_phaserOffset->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _phaserSweep->setValue(_phaserSweep->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _repeatSpeed->setValue(_repeatSpeed->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _changeSpeed->setValue(_changeSpeed->value() + frnd(0.1f) - 0.05f);
-    if (rnd(1)) _changeAmount->setValue(_changeAmount->value() + frnd(0.1f) - 0.05f);
+    RandomGenerator & random = sfxr->presetRandom;
+    if (rnd(random, 1)) _startFrequency->setValue(_startFrequency->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _slide->setValue(_slide->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _deltaSlide->setValue(_deltaSlide->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _squareDuty->setValue(_squareDuty->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _dutySweep->setValue(_dutySweep->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _vibratoDepth->setValue(_vibratoDepth->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _vibratoSpeed->setValue(_vibratoSpeed->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _attack->setValue(_attack->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _sustainTime->setValue(_sustainTime->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _decayTime->setValue(_decayTime->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _sustainPunch->setValue(_sustainPunch->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _lpFilterResonance->setValue(_lpFilterResonance->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _lpFilterCutoff->setValue(_lpFilterCutoff->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _lpFilterCutoffSweep->setValue(_lpFilterCutoffSweep->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _hpFilterCutoff->setValue(_hpFilterCutoff->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _hpFilterCutoffSweep->setValue(_hpFilterCutoffSweep->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _phaserOffset->setValue(_phaserOffset->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _phaserSweep->setValue(_phaserSweep->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _repeatSpeed->setValue(_repeatSpeed->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _changeSpeed->setValue(_changeSpeed->value() + frnd(random, 0.1f) - 0.05f);
+    if (rnd(random, 1)) _changeAmount->setValue(_changeAmount->value() + frnd(random, 0.1f) - 0.05f);
 }
 
 /// @TODO remove need for context lock see above
 void SfxrNode::randomize()
 {
-    if (rnd(1))
-        _startFrequency->setValue(cube(frnd(2) - 1) + 0.5f);
+    RandomGenerator & random = sfxr->presetRandom;
+    if (rnd(random, 1))
+        _startFrequency->setValue(cube(frnd(random, 2) - 1) + 0.5f);
     else
-        _startFrequency->setValue(sqr(frnd(1)));
+        _startFrequency->setValue(sqr(frnd(random, 1)));
     _minFrequency->setValue(0);
-    _slide->setValue(powf(frnd(2) - 1, 5));
+    _slide->setValue(powf(frnd(random, 2) - 1, 5));
     if (_startFrequency->value() > 0.7 && _slide->value() > 0.2)
         _slide->setValue(-_slide->value());
     if (_startFrequency->value() < 0.2 && _slide->value() < -0.05)
         _slide->setValue(-_slide->value());
-    _deltaSlide->setValue(powf(frnd(2) - 1, 3));
-    _squareDuty->setValue(frnd(2) - 1);
-    _dutySweep->setValue(powf(frnd(2) - 1, 3));
-    _vibratoDepth->setValue(powf(frnd(2) - 1, 3));
-    _vibratoSpeed->setValue(rndr(-1, 1));
-    _attack->setValue(cube(rndr(0, 1)));
-    _sustainTime->setValue(sqr(rndr(0, 1)));
-    _decayTime->setValue(rndr(0, 1));
-    _sustainPunch->setValue(powf(frnd(0.8f), 2));
+    _deltaSlide->setValue(powf(frnd(random, 2) - 1, 3));
+    _squareDuty->setValue(frnd(random, 2) - 1);
+    _dutySweep->setValue(powf(frnd(random, 2) - 1, 3));
+    _vibratoDepth->setValue(powf(frnd(random, 2) - 1, 3));
+    _vibratoSpeed->setValue(rndr(random, -1, 1));
+    _attack->setValue(cube(rndr(random, 0, 1)));
+    _sustainTime->setValue(sqr(rndr(random, 0, 1)));
+    _decayTime->setValue(rndr(random, 0, 1));
+    _sustainPunch->setValue(powf(frnd(random, 0.8f), 2));
     if (_attack->value() + _sustainTime->value() + _decayTime->value() < 0.2f)
     {
-        _sustainTime->setValue(_sustainTime->value() + 0.2f + frnd(0.3f));
-        _decayTime->setValue(_decayTime->value() + 0.2f + frnd(0.3f));
+        _sustainTime->setValue(_sustainTime->value() + 0.2f + frnd(random, 0.3f));
+        _decayTime->setValue(_decayTime->value() + 0.2f + frnd(random, 0.3f));
     }
-    _lpFilterResonance->setValue(rndr(-1, 1));
-    _lpFilterCutoff->setValue(1 - powf(frnd(1), 3));
-    _lpFilterCutoffSweep->setValue(powf(frnd(2) - 1, 3));
+    _lpFilterResonance->setValue(rndr(random, -1, 1));
+    _lpFilterCutoff->setValue(1 - powf(frnd(random, 1), 3));
+    _lpFilterCutoffSweep->setValue(powf(frnd(random, 2) - 1, 3));
     if (_lpFilterCutoff->value() < 0.1 && _lpFilterCutoffSweep->value() < -0.05f)
         _lpFilterCutoffSweep->setValue(-_lpFilterCutoffSweep->value());
-    _hpFilterCutoff->setValue(powf(frnd(1), 5));
-    _hpFilterCutoffSweep->setValue(powf(frnd(2) - 1, 5));
-    _phaserOffset->setValue(powf(frnd(2) - 1, 3));
-    _phaserSweep->setValue(powf(frnd(2) - 1, 3));
-    _repeatSpeed->setValue(frnd(2) - 1);
-    _changeSpeed->setValue(frnd(2) - 1);
-    _changeAmount->setValue(frnd(2) - 1);
+    _hpFilterCutoff->setValue(powf(frnd(random, 1), 5));
+    _hpFilterCutoffSweep->setValue(powf(frnd(random, 2) - 1, 5));
+    _phaserOffset->setValue(powf(frnd(random, 2) - 1, 3));
+    _phaserSweep->setValue(powf(frnd(random, 2) - 1, 3));
+    _repeatSpeed->setValue(frnd(random, 2) - 1);
+    _changeSpeed->setValue(frnd(random, 2) - 1);
+    _changeAmount->setValue(frnd(random, 2) - 1);
 }
 
 //------------------------------------------------------------------------
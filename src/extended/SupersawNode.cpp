@@ -1,4 +1,3 @@
-
 // SPDX-License-Identifier: BSD-2-Clause
 // Copyright (C) 2015, The LabSound Authors. All rights reserved.
 
@@ -6,15 +5,18 @@
 #include "LabSound/core/AudioNodeInput.h"
 #include "LabSound/core/AudioNodeOutput.h"
 #include "LabSound/core/AudioSetting.h"
-#include "LabSound/core/GainNode.h"
-#include "LabSound/core/OscillatorNode.h"
 
 #include "LabSound/extended/AudioContextLock.h"
 #include "LabSound/extended/SupersawNode.h"
 #include "LabSound/extended/Registry.h"
 #include "LabSound/extended/VectorMath.h"
 
-#include <cfloat>
+#include "internal/Assertions.h"
+#include "internal/OscillatorBank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace lab;
 
@@ -25,10 +27,15 @@ namespace lab
 // Private Supersaw Node Implementation //
 //////////////////////////////////////////
 
+static char const * const s_ssTypes[] = {"Sawtooth", "Square", nullptr};
+
 static AudioParamDescriptor s_ssParams[] = {
     {"detune",    "DTUN",   1.0, 0,    120},
-    {"frequency", "FREQ", 440.0, 0, 100000}, nullptr};
-static AudioSettingDescriptor s_ssSettings[] = {{"sawCount", "SAWC", SettingType::Integer}, nullptr};
+    {"frequency", "FREQ", 440.0, 0, 100000},
+    {"voices",    "VOIC",   1.0, 1, OscillatorBank::MaxVoices}, nullptr};
+static AudioSettingDescriptor s_ssSettings[] = {
+    {"sawCount", "SAWC", SettingType::Integer},
+    {"type",     "TYPE", SettingType::Enum, s_ssTypes}, nullptr};
 
 AudioNodeDescriptor * SupersawNode::desc()
 {
@@ -39,99 +46,148 @@ AudioNodeDescriptor * SupersawNode::desc()
 class SupersawNode::SupersawNodeInternal
 {
 public:
-    SupersawNodeInternal(AudioContext & ac)
-        : cachedDetune(FLT_MAX)
-        , cachedFrequency(FLT_MAX)
+    SupersawNodeInternal()
+        : frequencyValues(AudioNode::ProcessingSizeInFrames)
+        , detuneValues(AudioNode::ProcessingSizeInFrames)
+        , voiceValues(AudioNode::ProcessingSizeInFrames)
+        , ratios(AudioNode::ProcessingSizeInFrames)
+        , increments(AudioNode::ProcessingSizeInFrames * OscillatorBank::MaxVoices)
+        , gains(AudioNode::ProcessingSizeInFrames * OscillatorBank::MaxVoices)
     {
-        gainNode = std::make_shared<GainNode>(ac);
     }
 
     ~SupersawNodeInternal() = default;
 
-    void update(ContextRenderLock & r)
+    // Where voice v sits in the spread, from -1 to 1, when voiceCount voices sound. The
+    // voices are evenly spaced, and the spacing changes smoothly with a fractional count.
+    static float spreadPosition(int v, float voiceCount)
     {
-        /// @fixme these values should be per sample, not per quantum
-        /// -or- they should be settings if they don't vary per sample
-        if (cachedFrequency != frequency->value())
-        {
-            cachedFrequency = frequency->value();
-            for (auto i : saws)
-            {
-                i->frequency()->setValue(cachedFrequency);
-                i->frequency()->resetSmoothedValue();
-            }
-        }
-
-        /// @fixme these values should be per sample, not per quantum
-        /// -or- they should be settings if they don't vary per sample
-        if (cachedDetune != detune->value())
-        {
-            cachedDetune = detune->value();
-            float n = cachedDetune / ((float) saws.size() - 1.0f);
-            for (size_t i = 0; i < saws.size(); ++i)
-            {
-                saws[i]->detune()->setValue(-cachedDetune + float(i) * 2 * n);
-                saws[i]->detune()->resetSmoothedValue();
-            }
-        }
+        const float span = voiceCount - 1.f;
+        return std::max(-1.f, std::min(1.f, (2.f * v - span) / std::max(span, 1.f)));
     }
 
-    void update(ContextRenderLock & r, bool okayToReallocate)
+    // The share of the output of voice v; the last voice of a fractional count is faded in.
+    static float voiceGain(int v, float voiceCount)
     {
-        size_t currentN = saws.size();
-        int n = int(sawCount->valueUint32() + 0.5f);
-
-        auto context = r.context();
+        return std::max(0.f, std::min(1.f, voiceCount - v)) / voiceCount;
+    }
 
-        if (okayToReallocate && (n != currentN))
+    void render(ContextRenderLock & r, int bufferSize, int offset, int count, float * destination)
+    {
+        if (bufferSize > frequencyValues.size())
         {
-            sampleRate = r.context()->sampleRate();
+            frequencyValues.allocate(bufferSize);
+            detuneValues.allocate(bufferSize);
+            voiceValues.allocate(bufferSize);
+            ratios.allocate(bufferSize);
+            increments.allocate(bufferSize * OscillatorBank::MaxVoices);
+            gains.allocate(bufferSize * OscillatorBank::MaxVoices);
+        }
 
-            // This implementation is similar to the technique illustrated here
-            // https://noisehack.com/how-to-build-supersaw-synth-web-audio-api/
-            //
-            for (auto i : sawStorage)
-            {
-                context->disconnect(i, nullptr);
-            }
+        AudioParamShape frequencyShape {AudioParamShape::Constant, frequency->value()};
+        if (frequency->hasSampleAccurateValues())
+            frequencyShape = frequency->calculateSampleAccurateValues(r, frequencyValues.data(), bufferSize);
+
+        AudioParamShape detuneShape {AudioParamShape::Constant, detune->value()};
+        if (detune->hasSampleAccurateValues())
+            detuneShape = detune->calculateSampleAccurateValues(r, detuneValues.data(), bufferSize);
 
-            sawStorage.clear();
-            saws.clear();
+        AudioParamShape voiceShape {AudioParamShape::Constant, voices->value()};
+        if (voices->hasSampleAccurateValues())
+            voiceShape = voices->calculateSampleAccurateValues(r, voiceValues.data(), bufferSize);
 
-            for (int i = 0; i < n; ++i)
-                sawStorage.emplace_back(std::make_shared<OscillatorNode>(*context));
+        const float maxVoices = static_cast<float>(OscillatorBank::MaxVoices);
+        float * voiceCounts = voiceValues.data() + offset;
+        float greatestCount;
+        if (voiceShape.isConstant())
+            greatestCount = std::max(1.f, std::min(maxVoices, voiceShape.value));
+        else
+        {
+            const float one = 1.f;
+            VectorMath::vclip(voiceCounts, 1, &one, &maxVoices, voiceCounts, 1, count);
+            greatestCount = 1.f;
+            for (int i = 0; i < count; ++i)
+                greatestCount = std::max(greatestCount, voiceCounts[i]);
+        }
 
-            for (int i = 0; i < n; ++i)
-                saws.push_back(sawStorage[i].get());
+        const int voiceCount = static_cast<int>(std::ceil(greatestCount));
+        const int lanes = OscillatorBank::lanes(voiceCount);
+        const float inverseSampleRate = 1.f / r.context()->sampleRate();
+        float * incrementP = increments.data();
+        float * gainP = gains.data();
 
-            for (auto i : sawStorage)
+        if (frequencyShape.isConstant() && detuneShape.isConstant() && voiceShape.isConstant())
+        {
+            // the voices are steady over the quantum; compute them once, and repeat them on every frame
+            for (int v = 0; v < lanes; ++v)
             {
-                i->setType(OscillatorType::SAWTOOTH);
-                context->connect(gainNode, i, 0, 0);
-                i->start(0);
+                const float cents = detuneShape.value * spreadPosition(v, greatestCount);
+                incrementP[v] = frequencyShape.value * std::pow(2.f, cents / 1200.f) * inverseSampleRate;
+                gainP[v] = v < voiceCount ? voiceGain(v, greatestCount) : 0.f;
+            }
+            for (int i = 1; i < count; ++i)
+            {
+                memcpy(incrementP + i * lanes, incrementP, sizeof(float) * lanes);
+                memcpy(gainP + i * lanes, gainP, sizeof(float) * lanes);
+            }
+        }
+        else
+        {
+            const float * frequencies = frequencyValues.data() + offset;
+            const float * detunes = detuneValues.data() + offset;
+            float * ratioP = ratios.data();
+            for (int v = 0; v < lanes; ++v)
+            {
+                if (v >= voiceCount)
+                {
+                    for (int i = 0; i < count; ++i)
+                    {
+                        incrementP[i * lanes + v] = 0.f;
+                        gainP[i * lanes + v] = 0.f;
+                    }
+                    continue;
+                }
+
+                // the detune of the voice in octaves, then as a ratio of the frequency
+                for (int i = 0; i < count; ++i)
+                {
+                    const float voiceCountAt = voiceShape.isConstant() ? greatestCount : voiceCounts[i];
+                    const float detuneAt = detuneShape.isConstant() ? detuneShape.value : detunes[i];
+                    ratioP[i] = detuneAt * spreadPosition(v, voiceCountAt) * (1.f / 1200.f);
+                    gainP[i * lanes + v] = voiceGain(v, voiceCountAt);
+                }
+                VectorMath::vexp2(ratioP, ratioP, count);
+
+                for (int i = 0; i < count; ++i)
+                {
+                    const float frequencyAt = frequencyShape.isConstant() ? frequencyShape.value : frequencies[i];
+                    incrementP[i * lanes + v] = frequencyAt * ratioP[i] * inverseSampleRate;
+                }
             }
-
-            gainNode->gain()->setValue(1.f / float(n));
-
-            cachedFrequency = FLT_MAX;
-            cachedDetune = FLT_MAX;
         }
 
-        update(r);
+        const OscillatorBank::Waveform waveform = type->valueUint32() == 1 ? OscillatorBank::Waveform::Square
+                                                                             : OscillatorBank::Waveform::Sawtooth;
+        bank.render(waveform, incrementP, gainP, voiceCount, destination + offset, count);
     }
 
-    std::shared_ptr<GainNode> gainNode;
     std::shared_ptr<AudioParam> detune;
     std::shared_ptr<AudioParam> frequency;
+    std::shared_ptr<AudioParam> voices;
     std::shared_ptr<AudioSetting> sawCount;
+    std::shared_ptr<AudioSetting> type;
 
-private:
-    float sampleRate;
-    float cachedDetune;
-    float cachedFrequency;
+    OscillatorBank bank;
 
-    std::vector<std::shared_ptr<OscillatorNode>> sawStorage;
-    std::vector<OscillatorNode *> saws;
+private:
+    AudioFloatArray frequencyValues;
+    AudioFloatArray detuneValues;
+    AudioFloatArray voiceValues;
+    AudioFloatArray ratios;
+
+    // per frame, per voice
+    AudioFloatArray increments;
+    AudioFloatArray gains;
 };
 
 //////////////////////////
@@ -141,11 +197,16 @@ private:
 SupersawNode::SupersawNode(AudioContext & ac)
 : AudioScheduledSourceNode(ac, *desc())
 {
-    internalNode.reset(new SupersawNodeInternal(ac));
-    internalNode->sawCount = setting("sawCount");
-    internalNode->sawCount->setUint32(1);
+    internalNode.reset(new SupersawNodeInternal());
     internalNode->detune = param("detune");
     internalNode->frequency = param("frequency");
+    internalNode->voices = param("voices");
+    internalNode->type = setting("type");
+    internalNode->sawCount = setting("sawCount");
+    internalNode->sawCount->setUint32(1);
+    internalNode->sawCount->setValueChanged([this]() {
+        internalNode->voices->setValue(static_cast<float>(internalNode->sawCount->valueUint32()));
+    });
     initialize();
 }
 
@@ -156,8 +217,6 @@ SupersawNode::~SupersawNode()
 
 void SupersawNode::process(ContextRenderLock & r, int bufferSize)
 {
-    internalNode->update(r, true);
-
     AudioBus * outputBus = output(0)->bus(r);
 
     if (!isInitialized() || !outputBus->numberOfChannels())
@@ -166,18 +225,26 @@ void SupersawNode::process(ContextRenderLock & r, int bufferSize)
         return;
     }
 
-    AudioBus * dst = nullptr;
-    internalNode->gainNode->input(0)->bus(r)->zero();
-    /*AudioBus * renderedBus =*/ internalNode->gainNode->input(0)->pull(r, dst, bufferSize);
-    internalNode->gainNode->process(r, bufferSize);
-    AudioBus * inputBus = internalNode->gainNode->output(0)->bus(r);
-    outputBus->copyFrom(*inputBus);
+    int quantumFrameOffset = _self->_scheduler._renderOffset;
+    int nonSilentFramesToProcess = _self->_scheduler._renderLength;
+
+    if (!nonSilentFramesToProcess)
+    {
+        outputBus->zero();
+        return;
+    }
+
+    internalNode->render(r, bufferSize, quantumFrameOffset, nonSilentFramesToProcess, outputBus->channel(0)->mutableData());
     outputBus->clearSilentFlag();
 }
 
+void SupersawNode::reset(ContextRenderLock &)
+{
+    internalNode->bank.reset();
+}
+
 void SupersawNode::update(ContextRenderLock & r)
 {
-    internalNode->update(r, true);
 }
 
 std::shared_ptr<AudioParam> SupersawNode::detune() const
@@ -188,10 +255,18 @@ std::shared_ptr<AudioParam> SupersawNode::frequency() const
 {
     return internalNode->frequency;
 }
+std::shared_ptr<AudioParam> SupersawNode::voices() const
+{
+    return internalNode->voices;
+}
 std::shared_ptr<AudioSetting> SupersawNode::sawCount() const
 {
     return internalNode->sawCount;
 }
+std::shared_ptr<AudioSetting> SupersawNode::type() const
+{
+    return internalNode->type;
+}
 
 bool SupersawNode::propagatesSilence(ContextRenderLock & r) const
 {
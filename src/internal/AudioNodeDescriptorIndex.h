@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef AudioNodeDescriptorIndex_h
+#define AudioNodeDescriptorIndex_h
+
+#include "LabSound/core/AudioNodeDescriptor.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lab
+{
+
+// The names are views of the descriptor's strings, which are static.
+struct AudioSettingEnumIndex
+{
+    std::unordered_map<std::string_view, int> byName;
+};
+
+struct AudioNodeDescriptorIndex
+{
+    explicit AudioNodeDescriptorIndex(AudioNodeDescriptor const &);
+
+    std::unordered_map<std::string_view, int> paramByName;
+    std::unordered_map<uint32_t, int> paramById;
+    std::unordered_map<std::string_view, int> settingByName;
+    std::unordered_map<uint32_t, int> settingById;
+    std::vector<AudioSettingEnumIndex> enums;  // one per setting
+
+    // nullptr if the setting isn't an enumeration
+    AudioSettingEnumIndex const * enumIndex(int settingSlot) const;
+};
+
+}  // namespace lab
+
+#endif
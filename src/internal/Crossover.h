@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef Crossover_h
+#define Crossover_h
+
+#include "internal/Biquad.h"
+
+namespace lab
+{
+
+// Crossover splits a channel into two or three bands with fourth order
+// Linkwitz-Riley filters, each a pair of Butterworth sections. The bands sum
+// back to an allpass response, so a signal split and summed unprocessed keeps
+// its magnitude response. With three bands, the low band passes through an
+// allpass matching the phase of the upper split, so that all three stay aligned.
+//
+// Frequencies are normalized, 0 to 1 being 0 to the Nyquist frequency.
+class Crossover
+{
+public:
+    enum
+    {
+        MaxBands = 3
+    };
+
+    Crossover();
+
+    // bandCount is clamped to [1, MaxBands]. highFrequency is only used with three bands.
+    void setBands(int bandCount, double lowFrequency, double highFrequency);
+    int bandCount() const { return m_bandCount; }
+
+    // Writes bandCount() bands, lowest first. The source may be one of the bands.
+    void process(const float * source, float * const * bands, int framesToProcess);
+
+    void reset();
+
+private:
+    int m_bandCount = 1;
+
+    Biquad m_lowSplitLowpass[2];
+    Biquad m_lowSplitHighpass[2];
+    Biquad m_highSplitLowpass[2];
+    Biquad m_highSplitHighpass[2];
+    Biquad m_lowBandAllpass;
+};
+
+}  // namespace lab
+
+#endif  // Crossover_h
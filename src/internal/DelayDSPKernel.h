@@ -8,6 +8,7 @@
 #include "LabSound/core/AudioArray.h"
 
 #include "internal/AudioDSPKernel.h"
+#include "internal/DelayLine.h"
 #include "internal/DelayProcessor.h"
 
 namespace lab
@@ -33,18 +34,18 @@ public:
     virtual double latencyTime(ContextRenderLock & r) const override;
 
 private:
-    AudioFloatArray m_buffer;
+    DelayLine m_line;
+    DelayLine::Tap m_tap;
     double m_maxDelayTime;
-    int m_writeIndex;
     double m_currentDelayTime;
     double m_smoothingRate;
     bool m_firstTime;
     double m_desiredDelayFrames;
 
-    AudioFloatArray m_delayTimes;
+    AudioFloatArray m_delayFrames;
 
     DelayProcessor * delayProcessor() { return static_cast<DelayProcessor *>(processor()); }
-    size_t bufferLengthForDelay(double delayTime, double sampleRate) const;
+    void allocate(double maxDelayTime, float sampleRate);
 };
 
 }  // namespace lab
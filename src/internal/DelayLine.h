@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef DelayLine_h
+#define DelayLine_h
+
+#include "LabSound/core/AudioArray.h"
+#include "LabSound/core/DelayNode.h"
+
+namespace lab
+{
+
+// DelayLine is a circular buffer that is written a block at a time, and then
+// read by any number of taps. The buffer length is a power of two so positions
+// wrap with a mask, and the first blockFrames + 3 frames are mirrored past the
+// end so that every read of a block is contiguous in memory.
+//
+// A block is written first, then read: frame i of a read is delayed relative to
+// frame i of the block just written, so a delay of zero returns the input. The
+// delay is in frames, and is clamped to [0, maxDelayFrames].
+//
+// Delays that are constant over a block are read with a few vector operations.
+// Delays that vary per frame are read sample by sample. Cubic reads fall back to
+// linear below one frame of delay, where the next frame hasn't been written yet.
+class DelayLine
+{
+public:
+    // Allpass interpolation is recursive, so each tap keeps its own state.
+    struct Tap
+    {
+        float allpassState = 0;
+    };
+
+    DelayLine() = default;
+    DelayLine(int maxDelayFrames, int blockFrames);
+
+    void allocate(int maxDelayFrames, int blockFrames);
+    bool isAllocated() const { return m_mask != 0; }
+    void reset();
+
+    int maxDelayFrames() const { return m_maxDelayFrames; }
+    int blockFrames() const { return m_blockFrames; }
+
+    // framesToProcess must not exceed blockFrames
+    void write(const float * source, int framesToProcess);
+
+    void read(Tap &, DelayInterpolation, double delayFrames, float * destination, int framesToProcess) const;
+    void read(Tap &, DelayInterpolation, const float * delayFrames, float * destination, int framesToProcess) const;
+
+private:
+    AudioFloatArray m_buffer;
+    unsigned m_mask = 0;
+    unsigned m_writeIndex = 0;  // start of the block last written
+    int m_maxDelayFrames = 0;
+    int m_blockFrames = 0;
+};
+
+}  // namespace lab
+
+#endif  // DelayLine_h
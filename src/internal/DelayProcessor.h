@@ -17,17 +17,20 @@ class AudioDSPKernel;
 class DelayProcessor : public AudioDSPKernelProcessor
 {
     std::shared_ptr<AudioSetting> m_delayTime;
+    std::shared_ptr<AudioSetting> m_interpolation;
     double m_maxDelayTime;
     float m_sampleRate;
 
 public:
-    DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> delayTime);
+    DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> delayTime,
+                   std::shared_ptr<AudioSetting> interpolation);
 
     virtual ~DelayProcessor();
 
     virtual AudioDSPKernel * createKernel();
 
     std::shared_ptr<AudioSetting> delayTime() const { return m_delayTime; }
+    std::shared_ptr<AudioSetting> interpolation() const { return m_interpolation; }
 
     double maxDelayTime() { return m_maxDelayTime; }
 };
@@ -7,9 +7,11 @@
 
 #include "LabSound/core/AudioArray.h"
 
+#include "internal/Crossover.h"
 #include "internal/DynamicsCompressorKernel.h"
 #include "internal/ZeroPole.h"
 
+#include <memory>
 #include <vector>
 
 namespace lab
@@ -21,6 +23,10 @@ class AudioBus;
 // is commonly used in musical production and game audio. It lowers the volume
 // of the loudest parts of the signal and raises the volume of the softest parts,
 // making the sound richer, fuller, and more controlled.
+//
+// In multi-band mode, the emphasized signal is split into two or three bands by
+// a crossover, each band is compressed by its own kernel with the same settings,
+// and the bands are summed. A loud band then doesn't pull down the others.
 
 class DynamicsCompressor
 {
@@ -44,6 +50,9 @@ public:
         ParamFilterAnchor,
         ParamEffectBlend,
         ParamReduction,
+        ParamBandCount,
+        ParamLowCrossover,
+        ParamHighCrossover,
         ParamLast
     };
 
@@ -86,8 +95,22 @@ protected:
     void setEmphasisStageParameters(unsigned stageIndex, float gain, float normalizedFrequency /* 0 -> 1 */);
     void setEmphasisParameters(float gain, float anchorFreq, float filterStageRatio);
 
-    // The core compressor.
-    DynamicsCompressorKernel m_compressor;
+    // Band controls.
+    int m_lastBandCount;
+    float m_lastLowCrossover;
+    float m_lastHighCrossover;
+
+    // Per-channel crossovers. The lowest band is split into the destination; the
+    // others have their own buffers, indexed by (band - 1) * channels + channel.
+    std::vector<std::unique_ptr<Crossover>> m_crossovers;
+    std::vector<std::unique_ptr<AudioFloatArray>> m_bandBuffers;
+
+    // The channels of each band, indexed by band * channels + channel.
+    std::unique_ptr<const float * []> m_bandSources;
+    std::unique_ptr<float * []> m_bandDestinations;
+
+    // The core compressors, one per band.
+    std::unique_ptr<DynamicsCompressorKernel> m_compressors[Crossover::MaxBands];
 };
 
 }  // namespace lab
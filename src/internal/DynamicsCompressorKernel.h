@@ -7,6 +7,8 @@
 
 #include "LabSound/core/AudioArray.h"
 
+#include "internal/DelayLine.h"
+
 #include <memory>
 #include <vector>
 
@@ -23,7 +25,8 @@ public:
 
     void setNumberOfChannels(unsigned);
 
-    // Performs stereo-linked compression.
+    // Performs linked compression: one detector follows the loudest channel, and
+    // its gain is applied to every channel. The destination may be the source.
     void process(ContextRenderLock &,
                  const float * sourceChannels[],
                  float * destinationChannels[],
@@ -64,20 +67,21 @@ protected:
         MaxPreDelayFrames = 1024
     };
     enum
-    {
-        MaxPreDelayFramesMask = MaxPreDelayFrames - 1
-    };
-    enum
     {
         DefaultPreDelayFrames = 256
     };  // setPreDelayTime() will override this initial value
     unsigned m_lastPreDelayFrames;
     void setPreDelayTime(float time, float sampleRate);
 
-    std::vector<std::unique_ptr<AudioFloatArray>> m_preDelayBuffers;
+    // The pre-delay lines are only as long as the current pre-delay.
+    std::vector<std::unique_ptr<DelayLine>> m_preDelayLines;
+    DelayLine::Tap m_preDelayTap;
 
-    int m_preDelayReadIndex;
-    int m_preDelayWriteIndex;
+    // Per frame detector level, attenuation, release rate, and gain for a render quantum.
+    AudioFloatArray m_level;
+    AudioFloatArray m_attenuation;
+    AudioFloatArray m_releaseRate;
+    AudioFloatArray m_gain;
 
     float m_maxAttackCompressionDiffDb;
 
@@ -109,6 +113,20 @@ protected:
 
     // Internal parameter for the knee portion of the curve.
     float m_K;
+
+    // The attenuation through the knee, as log2 of the gain, tabulated over log2 of the
+    // input level from m_linearThreshold to m_kneeThreshold. Above the knee the
+    // attenuation is linear in the log of the level, and is computed directly.
+    enum
+    {
+        KneeTableSize = 256
+    };
+    float m_kneeTable[KneeTableSize];
+    float m_log2LinearThreshold;
+    float m_log2KneeThreshold;
+    float m_kneeTableScale;
+    void updateKneeTable(float k);
+    void computeAttenuation(int framesToProcess, float satReleaseFrames);
 };
 
 }  // namespace lab
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef GrainPool_h
+#define GrainPool_h
+
+#include "LabSound/core/WindowFunctions.h"
+
+#include <vector>
+
+namespace lab
+{
+
+class AudioBus;
+
+// GrainPool plays up to MaxGrains grains of a source at once. The grains live
+// in storage allocated once, when the pool is made; starting a grain takes a
+// free slot and a finished grain gives it back, so nothing is allocated or
+// freed on the audio thread.
+//
+// A grain reads the source at a constant rate from a starting position,
+// wrapping around the end of the source, and is shaped by a window that is
+// read from a precomputed table, so the cost of a grain doesn't depend on the
+// window function. Grains are rendered four frames at a time in the lanes of
+// a vector, and each is panned with equal power between a pair of adjacent
+// output channels.
+class GrainPool
+{
+public:
+    enum
+    {
+        MaxGrains = 4096,
+        WindowTableSize = 1024
+    };
+
+    struct Grain
+    {
+        int delay = 0;          // frames into the next render before the grain begins
+        int length = 2;         // frames, at least two
+        double position = 0;    // the source frame the grain begins on
+        float increment = 1.f;  // source frames per output frame
+        float gain = 1.f;
+        float pan = 0.f;        // from -1, the first output channel, to 1, the last
+    };
+
+    GrainPool();
+    ~GrainPool();
+
+    // Mixes the source down to mono and stops every grain. This allocates, so it
+    // must not run at the same time as render.
+    void setSource(const AudioBus * source);
+    int sourceLength() const { return static_cast<int>(m_source.size()); }
+    float sourceSampleRate() const { return m_sourceSampleRate; }
+
+    // Fills the window table if the function has changed; safe on the audio thread.
+    void setWindow(WindowFunction window);
+
+    // Starts a grain, returning false if there is no source or every slot is taken.
+    bool start(const Grain & grain, int channelCount);
+
+    // the number of grains sounding
+    int count() const { return m_count; }
+
+    // stops every grain
+    void clear() { m_count = 0; }
+
+    // Adds the grains to the channels, and advances them by framesToProcess.
+    void render(float * const * channels, int channelCount, int framesToProcess);
+
+private:
+    struct Voice
+    {
+        int delay;
+        int age;
+        int length;
+        int base;         // the whole part of the read position
+        float fraction;   // and its fractional part
+        float increment;
+        float windowStep;
+        int channel;      // the first of the pair the grain is panned between
+        float gains[2];
+    };
+
+    // reads the source from the voice's position, wrapping at the end
+    void read(const Voice & voice, float * destination, int framesToProcess);
+
+    // adds a voice whose reads stay inside the source to one or two channels
+    void mix(const Voice & voice, float * left, float * right, int framesToProcess);
+
+    std::vector<Voice> m_voices;
+    int m_count = 0;
+
+    std::vector<float> m_source;
+    float m_sourceSampleRate = 0.f;
+
+    int m_windowFunction = -1;
+    float m_window[WindowTableSize + 2];
+};
+
+}  // namespace lab
+
+#endif  // GrainPool_h
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef HalfBandFilter_h
+#define HalfBandFilter_h
+
+namespace lab
+{
+
+// HalfBandFilter resamples by a factor of two with a polyphase half-band IIR
+// filter. The filter is the sum of two branches of first order allpass
+// sections, each running at the lower rate, so a section costs one multiply
+// per low rate frame. Its elliptic design gives a steep transition around a
+// quarter of the high sample rate, at the cost of a non-linear phase, which is
+// usually inaudible in an oversampled nonlinearity.
+//
+// A filter keeps the state of one channel in one direction; up and down
+// sampling a channel takes two filters.
+class HalfBandFilter
+{
+public:
+    enum
+    {
+        MaxCoefficients = 12
+    };
+
+    // transition is the width of the transition band, normalized to the high
+    // sample rate, in (0, 0.5). The pass band ends at 0.25 - transition / 2.
+    // More coefficients give a deeper stop band.
+    HalfBandFilter(int coefficientCount, double transition);
+
+    // destination holds framesToProcess * 2 frames, and must not overlap the source.
+    void upsample(const float * source, float * destination, int framesToProcess);
+
+    // source holds framesToProcess * 2 frames. The destination may be the source.
+    void downsample(const float * source, float * destination, int framesToProcess);
+
+    void reset();
+
+private:
+    int m_coefficientCount;
+    float m_coefficients[MaxCoefficients];
+
+    // the input and output of each section, a low rate frame ago
+    float m_x[MaxCoefficients];
+    float m_y[MaxCoefficients];
+};
+
+}  // namespace lab
+
+#endif  // HalfBandFilter_h
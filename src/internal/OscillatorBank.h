@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef OscillatorBank_h
+#define OscillatorBank_h
+
+namespace lab
+{
+
+// OscillatorBank renders the sum of up to MaxVoices sawtooth or square voices.
+// The voices run side by side in the lanes of a vector, four at a time, and
+// their discontinuities are smoothed by a PolyBLEP, a two frame polynomial
+// correction that removes most of the aliasing of the naive waveforms.
+//
+// The waveforms have the shapes of OscillatorNode's: the sawtooth falls from
+// one to minus one over a cycle, and the square is one for the first half of a
+// cycle and minus one for the second.
+//
+// Each voice has its own phase increment and gain on every frame. They are
+// interleaved, increments[frame * lanes + voice], where lanes is the voice
+// count rounded up to a multiple of four; the padding voices should have a
+// gain of zero.
+class OscillatorBank
+{
+public:
+    enum
+    {
+        MaxVoices = 16
+    };
+
+    enum class Waveform
+    {
+        Sawtooth,
+        Square
+    };
+
+    OscillatorBank();
+
+    // the voice count rounded up to a multiple of four
+    static int lanes(int voiceCount) { return (voiceCount + 3) & ~3; }
+
+    // Increments are in cycles per frame, and are clamped to [0, 0.5).
+    // destination is overwritten with the sum of the voices.
+    void render(Waveform waveform, const float * increments, const float * gains, int voiceCount,
+                float * destination, int framesToProcess);
+
+    // Spreads the starting phases of the voices over the cycle, so that they
+    // don't start in phase.
+    void reset();
+
+private:
+    alignas(16) float m_phases[MaxVoices];
+};
+
+}  // namespace lab
+
+#endif  // OscillatorBank_h
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#ifndef RandomGenerator_h
+#define RandomGenerator_h
+
+#include <cstdint>
+
+namespace lab
+{
+
+// RandomGenerator is a small, per instance source of random numbers that is
+// safe to use on the audio thread. It never locks or allocates, unlike rand()
+// and std::random_device, and the same seed always gives the same sequence.
+//
+// Blocks of noise are drawn from four xorshift32 generators running side by
+// side in the lanes of a vector, each seeded from the seed by splitmix32.
+// Single draws, for control decisions, come from a fifth generator so they
+// don't disturb the noise streams.
+//
+// The pink and brown fills are filtered white noise; the filter state belongs
+// to the generator, so a generator should fill only one stream of noise.
+class RandomGenerator
+{
+public:
+    enum
+    {
+        Lanes = 4
+    };
+
+    static const uint32_t DefaultSeed = 1489853723;
+
+    explicit RandomGenerator(uint32_t seed = DefaultSeed);
+
+    // restarts the sequences, and clears the pink and brown filters
+    void seed(uint32_t seed);
+
+    uint32_t nextUint32();
+
+    // uniform in [0, n], inclusive
+    uint32_t nextUint32(uint32_t n);
+
+    // uniform in [0, 1)
+    float nextFloat();
+
+    // uniform in [low, high)
+    float nextFloat(float low, float high) { return low + (high - low) * nextFloat(); }
+
+    // uniform white noise in [-1, 1)
+    void white(float * destination, int framesToProcess);
+
+    // white noise with a -3dB per octave slope, by Paul Kellet's refined filter
+    void pink(float * destination, int framesToProcess);
+
+    // white noise with a -6dB per octave slope, by a leaky integrator
+    void brown(float * destination, int framesToProcess);
+
+private:
+    alignas(16) uint32_t m_lanes[Lanes];
+    uint32_t m_single;
+
+    float m_pink[7];
+    float m_brown;
+};
+
+}  // namespace lab
+
+#endif  // RandomGenerator_h
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "internal/Crossover.h"
+#include "internal/Assertions.h"
+
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lab
+{
+
+Crossover::Crossover()
+{
+    setBands(1, 0, 0);
+}
+
+void Crossover::setBands(int bandCount, double lowFrequency, double highFrequency)
+{
+    m_bandCount = std::max(1, std::min(static_cast<int>(MaxBands), bandCount));
+    if (m_bandCount == 1)
+        return;
+
+    // a resonance of 0dB gives a Butterworth section
+    lowFrequency = std::max(0.0, std::min(1.0, lowFrequency));
+    for (int i = 0; i < 2; ++i)
+    {
+        m_lowSplitLowpass[i].setLowpassParams(lowFrequency, 0);
+        m_lowSplitHighpass[i].setHighpassParams(lowFrequency, 0);
+    }
+
+    if (m_bandCount == 3)
+    {
+        highFrequency = std::max(lowFrequency, std::min(1.0, highFrequency));
+        for (int i = 0; i < 2; ++i)
+        {
+            m_highSplitLowpass[i].setLowpassParams(highFrequency, 0);
+            m_highSplitHighpass[i].setHighpassParams(highFrequency, 0);
+        }
+
+        // the sum of a Linkwitz-Riley pair is a second order allpass with a Q of 1/sqrt(2)
+        m_lowBandAllpass.setAllpassParams(highFrequency, LAB_INV_SQRT_2);
+    }
+}
+
+void Crossover::process(const float * source, float * const * bands, int framesToProcess)
+{
+    if (m_bandCount == 1)
+    {
+        if (bands[0] != source)
+            memcpy(bands[0], source, sizeof(float) * framesToProcess);
+        return;
+    }
+
+    // The upper band is computed first, since the source may be the low band.
+    float * high = bands[m_bandCount - 1];
+    ASSERT(high != source);
+    m_lowSplitHighpass[0].process(source, high, framesToProcess);
+    m_lowSplitHighpass[1].process(high, high, framesToProcess);
+
+    float * low = bands[0];
+    m_lowSplitLowpass[0].process(source, low, framesToProcess);
+    m_lowSplitLowpass[1].process(low, low, framesToProcess);
+
+    if (m_bandCount == 3)
+    {
+        m_lowBandAllpass.process(low, low, framesToProcess);
+
+        float * mid = bands[1];
+        m_highSplitLowpass[0].process(high, mid, framesToProcess);
+        m_highSplitLowpass[1].process(mid, mid, framesToProcess);
+        m_highSplitHighpass[0].process(high, high, framesToProcess);
+        m_highSplitHighpass[1].process(high, high, framesToProcess);
+    }
+}
+
+void Crossover::reset()
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        m_lowSplitLowpass[i].reset();
+        m_lowSplitHighpass[i].reset();
+        m_highSplitLowpass[i].reset();
+        m_highSplitHighpass[i].reset();
+    }
+    m_lowBandAllpass.reset();
+}
+
+}  // namespace lab
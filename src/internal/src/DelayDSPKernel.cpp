@@ -9,6 +9,7 @@
 #include "internal/DelayDSPKernel.h"
 
 #include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -17,80 +18,65 @@ namespace lab
 
 const float SmoothingTimeConstant = 0.020f;  // 20ms
 
+// Once the smoothed delay is this close to the desired delay, in frames, it snaps to it.
+const double SettledDelayFrames = 1.0e-3;
+
 DelayDSPKernel::DelayDSPKernel(DelayProcessor * processor, float sampleRate)
     : AudioDSPKernel(processor)
-    , m_writeIndex(0)
+    , m_maxDelayTime(0)
+    , m_currentDelayTime(0)
     , m_firstTime(true)
-    , m_delayTimes(AudioNode::ProcessingSizeInFrames)
+    , m_desiredDelayFrames(0)
+    , m_delayFrames(AudioNode::ProcessingSizeInFrames)
 {
     ASSERT(processor);
     if (!processor)
         return;
 
-    m_maxDelayTime = processor->maxDelayTime();
-    ASSERT(m_maxDelayTime >= 0);
-    if (m_maxDelayTime < 0)
-        return;
-
-    m_buffer.allocate((int) bufferLengthForDelay(m_maxDelayTime, sampleRate));
-    m_buffer.zero();
-
-    m_smoothingRate = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, sampleRate);
+    allocate(processor->maxDelayTime(), sampleRate);
 }
 
 DelayDSPKernel::DelayDSPKernel(double maxDelayTime, float sampleRate)
     : AudioDSPKernel()
-    , m_maxDelayTime(maxDelayTime)
-    , m_writeIndex(0)
+    , m_maxDelayTime(0)
+    , m_currentDelayTime(0)
     , m_firstTime(true)
+    , m_desiredDelayFrames(0)
+    , m_delayFrames(AudioNode::ProcessingSizeInFrames)
 {
-    ASSERT(maxDelayTime > 0.0);
-    if (maxDelayTime <= 0.0)
-        return;
+    allocate(maxDelayTime, sampleRate);
+}
 
-    int bufferLength = (int) bufferLengthForDelay(maxDelayTime, sampleRate);
-    if (!bufferLength)
+void DelayDSPKernel::allocate(double maxDelayTime, float sampleRate)
+{
+    ASSERT(maxDelayTime >= 0);
+    if (maxDelayTime < 0)
         return;
 
-    m_buffer.allocate(bufferLength);
-    m_buffer.zero();
-
+    m_maxDelayTime = maxDelayTime;
+    m_line.allocate(static_cast<int>(AudioUtilities::timeToSampleFrame(maxDelayTime, sampleRate)), AudioNode::ProcessingSizeInFrames);
     m_smoothingRate = AudioUtilities::discreteTimeConstantForSampleRate(SmoothingTimeConstant, sampleRate);
 }
 
-size_t DelayDSPKernel::bufferLengthForDelay(double maxDelayTime, double sampleRate) const
-{
-    // Compute the length of the buffer needed to handle a max delay of |maxDelayTime|. One is
-    // added to handle the case where the actual delay equals the maximum delay.
-    return 1 + AudioUtilities::timeToSampleFrame(maxDelayTime, sampleRate);
-}
-
 void DelayDSPKernel::process(ContextRenderLock & r, const float * source, float * destination, int framesToProcess)
 {
-    size_t bufferLength = m_buffer.size();
-    float * buffer = m_buffer.data();
-
-    ASSERT(bufferLength);
-    if (!bufferLength)
+    ASSERT(m_line.isAllocated());
+    if (!m_line.isAllocated())
         return;
 
     ASSERT(source && destination);
     if (!source || !destination)
         return;
 
-    float sampleRate = r.context()->sampleRate();
-    double delayTime = 0;
-    float * delayTimes = m_delayTimes.data();
-    double maxTime = maxDelayTime();
+    const float sampleRate = r.context()->sampleRate();
 
-#if 1
-    /// @TODO before deleting the else clause here, is there a legitimate reason to have the delayTime be automated?
-    /// is it not just a setting? If it's actually an audio rate signal, then delayTime should be switched back
-    /// from AudioSetting to AudioParam.
-    delayTime = delayProcessor() ? delayProcessor()->delayTime()->valueFloat() : m_desiredDelayFrames / sampleRate;
+    /// @TODO is there a legitimate reason to have the delayTime be automated? is it not just a setting?
+    /// If it's actually an audio rate signal, then delayTime should be switched back from AudioSetting
+    /// to AudioParam, and the line read with per frame delays as it is while smoothing.
+    double delayTime = delayProcessor() ? delayProcessor()->delayTime()->valueFloat() : m_desiredDelayFrames / sampleRate;
 
     // Make sure the delay time is in a valid range.
-    delayTime = min(maxTime, delayTime);
+    delayTime = min(maxDelayTime(), delayTime);
     delayTime = max(0.0, delayTime);
 
     if (m_firstTime)
@@ -98,71 +84,40 @@ void DelayDSPKernel::process(ContextRenderLock & r, const float * source, float
         m_currentDelayTime = delayTime;
         m_firstTime = false;
     }
-    bool sampleAccurate = false;
-#else
-    bool sampleAccurate = delayProcessor() && delayProcessor()->delayTime()->hasSampleAccurateValues();
 
-    if (sampleAccurate)
-        delayProcessor()->delayTime()->calculateSampleAccurateValues(r, delayTimes, framesToProcess);
-    else
-    {
-        delayTime = delayProcessor() ? delayProcessor()->delayTime()->finalValue(r) : m_desiredDelayFrames / sampleRate;
+    DelayInterpolation interpolation = DelayInterpolation::Linear;
+    if (delayProcessor() && delayProcessor()->interpolation())
+        interpolation = static_cast<DelayInterpolation>(delayProcessor()->interpolation()->valueUint32());
 
-        // Make sure the delay time is in a valid range.
-        delayTime = min(maxTime, delayTime);
-        delayTime = max(0.0, delayTime);
+    const int blockFrames = m_line.blockFrames();
+    for (int offset = 0; offset < framesToProcess; offset += blockFrames)
+    {
+        const int frames = min(blockFrames, framesToProcess - offset);
+        m_line.write(source + offset, frames);
 
-        if (m_firstTime)
+        if (fabs(delayTime - m_currentDelayTime) * sampleRate < SettledDelayFrames)
         {
             m_currentDelayTime = delayTime;
-            m_firstTime = false;
+            m_line.read(m_tap, interpolation, delayTime * sampleRate, destination + offset, frames);
+            continue;
         }
-    }
-#endif
 
-    for (int i = 0; i < framesToProcess; ++i)
-    {
-        if (sampleAccurate)
+        // Approach desired delay time.
+        float * delayFrames = m_delayFrames.data();
+        for (int i = 0; i < frames; ++i)
         {
-            delayTime = delayTimes[i];
-            delayTime = std::min(maxTime, delayTime);
-            delayTime = std::max(0.0, delayTime);
-            m_currentDelayTime = delayTime;
-        }
-        else
-        {
-            // Approach desired delay time.
             m_currentDelayTime += (delayTime - m_currentDelayTime) * m_smoothingRate;
+            delayFrames[i] = static_cast<float>(m_currentDelayTime * sampleRate);
         }
-
-        double desiredDelayFrames = m_currentDelayTime * sampleRate;
-
-        double readPosition = m_writeIndex + bufferLength - desiredDelayFrames;
-        if (readPosition >= bufferLength)
-            readPosition -= bufferLength;
-
-        // Linearly interpolate in-between delay times.
-        int readIndex1 = static_cast<int>(readPosition);
-        int readIndex2 = (readIndex1 + 1) % bufferLength;
-        double interpolationFactor = readPosition - readIndex1;
-
-        double input = static_cast<float>(*source++);
-        buffer[m_writeIndex] = static_cast<float>(input);
-        m_writeIndex = (m_writeIndex + 1) % bufferLength;
-
-        double sample1 = buffer[readIndex1];
-        double sample2 = buffer[readIndex2];
-
-        double output = (1.0 - interpolationFactor) * sample1 + interpolationFactor * sample2;
-
-        *destination++ = static_cast<float>(output);
+        m_line.read(m_tap, interpolation, m_delayFrames.data(), destination + offset, frames);
     }
 }
 
 void DelayDSPKernel::reset()
 {
     m_firstTime = true;
-    m_buffer.zero();
+    m_tap = {};
+    m_line.reset();
 }
 
 double DelayDSPKernel::tailTime(ContextRenderLock & r) const
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "internal/DelayLine.h"
+#include "internal/Assertions.h"
+
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lab
+{
+
+namespace
+{
+    // Four point Catmull-Rom weights for a position t in [0, 1) between the middle two points.
+    inline void cubicWeights(float t, float * w)
+    {
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+        w[0] = -0.5f * t3 + t2 - 0.5f * t;
+        w[1] = 1.5f * t3 - 2.5f * t2 + 1.f;
+        w[2] = -1.5f * t3 + 2.f * t2 + 0.5f * t;
+        w[3] = 0.5f * t3 - 0.5f * t2;
+    }
+
+    // floor without a call into libm; delay positions are well within the range of an int
+    inline int floorToInt(float x)
+    {
+        const int i = static_cast<int>(x);
+        return i - (static_cast<float>(i) > x);
+    }
+
+    inline float cubic(const float * p, float t)
+    {
+        float w[4];
+        cubicWeights(t, w);
+        return w[0] * p[0] + w[1] * p[1] + w[2] * p[2] + w[3] * p[3];
+    }
+}
+
+DelayLine::DelayLine(int maxDelayFrames, int blockFrames)
+{
+    allocate(maxDelayFrames, blockFrames);
+}
+
+void DelayLine::allocate(int maxDelayFrames, int blockFrames)
+{
+    ASSERT(maxDelayFrames >= 0 && blockFrames > 0);
+    m_maxDelayFrames = std::max(0, maxDelayFrames);
+    m_blockFrames = std::max(1, blockFrames);
+
+    // a read reaches back one frame before the longest delay, and forward one frame past the block
+    unsigned length = 1;
+    while (length < static_cast<unsigned>(m_maxDelayFrames + m_blockFrames + 4))
+        length <<= 1;
+
+    m_mask = length - 1;
+    m_buffer.allocate(static_cast<int>(length) + m_blockFrames + 3);
+    reset();
+}
+
+void DelayLine::reset()
+{
+    m_buffer.zero();
+    m_writeIndex = 0;
+}
+
+void DelayLine::write(const float * source, int framesToProcess)
+{
+    ASSERT(framesToProcess <= m_blockFrames);
+    if (!m_mask || framesToProcess <= 0)
+        return;
+
+    float * buffer = m_buffer.data();
+    const int length = static_cast<int>(m_mask) + 1;
+    const int guard = m_buffer.size() - length;
+    const int start = static_cast<int>(m_writeIndex);
+
+    const int first = std::min(framesToProcess, length - start);
+    memcpy(buffer + start, source, sizeof(float) * first);
+    if (framesToProcess > first)
+        memcpy(buffer, source + first, sizeof(float) * (framesToProcess - first));
+
+    // mirror whatever landed in the head of the buffer past its end
+    if (start < guard)
+        memcpy(buffer + length + start, buffer + start, sizeof(float) * std::min(first, guard - start));
+    if (framesToProcess > first)
+        memcpy(buffer + length, buffer, sizeof(float) * std::min(framesToProcess - first, guard));
+
+    m_writeIndex = (m_writeIndex + framesToProcess) & m_mask;
+}
+
+void DelayLine::read(Tap & tap, DelayInterpolation interpolation, double delayFrames, float * destination, int framesToProcess) const
+{
+    ASSERT(framesToProcess <= m_blockFrames);
+    if (!m_mask || framesToProcess <= 0)
+        return;
+
+    const float * buffer = m_buffer.data();
+    const unsigned blockStart = (m_writeIndex - framesToProcess) & m_mask;
+
+    delayFrames = std::max(0.0, std::min(static_cast<double>(m_maxDelayFrames), delayFrames));
+    const int whole = static_cast<int>(delayFrames);
+    const float fraction = static_cast<float>(delayFrames - whole);
+
+    // frame i of the block, delayed by the whole frames, is at p[i]
+    const float * p = buffer + ((blockStart - whole) & m_mask);
+
+    if (fraction == 0.f)
+    {
+        memcpy(destination, p, sizeof(float) * framesToProcess);
+        tap.allpassState = destination[framesToProcess - 1];
+        return;
+    }
+
+    if (interpolation == DelayInterpolation::Cubic && whole >= 1)
+    {
+        // the read position is a fraction 1 - fraction past p[i - 1]
+        float w[4];
+        cubicWeights(1.f - fraction, w);
+        const float * q = buffer + ((blockStart - whole - 2) & m_mask);
+        VectorMath::vsmul(q, 1, &w[0], destination, 1, framesToProcess);
+        VectorMath::vsma(q + 1, 1, &w[1], destination, 1, framesToProcess);
+        VectorMath::vsma(q + 2, 1, &w[2], destination, 1, framesToProcess);
+        VectorMath::vsma(q + 3, 1, &w[3], destination, 1, framesToProcess);
+    }
+    else if (interpolation == DelayInterpolation::Allpass)
+    {
+        // keep the allpass delay in [0.5, 1.5) where its phase delay is flattest
+        float delta = fraction;
+        int newest = whole;
+        if (delta < 0.5f && whole >= 1)
+        {
+            delta += 1.f;
+            newest -= 1;
+        }
+        const float eta = (1.f - delta) / (1.f + delta);
+        const float * q = buffer + ((blockStart - newest - 1) & m_mask);
+        float y = tap.allpassState;
+        for (int i = 0; i < framesToProcess; ++i)
+        {
+            y = eta * (q[i + 1] - y) + q[i];
+            destination[i] = y;
+        }
+        tap.allpassState = y;
+        return;
+    }
+    else
+    {
+        const float * q = buffer + ((blockStart - whole - 1) & m_mask);
+        const float near = 1.f - fraction;
+        VectorMath::vsmul(q + 1, 1, &near, destination, 1, framesToProcess);
+        VectorMath::vsma(q, 1, &fraction, destination, 1, framesToProcess);
+    }
+
+    tap.allpassState = destination[framesToProcess - 1];
+}
+
+void DelayLine::read(Tap & tap, DelayInterpolation interpolation, const float * delayFrames, float * destination, int framesToProcess) const
+{
+    ASSERT(framesToProcess <= m_blockFrames);
+    if (!m_mask || framesToProcess <= 0)
+        return;
+
+    const float * buffer = m_buffer.data();
+    const unsigned blockStart = (m_writeIndex - framesToProcess) & m_mask;
+    const float maxDelay = static_cast<float>(m_maxDelayFrames);
+
+    switch (interpolation)
+    {
+        case DelayInterpolation::Cubic:
+            for (int i = 0; i < framesToProcess; ++i)
+            {
+                const float delay = std::max(0.f, std::min(maxDelay, delayFrames[i]));
+                const float position = static_cast<float>(i) - delay;
+                const int index = floorToInt(position);
+                const float t = position - index;
+                const unsigned base = blockStart + index;
+                if (delay >= 1.f)
+                    destination[i] = cubic(buffer + ((base - 1) & m_mask), t);
+                else
+                {
+                    const float * q = buffer + (base & m_mask);
+                    destination[i] = q[0] + t * (q[1] - q[0]);
+                }
+            }
+            tap.allpassState = destination[framesToProcess - 1];
+            break;
+
+        case DelayInterpolation::Allpass:
+        {
+            float y = tap.allpassState;
+            for (int i = 0; i < framesToProcess; ++i)
+            {
+                const float delay = std::max(0.f, std::min(maxDelay, delayFrames[i]));
+                const float position = static_cast<float>(i) - delay;
+                const int index = floorToInt(position);
+                int newest = index + 1;
+                float delta = 1.f - (position - index);
+                if (delta < 0.5f && newest < i)
+                {
+                    delta += 1.f;
+                    newest += 1;
+                }
+                const float eta = (1.f - delta) / (1.f + delta);
+                const float * q = buffer + ((blockStart + newest - 1) & m_mask);
+                y = eta * (q[1] - y) + q[0];
+                destination[i] = y;
+            }
+            tap.allpassState = y;
+            break;
+        }
+
+        default:
+            for (int i = 0; i < framesToProcess; ++i)
+            {
+                const float delay = std::max(0.f, std::min(maxDelay, delayFrames[i]));
+                const float position = static_cast<float>(i) - delay;
+                const int index = floorToInt(position);
+                const float t = position - index;
+                const float * q = buffer + ((blockStart + index) & m_mask);
+                destination[i] = q[0] + t * (q[1] - q[0]);
+            }
+            tap.allpassState = destination[framesToProcess - 1];
+            break;
+    }
+}
+
+}  // namespace lab
@@ -12,11 +12,13 @@ namespace lab
 {
 
 
-DelayProcessor::DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> t)
+DelayProcessor::DelayProcessor(float sampleRate, double maxDelayTime, std::shared_ptr<AudioSetting> t,
+                               std::shared_ptr<AudioSetting> interpolation)
     : AudioDSPKernelProcessor()
     , m_maxDelayTime(maxDelayTime)
     , m_sampleRate(sampleRate)
     , m_delayTime(t)
+    , m_interpolation(interpolation)
 {
 }
 
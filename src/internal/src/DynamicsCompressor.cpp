@@ -7,23 +7,32 @@
 #include "internal/AudioUtilities.h"
 
 #include "LabSound/core/AudioBus.h"
+#include "LabSound/core/AudioNode.h"
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include "LabSound/core/Macros.h"
 
+#include <algorithm>
+
 namespace lab
 {
 
 using namespace AudioUtilities;
 
 DynamicsCompressor::DynamicsCompressor(unsigned numberOfChannels)
-    : m_numberOfChannels(numberOfChannels)
-    , m_compressor(numberOfChannels)
+    : m_numberOfChannels(0)
 {
     // Uninitialized state - for parameter recalculation.
     m_lastFilterStageRatio = -1;
     m_lastAnchor = -1;
     m_lastFilterStageGain = -1;
+    m_lastBandCount = -1;
+    m_lastLowCrossover = -1;
+    m_lastHighCrossover = -1;
+
+    for (auto & compressor : m_compressors)
+        compressor.reset(new DynamicsCompressorKernel(numberOfChannels));
 
     setNumberOfChannels(numberOfChannels);
     initializeParameters();
@@ -60,6 +69,11 @@ void DynamicsCompressor::initializeParameters()
     m_parameters[ParamPostGain] = 0;  // dB
     m_parameters[ParamReduction] = 0;  // dB
 
+    // A single band, or crossovers for two or three bands.
+    m_parameters[ParamBandCount] = 1;
+    m_parameters[ParamLowCrossover] = 200;  // Hz
+    m_parameters[ParamHighCrossover] = 2000;  // Hz
+
     // Linear crossfade (0 -> 1).
     m_parameters[ParamEffectBlend] = 1;
 }
@@ -108,24 +122,21 @@ void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceB
     int numberOfDestChannels = destinationBus->numberOfChannels();
     int numberOfSourceChannels = sourceBus->numberOfChannels();
 
-    if (!numberOfSourceChannels)
+    // Destination channels the source doesn't have are silent.
+    int numberOfChannels = std::min(numberOfSourceChannels, numberOfDestChannels);
+    if (!numberOfChannels)
     {
         destinationBus->zero();
         return;
     }
 
-    if (numberOfDestChannels != m_numberOfChannels)
-    {
-        setNumberOfChannels(numberOfSourceChannels);
-        numberOfDestChannels = numberOfSourceChannels;
-        for (int i = 0; i < numberOfDestChannels; ++i)
-        {
-            m_sourceChannels[i] = sourceBus->channel(i)->data();
-            m_destinationChannels[i] = destinationBus->channel(i)->mutableData();
-        }
-    }
+    if (numberOfChannels != m_numberOfChannels)
+        setNumberOfChannels(numberOfChannels);
 
-    for (int i = 0; i < numberOfDestChannels; ++i)
+    for (int i = numberOfChannels; i < numberOfDestChannels; ++i)
+        destinationBus->channel(i)->zero();
+
+    for (int i = 0; i < numberOfChannels; ++i)
     {
         m_sourceChannels[i] = sourceBus->channel(i)->data();
         m_destinationChannels[i] = destinationBus->channel(i)->mutableData();
@@ -146,7 +157,7 @@ void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceB
 
     // Apply pre-emphasis filter.
     // Note that the final three stages are computed in-place in the destination buffer.
-    for (int i = 0; i < numberOfDestChannels; ++i)
+    for (int i = 0; i < numberOfChannels; ++i)
     {
         const float * sourceData = m_sourceChannels[i];
         float * destinationData = m_destinationChannels[i];
@@ -178,30 +189,97 @@ void DynamicsCompressor::process(ContextRenderLock & r, const AudioBus * sourceB
     float releaseZone3 = parameterValue(ParamReleaseZone3);
     float releaseZone4 = parameterValue(ParamReleaseZone4);
 
-    // Apply compression to the pre-filtered signal. The processing is performed in place.
-    m_compressor.process(r,
-                         m_sourceChannels.get(),
-                         m_destinationChannels.get(),
-                         numberOfDestChannels,
-                         bufferSize,
-                         dbThreshold,
-                         dbKnee,
-                         ratio,
-                         attackTime,
-                         releaseTime,
-                         preDelayTime,
-                         dbPostGain,
-                         effectBlend,
-                         releaseZone1,
-                         releaseZone2,
-                         releaseZone3,
-                         releaseZone4);
+    int bandCount = std::max(1, std::min(static_cast<int>(Crossover::MaxBands), static_cast<int>(parameterValue(ParamBandCount))));
+    float lowCrossover = parameterValue(ParamLowCrossover);
+    float highCrossover = parameterValue(ParamHighCrossover);
+
+    if (bandCount != m_lastBandCount || lowCrossover != m_lastLowCrossover || highCrossover != m_lastHighCrossover)
+    {
+        // Bands that weren't running have stale state.
+        if (bandCount != m_lastBandCount)
+        {
+            for (int band = std::max(1, m_lastBandCount); band < bandCount; ++band)
+                m_compressors[band]->reset();
+            for (unsigned i = 0; i < m_numberOfChannels; ++i)
+                m_crossovers[i]->reset();
+        }
+
+        m_lastBandCount = bandCount;
+        m_lastLowCrossover = lowCrossover;
+        m_lastHighCrossover = highCrossover;
+
+        const double nyquist = 0.5 * r.context()->sampleRate();
+        for (unsigned i = 0; i < m_numberOfChannels; ++i)
+            m_crossovers[i]->setBands(bandCount, lowCrossover / nyquist, highCrossover / nyquist);
+    }
+
+    // Split the pre-filtered signal into bands; the lowest band stays in the destination.
+    for (int band = 0; band < bandCount; ++band)
+    {
+        for (int i = 0; i < numberOfChannels; ++i)
+        {
+            float * bandData = m_destinationChannels[i];
+            if (band > 0)
+            {
+                AudioFloatArray & buffer = *m_bandBuffers[(band - 1) * numberOfChannels + i];
+                if (buffer.size() < bufferSize)
+                    buffer.allocate(bufferSize);
+                bandData = buffer.data();
+            }
+            m_bandSources[band * numberOfChannels + i] = bandData;
+            m_bandDestinations[band * numberOfChannels + i] = bandData;
+        }
+    }
+
+    if (bandCount > 1)
+    {
+        for (int i = 0; i < numberOfChannels; ++i)
+        {
+            float * bands[Crossover::MaxBands];
+            for (int band = 0; band < bandCount; ++band)
+                bands[band] = m_bandDestinations[band * numberOfChannels + i];
+            m_crossovers[i]->process(m_destinationChannels[i], bands, bufferSize);
+        }
+    }
+
+    // Apply compression to each band of the pre-filtered signal. The processing is performed in place.
+    float reduction = 0;
+    for (int band = 0; band < bandCount; ++band)
+    {
+        m_compressors[band]->process(r,
+                                     m_bandSources.get() + band * numberOfChannels,
+                                     m_bandDestinations.get() + band * numberOfChannels,
+                                     numberOfChannels,
+                                     bufferSize,
+                                     dbThreshold,
+                                     dbKnee,
+                                     ratio,
+                                     attackTime,
+                                     releaseTime,
+                                     preDelayTime,
+                                     dbPostGain,
+                                     effectBlend,
+                                     releaseZone1,
+                                     releaseZone2,
+                                     releaseZone3,
+                                     releaseZone4);
+
+        // The reported compression is that of the most compressed band.
+        reduction = std::min(reduction, m_compressors[band]->meteringGain());
+    }
+
+    // Sum the bands back into the destination.
+    for (int band = 1; band < bandCount; ++band)
+    {
+        for (int i = 0; i < numberOfChannels; ++i)
+            VectorMath::vadd(m_bandSources[band * numberOfChannels + i], 1, m_destinationChannels[i], 1, m_destinationChannels[i], 1, bufferSize);
+    }
 
     // Update the compression amount.
-    setParameterValue(ParamReduction, m_compressor.meteringGain());
+    setParameterValue(ParamReduction, reduction);
 
     // Apply de-emphasis filter.
-    for (int i = 0; i < numberOfDestChannels; ++i)
+    for (int i = 0; i < numberOfChannels; ++i)
     {
         float * destinationData = m_destinationChannels[i];
         ZeroPole * postFilters = m_postFilterPacks[i]->filters;
@@ -226,9 +304,11 @@ void DynamicsCompressor::reset()
             m_preFilterPacks[channel]->filters[stageIndex].reset();
             m_postFilterPacks[channel]->filters[stageIndex].reset();
         }
+        m_crossovers[channel]->reset();
     }
 
-    m_compressor.reset();
+    for (auto & compressor : m_compressors)
+        compressor->reset();
 }
 
 void DynamicsCompressor::setNumberOfChannels(unsigned numberOfChannels)
@@ -247,7 +327,21 @@ void DynamicsCompressor::setNumberOfChannels(unsigned numberOfChannels)
     m_sourceChannels = std::unique_ptr<const float * []>(new const float *[numberOfChannels]);
     m_destinationChannels = std::unique_ptr<float * []>(new float *[numberOfChannels]);
 
-    m_compressor.setNumberOfChannels(numberOfChannels);
+    // The crossovers are set up on the next process.
+    m_crossovers.clear();
+    for (unsigned i = 0; i < numberOfChannels; ++i)
+        m_crossovers.push_back(std::unique_ptr<Crossover>(new Crossover()));
+    m_lastBandCount = -1;
+
+    m_bandBuffers.clear();
+    for (unsigned i = 0; i < (Crossover::MaxBands - 1) * numberOfChannels; ++i)
+        m_bandBuffers.push_back(std::unique_ptr<AudioFloatArray>(new AudioFloatArray(AudioNode::ProcessingSizeInFrames)));
+
+    m_bandSources = std::unique_ptr<const float * []>(new const float *[Crossover::MaxBands * numberOfChannels]);
+    m_bandDestinations = std::unique_ptr<float * []>(new float *[Crossover::MaxBands * numberOfChannels]);
+
+    for (auto & compressor : m_compressors)
+        compressor->setNumberOfChannels(numberOfChannels);
     m_numberOfChannels = numberOfChannels;
 }
 
@@ -257,7 +351,7 @@ double DynamicsCompressor::tailTime(ContextRenderLock & r) const
 }
 double DynamicsCompressor::latencyTime(ContextRenderLock & r) const
 {
-    return m_compressor.latencyFrames() / static_cast<double>(r.context()->sampleRate());
+    return m_compressors[0]->latencyFrames() / static_cast<double>(r.context()->sampleRate());
 }
 
 }  // namespace lab
@@ -2,6 +2,7 @@
 // Copyright (C) 2011, Google Inc. All rights reserved.
 // Copyright (C) 2015+, The LabSound Authors. All rights reserved.
 
+#include "LabSound/core/AudioNode.h"
 #include "LabSound/core/Macros.h"
 
 #include "internal/Assertions.h"
@@ -10,6 +11,7 @@
 #include "internal/DynamicsCompressorKernel.h"
 
 #include "LabSound/extended/AudioContextLock.h"
+#include "LabSound/extended/VectorMath.h"
 
 #include <algorithm>
 #include <memory>
@@ -26,10 +28,20 @@ const float meteringReleaseTimeConstant = 0.325f;
 
 const float uninitializedValue = -1;
 
+namespace
+{
+    const int BlockFrames = AudioNode::ProcessingSizeInFrames;
+
+    // 20 * log10(2), to convert log2 of a gain to decibels.
+    const float DecibelsPerDoubling = 6.0205999f;
+}
+
 DynamicsCompressorKernel::DynamicsCompressorKernel(unsigned numberOfChannels)
     : m_lastPreDelayFrames(DefaultPreDelayFrames)
-    , m_preDelayReadIndex(0)
-    , m_preDelayWriteIndex(DefaultPreDelayFrames)
+    , m_level(BlockFrames)
+    , m_attenuation(BlockFrames)
+    , m_releaseRate(BlockFrames)
+    , m_gain(BlockFrames)
     , m_ratio(uninitializedValue)
     , m_slope(uninitializedValue)
     , m_linearThreshold(uninitializedValue)
@@ -39,7 +51,12 @@ DynamicsCompressorKernel::DynamicsCompressorKernel(unsigned numberOfChannels)
     , m_kneeThresholdDb(uninitializedValue)
     , m_ykneeThresholdDb(uninitializedValue)
     , m_K(uninitializedValue)
+    , m_log2LinearThreshold(0)
+    , m_log2KneeThreshold(0)
+    , m_kneeTableScale(0)
 {
+    std::fill(m_kneeTable, m_kneeTable + KneeTableSize, 0.f);
+
     setNumberOfChannels(numberOfChannels);
 
     // Initializes most member variables
@@ -49,12 +66,12 @@ DynamicsCompressorKernel::DynamicsCompressorKernel(unsigned numberOfChannels)
 void DynamicsCompressorKernel::setNumberOfChannels(unsigned numberOfChannels)
 {
 
-    if (m_preDelayBuffers.size() == numberOfChannels)
+    if (m_preDelayLines.size() == numberOfChannels)
         return;
 
-    m_preDelayBuffers.clear();
+    m_preDelayLines.clear();
     for (unsigned i = 0; i < numberOfChannels; ++i)
-        m_preDelayBuffers.push_back(std::unique_ptr<AudioFloatArray>(new AudioFloatArray(MaxPreDelayFrames)));
+        m_preDelayLines.push_back(std::unique_ptr<DelayLine>(new DelayLine(MaxPreDelayFrames, BlockFrames)));
 }
 
 void DynamicsCompressorKernel::setPreDelayTime(float preDelayTime, float sampleRate)
@@ -63,15 +80,16 @@ void DynamicsCompressorKernel::setPreDelayTime(float preDelayTime, float sampleR
     int preDelayFrames = static_cast<int>(preDelayTime * sampleRate);
     if (preDelayFrames > MaxPreDelayFrames - 1)
         preDelayFrames = MaxPreDelayFrames - 1;
+    if (preDelayFrames < 0)
+        preDelayFrames = 0;
 
-    if (m_lastPreDelayFrames != preDelayFrames)
+    if (m_lastPreDelayFrames != static_cast<unsigned>(preDelayFrames))
     {
+        // the lines hold the longest pre-delay, so changing it never reallocates
         m_lastPreDelayFrames = preDelayFrames;
-        for (unsigned i = 0; i < m_preDelayBuffers.size(); ++i)
-            m_preDelayBuffers[i]->zero();
-
-        m_preDelayReadIndex = 0;
-        m_preDelayWriteIndex = preDelayFrames;
+        for (auto & line : m_preDelayLines)
+            line->reset();
+        m_preDelayTap = {};
     }
 }
 
@@ -180,10 +198,80 @@ float DynamicsCompressorKernel::updateStaticCurveParameters(float dbThreshold, f
         m_ykneeThresholdDb = linearToDecibels(kneeCurve(m_kneeThreshold, k));
 
         m_K = k;
+
+        updateKneeTable(k);
     }
     return m_K;
 }
 
+void DynamicsCompressorKernel::updateKneeTable(float k)
+{
+    m_log2LinearThreshold = log2f(m_linearThreshold);
+    m_log2KneeThreshold = log2f(m_kneeThreshold);
+
+    const float span = m_log2KneeThreshold - m_log2LinearThreshold;
+    if (!(span > 0))
+    {
+        // no knee; the curve breaks straight from linear to the ratio at the threshold
+        std::fill(m_kneeTable, m_kneeTable + KneeTableSize, 0.f);
+        m_kneeTableScale = 0;
+        return;
+    }
+
+    for (int i = 0; i < KneeTableSize; ++i)
+    {
+        const float x = exp2f(m_log2LinearThreshold + span * i / (KneeTableSize - 1));
+        m_kneeTable[i] = std::min(0.f, log2f(kneeCurve(x, k) / x));
+    }
+    m_kneeTableScale = (KneeTableSize - 1) / span;
+}
+
+// Put the detector levels in m_level through the shaping curve, giving the attenuation
+// and the rate at which the detector releases towards it for each frame. The curve is
+// linear up to the threshold, then enters a "knee" portion followed by the "ratio" portion.
+// Working with log2 of the level and of the gain, only the knee lookup isn't vectorized.
+void DynamicsCompressorKernel::computeAttenuation(int framesToProcess, float satReleaseFrames)
+{
+    float * log2Level = m_level.data();
+    float * attenuation = m_attenuation.data();
+    float * releaseRate = m_releaseRate.data();
+
+    VectorMath::vlog2(log2Level, log2Level, framesToProcess);
+
+    // Below this level, the input is treated as silence and isn't attenuated.
+    const float log2Silence = -13.287712f;  // log2(0.0001)
+
+    const float * table = m_kneeTable;
+    const float tableStart = m_log2LinearThreshold;
+    const float tableScale = m_kneeTableScale;
+    const float tableEnd = static_cast<float>(KneeTableSize - 1);
+    const float log2KneeThreshold = m_log2KneeThreshold;
+    const float ratioSlope = m_slope - 1;
+
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        // the knee, clamped to its ends, plus the ratio portion above it
+        const float t = std::min(tableEnd, std::max(0.f, (log2Level[i] - tableStart) * tableScale));
+        const int index = std::min(static_cast<int>(t), KneeTableSize - 2);
+        const float fraction = t - static_cast<float>(index);
+        const float log2Gain = table[index] + fraction * (table[index + 1] - table[index])
+            + ratioSlope * std::max(0.f, log2Level[i] - log2KneeThreshold);
+        attenuation[i] = log2Level[i] > log2Silence ? log2Gain : 0.f;
+    }
+
+    // satReleaseRate = decibelsToLinear(max(2, attenuationDb) / satReleaseFrames) - 1, as
+    // the series for exp(y) - 1, which is accurate for the small exponents involved.
+    const float exponentScale = static_cast<float>(LAB_LN_2) / satReleaseFrames;
+    const float minExponent = 2.f * static_cast<float>(LAB_LN_10) / (20.f * satReleaseFrames);
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        const float y = std::max(minExponent, -attenuation[i] * exponentScale);
+        releaseRate[i] = y * (1.f + y * (0.5f + y * (0.16666667f + y * (0.041666668f + y * 0.0083333333f))));
+    }
+
+    VectorMath::vexp2(attenuation, attenuation, framesToProcess);
+}
+
 void DynamicsCompressorKernel::process(ContextRenderLock & r,
                                        const float * sourceChannels[],
                                        float * destinationChannels[],
@@ -202,7 +290,7 @@ void DynamicsCompressorKernel::process(ContextRenderLock & r,
                                        float releaseZone3,
                                        float releaseZone4)
 {
-    ASSERT(m_preDelayBuffers.size() == numberOfChannels);
+    ASSERT(m_preDelayLines.size() == numberOfChannels);
 
     float sampleRate = r.context()->sampleRate();
 
@@ -260,150 +348,134 @@ void DynamicsCompressorKernel::process(ContextRenderLock & r,
 
     const int nDivisionFrames = 32;
 
-    const int nDivisions = framesToProcess / nDivisionFrames;
+    float * level = m_level.data();
+    float * attenuation = m_attenuation.data();
+    float * releaseRate = m_releaseRate.data();
+    float * gain = m_gain.data();
 
-    unsigned frameIndex = 0;
-    for (int i = 0; i < nDivisions; ++i)
+    for (int blockStart = 0; blockStart < framesToProcess; blockStart += BlockFrames)
     {
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-        // Calculate desired gain
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-
-        // Fix gremlins.
-        if (std::isnan(m_detectorAverage))
-            m_detectorAverage = 1;
-        if (std::isinf(m_detectorAverage))
-            m_detectorAverage = 1;
-
-        float desiredGain = m_detectorAverage;
-
-        // Pre-warp so we get desiredGain after sin() warp below.
-        float scaledDesiredGain = asinf(desiredGain) / (0.5f * static_cast<float>(LAB_PI));
+        const int blockFrames = std::min(BlockFrames, framesToProcess - blockStart);
 
         // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-        // Deal with envelopes
+        // Calculate shaped power on the undelayed input, for the whole block.
         // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-        // envelopeRate is the rate we slew from current compressor level to the desired level.
-        // The exact rate depends on if we're attacking or releasing and by how much.
-        float envelopeRate;
-
-        bool isReleasing = scaledDesiredGain > m_compressorGain;
-
-        // compressionDiffDb is the difference between current compression level and the desired level.
-        float compressionDiffDb = linearToDecibels(m_compressorGain / scaledDesiredGain);
-
-        if (isReleasing)
+        // The channels are linked; the detector follows the loudest of them.
         {
-            // Release mode - compressionDiffDb should be negative dB
-            m_maxAttackCompressionDiffDb = -1;
-
-            // Fix gremlins.
-            if (isnan(compressionDiffDb))
-                compressionDiffDb = -1;
-            if (isinf(compressionDiffDb))
-                compressionDiffDb = -1;
-
-            // Adaptive release - higher compression (lower compressionDiffDb)  releases faster.
-
-            // Contain within range: -12 -> 0 then scale to go from 0 -> 3
-            float x = compressionDiffDb;
-            x = max(-12.0f, x);
-            x = min(0.0f, x);
-            x = 0.25f * (x + 12);
-
-            // Compute adaptive release curve using 4th order polynomial.
-            // Normal values for the polynomial coefficients would create a monotonically increasing function.
-            float x2 = x * x;
-            float x3 = x2 * x;
-            float x4 = x2 * x2;
-            float releaseFrames = kA + kB * x + kC * x2 + kD * x3 + kE * x4;
+            const float * source = sourceChannels[0] + blockStart;
+            for (int j = 0; j < blockFrames; ++j)
+                level[j] = std::fabs(source[j]);
+        }
+        for (unsigned i = 1; i < numberOfChannels; ++i)
+        {
+            const float * source = sourceChannels[i] + blockStart;
+            for (int j = 0; j < blockFrames; ++j)
+                level[j] = std::max(level[j], std::fabs(source[j]));
+        }
 
-#define kSpacingDb 5
-            float dbPerFrame = kSpacingDb / releaseFrames;
+        computeAttenuation(blockFrames, satReleaseFrames);
 
-            envelopeRate = decibelsToLinear(dbPerFrame);
-        }
-        else
+        // A short block ends with a short division.
+        for (int divisionStart = 0; divisionStart < blockFrames; divisionStart += nDivisionFrames)
         {
-            // Attack mode - compressionDiffDb should be positive dB
+            const int divisionEnd = std::min(blockFrames, divisionStart + nDivisionFrames);
+
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // Calculate desired gain
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
             // Fix gremlins.
-            if (isnan(compressionDiffDb))
-                compressionDiffDb = 1;
-            if (isinf(compressionDiffDb))
-                compressionDiffDb = 1;
+            if (std::isnan(m_detectorAverage))
+                m_detectorAverage = 1;
+            if (std::isinf(m_detectorAverage))
+                m_detectorAverage = 1;
 
-            // As long as we're still in attack mode, use a rate based off
-            // the largest compressionDiffDb we've encountered so far.
-            if (m_maxAttackCompressionDiffDb == -1 || m_maxAttackCompressionDiffDb < compressionDiffDb)
-                m_maxAttackCompressionDiffDb = compressionDiffDb;
+            float desiredGain = m_detectorAverage;
 
-            float effAttenDiffDb = max(0.5f, m_maxAttackCompressionDiffDb);
+            // Pre-warp so we get desiredGain after sin() warp below.
+            float scaledDesiredGain = asinf(desiredGain) / (0.5f * static_cast<float>(LAB_PI));
 
-            float x = 0.25f / effAttenDiffDb;
-            envelopeRate = 1 - powf(x, 1 / attackFrames);
-        }
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // Deal with envelopes
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-        // Inner loop - calculate shaped power average - apply compression.
-        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // envelopeRate is the rate we slew from current compressor level to the desired level.
+            // The exact rate depends on if we're attacking or releasing and by how much.
+            float envelopeRate;
 
-        {
-            int preDelayReadIndex = m_preDelayReadIndex;
-            int preDelayWriteIndex = m_preDelayWriteIndex;
-            float detectorAverage = m_detectorAverage;
-            float compressorGain = m_compressorGain;
+            bool isReleasing = scaledDesiredGain > m_compressorGain;
 
-            int loopFrames = nDivisionFrames;
-            while (loopFrames--)
+            // compressionDiffDb is the difference between current compression level and the desired level.
+            float compressionDiffDb = linearToDecibels(m_compressorGain / scaledDesiredGain);
+
+            if (isReleasing)
             {
-                float compressorInput = 0;
+                // Release mode - compressionDiffDb should be negative dB
+                m_maxAttackCompressionDiffDb = -1;
 
-                // Predelay signal, computing compression amount from un-delayed version.
-                for (unsigned i = 0; i < numberOfChannels; ++i)
-                {
-                    float * delayBuffer = m_preDelayBuffers[i]->data();
-                    float undelayedSource = sourceChannels[i][frameIndex];
-                    delayBuffer[preDelayWriteIndex] = undelayedSource;
+                // Fix gremlins.
+                if (isnan(compressionDiffDb))
+                    compressionDiffDb = -1;
+                if (isinf(compressionDiffDb))
+                    compressionDiffDb = -1;
+
+                // Adaptive release - higher compression (lower compressionDiffDb)  releases faster.
+
+                // Contain within range: -12 -> 0 then scale to go from 0 -> 3
+                float x = compressionDiffDb;
+                x = max(-12.0f, x);
+                x = min(0.0f, x);
+                x = 0.25f * (x + 12);
+
+                // Compute adaptive release curve using 4th order polynomial.
+                // Normal values for the polynomial coefficients would create a monotonically increasing function.
+                float x2 = x * x;
+                float x3 = x2 * x;
+                float x4 = x2 * x2;
+                float releaseFrames = kA + kB * x + kC * x2 + kD * x3 + kE * x4;
 
-                    float absUndelayedSource = undelayedSource > 0 ? undelayedSource : -undelayedSource;
-                    if (compressorInput < absUndelayedSource)
-                        compressorInput = absUndelayedSource;
-                }
+#define kSpacingDb 5
+                float dbPerFrame = kSpacingDb / releaseFrames;
 
-                // Calculate shaped power on undelayed input.
+                envelopeRate = decibelsToLinear(dbPerFrame);
+            }
+            else
+            {
+                // Attack mode - compressionDiffDb should be positive dB
 
-                float scaledInput = compressorInput;
-                float absInput = scaledInput > 0 ? scaledInput : -scaledInput;
+                // Fix gremlins.
+                if (isnan(compressionDiffDb))
+                    compressionDiffDb = 1;
+                if (isinf(compressionDiffDb))
+                    compressionDiffDb = 1;
 
-                // Put through shaping curve.
-                // This is linear up to the threshold, then enters a "knee" portion followed by the "ratio" portion.
-                // The transition from the threshold to the knee is smooth (1st derivative matched).
-                // The transition from the knee to the ratio portion is smooth (1st derivative matched).
-                float shapedInput = saturate(absInput, k);
+                // As long as we're still in attack mode, use a rate based off
+                // the largest compressionDiffDb we've encountered so far.
+                if (m_maxAttackCompressionDiffDb == -1 || m_maxAttackCompressionDiffDb < compressionDiffDb)
+                    m_maxAttackCompressionDiffDb = compressionDiffDb;
 
-                float attenuation = absInput <= 0.0001f ? 1 : shapedInput / absInput;
+                float effAttenDiffDb = max(0.5f, m_maxAttackCompressionDiffDb);
 
-                float attenuationDb = -linearToDecibels(attenuation);
-                attenuationDb = max(2.0f, attenuationDb);
+                float x = 0.25f / effAttenDiffDb;
+                envelopeRate = 1 - powf(x, 1 / attackFrames);
+            }
 
-                float dbPerFrame = attenuationDb / satReleaseFrames;
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+            // Inner loop - run the detector average and the compressor gain, which are recurrences.
+            // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-                float satReleaseRate = decibelsToLinear(dbPerFrame) - 1;
+            float detectorAverage = m_detectorAverage;
+            float compressorGain = m_compressorGain;
 
-                bool isRelease = (attenuation > detectorAverage);
-                float rate = isRelease ? satReleaseRate : 1;
+            for (int j = divisionStart; j < divisionEnd; ++j)
+            {
+                bool isRelease = (attenuation[j] > detectorAverage);
+                float rate = isRelease ? releaseRate[j] : 1;
 
-                detectorAverage += (attenuation - detectorAverage) * rate;
+                detectorAverage += (attenuation[j] - detectorAverage) * rate;
                 detectorAverage = min(1.0f, detectorAverage);
 
-                // Fix gremlins.
-                if (isnan(detectorAverage))
-                    detectorAverage = 1;
-                if (isinf(detectorAverage))
-                    detectorAverage = 1;
-
                 // Exponential approach to desired gain.
                 if (envelopeRate < 1)
                 {
@@ -417,37 +489,55 @@ void DynamicsCompressorKernel::process(ContextRenderLock & r,
                     compressorGain = min(1.0f, compressorGain);
                 }
 
-                // Warp pre-compression gain to smooth out sharp exponential transition points.
-                float postWarpCompressorGain = sinf(0.5f * static_cast<float>(LAB_PI) * compressorGain);
-
-                // Calculate total gain using master gain and effect blend.
-                float totalGain = dryMix + wetMix * masterLinearGain * postWarpCompressorGain;
-
-                // Calculate metering.
-                float dbRealGain = 20 * log10(postWarpCompressorGain);
-                if (dbRealGain < m_meteringGain)
-                    m_meteringGain = dbRealGain;
-                else
-                    m_meteringGain += (dbRealGain - m_meteringGain) * m_meteringReleaseK;
-
-                // Apply final gain.
-                for (unsigned i = 0; i < numberOfChannels; ++i)
-                {
-                    float * delayBuffer = m_preDelayBuffers[i]->data();
-                    destinationChannels[i][frameIndex] = delayBuffer[preDelayReadIndex] * totalGain;
-                }
-
-                frameIndex++;
-                preDelayReadIndex = (preDelayReadIndex + 1) & MaxPreDelayFramesMask;
-                preDelayWriteIndex = (preDelayWriteIndex + 1) & MaxPreDelayFramesMask;
+                gain[j] = compressorGain;
             }
 
             // Locals back to member variables.
-            m_preDelayReadIndex = preDelayReadIndex;
-            m_preDelayWriteIndex = preDelayWriteIndex;
             m_detectorAverage = DenormalDisabler::flushDenormalFloatToZero(detectorAverage);
             m_compressorGain = DenormalDisabler::flushDenormalFloatToZero(compressorGain);
         }
+
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        // Warp, meter, and apply the gain, for the whole block.
+        // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        // Warp pre-compression gain to smooth out sharp exponential transition points.
+        // sin(pi/2 * gain) as its Taylor series, which is within 4e-6 over [0, 1].
+        for (int j = 0; j < blockFrames; ++j)
+        {
+            const float z = static_cast<float>(LAB_HALF_PI) * gain[j];
+            const float z2 = z * z;
+            gain[j] = z * (1.f + z2 * (-0.16666667f + z2 * (0.0083333333f + z2 * (-0.00019841270f + z2 * 2.7557319e-6f))));
+        }
+
+        // Calculate metering. The level isn't needed any longer, and holds log2 of the gain.
+        VectorMath::vlog2(gain, level, blockFrames);
+        float meteringGain = m_meteringGain;
+        for (int j = 0; j < blockFrames; ++j)
+        {
+            float dbRealGain = DecibelsPerDoubling * level[j];
+            if (dbRealGain < meteringGain)
+                meteringGain = dbRealGain;
+            else
+                meteringGain += (dbRealGain - meteringGain) * m_meteringReleaseK;
+        }
+        m_meteringGain = meteringGain;
+
+        // Calculate total gain using master gain and effect blend.
+        const float wetGain = wetMix * masterLinearGain;
+        for (int j = 0; j < blockFrames; ++j)
+            gain[j] = dryMix + wetGain * gain[j];
+
+        // Predelay the signal, then apply the final gain. The source is written to the
+        // line before it is read, so the destination may be the source.
+        for (unsigned i = 0; i < numberOfChannels; ++i)
+        {
+            float * destination = destinationChannels[i] + blockStart;
+            DelayLine & line = *m_preDelayLines[i];
+            line.write(sourceChannels[i] + blockStart, blockFrames);
+            line.read(m_preDelayTap, DelayInterpolation::Linear, static_cast<double>(m_lastPreDelayFrames), destination, blockFrames);
+            VectorMath::vmul(destination, 1, gain, 1, destination, 1, blockFrames);
+        }
     }
 }
 
@@ -458,11 +548,9 @@ void DynamicsCompressorKernel::reset()
     m_meteringGain = 1;
 
     // Predelay section.
-    for (unsigned i = 0; i < m_preDelayBuffers.size(); ++i)
-        m_preDelayBuffers[i]->zero();
-
-    m_preDelayReadIndex = 0;
-    m_preDelayWriteIndex = DefaultPreDelayFrames;
+    for (auto & line : m_preDelayLines)
+        line->reset();
+    m_preDelayTap = {};
 
     m_maxAttackCompressionDiffDb = -1;  // uninitialized state
 }
@@ -47,7 +47,7 @@ FFTFrame::FFTFrame() : m_FFTSize(0), m_log2FFTSize(0), mFFT(0), mIFFT(0)
 
 // Copy constructor.
 FFTFrame::FFTFrame(const FFTFrame & frame) 
-    : m_FFTSize(frame.m_FFTSize), m_log2FFTSize(frame.m_log2FFTSize), mFFT(0), mIFFT(0), m_realData(frame.m_FFTSize / 2), m_imagData(frame.m_FFTSize / 2)
+    : m_FFTSize(frame.m_FFTSize), m_log2FFTSize(frame.m_log2FFTSize), mFFT(0), mIFFT(0), m_realData(frame.m_FFTSize / 2 + 1), m_imagData(frame.m_FFTSize / 2 + 1)
 {
     mFFT = kiss_fftr_alloc(m_FFTSize, 0, nullptr, nullptr);
     mIFFT = kiss_fftr_alloc(m_FFTSize, 1, nullptr, nullptr);
@@ -68,8 +68,8 @@ FFTFrame::~FFTFrame()
 {
     KISS_FFT_FREE(mFFT);
     KISS_FFT_FREE(mIFFT);
-    delete m_cpxInputData;
-    delete m_cpxOutputData;
+    delete[] m_cpxInputData;
+    delete[] m_cpxOutputData;
 }
 
 void FFTFrame::multiply(const FFTFrame & frame)
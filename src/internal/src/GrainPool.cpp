@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "internal/GrainPool.h"
+
+#include "LabSound/core/AudioBus.h"
+#include "LabSound/core/Macros.h"
+#include "LabSound/extended/VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+namespace lab
+{
+
+namespace
+{
+    const int ChunkFrames = 128;
+}
+
+GrainPool::GrainPool()
+    : m_voices(MaxGrains)
+{
+    setWindow(WindowFunction::bartlett);
+}
+
+GrainPool::~GrainPool() = default;
+
+void GrainPool::setSource(const AudioBus * source)
+{
+    m_count = 0;
+
+    if (!source || !source->length() || !source->numberOfChannels())
+    {
+        m_source.clear();
+        m_sourceSampleRate = 0.f;
+        return;
+    }
+
+    const int length = source->length();
+    const int channels = source->numberOfChannels();
+    m_source.assign(length, 0.f);
+    m_sourceSampleRate = source->sampleRate();
+
+    const float scale = 1.f / channels;
+    for (int c = 0; c < channels; ++c)
+        VectorMath::vsma(source->channel(c)->data(), 1, &scale, m_source.data(), 1, length);
+}
+
+void GrainPool::setWindow(WindowFunction window)
+{
+    if (static_cast<int>(window) == m_windowFunction)
+        return;
+
+    m_windowFunction = static_cast<int>(window);
+    for (int i = 0; i <= WindowTableSize; ++i)
+        m_window[i] = 1.f;
+    ApplyWindowFunctionInplace(window, m_window, WindowTableSize + 1);
+
+    // rounding may carry the last position of a grain just past the end of the table
+    m_window[WindowTableSize + 1] = m_window[WindowTableSize];
+}
+
+bool GrainPool::start(const Grain & grain, int channelCount)
+{
+    const int sourceLength = static_cast<int>(m_source.size());
+    if (!sourceLength || m_count == MaxGrains || channelCount < 1)
+        return false;
+
+    Voice & voice = m_voices[m_count++];
+    voice.delay = std::max(0, grain.delay);
+    voice.age = 0;
+    voice.length = std::max(2, grain.length);
+    voice.windowStep = static_cast<float>(WindowTableSize) / (voice.length - 1);
+    voice.increment = std::max(0.f, grain.increment);
+
+    double position = std::fmod(grain.position, static_cast<double>(sourceLength));
+    if (position < 0)
+        position += sourceLength;
+    voice.base = std::min(static_cast<int>(position), sourceLength - 1);
+    voice.fraction = static_cast<float>(position - voice.base);
+
+    // equal power between the two channels either side of the position
+    const float pan = std::max(-1.f, std::min(1.f, grain.pan));
+    const float x = (pan + 1.f) * 0.5f * (channelCount - 1);
+    voice.channel = std::min(static_cast<int>(x), std::max(0, channelCount - 2));
+    const float t = std::min(1.f, x - voice.channel) * static_cast<float>(LAB_HALF_PI);
+    voice.gains[0] = grain.gain * std::cos(t);
+    voice.gains[1] = grain.gain * std::sin(t);
+    if (channelCount == 1)
+    {
+        voice.gains[0] = grain.gain;
+        voice.gains[1] = 0.f;
+    }
+    return true;
+}
+
+void GrainPool::read(const Voice & voice, float * destination, int framesToProcess)
+{
+    const float * source = m_source.data();
+    const int sourceLength = static_cast<int>(m_source.size());
+
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        const float p = voice.fraction + i * voice.increment;
+        const int whole = static_cast<int>(p);
+        const int index = (voice.base + whole) % sourceLength;
+        const int next = index + 1 == sourceLength ? 0 : index + 1;
+        destination[i] = source[index] + (p - whole) * (source[next] - source[index]);
+    }
+}
+
+void GrainPool::mix(const Voice & voice, float * left, float * right, int framesToProcess)
+{
+    const float * window = m_window;
+    const float * source = m_source.data() + voice.base;
+    const float windowStart = voice.age * voice.windowStep;
+    int i = 0;
+
+#if defined(__SSE2__) || defined(ARM_NEON_INTRINSICS)
+    // Four frames at a time. The table reads are scalar, everything else is not.
+    const int end = framesToProcess - framesToProcess % 4;
+    alignas(16) int32_t w[4];
+    alignas(16) int32_t s[4];
+#endif
+
+#ifdef __SSE2__
+    const __m128 windowStep = _mm_set1_ps(voice.windowStep);
+    const __m128 increment = _mm_set1_ps(voice.increment);
+    const __m128 windowBegin = _mm_set1_ps(windowStart);
+    const __m128 sourceBegin = _mm_set1_ps(voice.fraction);
+    const __m128 gain0 = _mm_set1_ps(voice.gains[0]);
+    const __m128 gain1 = _mm_set1_ps(voice.gains[1]);
+    __m128 index = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+    const __m128 four = _mm_set1_ps(4.f);
+    for (; i < end; i += 4)
+    {
+        const __m128 wp = _mm_add_ps(windowBegin, _mm_mul_ps(index, windowStep));
+        const __m128 sp = _mm_add_ps(sourceBegin, _mm_mul_ps(index, increment));
+        const __m128i wi = _mm_cvttps_epi32(wp);
+        const __m128i si = _mm_cvttps_epi32(sp);
+        const __m128 wf = _mm_sub_ps(wp, _mm_cvtepi32_ps(wi));
+        const __m128 sf = _mm_sub_ps(sp, _mm_cvtepi32_ps(si));
+        _mm_store_si128(reinterpret_cast<__m128i *>(w), wi);
+        _mm_store_si128(reinterpret_cast<__m128i *>(s), si);
+
+        const __m128 w0 = _mm_setr_ps(window[w[0]], window[w[1]], window[w[2]], window[w[3]]);
+        const __m128 w1 = _mm_setr_ps(window[w[0] + 1], window[w[1] + 1], window[w[2] + 1], window[w[3] + 1]);
+        const __m128 s0 = _mm_setr_ps(source[s[0]], source[s[1]], source[s[2]], source[s[3]]);
+        const __m128 s1 = _mm_setr_ps(source[s[0] + 1], source[s[1] + 1], source[s[2] + 1], source[s[3] + 1]);
+
+        const __m128 envelope = _mm_add_ps(w0, _mm_mul_ps(wf, _mm_sub_ps(w1, w0)));
+        const __m128 y = _mm_mul_ps(envelope, _mm_add_ps(s0, _mm_mul_ps(sf, _mm_sub_ps(s1, s0))));
+
+        _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(y, gain0)));
+        if (right)
+            _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(y, gain1)));
+        index = _mm_add_ps(index, four);
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    const float32x4_t windowStep = vdupq_n_f32(voice.windowStep);
+    const float32x4_t increment = vdupq_n_f32(voice.increment);
+    const float32x4_t windowBegin = vdupq_n_f32(windowStart);
+    const float32x4_t sourceBegin = vdupq_n_f32(voice.fraction);
+    const float32x4_t four = vdupq_n_f32(4.f);
+    const float first[4] = {0.f, 1.f, 2.f, 3.f};
+    float32x4_t index = vld1q_f32(first);
+    for (; i < end; i += 4)
+    {
+        const float32x4_t wp = vmlaq_f32(windowBegin, index, windowStep);
+        const float32x4_t sp = vmlaq_f32(sourceBegin, index, increment);
+        const int32x4_t wi = vcvtq_s32_f32(wp);
+        const int32x4_t si = vcvtq_s32_f32(sp);
+        const float32x4_t wf = vsubq_f32(wp, vcvtq_f32_s32(wi));
+        const float32x4_t sf = vsubq_f32(sp, vcvtq_f32_s32(si));
+        vst1q_s32(w, wi);
+        vst1q_s32(s, si);
+
+        const float w0p[4] = {window[w[0]], window[w[1]], window[w[2]], window[w[3]]};
+        const float w1p[4] = {window[w[0] + 1], window[w[1] + 1], window[w[2] + 1], window[w[3] + 1]};
+        const float s0p[4] = {source[s[0]], source[s[1]], source[s[2]], source[s[3]]};
+        const float s1p[4] = {source[s[0] + 1], source[s[1] + 1], source[s[2] + 1], source[s[3] + 1]};
+        const float32x4_t w0 = vld1q_f32(w0p);
+        const float32x4_t s0 = vld1q_f32(s0p);
+
+        const float32x4_t envelope = vmlaq_f32(w0, wf, vsubq_f32(vld1q_f32(w1p), w0));
+        const float32x4_t y = vmulq_f32(envelope, vmlaq_f32(s0, sf, vsubq_f32(vld1q_f32(s1p), s0)));
+
+        vst1q_f32(left + i, vmlaq_n_f32(vld1q_f32(left + i), y, voice.gains[0]));
+        if (right)
+            vst1q_f32(right + i, vmlaq_n_f32(vld1q_f32(right + i), y, voice.gains[1]));
+        index = vaddq_f32(index, four);
+    }
+#endif
+
+    for (; i < framesToProcess; ++i)
+    {
+        const float wp = windowStart + i * voice.windowStep;
+        const float sp = voice.fraction + i * voice.increment;
+        const int wi = static_cast<int>(wp);
+        const int si = static_cast<int>(sp);
+        const float envelope = window[wi] + (wp - wi) * (window[wi + 1] - window[wi]);
+        const float y = envelope * (source[si] + (sp - si) * (source[si + 1] - source[si]));
+        left[i] += y * voice.gains[0];
+        if (right)
+            right[i] += y * voice.gains[1];
+    }
+}
+
+void GrainPool::render(float * const * channels, int channelCount, int framesToProcess)
+{
+    if (m_source.empty() || channelCount < 1)
+        return;
+
+    const int sourceLength = static_cast<int>(m_source.size());
+    alignas(16) float envelope[ChunkFrames];
+    alignas(16) float samples[ChunkFrames];
+
+    for (int g = 0; g < m_count;)
+    {
+        Voice & voice = m_voices[g];
+
+        if (voice.delay >= framesToProcess)
+        {
+            voice.delay -= framesToProcess;
+            ++g;
+            continue;
+        }
+
+        const int first = voice.delay;
+        const int frames = std::min(framesToProcess - first, voice.length - voice.age);
+        voice.delay = 0;
+
+        float * left = channels[std::min(voice.channel, channelCount - 1)] + first;
+        float * right = voice.channel + 1 < channelCount ? channels[voice.channel + 1] + first : nullptr;
+
+        // one frame of margin past the last read, for rounding
+        const float last = voice.fraction + (frames - 1) * voice.increment;
+        if (voice.base + static_cast<int>(last) + 2 < sourceLength)
+            mix(voice, left, right, frames);
+        else
+        {
+            // the grain reaches the end of the source, and continues from the start
+            for (int start = 0; start < frames; start += ChunkFrames)
+            {
+                const int n = std::min(ChunkFrames, frames - start);
+
+                const float windowStart = (voice.age + start) * voice.windowStep;
+                VectorMath::vramp(&windowStart, &voice.windowStep, envelope, 1, n);
+                VectorMath::vlint(m_window, envelope, envelope, n);
+
+                Voice chunk = voice;
+                const float offset = voice.fraction + start * voice.increment;
+                chunk.base = (voice.base + static_cast<int>(offset)) % sourceLength;
+                chunk.fraction = offset - static_cast<int>(offset);
+                read(chunk, samples, n);
+                VectorMath::vmul(envelope, 1, samples, 1, samples, 1, n);
+
+                VectorMath::vsma(samples, 1, &voice.gains[0], left + start, 1, n);
+                if (right)
+                    VectorMath::vsma(samples, 1, &voice.gains[1], right + start, 1, n);
+            }
+        }
+
+        voice.age += frames;
+        const float end = voice.fraction + frames * voice.increment;
+        const int whole = static_cast<int>(end);
+        voice.fraction = end - whole;
+        voice.base = (voice.base + whole) % sourceLength;
+
+        // a finished grain gives its slot to the last grain, which is visited next
+        if (voice.age >= voice.length)
+            voice = m_voices[--m_count];
+        else
+            ++g;
+    }
+}
+
+}  // namespace lab
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "internal/HalfBandFilter.h"
+#include "internal/Assertions.h"
+
+#include "LabSound/core/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lab
+{
+
+namespace
+{
+    // The allpass coefficients of a half-band elliptic filter, following
+    // Valenzuela and Constantinides, "Digital signal processing schemes for
+    // efficient interpolation and decimation", IEE Proceedings 1983.
+    void designHalfBand(double * coefficients, int count, double transition)
+    {
+        const int order = count * 2 + 1;
+
+        // the modulus, and the nome of the elliptic functions
+        const double t = std::tan((1 - transition * 2) * LAB_PI / 4);
+        const double k = t * t;
+        const double kk = std::pow(1 - k * k, 0.25);
+        const double e = 0.5 * (1 - kk) / (1 + kk);
+        const double e4 = e * e * e * e;
+        const double q = e * (1 + e4 * (2 + e4 * (15 + 150 * e4)));
+
+        for (int index = 0; index < count; ++index)
+        {
+            const int c = index + 1;
+
+            // the theta functions, as series in the nome
+            double numerator = 0;
+            double term;
+            int i = 0;
+            double sign = 1;
+            do
+            {
+                term = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * LAB_PI / order) * sign;
+                numerator += term;
+                sign = -sign;
+                ++i;
+            } while (std::fabs(term) > 1e-100);
+
+            double denominator = 0;
+            i = 1;
+            sign = -1;
+            do
+            {
+                term = std::pow(q, i * i) * std::cos(i * 2 * c * LAB_PI / order) * sign;
+                denominator += term;
+                sign = -sign;
+                ++i;
+            } while (std::fabs(term) > 1e-100);
+
+            const double w = numerator * std::pow(q, 0.25) / (denominator + 0.5);
+            const double w2 = w * w;
+            const double x = std::sqrt((1 - w2 * k) * (1 - w2 / k)) / (1 + w2);
+            coefficients[index] = (1 - x) / (1 + x);
+        }
+    }
+}
+
+HalfBandFilter::HalfBandFilter(int coefficientCount, double transition)
+    : m_coefficientCount(std::max(1, std::min(static_cast<int>(MaxCoefficients), coefficientCount)))
+{
+    ASSERT(transition > 0 && transition < 0.5);
+    double coefficients[MaxCoefficients];
+    designHalfBand(coefficients, m_coefficientCount, transition);
+    for (int i = 0; i < m_coefficientCount; ++i)
+        m_coefficients[i] = static_cast<float>(coefficients[i]);
+    reset();
+}
+
+void HalfBandFilter::reset()
+{
+    std::fill(m_x, m_x + MaxCoefficients, 0.f);
+    std::fill(m_y, m_y + MaxCoefficients, 0.f);
+}
+
+// The even sections form one branch and the odd sections the other. Each
+// branch filters its own phase of the high rate signal.
+void HalfBandFilter::upsample(const float * source, float * destination, int framesToProcess)
+{
+    const int count = m_coefficientCount;
+    const float * c = m_coefficients;
+    float * x = m_x;
+    float * y = m_y;
+
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        float even = source[i];
+        float odd = source[i];
+        for (int j = 0; j + 1 < count; j += 2)
+        {
+            const float evenOut = (even - y[j]) * c[j] + x[j];
+            x[j] = even;
+            y[j] = evenOut;
+            even = evenOut;
+
+            const float oddOut = (odd - y[j + 1]) * c[j + 1] + x[j + 1];
+            x[j + 1] = odd;
+            y[j + 1] = oddOut;
+            odd = oddOut;
+        }
+        if (count & 1)
+        {
+            const int j = count - 1;
+            const float evenOut = (even - y[j]) * c[j] + x[j];
+            x[j] = even;
+            y[j] = evenOut;
+            even = evenOut;
+        }
+        destination[i * 2] = even;
+        destination[i * 2 + 1] = odd;
+    }
+}
+
+void HalfBandFilter::downsample(const float * source, float * destination, int framesToProcess)
+{
+    const int count = m_coefficientCount;
+    const float * c = m_coefficients;
+    float * x = m_x;
+    float * y = m_y;
+
+    for (int i = 0; i < framesToProcess; ++i)
+    {
+        float even = source[i * 2 + 1];
+        float odd = source[i * 2];
+        for (int j = 0; j + 1 < count; j += 2)
+        {
+            const float evenOut = (even - y[j]) * c[j] + x[j];
+            x[j] = even;
+            y[j] = evenOut;
+            even = evenOut;
+
+            const float oddOut = (odd - y[j + 1]) * c[j + 1] + x[j + 1];
+            x[j + 1] = odd;
+            y[j + 1] = oddOut;
+            odd = oddOut;
+        }
+        if (count & 1)
+        {
+            const int j = count - 1;
+            const float evenOut = (even - y[j]) * c[j] + x[j];
+            x[j] = even;
+            y[j] = evenOut;
+            even = evenOut;
+        }
+        destination[i] = 0.5f * (even + odd);
+    }
+}
+
+}  // namespace lab
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "internal/OscillatorBank.h"
+#include "internal/Assertions.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+namespace lab
+{
+
+namespace
+{
+    const int ChunkFrames = 128;
+
+    // The highest increment is just under Nyquist, and the PolyBLEP divides by the increment.
+    const float MaxIncrement = 0.4999f;
+    const float MinBlepIncrement = 1e-9f;
+
+    // The PolyBLEP residual for a rising step of two at phase zero, for a phase t in [0, 1).
+    inline float polyBlep(float t, float dt)
+    {
+        if (t < dt)
+        {
+            const float x = t / dt;
+            return x + x - x * x - 1.f;
+        }
+        if (t > 1.f - dt)
+        {
+            const float x = (t - 1.f) / dt;
+            return x * x + x + x + 1.f;
+        }
+        return 0.f;
+    }
+
+    inline float voice(OscillatorBank::Waveform waveform, float t, float dt)
+    {
+        const float blepIncrement = std::max(dt, MinBlepIncrement);
+        if (waveform == OscillatorBank::Waveform::Sawtooth)
+            return 1.f - 2.f * t + polyBlep(t, blepIncrement);
+
+        float half = t + 0.5f;
+        if (half >= 1.f)
+            half -= 1.f;
+        return (t < 0.5f ? 1.f : -1.f) + polyBlep(t, blepIncrement) - polyBlep(half, blepIncrement);
+    }
+
+#ifdef __SSE2__
+    inline __m128 polyBlep(__m128 t, __m128 dt, __m128 inverseDt)
+    {
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 x1 = _mm_mul_ps(t, inverseDt);
+        const __m128 c1 = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(x1, x1), _mm_mul_ps(x1, x1)), one);
+        const __m128 x2 = _mm_mul_ps(_mm_sub_ps(t, one), inverseDt);
+        const __m128 c2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x2, x2), _mm_add_ps(x2, x2)), one);
+        return _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(t, dt), c1), _mm_and_ps(_mm_cmpgt_ps(t, _mm_sub_ps(one, dt)), c2));
+    }
+#elif defined(ARM_NEON_INTRINSICS)
+    inline float32x4_t polyBlep(float32x4_t t, float32x4_t dt, float32x4_t inverseDt)
+    {
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const float32x4_t zero = vdupq_n_f32(0.f);
+        const float32x4_t x1 = vmulq_f32(t, inverseDt);
+        const float32x4_t c1 = vsubq_f32(vmlsq_f32(vaddq_f32(x1, x1), x1, x1), one);
+        const float32x4_t x2 = vmulq_f32(vsubq_f32(t, one), inverseDt);
+        const float32x4_t c2 = vaddq_f32(vmlaq_f32(vaddq_f32(x2, x2), x2, x2), one);
+        return vaddq_f32(vbslq_f32(vcltq_f32(t, dt), c1, zero), vbslq_f32(vcgtq_f32(t, vsubq_f32(one, dt)), c2, zero));
+    }
+#endif
+}
+
+OscillatorBank::OscillatorBank()
+{
+    reset();
+}
+
+void OscillatorBank::reset()
+{
+    // steps of the golden ratio spread any number of voices evenly over the cycle
+    for (int v = 0; v < MaxVoices; ++v)
+    {
+        const float phase = 0.6180340f * v;
+        m_phases[v] = phase - static_cast<float>(static_cast<int>(phase));
+    }
+}
+
+void OscillatorBank::render(Waveform waveform, const float * increments, const float * gains, int voiceCount,
+                            float * destination, int framesToProcess)
+{
+    ASSERT(voiceCount <= MaxVoices);
+    voiceCount = std::max(1, std::min(static_cast<int>(MaxVoices), voiceCount));
+    const int laneCount = lanes(voiceCount);
+    const bool square = waveform == Waveform::Square;
+
+    for (int start = 0; start < framesToProcess; start += ChunkFrames)
+    {
+        const int frames = std::min(ChunkFrames, framesToProcess - start);
+
+        // the voices of each group of four are summed lane by lane, and the lanes are summed at the end
+        alignas(16) float sums[ChunkFrames * 4];
+        memset(sums, 0, sizeof(float) * frames * 4);
+
+        for (int v0 = 0; v0 < laneCount; v0 += 4)
+        {
+#ifdef __SSE2__
+            const __m128 one = _mm_set1_ps(1.f);
+            const __m128 two = _mm_set1_ps(2.f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 maxIncrement = _mm_set1_ps(MaxIncrement);
+            const __m128 minBlepIncrement = _mm_set1_ps(MinBlepIncrement);
+            __m128 t = _mm_load_ps(m_phases + v0);
+            for (int i = 0; i < frames; ++i)
+            {
+                const int index = (start + i) * laneCount + v0;
+                const __m128 dt = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(increments + index), zero), maxIncrement);
+                const __m128 blepDt = _mm_max_ps(dt, minBlepIncrement);
+                const __m128 inverseDt = _mm_div_ps(one, blepDt);
+
+                __m128 y;
+                if (square)
+                {
+                    __m128 t2 = _mm_add_ps(t, half);
+                    t2 = _mm_sub_ps(t2, _mm_and_ps(_mm_cmpge_ps(t2, one), one));
+                    // one for the first half of the cycle, minus one for the second
+                    y = _mm_sub_ps(one, _mm_and_ps(_mm_cmpge_ps(t, half), two));
+                    y = _mm_add_ps(y, _mm_sub_ps(polyBlep(t, blepDt, inverseDt), polyBlep(t2, blepDt, inverseDt)));
+                }
+                else
+                    y = _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(two, t)), polyBlep(t, blepDt, inverseDt));
+
+                float * sum = sums + i * 4;
+                _mm_store_ps(sum, _mm_add_ps(_mm_load_ps(sum), _mm_mul_ps(y, _mm_loadu_ps(gains + index))));
+
+                t = _mm_add_ps(t, dt);
+                t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpge_ps(t, one), one));
+            }
+            _mm_store_ps(m_phases + v0, t);
+#elif defined(ARM_NEON_INTRINSICS)
+            const float32x4_t one = vdupq_n_f32(1.f);
+            const float32x4_t minusOne = vdupq_n_f32(-1.f);
+            const float32x4_t two = vdupq_n_f32(2.f);
+            const float32x4_t half = vdupq_n_f32(0.5f);
+            const float32x4_t zero = vdupq_n_f32(0.f);
+            const float32x4_t maxIncrement = vdupq_n_f32(MaxIncrement);
+            const float32x4_t minBlepIncrement = vdupq_n_f32(MinBlepIncrement);
+            float32x4_t t = vld1q_f32(m_phases + v0);
+            for (int i = 0; i < frames; ++i)
+            {
+                const int index = (start + i) * laneCount + v0;
+                const float32x4_t dt = vminq_f32(vmaxq_f32(vld1q_f32(increments + index), zero), maxIncrement);
+                const float32x4_t blepDt = vmaxq_f32(dt, minBlepIncrement);
+                float32x4_t inverseDt = vrecpeq_f32(blepDt);
+                inverseDt = vmulq_f32(vrecpsq_f32(blepDt, inverseDt), inverseDt);
+                inverseDt = vmulq_f32(vrecpsq_f32(blepDt, inverseDt), inverseDt);
+
+                float32x4_t y;
+                if (square)
+                {
+                    float32x4_t t2 = vaddq_f32(t, half);
+                    t2 = vsubq_f32(t2, vbslq_f32(vcgeq_f32(t2, one), one, zero));
+                    // one for the first half of the cycle, minus one for the second
+                    y = vbslq_f32(vcltq_f32(t, half), one, minusOne);
+                    y = vaddq_f32(y, vsubq_f32(polyBlep(t, blepDt, inverseDt), polyBlep(t2, blepDt, inverseDt)));
+                }
+                else
+                    y = vaddq_f32(vmlsq_f32(one, two, t), polyBlep(t, blepDt, inverseDt));
+
+                float * sum = sums + i * 4;
+                vst1q_f32(sum, vmlaq_f32(vld1q_f32(sum), y, vld1q_f32(gains + index)));
+
+                t = vaddq_f32(t, dt);
+                t = vsubq_f32(t, vbslq_f32(vcgeq_f32(t, one), one, zero));
+            }
+            vst1q_f32(m_phases + v0, t);
+#else
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                float t = m_phases[v0 + lane];
+                for (int i = 0; i < frames; ++i)
+                {
+                    const int index = (start + i) * laneCount + v0 + lane;
+                    const float dt = std::min(std::max(increments[index], 0.f), MaxIncrement);
+                    sums[i * 4 + lane] += voice(waveform, t, dt) * gains[index];
+                    t += dt;
+                    if (t >= 1.f)
+                        t -= 1.f;
+                }
+                m_phases[v0 + lane] = t;
+            }
+#endif
+        }
+
+        float * dest = destination + start;
+        for (int i = 0; i < frames; ++i)
+        {
+            const float * sum = sums + i * 4;
+            dest[i] = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+        }
+    }
+}
+
+}  // namespace lab
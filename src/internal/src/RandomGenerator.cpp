@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright (C) 2020, The LabSound Authors. All rights reserved.
+
+#include "internal/RandomGenerator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(ARM_NEON_INTRINSICS)
+#include <arm_neon.h>
+#endif
+
+namespace lab
+{
+
+namespace
+{
+    const int ChunkFrames = 128;
+
+    // splitmix32 turns consecutive seeds into well mixed, unrelated states
+    inline uint32_t splitmix32(uint32_t & state)
+    {
+        uint32_t z = (state += 0x9e3779b9u);
+        z = (z ^ (z >> 16)) * 0x85ebca6bu;
+        z = (z ^ (z >> 13)) * 0xc2b2ae35u;
+        z ^= z >> 16;
+        // xorshift never leaves a zero state
+        return z ? z : 0x6d2b79f5u;
+    }
+
+    inline uint32_t xorshift32(uint32_t & x)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    // The top 23 bits become the mantissa of a float in [2, 4), which is moved to [-1, 1).
+    inline float bipolar(uint32_t x)
+    {
+        const uint32_t bits = (x >> 9) | 0x40000000u;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f - 3.f;
+    }
+}
+
+RandomGenerator::RandomGenerator(uint32_t seed)
+{
+    this->seed(seed);
+}
+
+void RandomGenerator::seed(uint32_t seed)
+{
+    uint32_t state = seed;
+    for (int lane = 0; lane < Lanes; ++lane)
+        m_lanes[lane] = splitmix32(state);
+    m_single = splitmix32(state);
+
+    for (float & p : m_pink)
+        p = 0.f;
+    m_brown = 0.f;
+}
+
+uint32_t RandomGenerator::nextUint32()
+{
+    return xorshift32(m_single);
+}
+
+uint32_t RandomGenerator::nextUint32(uint32_t n)
+{
+    // scale the draw rather than take a modulus, which favors small results
+    return static_cast<uint32_t>((static_cast<uint64_t>(nextUint32()) * (static_cast<uint64_t>(n) + 1)) >> 32);
+}
+
+float RandomGenerator::nextFloat()
+{
+    const uint32_t bits = (nextUint32() >> 9) | 0x3f800000u;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f - 1.f;
+}
+
+void RandomGenerator::white(float * destination, int framesToProcess)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(m_lanes));
+    const __m128i exponent = _mm_set1_epi32(0x40000000);
+    const __m128 three = _mm_set1_ps(3.f);
+    for (; i + 4 <= framesToProcess; i += 4)
+    {
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        const __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), exponent);
+        _mm_storeu_ps(destination + i, _mm_sub_ps(_mm_castsi128_ps(bits), three));
+    }
+    _mm_store_si128(reinterpret_cast<__m128i *>(m_lanes), x);
+#elif defined(ARM_NEON_INTRINSICS)
+    uint32x4_t x = vld1q_u32(m_lanes);
+    const uint32x4_t exponent = vdupq_n_u32(0x40000000);
+    const float32x4_t three = vdupq_n_f32(3.f);
+    for (; i + 4 <= framesToProcess; i += 4)
+    {
+        x = veorq_u32(x, vshlq_n_u32(x, 13));
+        x = veorq_u32(x, vshrq_n_u32(x, 17));
+        x = veorq_u32(x, vshlq_n_u32(x, 5));
+        const uint32x4_t bits = vorrq_u32(vshrq_n_u32(x, 9), exponent);
+        vst1q_f32(destination + i, vsubq_f32(vreinterpretq_f32_u32(bits), three));
+    }
+    vst1q_u32(m_lanes, x);
+#endif
+
+    // the remainder, and everything without a vector unit, one lane at a time
+    for (int lane = 0; i < framesToProcess; ++i)
+    {
+        destination[i] = bipolar(xorshift32(m_lanes[lane]));
+        lane = (lane + 1) & (Lanes - 1);
+    }
+}
+
+void RandomGenerator::pink(float * destination, int framesToProcess)
+{
+    // reference: http://www.firstpr.com.au/dsp/pink-noise/
+    // Six one pole filters are summed with a one frame delay and the white noise itself.
+    // The filters are independent, so with a vector unit they run side by side in lanes.
+#ifdef __SSE2__
+    const __m128 poles0 = _mm_setr_ps(0.99886f, 0.99332f, 0.96900f, 0.86650f);
+    const __m128 gains0 = _mm_setr_ps(0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f);
+    const __m128 poles1 = _mm_setr_ps(0.55000f, -0.7616f, 0.f, 0.f);
+    const __m128 gains1 = _mm_setr_ps(0.5329522f, -0.0168980f, 0.5362f, 0.f);
+    __m128 b0 = _mm_loadu_ps(m_pink);
+    __m128 b1 = _mm_setr_ps(m_pink[4], m_pink[5], 0.f, 0.f);
+#elif defined(ARM_NEON_INTRINSICS)
+    const float poles[8] = {0.99886f, 0.99332f, 0.96900f, 0.86650f, 0.55000f, -0.7616f, 0.f, 0.f};
+    const float gains[8] = {0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f, 0.5329522f, -0.0168980f, 0.5362f, 0.f};
+    const float32x4_t poles0 = vld1q_f32(poles), poles1 = vld1q_f32(poles + 4);
+    const float32x4_t gains0 = vld1q_f32(gains), gains1 = vld1q_f32(gains + 4);
+    float32x4_t b0 = vld1q_f32(m_pink);
+    float32x4_t b1 = {m_pink[4], m_pink[5], 0.f, 0.f};
+#else
+    float b0 = m_pink[0], b1 = m_pink[1], b2 = m_pink[2], b3 = m_pink[3];
+    float b4 = m_pink[4], b5 = m_pink[5];
+#endif
+    float b6 = m_pink[6];
+
+    for (int start = 0; start < framesToProcess; start += ChunkFrames)
+    {
+        const int frames = std::min(ChunkFrames, framesToProcess - start);
+        float * dest = destination + start;
+        white(dest, frames);
+
+        for (int i = 0; i < frames; ++i)
+        {
+            const float w = dest[i];
+#ifdef __SSE2__
+            const __m128 white = _mm_set1_ps(w);
+            b0 = _mm_add_ps(_mm_mul_ps(poles0, b0), _mm_mul_ps(gains0, white));
+            b1 = _mm_add_ps(_mm_mul_ps(poles1, b1), _mm_mul_ps(gains1, white));
+            __m128 sum = _mm_add_ps(b0, b1);
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            const float total = _mm_cvtss_f32(sum) + b6;
+#elif defined(ARM_NEON_INTRINSICS)
+            b0 = vmlaq_n_f32(vmulq_f32(poles0, b0), gains0, w);
+            b1 = vmlaq_n_f32(vmulq_f32(poles1, b1), gains1, w);
+            const float32x4_t sum = vaddq_f32(b0, b1);
+            const float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+            const float total = vget_lane_f32(vpadd_f32(pair, pair), 0) + b6;
+#else
+            b0 = 0.99886f * b0 + w * 0.0555179f;
+            b1 = 0.99332f * b1 + w * 0.0750759f;
+            b2 = 0.96900f * b2 + w * 0.1538520f;
+            b3 = 0.86650f * b3 + w * 0.3104856f;
+            b4 = 0.55000f * b4 + w * 0.5329522f;
+            b5 = -0.7616f * b5 - w * 0.0168980f;
+            const float total = b0 + b1 + b2 + b3 + b4 + b5 + b6 + w * 0.5362f;
+#endif
+            dest[i] = total * 0.11f;  // .11 roughly compensates gain
+            b6 = w * 0.115926f;
+        }
+    }
+
+#ifdef __SSE2__
+    alignas(16) float lanes[4];
+    _mm_storeu_ps(m_pink, b0);
+    _mm_store_ps(lanes, b1);
+    m_pink[4] = lanes[0];
+    m_pink[5] = lanes[1];
+#elif defined(ARM_NEON_INTRINSICS)
+    vst1q_f32(m_pink, b0);
+    m_pink[4] = vgetq_lane_f32(b1, 0);
+    m_pink[5] = vgetq_lane_f32(b1, 1);
+#else
+    m_pink[0] = b0; m_pink[1] = b1; m_pink[2] = b2; m_pink[3] = b3;
+    m_pink[4] = b4; m_pink[5] = b5;
+#endif
+    m_pink[6] = b6;
+}
+
+void RandomGenerator::brown(float * destination, int framesToProcess)
+{
+    float brown = m_brown;
+
+    for (int start = 0; start < framesToProcess; start += ChunkFrames)
+    {
+        const int frames = std::min(ChunkFrames, framesToProcess - start);
+        float * dest = destination + start;
+        white(dest, frames);
+
+        for (int i = 0; i < frames; ++i)
+        {
+            brown = (brown + 0.02f * dest[i]) * (1.f / 1.02f);
+            dest[i] = brown * 3.5f;  // roughly compensates gain
+        }
+    }
+
+    m_brown = brown;
+}
+
+}  // namespace lab
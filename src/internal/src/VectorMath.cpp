@@ -20,6 +20,7 @@
 #endif
 
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <math.h>
 
@@ -784,6 +785,394 @@ namespace VectorMath
         }
     }
 
+    void vramp(const float * start, const float * step, float * destP, int destStride, int framesToProcess)
+    {
+        const float a = *start;
+        const float k = *step;
+        int i = 0;
+
+        // Each value is computed from its index rather than accumulated, so errors don't build up along the ramp.
+#ifdef __SSE2__
+        if (destStride == 1)
+        {
+            const int end = framesToProcess - framesToProcess % 4;
+            __m128 index = _mm_set_ps(3, 2, 1, 0);
+            const __m128 four = _mm_set_ps1(4);
+            const __m128 mStart = _mm_set_ps1(a);
+            const __m128 mStep = _mm_set_ps1(k);
+            for (; i < end; i += 4)
+            {
+                _mm_storeu_ps(destP + i, _mm_add_ps(mStart, _mm_mul_ps(index, mStep)));
+                index = _mm_add_ps(index, four);
+            }
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        if (destStride == 1)
+        {
+            const int end = framesToProcess - framesToProcess % 4;
+            const float lanes[4] = {0, 1, 2, 3};
+            float32x4_t index = vld1q_f32(lanes);
+            const float32x4_t four = vdupq_n_f32(4);
+            const float32x4_t mStart = vdupq_n_f32(a);
+            for (; i < end; i += 4)
+            {
+                vst1q_f32(destP + i, vmlaq_n_f32(mStart, index, k));
+                index = vaddq_f32(index, four);
+            }
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+            destP[i * destStride] = a + static_cast<float>(i) * k;
+    }
+
+    void vgeom(const float * start, const float * ratio, const float * offset, float * destP, int destStride, int framesToProcess)
+    {
+        const double r = *ratio;
+        const float c = *offset;
+
+        // Four lanes step by ratio^4 at a time, so the recurrence has no serial dependency between
+        // neighbouring frames. Each block restarts from an exact power to bound the accumulated error.
+        const int BlockSize = 128;
+        for (int blockStart = 0; blockStart < framesToProcess; blockStart += BlockSize)
+        {
+            const int blockFrames = std::min(BlockSize, framesToProcess - blockStart);
+            const double anchor = *start * (blockStart ? pow(r, blockStart) : 1.0);
+            float lanes[4] = {static_cast<float>(anchor), static_cast<float>(anchor * r),
+                              static_cast<float>(anchor * r * r), static_cast<float>(anchor * r * r * r)};
+            const float r4 = static_cast<float>(r * r * r * r);
+            float * dest = destP + blockStart * destStride;
+            int i = 0;
+
+#ifdef __SSE2__
+            if (destStride == 1)
+            {
+                const int end = blockFrames - blockFrames % 4;
+                __m128 p = _mm_loadu_ps(lanes);
+                const __m128 mRatio = _mm_set_ps1(r4);
+                const __m128 mOffset = _mm_set_ps1(c);
+                for (; i < end; i += 4)
+                {
+                    _mm_storeu_ps(dest + i, _mm_add_ps(mOffset, p));
+                    p = _mm_mul_ps(p, mRatio);
+                }
+                _mm_storeu_ps(lanes, p);
+            }
+#elif defined(ARM_NEON_INTRINSICS)
+            if (destStride == 1)
+            {
+                const int end = blockFrames - blockFrames % 4;
+                float32x4_t p = vld1q_f32(lanes);
+                const float32x4_t mOffset = vdupq_n_f32(c);
+                for (; i < end; i += 4)
+                {
+                    vst1q_f32(dest + i, vaddq_f32(mOffset, p));
+                    p = vmulq_n_f32(p, r4);
+                }
+                vst1q_f32(lanes, p);
+            }
+#endif
+            for (int lane = 0; i < blockFrames; ++i)
+            {
+                dest[i * destStride] = c + lanes[lane];
+                lanes[lane] *= r4;
+                lane = (lane + 1) & 3;
+            }
+        }
+    }
+
+    void vbfly(float * aP, float * bP, int framesToProcess)
+    {
+        int i = 0;
+
+#ifdef __SSE2__
+        const int end = framesToProcess - framesToProcess % 4;
+        for (; i < end; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps(aP + i);
+            const __m128 b = _mm_loadu_ps(bP + i);
+            _mm_storeu_ps(aP + i, _mm_add_ps(a, b));
+            _mm_storeu_ps(bP + i, _mm_sub_ps(a, b));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const int end = framesToProcess - framesToProcess % 4;
+        for (; i < end; i += 4)
+        {
+            const float32x4_t a = vld1q_f32(aP + i);
+            const float32x4_t b = vld1q_f32(bP + i);
+            vst1q_f32(aP + i, vaddq_f32(a, b));
+            vst1q_f32(bP + i, vsubq_f32(a, b));
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            const float a = aP[i];
+            const float b = bP[i];
+            aP[i] = a + b;
+            bP[i] = a - b;
+        }
+    }
+
+    // log2(m) for a mantissa m in [sqrt(1/2), sqrt(2)) is an odd series in t = (m - 1) / (m + 1).
+    static const float Log2C1 = 2.8853901f;
+    static const float Log2C3 = 0.96179669f;
+    static const float Log2C5 = 0.57707801f;
+    static const float Log2C7 = 0.41219858f;
+
+    // Minimax polynomial for 2^f, f in [0, 1).
+    static const float Exp2C1 = 0.69315308f;
+    static const float Exp2C2 = 0.24015361f;
+    static const float Exp2C3 = 0.055826318f;
+    static const float Exp2C4 = 0.0089893397f;
+    static const float Exp2C5 = 0.0018775767f;
+
+    void vlog2(const float * sourceP, float * destP, int framesToProcess)
+    {
+        int i = 0;
+
+#ifdef __SSE2__
+        const int end = framesToProcess - framesToProcess % 4;
+        const __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+        const __m128i one = _mm_set1_epi32(0x3f800000);
+        const __m128i bias = _mm_set1_epi32(127);
+        const __m128 sqrt2 = _mm_set1_ps(1.41421356f);
+        for (; i < end; i += 4)
+        {
+            const __m128i bits = _mm_castps_si128(_mm_loadu_ps(sourceP + i));
+            __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+            __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), one));
+
+            // keep the mantissa within half an octave of one
+            const __m128 isLarge = _mm_cmpgt_ps(m, sqrt2);
+            m = _mm_or_ps(_mm_and_ps(isLarge, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(isLarge, m));
+            exponent = _mm_add_ps(exponent, _mm_and_ps(isLarge, _mm_set1_ps(1.f)));
+
+            const __m128 t = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.f)), _mm_add_ps(m, _mm_set1_ps(1.f)));
+            const __m128 t2 = _mm_mul_ps(t, t);
+            __m128 p = _mm_add_ps(_mm_set1_ps(Log2C5), _mm_mul_ps(t2, _mm_set1_ps(Log2C7)));
+            p = _mm_add_ps(_mm_set1_ps(Log2C3), _mm_mul_ps(t2, p));
+            p = _mm_add_ps(_mm_set1_ps(Log2C1), _mm_mul_ps(t2, p));
+            _mm_storeu_ps(destP + i, _mm_add_ps(exponent, _mm_mul_ps(t, p)));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const int end = framesToProcess - framesToProcess % 4;
+        const uint32x4_t mantissaMask = vdupq_n_u32(0x007fffff);
+        const uint32x4_t one = vdupq_n_u32(0x3f800000);
+        const int32x4_t bias = vdupq_n_s32(127);
+        const float32x4_t sqrt2 = vdupq_n_f32(1.41421356f);
+        for (; i < end; i += 4)
+        {
+            const uint32x4_t bits = vreinterpretq_u32_f32(vld1q_f32(sourceP + i));
+            float32x4_t exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), bias));
+            float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissaMask), one));
+
+            // keep the mantissa within half an octave of one
+            const uint32x4_t isLarge = vcgtq_f32(m, sqrt2);
+            m = vbslq_f32(isLarge, vmulq_n_f32(m, 0.5f), m);
+            exponent = vaddq_f32(exponent, vbslq_f32(isLarge, vdupq_n_f32(1.f), vdupq_n_f32(0.f)));
+
+            // (m - 1) / (m + 1), with a refined reciprocal estimate
+            const float32x4_t denominator = vaddq_f32(m, vdupq_n_f32(1.f));
+            float32x4_t reciprocal = vrecpeq_f32(denominator);
+            reciprocal = vmulq_f32(reciprocal, vrecpsq_f32(denominator, reciprocal));
+            reciprocal = vmulq_f32(reciprocal, vrecpsq_f32(denominator, reciprocal));
+            const float32x4_t t = vmulq_f32(vsubq_f32(m, vdupq_n_f32(1.f)), reciprocal);
+            const float32x4_t t2 = vmulq_f32(t, t);
+            float32x4_t p = vmlaq_f32(vdupq_n_f32(Log2C5), t2, vdupq_n_f32(Log2C7));
+            p = vmlaq_f32(vdupq_n_f32(Log2C3), t2, p);
+            p = vmlaq_f32(vdupq_n_f32(Log2C1), t2, p);
+            vst1q_f32(destP + i, vmlaq_f32(exponent, t, p));
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            uint32_t bits;
+            memcpy(&bits, sourceP + i, sizeof(bits));
+            int exponent = static_cast<int>(bits >> 23) - 127;
+            bits = (bits & 0x007fffff) | 0x3f800000;
+            float m;
+            memcpy(&m, &bits, sizeof(m));
+            if (m > 1.41421356f)
+            {
+                m *= 0.5f;
+                exponent += 1;
+            }
+            const float t = (m - 1.f) / (m + 1.f);
+            const float t2 = t * t;
+            destP[i] = static_cast<float>(exponent) + t * (Log2C1 + t2 * (Log2C3 + t2 * (Log2C5 + t2 * Log2C7)));
+        }
+    }
+
+    void vexp2(const float * sourceP, float * destP, int framesToProcess)
+    {
+        int i = 0;
+
+#ifdef __SSE2__
+        const int end = framesToProcess - framesToProcess % 4;
+        const __m128 low = _mm_set1_ps(-126.f);
+        const __m128 high = _mm_set1_ps(127.f);
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128i bias = _mm_set1_epi32(127);
+        for (; i < end; i += 4)
+        {
+            const __m128 x = _mm_min_ps(high, _mm_max_ps(low, _mm_loadu_ps(sourceP + i)));
+
+            // floor, from truncation
+            __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+            whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, x), one));
+            const __m128 f = _mm_sub_ps(x, whole);
+
+            __m128 p = _mm_add_ps(_mm_set1_ps(Exp2C4), _mm_mul_ps(f, _mm_set1_ps(Exp2C5)));
+            p = _mm_add_ps(_mm_set1_ps(Exp2C3), _mm_mul_ps(f, p));
+            p = _mm_add_ps(_mm_set1_ps(Exp2C2), _mm_mul_ps(f, p));
+            p = _mm_add_ps(_mm_set1_ps(Exp2C1), _mm_mul_ps(f, p));
+            p = _mm_add_ps(one, _mm_mul_ps(f, p));
+
+            const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(whole), bias), 23));
+            _mm_storeu_ps(destP + i, _mm_mul_ps(p, scale));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const int end = framesToProcess - framesToProcess % 4;
+        const float32x4_t low = vdupq_n_f32(-126.f);
+        const float32x4_t high = vdupq_n_f32(127.f);
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const int32x4_t bias = vdupq_n_s32(127);
+        for (; i < end; i += 4)
+        {
+            const float32x4_t x = vminq_f32(high, vmaxq_f32(low, vld1q_f32(sourceP + i)));
+
+            // floor, from truncation
+            float32x4_t whole = vcvtq_f32_s32(vcvtq_s32_f32(x));
+            whole = vsubq_f32(whole, vbslq_f32(vcgtq_f32(whole, x), one, vdupq_n_f32(0.f)));
+            const float32x4_t f = vsubq_f32(x, whole);
+
+            float32x4_t p = vmlaq_f32(vdupq_n_f32(Exp2C4), f, vdupq_n_f32(Exp2C5));
+            p = vmlaq_f32(vdupq_n_f32(Exp2C3), f, p);
+            p = vmlaq_f32(vdupq_n_f32(Exp2C2), f, p);
+            p = vmlaq_f32(vdupq_n_f32(Exp2C1), f, p);
+            p = vmlaq_f32(one, f, p);
+
+            const float32x4_t scale = vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(whole), bias), 23));
+            vst1q_f32(destP + i, vmulq_f32(p, scale));
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            const float x = std::min(127.f, std::max(-126.f, sourceP[i]));
+            int whole = static_cast<int>(x);
+            whole -= static_cast<float>(whole) > x;
+            const float f = x - static_cast<float>(whole);
+            const float p = 1.f + f * (Exp2C1 + f * (Exp2C2 + f * (Exp2C3 + f * (Exp2C4 + f * Exp2C5))));
+            const uint32_t bits = static_cast<uint32_t>(whole + 127) << 23;
+            float scale;
+            memcpy(&scale, &bits, sizeof(scale));
+            destP[i] = p * scale;
+        }
+    }
+
+    void vlint(const float * tableP, const float * positionP, float * destP, int framesToProcess)
+    {
+        int i = 0;
+
+#ifdef __SSE2__
+        const int end = framesToProcess - framesToProcess % 4;
+        for (; i < end; i += 4)
+        {
+            const __m128 position = _mm_loadu_ps(positionP + i);
+            const __m128i whole = _mm_cvttps_epi32(position);
+            const __m128 fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(whole));
+
+            // the table reads are scalar, the interpolation is not
+            alignas(16) int32_t index[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(index), whole);
+            const __m128 a = _mm_setr_ps(tableP[index[0]], tableP[index[1]], tableP[index[2]], tableP[index[3]]);
+            const __m128 b = _mm_setr_ps(tableP[index[0] + 1], tableP[index[1] + 1], tableP[index[2] + 1], tableP[index[3] + 1]);
+            _mm_storeu_ps(destP + i, _mm_add_ps(a, _mm_mul_ps(fraction, _mm_sub_ps(b, a))));
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const int end = framesToProcess - framesToProcess % 4;
+        for (; i < end; i += 4)
+        {
+            const float32x4_t position = vld1q_f32(positionP + i);
+            const int32x4_t whole = vcvtq_s32_f32(position);
+            const float32x4_t fraction = vsubq_f32(position, vcvtq_f32_s32(whole));
+
+            // the table reads are scalar, the interpolation is not
+            int32_t index[4];
+            vst1q_s32(index, whole);
+            const float ap[4] = {tableP[index[0]], tableP[index[1]], tableP[index[2]], tableP[index[3]]};
+            const float bp[4] = {tableP[index[0] + 1], tableP[index[1] + 1], tableP[index[2] + 1], tableP[index[3] + 1]};
+            const float32x4_t a = vld1q_f32(ap);
+            vst1q_f32(destP + i, vmlaq_f32(a, fraction, vsubq_f32(vld1q_f32(bp), a)));
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            const float position = positionP[i];
+            const int index = static_cast<int>(position);
+            const float a = tableP[index];
+            destP[i] = a + (position - static_cast<float>(index)) * (tableP[index + 1] - a);
+        }
+    }
+
+    void vwrap(const float * sourceP, const float * period, float * destP, int framesToProcess)
+    {
+        const float p = *period;
+        const float inverse = 1.f / p;
+        int i = 0;
+
+#ifdef __SSE2__
+        const int end = framesToProcess - framesToProcess % 4;
+        const __m128 mPeriod = _mm_set1_ps(p);
+        const __m128 mInverse = _mm_set1_ps(inverse);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.f);
+        for (; i < end; i += 4)
+        {
+            const __m128 source = _mm_loadu_ps(sourceP + i);
+            const __m128 cycles = _mm_mul_ps(source, mInverse);
+
+            // floor is truncation, less one where truncation rounded up
+            __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(cycles));
+            whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, cycles), one));
+            __m128 wrapped = _mm_sub_ps(source, _mm_mul_ps(whole, mPeriod));
+
+            // rounding can leave the result a hair outside the period
+            wrapped = _mm_sub_ps(wrapped, _mm_and_ps(_mm_cmpge_ps(wrapped, mPeriod), mPeriod));
+            wrapped = _mm_add_ps(wrapped, _mm_and_ps(_mm_cmplt_ps(wrapped, zero), mPeriod));
+            _mm_storeu_ps(destP + i, wrapped);
+        }
+#elif defined(ARM_NEON_INTRINSICS)
+        const int end = framesToProcess - framesToProcess % 4;
+        const float32x4_t mPeriod = vdupq_n_f32(p);
+        const float32x4_t zero = vdupq_n_f32(0.f);
+        const float32x4_t one = vdupq_n_f32(1.f);
+        for (; i < end; i += 4)
+        {
+            const float32x4_t source = vld1q_f32(sourceP + i);
+            const float32x4_t cycles = vmulq_n_f32(source, inverse);
+
+            // floor is truncation, less one where truncation rounded up
+            float32x4_t whole = vcvtq_f32_s32(vcvtq_s32_f32(cycles));
+            whole = vsubq_f32(whole, vbslq_f32(vcgtq_f32(whole, cycles), one, zero));
+            float32x4_t wrapped = vmlsq_f32(source, whole, mPeriod);
+
+            // rounding can leave the result a hair outside the period
+            wrapped = vsubq_f32(wrapped, vbslq_f32(vcgeq_f32(wrapped, mPeriod), mPeriod, zero));
+            wrapped = vaddq_f32(wrapped, vbslq_f32(vcltq_f32(wrapped, zero), mPeriod, zero));
+            vst1q_f32(destP + i, wrapped);
+        }
+#endif
+        for (; i < framesToProcess; ++i)
+        {
+            float wrapped = sourceP[i] - p * floorf(sourceP[i] * inverse);
+            if (wrapped >= p)
+                wrapped -= p;
+            else if (wrapped < 0.f)
+                wrapped += p;
+            destP[i] = wrapped;
+        }
+    }
+
 }  // namespace VectorMath
 
 }  // namespace lab